@@ -0,0 +1,110 @@
+/**
+ * @file bench_context.cc
+ * @brief Contention benchmark for json_context_find_field(), 1 to 64
+ *        threads sharing one context.
+ *
+ * "locked" wraps each lookup in the context mutex, which is what every
+ * lookup paid before the table became an immutable published snapshot;
+ * "lockfree" is the current read path. "republish" adds a writer that
+ * swaps in a new table every 1024 lookups of thread 0.
+ */
+
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <vector>
+
+extern "C" {
+#include "utils/json_context.h"
+}
+
+static const int kStructs = 16;
+static const int kFields = 16;
+
+/* Mirrors hash_2s_c() in json_context.c. */
+static unsigned int hash_2s(const char* key1, const char* key2) {
+    unsigned int res = 0xbc9f1d34;
+    const unsigned int m = 0xc6a4a793;
+    for (const char* p = key1; *p; p++) res = res * m + (unsigned char)*p;
+    res = res * m + '#';
+    for (const char* p = key2; *p; p++) res = res * m + (unsigned char)*p;
+    return res;
+}
+
+struct ContextFixture {
+    std::vector<std::vector<char>> names;
+    std::vector<struct json_field_offset_item> items;
+    std::vector<int> hash;
+    struct json_context* ctx = nullptr;
+
+    ContextFixture() {
+        names.reserve(kStructs + kFields);
+        for (int i = 0; i < kStructs; i++) add_name("struct_%d", i);
+        for (int i = 0; i < kFields; i++) add_name("field_%d", i);
+        for (int s = 0; s < kStructs; s++) {
+            for (int f = 0; f < kFields; f++) {
+                items.push_back({f * 8, 8, 0, "long", names[kStructs + f].data(),
+                                 names[s].data(), 0});
+            }
+        }
+        hash.assign(items.size() * 2, -1);
+        for (size_t i = 0; i < items.size(); i++) {
+            size_t h = hash_2s(items[i].struct_name, items[i].field_name) %
+                       hash.size();
+            while (hash[h] >= 0) h = (h + 1) % hash.size();
+            hash[h] = (int)i;
+        }
+        ctx = json_context_new();
+        publish();
+    }
+    ~ContextFixture() { json_context_free(ctx); }
+
+    void add_name(const char* fmt, int i) {
+        std::vector<char> buf(16);
+        snprintf(buf.data(), buf.size(), fmt, i);
+        names.push_back(buf);
+    }
+    void publish() {
+        json_context_init(ctx, items.data(), (int)items.size(), hash.data(),
+                          (int)hash.size());
+    }
+};
+
+static ContextFixture* g_fixture;
+
+static void setup(const benchmark::State& s) {
+    (void)s;
+    g_fixture = new ContextFixture();
+}
+static void teardown(const benchmark::State& s) {
+    (void)s;
+    delete g_fixture;
+    g_fixture = nullptr;
+}
+
+static void BM_find_field(benchmark::State& s) {
+    const bool locked = s.range(0) == 1;
+    const bool republish = s.range(0) == 2;
+    struct json_context* ctx = g_fixture->ctx;
+    size_t i = (size_t)s.thread_index() * 7;
+    const size_t n = g_fixture->items.size();
+    for (auto _ : s) {
+        const struct json_field_offset_item& want = g_fixture->items[i % n];
+        if (locked) compat_mutex_lock(&ctx->mutex);
+        benchmark::DoNotOptimize(
+            json_context_find_field(ctx, want.struct_name, want.field_name));
+        if (locked) compat_mutex_unlock(&ctx->mutex);
+        if (republish && s.thread_index() == 0 && (i & 1023) == 0) {
+            g_fixture->publish();
+        }
+        i++;
+    }
+    s.SetItemsProcessed((int64_t)s.iterations());
+}
+
+/* Arg 0 = lockfree, 1 = locked, 2 = lockfree with a republishing writer. */
+BENCHMARK(BM_find_field)
+    ->ArgName("mode")->Arg(0)->Arg(1)->Arg(2)
+    ->ThreadRange(1, 64)->UseRealTime()
+    ->Setup(setup)->Teardown(teardown);
+
+BENCHMARK_MAIN();
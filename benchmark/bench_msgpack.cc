@@ -0,0 +1,85 @@
+/**
+ * @file bench_msgpack.cc
+ * @brief msgpack_unpack_<struct>() against msgpack_unpack_<struct>_borrow()
+ *        on the benchmark schema (structs.json-gen-c).
+ *
+ * Arg "borrow" selects the entry point: 0 copies every string into its
+ * sstr_t, 1 leaves sstr_ref() strings pointing into the input. Each
+ * iteration decodes into a fresh object and clears it, as a request
+ * handler would.
+ */
+
+#include <benchmark/benchmark.h>
+#include <cstring>
+
+extern "C" {
+#include "msgpack.gen.h"
+}
+
+static void fill_address(struct address* a, const char* street,
+                         const char* city, const char* state,
+                         const char* zip) {
+    sstr_append_cstr(a->street, street);
+    sstr_append_cstr(a->city, city);
+    sstr_append_cstr(a->state, state);
+    sstr_append_cstr(a->zip, zip);
+}
+
+static sstr_t pack_nested(void) {
+    struct nested o;
+    nested_init(&o);
+    sstr_append_cstr(o.name, "John Doe");
+    o.age = 42;
+    fill_address(&o.home_addr, "123 Main St", "Springfield", "IL", "62701");
+    fill_address(&o.work_addr, "456 Oak Ave", "Chicago", "IL", "60601");
+    sstr_t wire = sstr_new();
+    msgpack_pack_nested(&o, wire);
+    nested_clear(&o);
+    return wire;
+}
+
+static sstr_t pack_string_heavy(void) {
+    struct string_heavy o;
+    string_heavy_init(&o);
+    sstr_append_cstr(o.first_name, "Alexander");
+    sstr_append_cstr(o.last_name, "Constantinovich");
+    sstr_append_cstr(o.email, "alexander.constantinovich@example.com");
+    sstr_append_cstr(o.phone, "+1-555-123-4567");
+    sstr_append_cstr(o.bio,
+                     "A software engineer with over 15 years of experience "
+                     "in distributed systems and compiler design.");
+    sstr_append_cstr(o.website, "https://example.com/alexander");
+    sstr_append_cstr(o.company, "Acme Corporation International");
+    sstr_append_cstr(o.title, "Principal Software Engineer");
+    sstr_t wire = sstr_new();
+    msgpack_pack_string_heavy(&o, wire);
+    string_heavy_clear(&o);
+    return wire;
+}
+
+#define MSGPACK_UNPACK_BENCH(S)                                              \
+    static void BM_unpack_##S(benchmark::State& s) {                         \
+        const bool borrow = s.range(0) != 0;                                 \
+        sstr_t wire = pack_##S();                                            \
+        const unsigned char* in = (const unsigned char*)sstr_cstr(wire);     \
+        size_t len = sstr_length(wire);                                      \
+        for (auto _ : s) {                                                   \
+            struct S o;                                                      \
+            S##_init(&o);                                                    \
+            if (borrow) {                                                    \
+                msgpack_unpack_##S##_borrow(in, len, &o);                    \
+            } else {                                                         \
+                msgpack_unpack_##S(in, len, &o);                             \
+            }                                                                \
+            benchmark::DoNotOptimize(&o);                                    \
+            S##_clear(&o);                                                   \
+        }                                                                    \
+        s.SetBytesProcessed((int64_t)s.iterations() * (int64_t)len);         \
+        sstr_free(wire);                                                     \
+    }                                                                        \
+    BENCHMARK(BM_unpack_##S)->ArgName("borrow")->Arg(0)->Arg(1)
+
+MSGPACK_UNPACK_BENCH(nested);
+MSGPACK_UNPACK_BENCH(string_heavy);
+
+BENCHMARK_MAIN();
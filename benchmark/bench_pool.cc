@@ -0,0 +1,142 @@
+/**
+ * @file bench_pool.cc
+ * @brief jgenc_pool against the default allocator (glibc malloc) on
+ *        decode-shaped workloads, from 1 to 64 threads.
+ *
+ * The decode benchmarks unmarshal and clear a struct per iteration, so
+ * every sstr_t header, string buffer and nested object goes through the
+ * allocator. The churn benchmarks replay a synthetic allocator workload in
+ * the style of the jemalloc/mimalloc stress tests: a sliding window of
+ * live blocks, mostly 16-256 bytes with an occasional large one, freed in
+ * a different order than allocated.
+ */
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+extern "C" {
+#include "json.gen.h"
+}
+
+static const char POOL_JSON_NESTED[] =
+    "{\"name\":\"John Doe\",\"age\":42,"
+    "\"home_addr\":{\"street\":\"123 Main St\",\"city\":\"Springfield\","
+    "\"state\":\"IL\",\"zip\":\"62701\"},"
+    "\"work_addr\":{\"street\":\"456 Oak Ave\",\"city\":\"Chicago\","
+    "\"state\":\"IL\",\"zip\":\"60601\"}}";
+
+static const char POOL_JSON_STRING_HEAVY[] =
+    "{\"first_name\":\"Alexander\",\"last_name\":\"Constantinovich\","
+    "\"email\":\"alexander.constantinovich@example.com\","
+    "\"phone\":\"+1-555-123-4567\","
+    "\"bio\":\"A software engineer with over 15 years of experience "
+    "in distributed systems and compiler design.\","
+    "\"website\":\"https://example.com/alexander\","
+    "\"company\":\"Acme Corporation International\","
+    "\"title\":\"Principal Software Engineer\"}";
+
+/* One pool per benchmark thread, installed for the whole run. */
+struct ThreadPool {
+    struct jgenc_pool* pool = nullptr;
+    explicit ThreadPool(bool on) {
+        if (on) {
+            pool = jgenc_pool_new();
+            jgenc_set_thread_allocator(jgenc_pool_allocator(pool));
+        }
+    }
+    ~ThreadPool() {
+        if (pool != nullptr) {
+            jgenc_set_thread_allocator(nullptr);
+            jgenc_pool_destroy(pool);
+        }
+    }
+};
+
+static void BM_decode_nested(benchmark::State& s) {
+    ThreadPool tp(s.range(0) != 0);
+    sstr_t in = sstr(POOL_JSON_NESTED);
+    size_t t = 0;
+    for (auto _ : s) {
+        struct nested o;
+        nested_init(&o);
+        json_unmarshal_nested(in, &o);
+        benchmark::DoNotOptimize(o.age);
+        nested_clear(&o);
+        t += sstr_length(in);
+    }
+    s.SetBytesProcessed((int64_t)t);
+    sstr_free(in);
+}
+
+static void BM_decode_string_heavy(benchmark::State& s) {
+    ThreadPool tp(s.range(0) != 0);
+    sstr_t in = sstr(POOL_JSON_STRING_HEAVY);
+    size_t t = 0;
+    for (auto _ : s) {
+        struct string_heavy o;
+        string_heavy_init(&o);
+        json_unmarshal_string_heavy(in, &o);
+        benchmark::DoNotOptimize(o.bio);
+        string_heavy_clear(&o);
+        t += sstr_length(in);
+    }
+    s.SetBytesProcessed((int64_t)t);
+    sstr_free(in);
+}
+
+/* Batch of decoded objects kept alive together, freed in one sweep: the
+ * shape of a request handler that decodes a page of records. */
+static void BM_decode_nested_batch(benchmark::State& s) {
+    ThreadPool tp(s.range(0) != 0);
+    const int n = 256;
+    sstr_t in = sstr(POOL_JSON_NESTED);
+    auto* objs = new struct nested[n];
+    for (auto _ : s) {
+        for (int i = 0; i < n; i++) {
+            nested_init(&objs[i]);
+            json_unmarshal_nested(in, &objs[i]);
+        }
+        for (int i = 0; i < n; i++) {
+            nested_clear(&objs[i]);
+        }
+    }
+    s.SetItemsProcessed((int64_t)s.iterations() * n);
+    delete[] objs;
+    sstr_free(in);
+}
+
+static void BM_churn(benchmark::State& s) {
+    ThreadPool tp(s.range(0) != 0);
+    const int window = 1024;
+    void* live[window] = {nullptr};
+    uint32_t rng = 0x9e3779b9u;
+    for (auto _ : s) {
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        int slot = (int)(rng % window);
+        size_t size = (rng >> 16) % 64 == 0 ? 1024 + (rng >> 22)
+                                              : 16 + ((rng >> 10) % 241);
+        jgenc_free(live[slot]);
+        live[slot] = jgenc_malloc(size);
+        memset(live[slot], 0, 16);
+    }
+    for (int i = 0; i < window; i++) {
+        jgenc_free(live[i]);
+    }
+    s.SetItemsProcessed((int64_t)s.iterations());
+}
+
+/* Arg 0 = malloc, 1 = jgenc_pool. */
+#define POOL_BENCH(fn)                                              \
+    BENCHMARK(fn)->ArgName("pool")->Arg(0)->Arg(1)->ThreadRange(1, 64) \
+        ->UseRealTime()
+
+POOL_BENCH(BM_decode_nested);
+POOL_BENCH(BM_decode_string_heavy);
+POOL_BENCH(BM_decode_nested_batch);
+POOL_BENCH(BM_churn);
+
+BENCHMARK_MAIN();
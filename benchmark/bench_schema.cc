@@ -0,0 +1,193 @@
+/**
+ * @file bench_schema.cc
+ * @brief Schema interpreter against the generated code for the same
+ *        schema (structs.json-gen-c).
+ *
+ * Arg "interp" selects the implementation: 0 = generated functions,
+ * 1 = jgenc_schema_* over the same struct. Both decode into and encode from
+ * the generated struct type, so the objects and output are identical and
+ * only the dispatch differs. BM_cache_hit is the per-request cost of
+ * looking a tenant schema up in a jgenc_schema_cache.
+ */
+
+#include <benchmark/benchmark.h>
+#include <cstring>
+
+extern "C" {
+#include "json.gen.h"
+#include "schema/schema_runtime.h"
+}
+
+static const char SCHEMA_TEXT[] = R"(
+struct scalar {
+    int int_val1;
+    int int_val2;
+    long long_val;
+    double double_val;
+    float float_val;
+    sstr_t sstr_val;
+};
+struct address {
+    sstr_t street;
+    sstr_t city;
+    sstr_t state;
+    sstr_t zip;
+};
+struct nested {
+    sstr_t name;
+    int age;
+    address home_addr;
+    address work_addr;
+};
+struct string_heavy {
+    sstr_t first_name;
+    sstr_t last_name;
+    sstr_t email;
+    sstr_t phone;
+    sstr_t bio;
+    sstr_t website;
+    sstr_t company;
+    sstr_t title;
+};
+)";
+
+static const char SCHEMA_JSON_SCALAR[] =
+    "{\"int_val1\":12345,\"int_val2\":-67890,\"long_val\":9876543210,"
+    "\"double_val\":3.141592653589793,\"float_val\":2.718,"
+    "\"sstr_val\":\"hello world\"}";
+
+static const char SCHEMA_JSON_NESTED[] =
+    "{\"name\":\"John Doe\",\"age\":42,"
+    "\"home_addr\":{\"street\":\"123 Main St\",\"city\":\"Springfield\","
+    "\"state\":\"IL\",\"zip\":\"62701\"},"
+    "\"work_addr\":{\"street\":\"456 Oak Ave\",\"city\":\"Chicago\","
+    "\"state\":\"IL\",\"zip\":\"60601\"}}";
+
+static const char SCHEMA_JSON_STRING_HEAVY[] =
+    "{\"first_name\":\"Alexander\",\"last_name\":\"Constantinovich\","
+    "\"email\":\"alexander.constantinovich@example.com\","
+    "\"phone\":\"+1-555-123-4567\","
+    "\"bio\":\"A software engineer with over 15 years of experience "
+    "in distributed systems and compiler design.\","
+    "\"website\":\"https://example.com/alexander\","
+    "\"company\":\"Acme Corporation International\","
+    "\"title\":\"Principal Software Engineer\"}";
+
+static struct jgenc_schema* g_schema;
+
+static const struct jgenc_schema_type* schema_type(const char* name) {
+    if (g_schema == nullptr) {
+        g_schema = jgenc_schema_compile(SCHEMA_TEXT, sizeof(SCHEMA_TEXT) - 1);
+    }
+    return jgenc_schema_find_type(g_schema, name);
+}
+
+/* Decode then clear one object per iteration. */
+#define SCHEMA_DECODE_BENCH(name, S, input)                                  \
+    static void BM_decode_##name(benchmark::State& s) {                      \
+        const bool interp = s.range(0) != 0;                                 \
+        const struct jgenc_schema_type* t = schema_type(#S);                 \
+        sstr_t in = sstr(input);                                             \
+        for (auto _ : s) {                                                   \
+            struct S o;                                                      \
+            if (interp) {                                                    \
+                jgenc_schema_init(t, &o);                                    \
+                jgenc_schema_json_unmarshal(t, sstr_cstr(in),                \
+                                            sstr_length(in), &o);            \
+                benchmark::DoNotOptimize(&o);                                \
+                jgenc_schema_clear(t, &o);                                   \
+            } else {                                                         \
+                S##_init(&o);                                                \
+                json_unmarshal_##S(in, &o);                                  \
+                benchmark::DoNotOptimize(&o);                                \
+                S##_clear(&o);                                               \
+            }                                                                \
+        }                                                                    \
+        s.SetBytesProcessed((int64_t)s.iterations() *                        \
+                            (int64_t)sstr_length(in));                       \
+        sstr_free(in);                                                       \
+    }                                                                        \
+    BENCHMARK(BM_decode_##name)->ArgName("interp")->Arg(0)->Arg(1)
+
+/* Encode one decoded object per iteration. */
+#define SCHEMA_ENCODE_BENCH(name, S, input)                                  \
+    static void BM_encode_##name(benchmark::State& s) {                      \
+        const bool interp = s.range(0) != 0;                                 \
+        const struct jgenc_schema_type* t = schema_type(#S);                 \
+        sstr_t in = sstr(input);                                             \
+        sstr_t out = sstr_new();                                             \
+        struct S o;                                                          \
+        S##_init(&o);                                                        \
+        json_unmarshal_##S(in, &o);                                          \
+        for (auto _ : s) {                                                   \
+            sstr_clear(out);                                                 \
+            if (interp) {                                                    \
+                jgenc_schema_json_marshal(t, &o, out);                       \
+            } else {                                                         \
+                json_marshal_##S(&o, out);                                   \
+            }                                                                \
+            benchmark::DoNotOptimize(sstr_cstr(out));                        \
+        }                                                                    \
+        s.SetBytesProcessed((int64_t)s.iterations() *                        \
+                            (int64_t)sstr_length(out));                      \
+        S##_clear(&o);                                                       \
+        sstr_free(out);                                                      \
+        sstr_free(in);                                                       \
+    }                                                                        \
+    BENCHMARK(BM_encode_##name)->ArgName("interp")->Arg(0)->Arg(1)
+
+SCHEMA_DECODE_BENCH(scalar, scalar, SCHEMA_JSON_SCALAR);
+SCHEMA_DECODE_BENCH(nested, nested, SCHEMA_JSON_NESTED);
+SCHEMA_DECODE_BENCH(string_heavy, string_heavy, SCHEMA_JSON_STRING_HEAVY);
+SCHEMA_ENCODE_BENCH(scalar, scalar, SCHEMA_JSON_SCALAR);
+SCHEMA_ENCODE_BENCH(nested, nested, SCHEMA_JSON_NESTED);
+SCHEMA_ENCODE_BENCH(string_heavy, string_heavy, SCHEMA_JSON_STRING_HEAVY);
+
+/* Interpreted msgpack round trip (the benchmark schema is generated for
+ * JSON only, so there is no generated counterpart here). */
+static void BM_msgpack_roundtrip_nested(benchmark::State& s) {
+    const struct jgenc_schema_type* t = schema_type("nested");
+    sstr_t in = sstr(SCHEMA_JSON_NESTED);
+    sstr_t wire = sstr_new();
+    struct nested o;
+    nested_init(&o);
+    json_unmarshal_nested(in, &o);
+    for (auto _ : s) {
+        struct nested d;
+        sstr_clear(wire);
+        jgenc_schema_msgpack_pack(t, &o, wire);
+        jgenc_schema_init(t, &d);
+        jgenc_schema_msgpack_unpack(t, (const unsigned char*)sstr_cstr(wire),
+                                    sstr_length(wire), &d);
+        benchmark::DoNotOptimize(&d);
+        jgenc_schema_clear(t, &d);
+    }
+    s.SetBytesProcessed((int64_t)s.iterations() * (int64_t)sstr_length(wire));
+    nested_clear(&o);
+    sstr_free(wire);
+    sstr_free(in);
+}
+BENCHMARK(BM_msgpack_roundtrip_nested);
+
+static void BM_cache_hit(benchmark::State& s) {
+    struct jgenc_schema_cache* cache = jgenc_schema_cache_new();
+    jgenc_schema_cache_compile(cache, SCHEMA_TEXT, sizeof(SCHEMA_TEXT) - 1);
+    for (auto _ : s) {
+        benchmark::DoNotOptimize(jgenc_schema_cache_compile(
+            cache, SCHEMA_TEXT, sizeof(SCHEMA_TEXT) - 1));
+    }
+    jgenc_schema_cache_free(cache);
+}
+BENCHMARK(BM_cache_hit);
+
+static void BM_compile(benchmark::State& s) {
+    for (auto _ : s) {
+        struct jgenc_schema* schema =
+            jgenc_schema_compile(SCHEMA_TEXT, sizeof(SCHEMA_TEXT) - 1);
+        benchmark::DoNotOptimize(schema);
+        jgenc_schema_free(schema);
+    }
+}
+BENCHMARK(BM_compile);
+
+BENCHMARK_MAIN();
@@ -83,6 +83,7 @@ static void BM_jgenc_marshal_string_heavy(benchmark::State& s){struct string_hea
 static void BM_jgenc_unmarshal_string_heavy(benchmark::State& s){struct string_heavy o;fill_string_heavy(&o);sstr_t c=sstr_new();json_marshal_string_heavy(&o,c);size_t t=0;for(auto _:s){string_heavy_clear(&o);json_unmarshal_string_heavy(c,&o);t+=sstr_length(c);}s.SetBytesProcessed((int64_t)t);sstr_free(c);string_heavy_clear(&o);}
 static void BM_jgenc_unmarshal_string_heavy_selected(benchmark::State& s){struct string_heavy seed;fill_string_heavy(&seed);sstr_t c=sstr_new();json_marshal_string_heavy(&seed,c);uint64_t m[string_heavy_FIELD_MASK_WORD_COUNT]={0};JSON_GEN_C_FIELD_MASK_SET(m,string_heavy_FIELD_email);JSON_GEN_C_FIELD_MASK_SET(m,string_heavy_FIELD_phone);size_t t=0;for(auto _:s){struct string_heavy o;string_heavy_init(&o);json_unmarshal_selected_string_heavy(c,&o,m,string_heavy_FIELD_MASK_WORD_COUNT);t+=sstr_length(c);string_heavy_clear(&o);}s.SetBytesProcessed((int64_t)t);sstr_free(c);string_heavy_clear(&seed);}
 static void BM_jgenc_marshal_scalar_array(benchmark::State& s){int n=(int)s.range(0);auto*obj=new struct scalar[(size_t)n];for(int i=0;i<n;i++)fill_scalar(&obj[i]);sstr_t out=sstr_new();size_t t=0;for(auto _:s){json_marshal_array_scalar(obj,n,out);t+=sstr_length(out);sstr_clear(out);}s.SetBytesProcessed((int64_t)t);sstr_free(out);for(int i=0;i<n;i++)scalar_clear(&obj[i]);delete[]obj;}
+static void BM_jgenc_marshal_scalar_array_parallel(benchmark::State& s){int n=(int)s.range(0);auto*obj=new struct scalar[(size_t)n];for(int i=0;i<n;i++)fill_scalar(&obj[i]);sstr_t out=sstr_new();size_t t=0;for(auto _:s){json_marshal_array_parallel_scalar(obj,n,0,out);t+=sstr_length(out);sstr_clear(out);}s.SetBytesProcessed((int64_t)t);sstr_free(out);for(int i=0;i<n;i++)scalar_clear(&obj[i]);delete[]obj;}
 static void BM_jgenc_unmarshal_scalar_array(benchmark::State& s){int n=(int)s.range(0);auto*obj=new struct scalar[(size_t)n];for(int i=0;i<n;i++)fill_scalar(&obj[i]);sstr_t c=sstr_new();json_marshal_array_scalar(obj,n,c);for(int i=0;i<n;i++)scalar_clear(&obj[i]);delete[]obj;size_t t=0;for(auto _:s){struct scalar*r=NULL;int rn=0;json_unmarshal_array_scalar(c,&r,&rn);t+=sstr_length(c);for(int i=0;i<rn;i++)scalar_clear(&r[i]);free(r);}s.SetBytesProcessed((int64_t)t);sstr_free(c);}
 
 /* ---- cJSON ---- */
@@ -117,6 +118,8 @@ BENCHMARK(BM_jgenc_marshal_string_heavy); BENCHMARK(BM_jgenc_unmarshal_string_he
 BENCHMARK(BM_jgenc_unmarshal_string_heavy_selected);
 BENCHMARK(BM_jgenc_marshal_scalar_array)->Args({64});
 BENCHMARK(BM_jgenc_unmarshal_scalar_array)->Args({64});
+BENCHMARK(BM_jgenc_marshal_scalar_array)->Args({100000});
+BENCHMARK(BM_jgenc_marshal_scalar_array_parallel)->Args({100000})->UseRealTime();
 BENCHMARK(BM_cjson_marshal_scalar); BENCHMARK(BM_cjson_unmarshal_scalar);
 BENCHMARK(BM_cjson_marshal_nested); BENCHMARK(BM_cjson_unmarshal_nested);
 BENCHMARK(BM_cjson_marshal_string_heavy); BENCHMARK(BM_cjson_unmarshal_string_heavy);
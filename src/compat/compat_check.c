@@ -33,6 +33,7 @@ static const char *field_type_str(int type) {
     case FIELD_TYPE_UINT32: return "uint32_t";
     case FIELD_TYPE_UINT64: return "uint64_t";
     case FIELD_TYPE_ONEOF:  return "oneof";
+    case FIELD_TYPE_FIXSTR: return "str";
     default:                return "?";
     }
 }
@@ -65,6 +66,14 @@ static void check_struct_pair(struct struct_container *old_sc,
                            field_type_str(nf->type),
                            nf->is_array ? "[]" : "");
                     ctx->breaking++;
+                } else if (of->type == FIELD_TYPE_FIXSTR &&
+                           nf->str_size < of->str_size) {
+                    /* Values that fitted before may now be rejected. */
+                    printf("  BREAKING: field '%s' in struct '%s' shrank "
+                           "(str<%d> -> str<%d>)\n",
+                           sstr_cstr(of->name), sstr_cstr(old_sc->name),
+                           of->str_size, nf->str_size);
+                    ctx->breaking++;
                 }
                 /* Check newly deprecated. */
                 if (!of->is_deprecated && nf->is_deprecated) {
@@ -102,6 +111,25 @@ static void check_struct_pair(struct struct_container *old_sc,
             ctx->safe++;
         }
     }
+    /* @compact structs are keyed by position: fields may only be appended. */
+    if (old_sc->is_compact && !new_sc->is_compact) {
+        printf("  BREAKING: struct '%s' is no longer @compact\n",
+               sstr_cstr(old_sc->name));
+        ctx->breaking++;
+    } else if (old_sc->is_compact) {
+        struct struct_field *of = old_sc->fields, *nf = new_sc->fields;
+        int pos = 0;
+        for (; of && nf; of = of->next, nf = nf->next, pos++) {
+            if (sstr_compare(of->name, nf->name) != 0) {
+                printf("  BREAKING: @compact struct '%s' position %d changed "
+                       "('%s' -> '%s')\n",
+                       sstr_cstr(old_sc->name), pos, sstr_cstr(of->name),
+                       sstr_cstr(nf->name));
+                ctx->breaking++;
+                break;
+            }
+        }
+    }
 }
 
 /* ---- per-enum comparison ---- */
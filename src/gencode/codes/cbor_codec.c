@@ -66,25 +66,25 @@ static CB_UNUSED void cb_encode_head(sstr_t out, int major, uint64_t val) {
     unsigned char hdr = (unsigned char)(major << 5);
     if (val <= 23) {
         unsigned char b = hdr | (unsigned char)val;
-        sstr_append_of(out, (const char *)&b, 1);
+        sstr_append_of_fast(out, (const char *)&b, 1);
     } else if (val <= 0xff) {
         unsigned char buf[2] = { (unsigned char)(hdr | CB_AI_1BYTE), (unsigned char)val };
-        sstr_append_of(out, (const char *)buf, 2);
+        sstr_append_of_fast(out, (const char *)buf, 2);
     } else if (val <= 0xffff) {
         unsigned char buf[3];
         buf[0] = hdr | CB_AI_2BYTE;
         cb_store_be16(buf + 1, (uint16_t)val);
-        sstr_append_of(out, (const char *)buf, 3);
+        sstr_append_of_fast(out, (const char *)buf, 3);
     } else if (val <= 0xffffffffULL) {
         unsigned char buf[5];
         buf[0] = hdr | CB_AI_4BYTE;
         cb_store_be32(buf + 1, (uint32_t)val);
-        sstr_append_of(out, (const char *)buf, 5);
+        sstr_append_of_fast(out, (const char *)buf, 5);
     } else {
         unsigned char buf[9];
         buf[0] = hdr | CB_AI_8BYTE;
         cb_store_be64(buf + 1, val);
-        sstr_append_of(out, (const char *)buf, 9);
+        sstr_append_of_fast(out, (const char *)buf, 9);
     }
 }
 
@@ -92,12 +92,12 @@ static CB_UNUSED void cb_encode_head(sstr_t out, int major, uint64_t val) {
 
 static CB_UNUSED void cb_pack_nil(sstr_t out) {
     unsigned char b = CB_NULL;
-    sstr_append_of(out, (const char *)&b, 1);
+    sstr_append_of_fast(out, (const char *)&b, 1);
 }
 
 static CB_UNUSED void cb_pack_bool(sstr_t out, int v) {
     unsigned char b = v ? CB_TRUE : CB_FALSE;
-    sstr_append_of(out, (const char *)&b, 1);
+    sstr_append_of_fast(out, (const char *)&b, 1);
 }
 
 static CB_UNUSED void cb_pack_uint(sstr_t out, uint64_t v) {
@@ -119,7 +119,7 @@ static CB_UNUSED void cb_pack_float(sstr_t out, float v) {
     buf[0] = CB_FLOAT32;
     memcpy(&u, &v, 4);
     cb_store_be32(buf + 1, u);
-    sstr_append_of(out, (const char *)buf, 5);
+    sstr_append_of_fast(out, (const char *)buf, 5);
 }
 
 static CB_UNUSED void cb_pack_double(sstr_t out, double v) {
@@ -128,12 +128,14 @@ static CB_UNUSED void cb_pack_double(sstr_t out, double v) {
     buf[0] = CB_FLOAT64;
     memcpy(&u, &v, 8);
     cb_store_be64(buf + 1, u);
-    sstr_append_of(out, (const char *)buf, 9);
+    sstr_append_of_fast(out, (const char *)buf, 9);
 }
 
 static CB_UNUSED void cb_pack_str(sstr_t out, const char *s, uint32_t len) {
+    /* One reservation covers the header and the payload. */
+    (void)sstr_reserve_fast(out, 9 + (size_t)len);
     cb_encode_head(out, CB_MAJOR_TSTR, (uint64_t)len);
-    if (len > 0) sstr_append_of(out, s, len);
+    if (len > 0) sstr_append_of_fast(out, s, len);
 }
 
 static CB_UNUSED void cb_pack_sstr(sstr_t out, sstr_t s) {
@@ -327,6 +329,35 @@ static CB_UNUSED int cb_unpack_str(struct cb_reader *r,
     return 0;
 }
 
+/* ── Borrowed strings ───────────────────────────────────────────────── */
+
+#if defined(_MSC_VER)
+  #define CB_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && \
+    !defined(__STDC_NO_THREADS__)
+  #define CB_THREAD_LOCAL _Thread_local
+#else
+  #define CB_THREAD_LOCAL __thread
+#endif
+
+/* Set by cbor_unpack_<struct>_borrow() for the duration of the call:
+ * decoded sstr_t then point into the input instead of copying it. */
+static CB_THREAD_LOCAL int cb_borrow_strs;
+
+static inline CB_UNUSED void cb_store_sstr(sstr_t dst, const char *s,
+                                           uint32_t n) {
+    if (cb_borrow_strs) {
+        sstr_set_ref(dst, s, n);
+    } else {
+        sstr_clear_fast(dst);
+        sstr_append_of_fast(dst, s, n);
+    }
+}
+
+static inline CB_UNUSED sstr_t cb_new_sstr(const char *s, uint32_t n) {
+    return cb_borrow_strs ? sstr_ref(s, n) : sstr_of(s, n);
+}
+
 static CB_UNUSED int cb_unpack_array_header(struct cb_reader *r,
                                              uint32_t *count) {
     int major;
@@ -349,6 +380,62 @@ static CB_UNUSED int cb_unpack_map_header(struct cb_reader *r,
     return 0;
 }
 
+/* ── Framing ────────────────────────────────────────────────────────── */
+
+/*
+ * Scan *pending data items starting at *pos without decoding them, to
+ * find where a message ends in a stream of back-to-back messages.
+ * Iterative, so nesting depth costs no stack. Returns 1 when every
+ * pending item is complete (*pos is then the end of the last one), 0 when
+ * data ends first and -1 on an indefinite-length or reserved item. On 0,
+ * *pos and *pending are left at the last item boundary, so the scan
+ * resumes there once more bytes arrive.
+ */
+static CB_UNUSED int cb_frame_scan(const unsigned char *data, size_t len,
+                                   size_t *pos, uint64_t *pending) {
+    size_t p = *pos;
+    uint64_t n = *pending;
+    int rc = 1;
+
+    while (n > 0) {
+        size_t aw;  /* width of the argument after the initial byte */
+        uint64_t val;
+        int major, ai;
+
+        if (p >= len) { rc = 0; break; }
+        major = (data[p] >> 5) & 0x07;
+        ai = data[p] & 0x1f;
+        if (ai <= 23) aw = 0;
+        else if (ai <= CB_AI_8BYTE) aw = (size_t)1 << (ai - CB_AI_1BYTE);
+        else return -1;  /* indefinite length (31) or reserved (28-30) */
+
+        if (len - p < 1 + aw) { rc = 0; break; }
+        if (aw == 0) val = (uint64_t)ai;
+        else if (aw == 1) val = data[p + 1];
+        else if (aw == 2) val = cb_load_be16(data + p + 1);
+        else if (aw == 4) val = cb_load_be32(data + p + 1);
+        else val = cb_load_be64(data + p + 1);
+
+        if ((major == CB_MAJOR_ARRAY || major == CB_MAJOR_MAP) &&
+            val > UINT32_MAX) {
+            return -1;  /* the decoders take 32-bit counts */
+        }
+        if (major == CB_MAJOR_BSTR || major == CB_MAJOR_TSTR) {
+            if (len - p - 1 - aw < val) { rc = 0; break; }
+            p += 1 + aw + (size_t)val;
+        } else {
+            p += 1 + aw;
+        }
+        n--;
+        if (major == CB_MAJOR_ARRAY) n += val;
+        if (major == CB_MAJOR_MAP) n += 2 * val;
+        if (major == CB_MAJOR_TAG) n += 1;
+    }
+    *pos = p;
+    *pending = n;
+    return rc;
+}
+
 /* ── Skip: recursively skip one CBOR data item ─────────────────────── */
 
 static CB_UNUSED int cb_unpack_skip(struct cb_reader *r) {
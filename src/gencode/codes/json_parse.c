@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <ctype.h>
+#include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -10,6 +11,21 @@
 #include "sstr.h"
 #include "utils/error_codes.h"
 
+/* json_marshal_array_parallel_<S>() runs its chunks on threads unless
+ * JSON_GEN_C_NO_THREADS is defined, in which case it marshals in the
+ * calling thread only. */
+#ifndef JSON_GEN_C_NO_THREADS
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#endif
+
 /* Fast character classification lookup table (replaces locale-aware
    isspace/isdigit in hot loops). Bit 0 = whitespace, Bit 1 = digit. */
 static const unsigned char json_char_class_[256] = {
@@ -34,21 +50,29 @@ static const unsigned char json_char_class_[256] = {
  * the generated .c file, e.g. -DJGENC_MALLOC=my_malloc.
  *
  * Run-time: call json_gen_c_set_alloc() to redirect allocations without
- * recompiling.  When custom macros are defined the runtime API is disabled.
+ * recompiling, or install a struct jgenc_allocator for the calling thread
+ * (jgenc_set_thread_allocator(), the _ex/_alloc entry points), which also
+ * covers sstr_t buffers.  When custom macros are defined the runtime API
+ * is disabled.
  */
 #ifndef JGENC_MALLOC
 static void* (*jgenc_malloc_fn_)(size_t)                        = NULL;
 static void* (*jgenc_realloc_fn_)(void*, size_t)                = NULL;
 static void  (*jgenc_free_fn_)(void*)                           = NULL;
 
+// A thread allocator (jgenc_set_thread_allocator()) wins over the
+// json_gen_c_set_alloc() functions.
 static inline void* jgenc_malloc_dispatch_(size_t sz) {
-    return jgenc_malloc_fn_ ? jgenc_malloc_fn_(sz) : malloc(sz);
+    return jgenc_malloc_fn_ && !jgenc_thread_allocator()
+               ? jgenc_malloc_fn_(sz) : jgenc_malloc(sz);
 }
 static inline void* jgenc_realloc_dispatch_(void* p, size_t sz) {
-    return jgenc_realloc_fn_ ? jgenc_realloc_fn_(p, sz) : realloc(p, sz);
+    return jgenc_realloc_fn_ && !jgenc_thread_allocator()
+               ? jgenc_realloc_fn_(p, sz) : jgenc_realloc(p, sz);
 }
 static inline void jgenc_free_dispatch_(void* p) {
-    if (jgenc_free_fn_) jgenc_free_fn_(p); else free(p);
+    if (jgenc_free_fn_ && !jgenc_thread_allocator()) jgenc_free_fn_(p);
+    else jgenc_free(p);
 }
 
 #define JGENC_MALLOC(sz)      jgenc_malloc_dispatch_(sz)
@@ -79,62 +103,6 @@ void json_gen_c_set_alloc(void* (*malloc_fn)(size_t),
 #define JGENC_FREE(p) free(p)
 #endif
 
-/* ---------------------------------------------------------------
- * Inline fast-path helpers for sstr operations.
- *
- * The sstr library lives in a separate translation unit, so none of
- * its tiny accessor functions (sstr_cstr, sstr_clear, sstr_append_of)
- * can be inlined by the compiler.  The struct layout is defined in
- * sstr.h, so we can build fast-path macros here that the compiler
- * will inline at every call-site in the generated runtime.
- *
- * These eliminate the function-call overhead that profiling showed
- * accounts for ~27% of total unmarshal time (sstr_cstr 8.9%,
- * sstr_append_zero 8.5%, ptoken 7.2%, sstr_append_of 6.1%,
- * sstr_clear 4.1%).
- * --------------------------------------------------------------- */
-
-/* Inline sstr_cstr: return pointer to the raw char data. */
-#define SSTR_I_(s)  ((struct sstr_s*)(s))
-#define SSTR_CSTR_(s) \
-    (SSTR_I_(s)->type == SSTR_TYPE_SHORT \
-        ? SSTR_I_(s)->un.short_str \
-        : SSTR_I_(s)->un.long_str.data)
-
-/* Inline sstr_clear for the hot path (token buffer is always SHORT or LONG). */
-static inline void sstr_clear_fast_(sstr_t s) {
-    struct sstr_s* ss = (struct sstr_s*)s;
-    if (ss->type == SSTR_TYPE_SHORT) {
-        ss->length = 0;
-        ss->un.short_str[0] = '\0';
-    } else if (ss->type == SSTR_TYPE_LONG) {
-        /* Keep the allocated buffer; just reset length. */
-        ss->length = 0;
-        ss->un.long_str.data[0] = '\0';
-    } else {
-        sstr_clear(s);
-    }
-}
-
-/* Inline sstr_append_of: fast path for SHORT string with capacity. */
-static inline void sstr_append_of_fast_(sstr_t s, const void* data, size_t len) {
-    struct sstr_s* ss = (struct sstr_s*)s;
-    if (ss->type == SSTR_TYPE_SHORT && ss->length + len <= SHORT_STR_CAPACITY) {
-        memcpy(ss->un.short_str + ss->length, data, len);
-        ss->length += len;
-        ss->un.short_str[ss->length] = '\0';
-        return;
-    }
-    if (ss->type == SSTR_TYPE_LONG &&
-        ss->un.long_str.capacity - ss->length > len) {
-        memcpy(ss->un.long_str.data + ss->length, data, len);
-        ss->length += len;
-        ss->un.long_str.data[ss->length] = '\0';
-        return;
-    }
-    sstr_append_of(s, data, len);
-}
-
 /*
   hash map to describe structs like:
 
@@ -297,7 +265,7 @@ static char* ptoken(int type, sstr_t txt) {
         case JSON_TOKEN_STRING:
         case JSON_TOKEN_INT:
         case JSON_TOKEN_FLOAT:
-            return SSTR_CSTR_(txt);
+            return sstr_cstr_fast(txt);
         case JSON_TOKEN_EOF:
             return "-EOF-";
         case JSON_ERROR:
@@ -312,6 +280,198 @@ static char* ptoken(int type, sstr_t txt) {
 #define PERROR(pos, msg, ...) \
     sstr_printf("line %d col %d: error: " msg, pos->line, pos->col, ##__VA_ARGS__)
 
+// Record the first error of a decode in the caller's json_error.
+static void json_error_set_(struct json_pos* pos, int code, int expected) {
+    if (pos->err->code == 0) {
+        pos->err->code = code;
+        pos->err->offset = pos->offset;
+        pos->err->expected_token = expected;
+    }
+}
+
+static void json_error_begin_(struct json_error* err) {
+    if (err != NULL) {
+        err->code = JSON_GEN_SUCCESS;
+        err->offset = 0;
+        err->expected_token = JSON_EXPECT_NONE;
+    }
+}
+
+// Give a failed decode a code when no error site recorded one (e.g. a
+// nested helper that only propagated a failure).
+static void json_error_end_(struct json_error* err, const struct json_pos* pos,
+                            int r) {
+    if (err != NULL && r != 0 && err->code == 0) {
+        err->code = r < 0 ? r : JSON_GEN_ERROR_PARSE;
+        err->offset = pos->offset;
+    }
+}
+
+// Report a decode error. With a structured sink (pos->err, set by the *_ex
+// entry points) only code, offset and expected token are stored and no text
+// is formatted; otherwise the message is appended to txt.
+#define JSON_FAIL(pos, txt, code, expected, msg, ...)                        \
+    do {                                                                     \
+        if ((pos)->err != NULL) {                                            \
+            json_error_set_((pos), (code), (expected));                      \
+        } else {                                                             \
+            sstr_t e_ = PERROR(pos, msg, ##__VA_ARGS__);                     \
+            sstr_append((txt), e_);                                          \
+            sstr_free(e_);                                                   \
+        }                                                                    \
+    } while (0)
+
+int json_error_format(const struct json_error* err, sstr_t in, sstr_t out) {
+    if (err == NULL || out == NULL) {
+        return JSON_GEN_ERROR_INVALID_PARAM;
+    }
+    // Line/col are only needed for display, so derive them here rather than
+    // tracking them on the error path.
+    long line = 0, col = 0, end = err->offset, len = 0, i;
+    const char* data = NULL;
+    if (in != NULL) {
+        data = sstr_cstr_fast(in);
+        len = (long)sstr_length(in);
+        if (end > len) {
+            end = len;
+        }
+        for (i = 0; i < end; i++) {
+            if (data[i] == '\n') {
+                line++;
+                col = 0;
+            } else {
+                col++;
+            }
+        }
+    }
+
+    const char* what;
+    switch (err->code) {
+        case JSON_GEN_SUCCESS:
+            what = "no error";
+            break;
+        case JSON_GEN_ERROR_MEMORY:
+            what = "memory allocation failed";
+            break;
+        case JSON_GEN_ERROR_NOT_FOUND:
+            what = "schema entry not found";
+            break;
+        case JSON_GEN_ERROR_BOUNDS:
+            what = "value out of bounds";
+            break;
+        default:
+            what = "syntax error";
+            break;
+    }
+    sstr_printf_append(out, "line %l col %l: error: %s", line, col, what);
+
+    switch (err->expected_token) {
+        case JSON_EXPECT_NONE:
+            break;
+        case JSON_EXPECT_STRING:
+            sstr_append_cstr(out, ", expected string");
+            break;
+        case JSON_EXPECT_NUMBER:
+            sstr_append_cstr(out, ", expected number");
+            break;
+        case JSON_EXPECT_VALUE:
+            sstr_append_cstr(out, ", expected value");
+            break;
+        default:
+            sstr_printf_append(out, ", expected '%c'", err->expected_token);
+            break;
+    }
+    if (data != NULL && end < len) {
+        size_t n = (size_t)(len - end < 16 ? len - end : 16);
+        sstr_printf_append(out, " near '%*s'", n, data + end);
+    }
+    return JSON_GEN_SUCCESS;
+}
+
+/* ---------------------------------------------------------------
+ * Resource limits.
+ *
+ * A decode carries its limits in pos->lim; with no limits the pointer is
+ * NULL and every check below reduces to that one test.  Counts are checked
+ * before the array/map/string grows, so a hostile document is rejected
+ * before the memory for the offending value is requested.
+ * --------------------------------------------------------------- */
+// Read without synchronisation by every decode; the header tells callers
+// to set it before decoding starts.
+static struct json_limits json_default_limits_;
+static int json_default_limits_set_ = 0;
+
+void json_gen_c_set_limits(const struct json_limits* limits) {
+    if (limits == NULL) {
+        memset(&json_default_limits_, 0, sizeof(json_default_limits_));
+        json_default_limits_set_ = 0;
+    } else {
+        json_default_limits_ = *limits;
+        json_default_limits_set_ = 1;
+    }
+}
+
+static int json_limit_fail_(struct json_pos* pos, sstr_t txt,
+                            const char* what, size_t cap) {
+    sstr_clear(txt);
+    JSON_FAIL(pos, txt, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE,
+              "%s exceeds limit of %uz", what, cap);
+    return JSON_GEN_ERROR_BOUNDS;
+}
+
+// Nonzero (after reporting) when count n is over the FIELD cap.
+#define JSON_LIMIT_CHECK(pos, txt, FIELD, n, what)                           \
+    (((pos)->lim != NULL && (pos)->lim->limits.FIELD != 0 &&                 \
+      (size_t)(n) > (pos)->lim->limits.FIELD)                                \
+         ? json_limit_fail_((pos), (txt), (what), (pos)->lim->limits.FIELD)  \
+         : 0)
+
+// Charge bytes to the decode's max_alloc_bytes budget.
+static int json_limit_alloc_(struct json_pos* pos, sstr_t txt, size_t bytes) {
+    struct json_limit_state* lim = pos->lim;
+    if (lim->limits.max_alloc_bytes == 0) {
+        return 0;
+    }
+    if (bytes > lim->limits.max_alloc_bytes - lim->alloc_bytes) {
+        return json_limit_fail_(pos, txt, "allocated bytes",
+                                lim->limits.max_alloc_bytes);
+    }
+    lim->alloc_bytes += bytes;
+    return 0;
+}
+
+#define JSON_LIMIT_ALLOC(pos, txt, bytes) \
+    ((pos)->lim != NULL ? json_limit_alloc_((pos), (txt), (bytes)) : 0)
+
+// Set up pos for a top-level decode: reset err, pick the limits that apply
+// (the call's own, else the process default) and check the input size.
+static int json_decode_begin_(sstr_t in, struct json_pos* pos,
+                              struct json_limit_state* lim,
+                              const struct json_limits* limits,
+                              struct json_error* err, sstr_t txt) {
+    pos->line = 0;
+    pos->col = 0;
+    pos->offset = 0;
+    pos->err = err;
+    pos->lim = NULL;
+    json_error_begin_(err);
+    if (limits == NULL && json_default_limits_set_) {
+        limits = &json_default_limits_;
+    }
+    if (limits == NULL) {
+        return 0;
+    }
+    lim->limits = *limits;
+    lim->alloc_bytes = 0;
+    pos->lim = lim;
+    if (in != NULL &&
+        JSON_LIMIT_CHECK(pos, txt, max_input_bytes, sstr_length(in),
+                         "input size") != 0) {
+        return JSON_GEN_ERROR_BOUNDS;
+    }
+    return 0;
+}
+
 static int json_next_token_(sstr_t content, struct json_pos* pos, sstr_t txt);
 
 static int json_next_token(sstr_t content, struct json_pos* pos, sstr_t txt) {
@@ -350,59 +510,52 @@ static unsigned int parse_hex4(const unsigned char* const input) {
 }
 
 // uXXXX [\uxxxx]
-static int utf16_literal_to_utf8(sstr_t content, struct json_pos* pos,
-                                 sstr_t txt) {
-    char* data = SSTR_CSTR_(content);
-    long i = pos->offset;
-    long len = sstr_length(content);
-    if (i + 5 >= len) {
-        sstr_clear(txt);
-        sstr_append_cstr(txt,
-                         "expected escape UTF-16 sequence, "
-                         "but reached end of json string");
-        return JSON_ERROR;
+static const char* const json_u_escape_errors_[] = {
+    "",
+    "expected escape UTF-16 sequence, but reached end of json string",
+    "expected escape UTF-16 sequence, but found invalid",
+    "UTF16 surrogate pair expected, but EOF",
+    "UTF16 surrogate pair expected, but not found \\uXXXX",
+    "expected escape UTF-16 second_code, but found invalid",
+    "invalid unicode codepoint, cannot convert to utf8",
+};
+
+// Decode the \uXXXX (or surrogate pair) escape whose 'u' is at data[*i]
+// into out. On success returns the UTF-8 length and advances *i past the
+// escape; on failure returns minus an index into json_u_escape_errors_.
+static int json_decode_u_escape(const char* data, long len, long* i,
+                                unsigned char out[4]) {
+    long k = *i;
+    if (k + 5 >= len) {
+        return -1;
     }
-    i++;
-    unsigned int first_code = parse_hex4((const unsigned char*)&data[i]);
+    k++;
+    unsigned int first_code = parse_hex4((const unsigned char*)&data[k]);
     unsigned int codepoint = 0;
-    i += 4;
-    pos->col += 5;
-    pos->offset += 5;
+    k += 4;
     /* check that the code is valid */
     if (((first_code >= 0xDC00) && (first_code <= 0xDFFF))) {
-        sstr_clear(txt);
-        sstr_append_cstr(txt,
-                         "expected escape UTF-16 sequence, but found invalid");
-        return JSON_ERROR;
+        return -2;
     }
     // UTF16 surrogate pair
     if ((first_code >= 0xD800) && (first_code <= 0xDBFF)) {
         unsigned int second_code;
 
-        if (i + 6 >= len) {
-            sstr_clear(txt);
-            sstr_append_cstr(txt, "UTF16 surrogate pair expected, but EOF");
-            return JSON_ERROR;
+        if (k + 6 >= len) {
+            return -3;
         }
-        if ((data[i] != '\\') || (data[i + 1] != 'u')) {
-            sstr_clear(txt);
-            sstr_append_cstr(
-                txt, "UTF16 surrogate pair expected, but not found \\uXXXX");
-            return JSON_ERROR;
+        if ((data[k] != '\\') || (data[k + 1] != 'u')) {
+            return -4;
         }
-        second_code = parse_hex4((const unsigned char*)&data[i + 2]);
+        second_code = parse_hex4((const unsigned char*)&data[k + 2]);
         /* check that the code is valid */
         if ((second_code < 0xDC00) || (second_code > 0xDFFF)) {
-            sstr_clear(txt);
-            sstr_append_cstr(
-                txt, "expected escape UTF-16 second_code, but found invalid");
-            return JSON_ERROR;
+            return -5;
         }
         /* calculate the unicode codepoint from the surrogate pair */
         codepoint =
             0x10000 + (((first_code & 0x3FF) << 10) | (second_code & 0x3FF));
-        pos->col += 6;
-        pos->offset += 6;
+        k += 6;
     } else {
         codepoint = first_code;
     }
@@ -429,28 +582,40 @@ static int utf16_literal_to_utf8(sstr_t content, struct json_pos* pos,
         first_byte_mark = 0xF0; /* 11110000 */
     } else {
         /* invalid unicode codepoint */
-        sstr_clear(txt);
-        sstr_append_cstr(txt,
-                         "invalid unicode codepoint, cannot convert to utf8");
-        return JSON_ERROR;
+        return -6;
     }
     int utf8_position;
-    unsigned char output_pointer[4];
     for (utf8_position = (unsigned char)(utf8_length - 1); utf8_position > 0;
          utf8_position--) {
         /* 10xxxxxx */
-        output_pointer[utf8_position] =
-            (unsigned char)((codepoint | 0x80) & 0xBF);
+        out[utf8_position] = (unsigned char)((codepoint | 0x80) & 0xBF);
         codepoint >>= 6;
     }
     /* encode first byte */
     if (utf8_length > 1) {
-        (output_pointer)[0] =
-            (unsigned char)((codepoint | first_byte_mark) & 0xFF);
+        out[0] = (unsigned char)((codepoint | first_byte_mark) & 0xFF);
     } else {
-        (output_pointer)[0] = (unsigned char)(codepoint & 0x7F);
+        out[0] = (unsigned char)(codepoint & 0x7F);
+    }
+    *i = k;
+    return utf8_length;
+}
+
+static int utf16_literal_to_utf8(sstr_t content, struct json_pos* pos,
+                                 sstr_t txt) {
+    unsigned char output_pointer[4];
+    long i = pos->offset;
+    int n = json_decode_u_escape(sstr_cstr_fast(content),
+                                 (long)sstr_length(content), &i,
+                                 output_pointer);
+    if (n < 0) {
+        sstr_clear(txt);
+        sstr_append_cstr(txt, json_u_escape_errors_[-n]);
+        return JSON_ERROR;
     }
-    sstr_append_of(txt, output_pointer, utf8_length);
+    pos->col += (int)(i - pos->offset);
+    pos->offset = i;
+    sstr_append_of(txt, output_pointer, n);
     return 0;
 }
 
@@ -465,7 +630,7 @@ static int json_parse_string_token(sstr_t content, struct json_pos* pos,
                                    sstr_t txt) {
     long len = sstr_length(content);
     long i;
-    char* data = SSTR_CSTR_(content);
+    char* data = sstr_cstr_fast(content);
     
     // Validate input parameters
     if (data == NULL || txt == NULL || pos == NULL) {
@@ -477,18 +642,16 @@ static int json_parse_string_token(sstr_t content, struct json_pos* pos,
     // Validate bounds before accessing data[i]
     if (i >= len) {
         sstr_clear(txt);
-        sstr_t e = PERROR(pos, "unexpected end of input when expecting string");
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE,
+                  "unexpected end of input when expecting string");
         return JSON_ERROR;
     }
 
     // data[i] should be '"' - validate this
     if (data[i] != '"') {
         sstr_clear(txt);
-        sstr_t e = PERROR(pos, "expected '\"' at start of string, got '%c'", data[i]);
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING,
+                  "expected '\"' at start of string, got '%c'", data[i]);
         return JSON_ERROR;
     }
     
@@ -496,17 +659,21 @@ static int json_parse_string_token(sstr_t content, struct json_pos* pos,
     i++;
     pos->col++;
 
-    sstr_clear_fast_(txt);
+    sstr_clear_fast(txt);
     while (i < len && data[i] != '"') {
         if (data[i] == '\\') {
+            // Every escape appends at least one byte.
+            if (JSON_LIMIT_CHECK(pos, txt, max_string_len,
+                                 sstr_length(txt) + 1,
+                                 "string length") != 0) {
+                return JSON_ERROR;
+            }
             // Handle escape sequence with proper bounds checking
             if (i + 1 >= len) {
                 sstr_clear(txt);
-                sstr_t e = PERROR(pos,
-                                  "expected escape sequence, but reached "
-                                  "end of json string");
-                sstr_append(txt, e);
-                sstr_free(e);
+                JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE,
+                          "expected escape sequence, but reached "
+                          "end of json string");
                 return JSON_ERROR;
             }
             i++;
@@ -514,42 +681,42 @@ static int json_parse_string_token(sstr_t content, struct json_pos* pos,
 
             switch (data[i]) {
                 case 'b':
-                    sstr_append_of_fast_(txt, "\b", 1);
+                    sstr_append_of_fast(txt, "\b", 1);
                     i++;
                     pos->col++;
                     break;
                 case 'f':
-                    sstr_append_of_fast_(txt, "\f", 1);
+                    sstr_append_of_fast(txt, "\f", 1);
                     i++;
                     pos->col++;
                     break;
                 case 'n':
-                    sstr_append_of_fast_(txt, "\n", 1);
+                    sstr_append_of_fast(txt, "\n", 1);
                     i++;
                     pos->col++;
                     break;
                 case 'r':
-                    sstr_append_of_fast_(txt, "\r", 1);
+                    sstr_append_of_fast(txt, "\r", 1);
                     i++;
                     pos->col++;
                     break;
                 case 't':
-                    sstr_append_of_fast_(txt, "\t", 1);
+                    sstr_append_of_fast(txt, "\t", 1);
                     i++;
                     pos->col++;
                     break;
                 case '\"':
-                    sstr_append_of_fast_(txt, "\"", 1);
+                    sstr_append_of_fast(txt, "\"", 1);
                     i++;
                     pos->col++;
                     break;
                 case '\\':
-                    sstr_append_of_fast_(txt, "\\", 1);
+                    sstr_append_of_fast(txt, "\\", 1);
                     i++;
                     pos->col++;
                     break;
                 case '/':
-                    sstr_append_of_fast_(txt, "/", 1);
+                    sstr_append_of_fast(txt, "/", 1);
                     i++;
                     pos->col++;
                     break;
@@ -565,15 +732,14 @@ static int json_parse_string_token(sstr_t content, struct json_pos* pos,
                         return JSON_ERROR;
                     }
                     sstr_append(txt, tmp);
+                    sstr_free(tmp);
                     i = pos->offset;
                     break;
                 }
                 default: {
                     sstr_clear(txt);
-                    sstr_t e =
-                        PERROR(pos, "unknown escape sequence '\\%s'", data[i]);
-                    sstr_append(txt, e);
-                    sstr_free(e);
+                    JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE,
+                              "unknown escape sequence '\\%c'", data[i]);
                     return JSON_ERROR;
                 }
             }
@@ -582,16 +748,25 @@ static int json_parse_string_token(sstr_t content, struct json_pos* pos,
             while (j < len && data[j] != '"' && data[j] != '\\') {
                 j++;
             }
-            sstr_append_of_fast_(txt, data + i, j - i);
+            if (JSON_LIMIT_CHECK(pos, txt, max_string_len,
+                                 sstr_length(txt) + (size_t)(j - i),
+                                 "string length") != 0) {
+                return JSON_ERROR;
+            }
+            sstr_append_of_fast(txt, data + i, j - i);
             pos->col += j - i;
             i = j;
         }
     }
     if (data[i] != '\"') {
         sstr_clear(txt);
-        sstr_t e = PERROR(pos, "expected '\"', but got '%s'", data[i]);
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING,
+                  "expected '\"', but got '%c'", data[i]);
+        return JSON_ERROR;
+    }
+    // A \u escape may add up to four bytes past the check above.
+    if (JSON_LIMIT_CHECK(pos, txt, max_string_len, sstr_length(txt),
+                         "string length") != 0) {
         return JSON_ERROR;
     }
     pos->offset = i + 1;
@@ -603,7 +778,7 @@ static int json_parse_string_token(sstr_t content, struct json_pos* pos,
 static inline int json_skip_space_comments(sstr_t content, struct json_pos* pos) {
     long len = sstr_length(content);
     long i = pos->offset;
-    char* data = SSTR_CSTR_(content);
+    char* data = sstr_cstr_fast(content);
 
     int skiped = 0;
 
@@ -671,9 +846,9 @@ JSON_TOKEN_RIGHT_BRACKET = ]
 static int json_next_token_(sstr_t content, struct json_pos* pos, sstr_t txt) {
     long len = sstr_length(content);
     long i = pos->offset;
-    char* data = SSTR_CSTR_(content);
+    char* data = sstr_cstr_fast(content);
 
-    sstr_clear_fast_(txt);
+    sstr_clear_fast(txt);
 
     if (i >= len) {
         return JSON_TOKEN_EOF;
@@ -704,7 +879,7 @@ static int json_next_token_(sstr_t content, struct json_pos* pos, sstr_t txt) {
     }
     // parse number
     int tk = JSON_TOKEN_INT;
-    sstr_clear_fast_(txt);
+    sstr_clear_fast(txt);
     int start_pos = i;
     if (JSON_IS_DIGIT(ch) || ch == '-' || ch == '.') {
         if (ch != '.') {
@@ -738,7 +913,7 @@ static int json_next_token_(sstr_t content, struct json_pos* pos, sstr_t txt) {
                 pos->col++;
             }
         }
-        sstr_append_of_fast_(txt, data + start_pos, i - start_pos);
+        sstr_append_of_fast(txt, data + start_pos, i - start_pos);
         pos->offset = i;
         return tk;
     }
@@ -749,7 +924,7 @@ static int json_next_token_(sstr_t content, struct json_pos* pos, sstr_t txt) {
         i += 4;
         pos->col += 4;
         pos->offset = i;
-        sstr_append_of_fast_(txt, "true", 4);
+        sstr_append_of_fast(txt, "true", 4);
         return JSON_TOKEN_TRUE;
     }
     if (ch == 'f' && i + 5 <= len && memcmp(data + i, "false", 5) == 0 &&
@@ -757,7 +932,7 @@ static int json_next_token_(sstr_t content, struct json_pos* pos, sstr_t txt) {
         i += 5;
         pos->col += 5;
         pos->offset = i;
-        sstr_append_of_fast_(txt, "false", 5);
+        sstr_append_of_fast(txt, "false", 5);
         return JSON_TOKEN_FALSE;
     }
     if (ch == 'n' && i + 4 <= len && memcmp(data + i, "null", 4) == 0 &&
@@ -765,7 +940,7 @@ static int json_next_token_(sstr_t content, struct json_pos* pos, sstr_t txt) {
         i += 4;
         pos->col += 4;
         pos->offset = i;
-        sstr_append_of_fast_(txt, "null", 4);
+        sstr_append_of_fast(txt, "null", 4);
         return JSON_TOKEN_NULL;
     }
     // Unknown identifier — scan and report error
@@ -773,12 +948,11 @@ static int json_next_token_(sstr_t content, struct json_pos* pos, sstr_t txt) {
         i++;
         pos->col++;
     }
-    sstr_append_of_fast_(txt, data + keyword_start, i - keyword_start);
+    sstr_append_of_fast(txt, data + keyword_start, i - keyword_start);
     pos->offset = i;
 
-    sstr_t e = PERROR(pos, "unexpected identify %s", SSTR_CSTR_(txt));
-    sstr_append(txt, e);
-    sstr_free(e);
+    JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE,
+              "unexpected identify %s", sstr_cstr_fast(txt));
     return JSON_ERROR;
 }
 
@@ -796,19 +970,19 @@ static int json_unmarshal_scalar_##TYPE(sstr_t content, struct json_pos* pos,  \
     } else if (tk == JSON_TOKEN_TRUE) {                                        \
         *val = 1;                                                              \
     } else if (tk != JSON_TOKEN_INT) {                                         \
-        sstr_t e = PERROR(pos, "expected integer but got '%s'",                \
-                          ptoken(tk, txt));                                     \
-        sstr_append(txt, e);                                                   \
-        sstr_free(e);                                                          \
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NUMBER,          \
+                  "expected integer but got '%s'",                             \
+                  ptoken(tk, txt));                                            \
         return tk;                                                             \
     } else {                                                                   \
         char* endptr;                                                          \
-        CONV_TYPE temp_val = CONV_FN(SSTR_CSTR_(txt), &endptr, 10);           \
-        if (*endptr != '\0' || temp_val > (MAX_VAL) || temp_val < (MIN_VAL)) { \
-            sstr_t e = PERROR(pos, #TYPE " value out of range: '%s'",          \
-                              SSTR_CSTR_(txt));                                \
-            sstr_append(txt, e);                                               \
-            sstr_free(e);                                                      \
+        errno = 0;                                                             \
+        CONV_TYPE temp_val = CONV_FN(sstr_cstr_fast(txt), &endptr, 10);        \
+        if (*endptr != '\0' || errno == ERANGE || temp_val > (MAX_VAL) ||     \
+            temp_val < (MIN_VAL)) {                                            \
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE,       \
+                      #TYPE " value out of range: '%s'",                       \
+                      sstr_cstr_fast(txt));                                    \
             return JSON_ERROR;                                                 \
         }                                                                      \
         *val = (TYPE)temp_val;                                                 \
@@ -831,19 +1005,17 @@ static int json_unmarshal_scalar_##TYPE(sstr_t content, struct json_pos* pos,  \
                                         TYPE* val, sstr_t txt) {              \
     int tk = json_next_token(content, pos, txt);                               \
     if (tk != JSON_TOKEN_FLOAT && tk != JSON_TOKEN_INT) {                      \
-        sstr_t e = PERROR(pos, "expected floating number but got '%s'",        \
-                          ptoken(tk, txt));                                     \
-        sstr_append(txt, e);                                                   \
-        sstr_free(e);                                                          \
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NUMBER,          \
+                  "expected floating number but got '%s'",                     \
+                  ptoken(tk, txt));                                            \
         return tk;                                                             \
     } else {                                                                   \
         char* endptr;                                                          \
-        TYPE temp_val = CONV_FN(SSTR_CSTR_(txt), &endptr);                    \
+        TYPE temp_val = CONV_FN(sstr_cstr_fast(txt), &endptr);                 \
         if (*endptr != '\0') {                                                 \
-            sstr_t e = PERROR(pos, #TYPE " format invalid: '%s'",              \
-                              SSTR_CSTR_(txt));                                \
-            sstr_append(txt, e);                                               \
-            sstr_free(e);                                                      \
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NUMBER,      \
+                      #TYPE " format invalid: '%s'",                           \
+                      sstr_cstr_fast(txt));                                    \
             return JSON_ERROR;                                                 \
         }                                                                      \
         *val = temp_val;                                                       \
@@ -862,16 +1034,74 @@ static int json_unmarshal_scalar_sstr_t(sstr_t content, struct json_pos* pos,
     if (tk == JSON_TOKEN_NULL) {
         return 0;
     } else if (tk != JSON_TOKEN_STRING) {
-        sstr_t e = PERROR(pos, "expected string but got '%s'", ptoken(tk, txt));
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING,
+                  "expected string but got '%s'", ptoken(tk, txt));
         return tk;
     } else {
+        if (JSON_LIMIT_ALLOC(pos, txt, sstr_length(txt) + 1) != 0) {
+            return JSON_ERROR;
+        }
         *val = sstr_dup(txt);
     }
     return 0;
 }
 
+// An @inline_str field keeps its struct sstr_s in the struct itself.
+#define JSON_FIELD_IS_INLINE_STR_(fi) ((fi)->is_inline_str)
+
+// Like json_unmarshal_scalar_sstr_t(), for an @inline_str field: the value
+// is copied into the embedded string, so a short one needs no allocation.
+// null leaves it empty.
+static int json_unmarshal_scalar_sstr_inline_(sstr_t content,
+                                              struct json_pos* pos,
+                                              sstr_t val, sstr_t txt) {
+    int tk = json_next_token(content, pos, txt);
+    if (tk == JSON_TOKEN_NULL) {
+        sstr_clear_fast(val);
+        return 0;
+    } else if (tk != JSON_TOKEN_STRING) {
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING,
+                  "expected string but got '%s'", ptoken(tk, txt));
+        return tk;
+    }
+    if (JSON_LIMIT_ALLOC(pos, txt, sstr_length(txt) + 1) != 0) {
+        return JSON_ERROR;
+    }
+    sstr_clear_fast(val);
+    sstr_append_of_fast(val, sstr_cstr_fast(txt), sstr_length(txt));
+    return 0;
+}
+
+// Decode a str<N> field: the string is copied into the char[N+1] at val,
+// whose length byte follows it at val[size]. null leaves it empty; a string
+// longer than N bytes is a bounds error.
+static int json_unmarshal_scalar_fixstr_(sstr_t content, struct json_pos* pos,
+                                         char* val, int size,
+                                         const char* field_name, sstr_t txt) {
+    int tk = json_next_token(content, pos, txt);
+    size_t n;
+    if (tk == JSON_TOKEN_NULL) {
+        val[0] = '\0';
+        val[size] = 0;
+        return 0;
+    } else if (tk != JSON_TOKEN_STRING) {
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING,
+                  "expected string but got '%s'", ptoken(tk, txt));
+        return tk;
+    }
+    n = sstr_length(txt);
+    if (n >= (size_t)size) {
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE,
+                  "string of %uz bytes exceeds str<%d> field '%s'", n,
+                  size - 1, field_name);
+        return JSON_ERROR;
+    }
+    memcpy(val, sstr_cstr_fast(txt), n);
+    val[n] = '\0';
+    val[size] = (char)(unsigned char)n;
+    return 0;
+}
+
 // parse enum value: read a JSON string and look up the corresponding int index
 // in the enum_strings array. Falls back to parsing as int if not a string.
 static int json_unmarshal_scalar_enum(sstr_t content, struct json_pos* pos,
@@ -879,32 +1109,30 @@ static int json_unmarshal_scalar_enum(sstr_t content, struct json_pos* pos,
                                       int enum_count, sstr_t txt) {
     int tk = json_next_token(content, pos, txt);
     if (tk == JSON_TOKEN_STRING) {
-        const char* s = SSTR_CSTR_(txt);
+        const char* s = sstr_cstr_fast(txt);
         for (int i = 0; i < enum_count; i++) {
             if (strcmp(s, enum_strings[i]) == 0) {
                 *val = i;
                 return 0;
             }
         }
-        sstr_t e = PERROR(pos, "unknown enum value '%s'", s);
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE,
+                  "unknown enum value '%s'", s);
         return -1;
     } else if (tk == JSON_TOKEN_INT) {
         char* endptr;
-        long temp_val = strtol(SSTR_CSTR_(txt), &endptr, 10);
+        long temp_val = strtol(sstr_cstr_fast(txt), &endptr, 10);
         if (*endptr != '\0' || temp_val > INT_MAX || temp_val < INT_MIN) {
-            sstr_t e = PERROR(pos, "enum integer value out of range: '%s'", SSTR_CSTR_(txt));
-            sstr_append(txt, e);
-            sstr_free(e);
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE,
+                      "enum integer value out of range: '%s'", sstr_cstr_fast(txt));
             return JSON_ERROR;
         }
         *val = (int)temp_val;
         return 0;
     } else {
-        sstr_t e = PERROR(pos, "expected string or integer for enum but got '%s'", ptoken(tk, txt));
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING,
+                  "expected string or integer for enum but got '%s'",
+                  ptoken(tk, txt));
         return tk;
     }
 }
@@ -921,28 +1149,26 @@ static int json_unmarshal_scalar_##TYPE(sstr_t content, struct json_pos* pos,  \
     } else if (tk == JSON_TOKEN_TRUE) {                                        \
         *val = 1;                                                              \
     } else if (tk != JSON_TOKEN_INT) {                                         \
-        sstr_t e = PERROR(pos, "expected integer but got '%s'",                \
-                          ptoken(tk, txt));                                     \
-        sstr_append(txt, e);                                                   \
-        sstr_free(e);                                                          \
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NUMBER,          \
+                  "expected integer but got '%s'",                             \
+                  ptoken(tk, txt));                                            \
         return tk;                                                             \
     } else {                                                                   \
-        const char* s = SSTR_CSTR_(txt);                                      \
+        const char* s = sstr_cstr_fast(txt);                                   \
         while (*s == ' ') s++;                                                 \
         if (*s == '-') {                                                       \
-            sstr_t e = PERROR(pos, #TYPE " cannot be negative: '%s'",          \
-                              SSTR_CSTR_(txt));                                \
-            sstr_append(txt, e);                                               \
-            sstr_free(e);                                                      \
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE,       \
+                      #TYPE " cannot be negative: '%s'",                       \
+                      sstr_cstr_fast(txt));                                    \
             return JSON_ERROR;                                                 \
         }                                                                      \
         char* endptr;                                                          \
-        CONV_TYPE temp_val = CONV_FN(SSTR_CSTR_(txt), &endptr, 10);           \
-        if (*endptr != '\0' || temp_val > (MAX_VAL)) {                         \
-            sstr_t e = PERROR(pos, #TYPE " value out of range: '%s'",          \
-                              SSTR_CSTR_(txt));                                \
-            sstr_append(txt, e);                                               \
-            sstr_free(e);                                                      \
+        errno = 0;                                                             \
+        CONV_TYPE temp_val = CONV_FN(sstr_cstr_fast(txt), &endptr, 10);        \
+        if (*endptr != '\0' || errno == ERANGE || temp_val > (MAX_VAL)) {      \
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE,       \
+                      #TYPE " value out of range: '%s'",                       \
+                      sstr_cstr_fast(txt));                                    \
             return JSON_ERROR;                                                 \
         }                                                                      \
         *val = (TYPE)temp_val;                                                 \
@@ -969,13 +1195,13 @@ static int json_unmarshal_array_internal_enum(sstr_t content,
         return 0;
     }
     if (tk != JSON_TOKEN_LEFT_BRACKET) {
-        sstr_t e = PERROR(pos, "expected '[' but got '%s'", ptoken(tk, txt));
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '[',
+                  "expected '[' but got '%s'", ptoken(tk, txt));
         return -1;
     }
     int cap = 4;
     int len = 0;
+    if (JSON_LIMIT_ALLOC(pos, txt, sizeof(int) * cap) != 0) return -1;
     int* arr = (int*)JGENC_MALLOC(sizeof(int) * cap);
     if (arr == NULL) return -1;
     while (1) {
@@ -987,11 +1213,15 @@ static int json_unmarshal_array_internal_enum(sstr_t content,
         if (tk == JSON_TOKEN_RIGHT_BRACKET) {
             break;
         }
-        if (tk == JSON_TOKEN_COMMA) {
-            continue;
-        }
         // restore position to re-read the token in scalar_enum
         *pos = saved;
+        if (JSON_LIMIT_CHECK(pos, txt, max_array_len, len + 1,
+                             "array length") != 0 ||
+            (len >= cap &&
+             JSON_LIMIT_ALLOC(pos, txt, sizeof(int) * cap) != 0)) {
+            JGENC_FREE(arr);
+            return -1;
+        }
         if (len >= cap) {
             cap *= 2;
             int* new_arr = (int*)JGENC_REALLOC(arr, sizeof(int) * cap);
@@ -1004,6 +1234,19 @@ static int json_unmarshal_array_internal_enum(sstr_t content,
             return r;
         }
         len++;
+        tk = json_next_token(content, pos, txt);
+        if (tk == JSON_TOKEN_RIGHT_BRACKET) {
+            break;
+        }
+        if (tk != JSON_TOKEN_COMMA) {
+            if (tk != JSON_ERROR) {
+                JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, ',',
+                          "expected ',' or ']' but got '%s'",
+                          ptoken(tk, txt));
+            }
+            JGENC_FREE(arr);
+            return -1;
+        }
     }
     *ptr = arr;
     *ptrlen = len;
@@ -1017,14 +1260,25 @@ static int json_unmarshal_ignore_value(sstr_t content, struct json_pos* pos,
                                        sstr_t txt) {
     int brace = 0;
     int bracket = 0;
+    int first = 1;
     while (1) {
         int tk = json_next_token(content, pos, txt);
         if (tk == JSON_TOKEN_EOF) {
-            sstr_t e = PERROR(pos, "unexpected EOF");
-            sstr_append(txt, e);
-            sstr_free(e);
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_VALUE,
+                      "unexpected EOF");
             return -1;
         }
+        if (tk == JSON_ERROR) {
+            return -1;
+        }
+        if (first && (tk == JSON_TOKEN_COMMA || tk == JSON_TOKEN_COLON ||
+                      tk == JSON_TOKEN_RIGHT_BRACE ||
+                      tk == JSON_TOKEN_RIGHT_BRACKET)) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_VALUE,
+                      "expected a value but got '%s'", ptoken(tk, txt));
+            return -1;
+        }
+        first = 0;
         if (tk == JSON_TOKEN_LEFT_BRACE) {
             brace++;
         } else if (tk == JSON_TOKEN_RIGHT_BRACE) {
@@ -1060,17 +1314,23 @@ static int json_field_is_selected(const struct json_parse_param* param,
 
 static void json_clear_struct_value(void* instance_ptr, const char* struct_name);
 
-static const struct json_nested_mask* json_find_nested_mask(
-        const struct json_parse_param* param, int field_index) {
+static const struct json_nested_mask* json_nested_mask_find_(
+        const struct json_nested_mask* masks, int count, int field_index) {
     int i;
-    for (i = 0; i < param->nested_mask_count; i++) {
-        if (param->nested_masks[i].field_index == field_index) {
-            return &param->nested_masks[i];
+    for (i = 0; i < count; i++) {
+        if (masks[i].field_index == field_index) {
+            return &masks[i];
         }
     }
     return NULL;
 }
 
+static const struct json_nested_mask* json_find_nested_mask(
+        const struct json_parse_param* param, int field_index) {
+    return json_nested_mask_find_(param->nested_masks,
+                                  param->nested_mask_count, field_index);
+}
+
 static struct json_field_offset_item* json_array_length_field(
     const struct json_field_offset_item* fi) {
     /* Build "field_name_len" on the stack to avoid sstr_t allocation. */
@@ -1234,9 +1494,17 @@ static void json_clear_field_value(void* instance_ptr,
             *(double*)field_ptr = 0.0;
             break;
         case FIELD_TYPE_SSTR:
+            if (JSON_FIELD_IS_INLINE_STR_(fi)) {
+                sstr_reset((sstr_t)field_ptr);
+                break;
+            }
             sstr_free(*(sstr_t*)field_ptr);
             *(sstr_t*)field_ptr = NULL;
             break;
+        case FIELD_TYPE_FIXSTR:
+            // the length byte follows the char array
+            memset(field_ptr, 0, (size_t)fi->type_size + 1);
+            break;
         case FIELD_TYPE_STRUCT:
             json_clear_struct_value(field_ptr, fi->field_type_name);
             break;
@@ -1252,8 +1520,26 @@ static void json_clear_field_value(void* instance_ptr,
     }
 }
 
+#ifdef JSON_HAS_CACHED_STRUCTS
+// Free the json fragments of a @cached struct whose fields are about to
+// change. The struct's own table entry holds the offset of _json_cache.
+static void json_drop_struct_cache(void* instance_ptr,
+                                   const struct json_field_offset_item* st) {
+    if (st != NULL && st->has_field_offset >= 0) {
+        struct json_cache** cache =
+            (struct json_cache**)((char*)instance_ptr + st->has_field_offset);
+        json_cache_free_(*cache);
+        *cache = NULL;
+    }
+}
+#endif
+
 static void json_clear_struct_value(void* instance_ptr, const char* struct_name) {
     int i;
+#ifdef JSON_HAS_CACHED_STRUCTS
+    json_drop_struct_cache(instance_ptr,
+                           json_field_offset_item_find(struct_name, ""));
+#endif
     for (i = 0; json_field_offset_item[i].field_name != NULL; i++) {
         struct json_field_offset_item* fi = &json_field_offset_item[i];
         if (fi->field_index < 0) {
@@ -1334,9 +1620,8 @@ static int json_scan_tag_value(sstr_t content, struct json_pos* pos,
 
     *pos = saved;
     if (!found) {
-        sstr_t e = PERROR(pos, "oneof: tag field \"%s\" not found", tag_field);
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE,
+                  "oneof: tag field \"%s\" not found", tag_field);
         return -1;
     }
     return 0;
@@ -1387,9 +1672,8 @@ static int json_unmarshal_oneof_internal(sstr_t content, struct json_pos* pos,
         return -1;
     }
     if (tk != JSON_TOKEN_LEFT_BRACE) {
-        sstr_t e = PERROR(pos, "oneof: expected '{' but got token %d", tk);
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '{',
+                  "oneof: expected '{' but got token %d", tk);
         return -1;
     }
 
@@ -1411,10 +1695,9 @@ static int json_unmarshal_oneof_internal(sstr_t content, struct json_pos* pos,
         }
     }
     if (matched < 0) {
-        sstr_t e = PERROR(pos, "oneof: unknown tag value \"%s\"",
-                          sstr_cstr(tag_value));
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE,
+                  "oneof: unknown tag value \"%s\"",
+                  sstr_cstr(tag_value));
         sstr_free(tag_value);
         return -1;
     }
@@ -1440,6 +1723,7 @@ static int json_unmarshal_oneof_internal(sstr_t content, struct json_pos* pos,
     sub.field_mask_word_count = 0;
     sub.nested_masks = NULL;
     sub.nested_mask_count = 0;
+    sub.merge = 0;
     r = json_unmarshal_struct_internal(content, pos, &sub, txt);
     if (r < 0) {
         return -1;
@@ -1482,9 +1766,8 @@ static int json_unmarshal_array_internal_oneof(
         return 0;
     }
     if (tk != JSON_TOKEN_LEFT_BRACKET) {
-        sstr_t e = PERROR(pos, "expected '[' but got %s", ptoken(tk, txt));
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '[',
+                  "expected '[' but got %s", ptoken(tk, txt));
         return -1;
     }
 
@@ -1504,6 +1787,16 @@ static int json_unmarshal_array_internal_oneof(
         }
 
         /* Grow array if needed. */
+        if (JSON_LIMIT_CHECK(pos, txt, max_array_len, len + 1,
+                             "array length") != 0 ||
+            (len >= cap &&
+             JSON_LIMIT_ALLOC(pos, txt, (size_t)(cap == 0 ? 4 : cap) *
+                                            element_size) != 0)) {
+            JGENC_FREE(arr);
+            *arr_pp = NULL;
+            *ptrlen = 0;
+            return -1;
+        }
         if (len >= cap) {
             cap = cap == 0 ? 4 : cap * 2;
             arr = (char*)JGENC_REALLOC(arr, (size_t)cap * element_size);
@@ -1537,12 +1830,15 @@ static int json_unmarshal_array_internal_oneof(
             *pos = peek;
             continue;
         }
-        if (peek_tk == JSON_ERROR || peek_tk == JSON_TOKEN_EOF) {
-            JGENC_FREE(arr);
-            *arr_pp = NULL;
-            *ptrlen = 0;
-            return -1;
+        if (peek_tk != JSON_ERROR) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, ',',
+                      "expected ',' or ']' but got '%s'",
+                      ptoken(peek_tk, txt));
         }
+        JGENC_FREE(arr);
+        *arr_pp = NULL;
+        *ptrlen = 0;
+        return -1;
     }
 
     /* Shrink to fit. */
@@ -1557,6 +1853,22 @@ static int json_unmarshal_array_internal_oneof(
 // ============================================================
 // Array unmarshal macro (handles all scalar array types)
 // ============================================================
+// Consume a ']' if it is the next token. Checked before each element, so
+// an empty array or a trailing comma never reaches the element decoder,
+// which would record an error for it.
+static int json_array_end_(sstr_t content, struct json_pos* pos) {
+    struct json_pos peek = *pos;
+    json_skip_space_comments(content, &peek);
+    if (peek.offset < (long)sstr_length(content) &&
+        sstr_cstr_fast(content)[peek.offset] == ']') {
+        *pos = peek;
+        pos->offset++;
+        pos->col++;
+        return 1;
+    }
+    return 0;
+}
+
 #define DEFINE_UNMARSHAL_ARRAY_INTERNAL(TYPE)                                   \
 static int json_unmarshal_array_internal_##TYPE(sstr_t content,                \
                                                 struct json_pos* pos,          \
@@ -1564,22 +1876,29 @@ static int json_unmarshal_array_internal_##TYPE(sstr_t content,                \
                                                 sstr_t txt) {                  \
     int tk = json_next_token(content, pos, txt);                               \
     if (tk != JSON_TOKEN_LEFT_BRACKET) {                                       \
-        sstr_t e = PERROR(pos, "expected '[' but got %s", ptoken(tk, txt));    \
-        sstr_append(txt, e);                                                   \
-        sstr_free(e);                                                          \
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '[',                         \
+                  "expected '[' but got %s", ptoken(tk, txt));                 \
         return -1;                                                             \
     }                                                                          \
     int cap_ = 0;                                                              \
     while (1) {                                                                \
         TYPE res = 0;                                                          \
-        int r = json_unmarshal_scalar_##TYPE(content, pos, &res, txt);         \
-        if (r == JSON_TOKEN_RIGHT_BRACKET) {                                   \
+        if (json_array_end_(content, pos)) {                                   \
             return 0;                                                          \
         }                                                                      \
-        if (r < 0) {                                                           \
+        int r = json_unmarshal_scalar_##TYPE(content, pos, &res, txt);         \
+        if (r != 0) {                                                          \
             return r;                                                          \
         }                                                                      \
+        if (JSON_LIMIT_CHECK(pos, txt, max_array_len, *ptrlen + 1,             \
+                             "array length") != 0) {                           \
+            return -1;                                                         \
+        }                                                                      \
         if (*ptrlen >= cap_) {                                                 \
+            if (JSON_LIMIT_ALLOC(pos, txt, (size_t)(cap_ == 0 ? 4 : cap_) *    \
+                                               sizeof(TYPE)) != 0) {           \
+                return -1;                                                     \
+            }                                                                  \
             cap_ = cap_ == 0 ? 4 : cap_ * 2;                                  \
             TYPE* np_ = (TYPE*)JGENC_REALLOC(*ptr, cap_ * sizeof(TYPE));       \
             if (!np_) return -1;                                               \
@@ -1594,15 +1913,14 @@ static int json_unmarshal_array_internal_##TYPE(sstr_t content,                \
         if (tk2 == JSON_TOKEN_COMMA) {                                         \
             continue;                                                          \
         }                                                                      \
-        if (tk2 == JSON_ERROR) {                                               \
-            return -1;                                                         \
-        }                                                                      \
         if (tk2 == JSON_TOKEN_EOF) {                                           \
-            sstr_t e = PERROR(pos, "parsing array, each EOF");                 \
-            sstr_append(txt, e);                                               \
-            sstr_free(e);                                                      \
-            return -1;                                                         \
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_VALUE,       \
+                      "parsing array, each EOF");                              \
+        } else if (tk2 != JSON_ERROR) {                                        \
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, ',',                     \
+                      "expected ',' or ']' but got '%s'", ptoken(tk2, txt));   \
         }                                                                      \
+        return -1;                                                             \
     }                                                                          \
     return 0;                                                                  \
 }
@@ -1618,22 +1936,29 @@ static int json_unmarshal_array_internal_sstr_t(sstr_t content,
                                                 sstr_t txt) {
     int tk = json_next_token(content, pos, txt);
     if (tk != JSON_TOKEN_LEFT_BRACKET) {
-        sstr_t e = PERROR(pos, "expected '[' but got %s", ptoken(tk, txt));
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '[',
+                  "expected '[' but got %s", ptoken(tk, txt));
         return -1;
     }
 
     int cap_ = 0;
     while (1) {
         sstr_t res = NULL;
-        int r = json_unmarshal_scalar_sstr_t(content, pos, &res, txt);
-        if (r == JSON_TOKEN_RIGHT_BRACKET) {
+        if (json_array_end_(content, pos)) {
             return 0;
         }
-        if (r < 0) {
+        int r = json_unmarshal_scalar_sstr_t(content, pos, &res, txt);
+        if (r != 0) {
             return r;
         }
+        if (JSON_LIMIT_CHECK(pos, txt, max_array_len, *ptrlen + 1,
+                             "array length") != 0 ||
+            (*ptrlen >= cap_ &&
+             JSON_LIMIT_ALLOC(pos, txt, (size_t)(cap_ == 0 ? 4 : cap_) *
+                                            sizeof(sstr_t)) != 0)) {
+            sstr_free(res);
+            return -1;
+        }
         if (*ptrlen >= cap_) {
             cap_ = cap_ == 0 ? 4 : cap_ * 2;
             sstr_t* np_ = (sstr_t*)JGENC_REALLOC(*ptr, cap_ * sizeof(sstr_t));
@@ -1649,15 +1974,14 @@ static int json_unmarshal_array_internal_sstr_t(sstr_t content,
         if (tk == JSON_TOKEN_COMMA) {
             continue;
         }
-        if (tk == JSON_ERROR) {
-            return -1;
-        }
         if (tk == JSON_TOKEN_EOF) {
-            sstr_t e = PERROR(pos, "parsing array, each EOF");
-            sstr_append(txt, e);
-            sstr_free(e);
-            return -1;
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_VALUE,
+                      "parsing array, each EOF");
+        } else if (tk != JSON_ERROR) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, ',',
+                      "expected ',' or ']' but got '%s'", ptoken(tk, txt));
         }
+        return -1;
     }
     return 0;
 }
@@ -1673,11 +1997,16 @@ DEFINE_UNMARSHAL_ARRAY_INTERNAL(uint64_t)
 
 int json_unmarshal_array_int(sstr_t content, int** ptr, int* len) {
     struct json_pos pos;
-    pos.line = 0;
-    pos.col = 0;
-    pos.offset = 0;
-    sstr_t txt = sstr_new();
-    int r = json_unmarshal_array_internal_int(content, &pos, ptr, len, txt);
+    struct json_limit_state lim;
+    SSTR_LOCAL(txt);
+    int r = json_decode_begin_(content, &pos, &lim, NULL, NULL, txt);
+    if (r != 0) {
+        *ptr = NULL;
+        *len = 0;
+        sstr_clear(txt);
+        return r;
+    }
+    r = json_unmarshal_array_internal_int(content, &pos, ptr, len, txt);
     if (r != 0) {
 #ifdef JSON_DEBUG
         printf("ERROR: %s\n", sstr_cstr(txt));
@@ -1686,17 +2015,22 @@ int json_unmarshal_array_int(sstr_t content, int** ptr, int* len) {
         *ptr = NULL;
         *len = 0;
     }
-    sstr_free(txt);
+    sstr_clear(txt);
     return r;
 }
 
 int json_unmarshal_array_long(sstr_t content, long** ptr, int* len) {
     struct json_pos pos;
-    pos.line = 0;
-    pos.col = 0;
-    pos.offset = 0;
-    sstr_t txt = sstr_new();
-    int r = json_unmarshal_array_internal_long(content, &pos, ptr, len, txt);
+    struct json_limit_state lim;
+    SSTR_LOCAL(txt);
+    int r = json_decode_begin_(content, &pos, &lim, NULL, NULL, txt);
+    if (r != 0) {
+        *ptr = NULL;
+        *len = 0;
+        sstr_clear(txt);
+        return r;
+    }
+    r = json_unmarshal_array_internal_long(content, &pos, ptr, len, txt);
 
     if (r != 0) {
 #ifdef JSON_DEBUG
@@ -1707,17 +2041,22 @@ int json_unmarshal_array_long(sstr_t content, long** ptr, int* len) {
         *len = 0;
     }
 
-    sstr_free(txt);
+    sstr_clear(txt);
     return r;
 }
 
 int json_unmarshal_array_float(sstr_t content, float** ptr, int* len) {
     struct json_pos pos;
-    pos.line = 0;
-    pos.col = 0;
-    pos.offset = 0;
-    sstr_t txt = sstr_new();
-    int r = json_unmarshal_array_internal_float(content, &pos, ptr, len, txt);
+    struct json_limit_state lim;
+    SSTR_LOCAL(txt);
+    int r = json_decode_begin_(content, &pos, &lim, NULL, NULL, txt);
+    if (r != 0) {
+        *ptr = NULL;
+        *len = 0;
+        sstr_clear(txt);
+        return r;
+    }
+    r = json_unmarshal_array_internal_float(content, &pos, ptr, len, txt);
     if (r != 0) {
 #ifdef JSON_DEBUG
         printf("ERROR: %s\n", sstr_cstr(txt));
@@ -1726,17 +2065,22 @@ int json_unmarshal_array_float(sstr_t content, float** ptr, int* len) {
         *ptr = NULL;
         *len = 0;
     }
-    sstr_free(txt);
+    sstr_clear(txt);
     return r;
 }
 
 int json_unmarshal_array_double(sstr_t content, double** ptr, int* len) {
     struct json_pos pos;
-    pos.line = 0;
-    pos.col = 0;
-    pos.offset = 0;
-    sstr_t txt = sstr_new();
-    int r = json_unmarshal_array_internal_double(content, &pos, ptr, len, txt);
+    struct json_limit_state lim;
+    SSTR_LOCAL(txt);
+    int r = json_decode_begin_(content, &pos, &lim, NULL, NULL, txt);
+    if (r != 0) {
+        *ptr = NULL;
+        *len = 0;
+        sstr_clear(txt);
+        return r;
+    }
+    r = json_unmarshal_array_internal_double(content, &pos, ptr, len, txt);
     if (r != 0) {
 #ifdef JSON_DEBUG
         printf("ERROR: %s\n", sstr_cstr(txt));
@@ -1745,17 +2089,22 @@ int json_unmarshal_array_double(sstr_t content, double** ptr, int* len) {
         *ptr = NULL;
         *len = 0;
     }
-    sstr_free(txt);
+    sstr_clear(txt);
     return r;
 }
 
 int json_unmarshal_array_sstr_t(sstr_t content, sstr_t** ptr, int* len) {
     struct json_pos pos;
-    pos.line = 0;
-    pos.col = 0;
-    pos.offset = 0;
-    sstr_t txt = sstr_new();
-    int r = json_unmarshal_array_internal_sstr_t(content, &pos, ptr, len, txt);
+    struct json_limit_state lim;
+    SSTR_LOCAL(txt);
+    int r = json_decode_begin_(content, &pos, &lim, NULL, NULL, txt);
+    if (r != 0) {
+        *ptr = NULL;
+        *len = 0;
+        sstr_clear(txt);
+        return r;
+    }
+    r = json_unmarshal_array_internal_sstr_t(content, &pos, ptr, len, txt);
     if (r != 0) {
 #ifdef JSON_DEBUG
         printf("ERROR: %s\n", sstr_cstr(txt));
@@ -1768,25 +2117,29 @@ int json_unmarshal_array_sstr_t(sstr_t content, sstr_t** ptr, int* len) {
         *ptr = NULL;
         *len = 0;
     }
-    sstr_free(txt);
+    sstr_clear(txt);
     return r;
 }
 
 #define DEFINE_UNMARSHAL_ARRAY_PUBLIC(TYPE)                                     \
 int json_unmarshal_array_##TYPE(sstr_t content, TYPE** ptr, int* len) {        \
     struct json_pos pos;                                                        \
-    pos.line = 0;                                                              \
-    pos.col = 0;                                                               \
-    pos.offset = 0;                                                            \
-    sstr_t txt = sstr_new();                                                   \
-    int r = json_unmarshal_array_internal_##TYPE(content, &pos, ptr, len,      \
-                                                  txt);                        \
+    struct json_limit_state lim;                                               \
+    SSTR_LOCAL(txt);                                                           \
+    int r = json_decode_begin_(content, &pos, &lim, NULL, NULL, txt);          \
+    if (r != 0) {                                                              \
+        *ptr = NULL;                                                           \
+        *len = 0;                                                              \
+        sstr_clear(txt);                                                       \
+        return r;                                                              \
+    }                                                                          \
+    r = json_unmarshal_array_internal_##TYPE(content, &pos, ptr, len, txt);    \
     if (r != 0) {                                                              \
         JGENC_FREE(*ptr);                                                            \
         *ptr = NULL;                                                           \
         *len = 0;                                                              \
     }                                                                          \
-    sstr_free(txt);                                                            \
+    sstr_clear(txt);                                                           \
     return r;                                                                  \
 }
 
@@ -1803,127 +2156,6 @@ static int json_unmarshal_struct_internal(sstr_t content, struct json_pos* pos,
                                           struct json_parse_param* param,
                                           sstr_t txt);
 
-/**
- * @brief Parse JSON array with proper memory management
- * @param content JSON content string
- * @param pos Current parsing position
- * @param param Parse parameters
- * @param len Output array length
- * @param txt Error message buffer
- * @return 0 on success, negative on error
- */
-static int json_unmarshal_array_internal(sstr_t content, struct json_pos* pos,
-                                         struct json_parse_param* param,
-                                         int* len, sstr_t txt) {
-    *len = 0;
-    struct json_field_offset_item* field =
-        json_field_offset_item_find(param->struct_name, "");
-    if (field == NULL) {
-        sstr_t e = PERROR(pos, "struct %s not found", param->struct_name);
-        sstr_append(txt, e);
-        sstr_free(e);
-        return JSON_GEN_ERROR_NOT_FOUND;
-    }
-#ifdef JSON_DEBUG
-    printf("array find field struct %s, size %d\n", field->struct_name,
-           field->type_size);
-#endif
-
-    int tk = json_next_token(content, pos, txt);
-    if (tk != JSON_TOKEN_LEFT_BRACKET) {
-        sstr_t e = PERROR(pos, "expected '[' but got %s", ptoken(tk, txt));
-        sstr_append(txt, e);
-        sstr_free(e);
-        return JSON_GEN_ERROR_PARSE;
-    }
-
-    // Check for empty array immediately after '['
-    // We need to peek ahead to see if the next token is ']'
-    struct json_pos peek_pos = *pos;  // Save current position
-    tk = json_next_token(content, &peek_pos, txt);
-    if (tk == JSON_TOKEN_RIGHT_BRACKET) {
-        // Empty array case - update position and return
-        *pos = peek_pos;
-        return JSON_GEN_SUCCESS;
-    }
-    // If not empty, continue with normal parsing using original position
-
-    int cap_ = 0;
-    while (1) {
-        void* ptr = JGENC_MALLOC(field->type_size);
-        if (ptr == NULL) {
-            sstr_t e = PERROR(pos, "memory allocation failed for array element");
-            sstr_append(txt, e);
-            sstr_free(e);
-            return JSON_GEN_ERROR_MEMORY;
-        }
-        
-        memset(ptr, 0, field->type_size);
-        struct json_parse_param sub_param;
-        sub_param.instance_ptr = ptr;
-        sub_param.in_array = 1;
-        sub_param.in_struct = 0;
-        sub_param.depth = param->depth + 1;
-        sub_param.struct_name = param->struct_name;
-        sub_param.field_name = param->field_name;
-        sub_param.field_mask = NULL;
-        sub_param.field_mask_word_count = 0;
-        sub_param.nested_masks = NULL;
-        sub_param.nested_mask_count = 0;
-
-        int r = json_unmarshal_struct_internal(content, pos, &sub_param, txt);
-        
-        // Handle parsing failure - free allocated memory before returning
-        if (r < 0) {
-            JGENC_FREE(ptr);
-            return r;
-        }
-        
-        // Grow array buffer with capacity doubling
-        if (*len >= cap_) {
-            cap_ = cap_ == 0 ? 4 : cap_ * 2;
-            void* pptr = JGENC_REALLOC(*(void**)param->instance_ptr,
-                                 cap_ * field->type_size);
-            if (pptr == NULL) {
-                JGENC_FREE(ptr);
-                sstr_t e = PERROR(pos, "memory reallocation failed for array");
-                sstr_append(txt, e);
-                sstr_free(e);
-                return JSON_GEN_ERROR_MEMORY;
-            }
-            *(void**)param->instance_ptr = pptr;
-        }
-        
-        // Copy element to array and update pointer
-        void* arr_base = *(void**)param->instance_ptr;
-        memcpy(arr_base + (*len * field->type_size), ptr, field->type_size);
-        JGENC_FREE(ptr);
-        *len = *len + 1;
-
-        if (r == 1) {
-            return JSON_GEN_SUCCESS;  // finished
-        }
-
-        int tk = json_next_token(content, pos, txt);
-        if (tk == JSON_TOKEN_RIGHT_BRACKET) {
-            return JSON_GEN_SUCCESS;
-        }
-        if (tk == JSON_TOKEN_COMMA) {
-            continue;
-        }
-        if (tk == JSON_ERROR) {
-            return JSON_GEN_ERROR_PARSE;
-        }
-        if (tk == JSON_TOKEN_EOF) {
-            sstr_t e = PERROR(pos, "parsing array, reached EOF unexpectedly");
-            sstr_append(txt, e);
-            sstr_free(e);
-            return JSON_GEN_ERROR_PARSE;
-        }
-    }
-    return JSON_GEN_SUCCESS;
-}
-
 // Unmarshal a single JSON object into a map container.
 // map_ptr points to the beginning of {entries_ptr, len} pair.
 // entry_size is sizeof(json_map_entry_<type>).
@@ -1939,10 +2171,9 @@ static int json_unmarshal_map_object(sstr_t content, struct json_pos* pos,
         return 0;
     }
     if (tk != JSON_TOKEN_LEFT_BRACE) {
-        sstr_t e = PERROR(pos, "expected '{' for map but got '%s'",
-                          ptoken(tk, txt));
-        sstr_append(txt, e);
-        sstr_free(e);
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '{',
+                  "expected '{' for map but got '%s'",
+                  ptoken(tk, txt));
         return -1;
     }
 
@@ -1951,22 +2182,42 @@ static int json_unmarshal_map_object(sstr_t content, struct json_pos* pos,
     int cap = *len_p;
     char* entries = *entries_pp;
 
+    int first = 1;
     while (1) {
         tk = json_next_token(content, pos, txt);
-        if (tk == JSON_TOKEN_RIGHT_BRACE) {
+        if (tk == JSON_TOKEN_RIGHT_BRACE && first) {
             break;
         }
-        if (tk == JSON_TOKEN_COMMA) {
-            continue;
+        // entries are separated by exactly one ',', with none after the last
+        if (!first) {
+            if (tk == JSON_TOKEN_RIGHT_BRACE) {
+                break;
+            }
+            if (tk == JSON_TOKEN_EOF || tk == JSON_ERROR) {
+                return -1;
+            }
+            if (tk != JSON_TOKEN_COMMA) {
+                JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, ',',
+                          "expected ',' or '}' in map but got '%s'",
+                          ptoken(tk, txt));
+                return -1;
+            }
+            tk = json_next_token(content, pos, txt);
         }
+        first = 0;
         if (tk == JSON_TOKEN_EOF || tk == JSON_ERROR) {
             return -1;
         }
         if (tk != JSON_TOKEN_STRING) {
-            sstr_t e = PERROR(pos, "expected string key in map but got '%s'",
-                              ptoken(tk, txt));
-            sstr_append(txt, e);
-            sstr_free(e);
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING,
+                      "expected string key in map but got '%s'",
+                      ptoken(tk, txt));
+            return -1;
+        }
+
+        if (JSON_LIMIT_CHECK(pos, txt, max_map_entries, *len_p + 1,
+                             "map entries") != 0 ||
+            JSON_LIMIT_ALLOC(pos, txt, sstr_length(txt) + 1) != 0) {
             return -1;
         }
 
@@ -1976,16 +2227,21 @@ static int json_unmarshal_map_object(sstr_t content, struct json_pos* pos,
         // Expect colon
         tk = json_next_token(content, pos, txt);
         if (tk != JSON_TOKEN_COLON) {
-            sstr_t e = PERROR(pos, "expected ':' in map but got '%s'",
-                              ptoken(tk, txt));
-            sstr_append(txt, e);
-            sstr_free(e);
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, ':',
+                      "expected ':' in map but got '%s'",
+                      ptoken(tk, txt));
             sstr_free(key);
             return -1;
         }
 
         // Grow entries array
         int idx = *len_p;
+        if (idx >= cap &&
+            JSON_LIMIT_ALLOC(pos, txt, (size_t)(cap == 0 ? 4 : cap) *
+                                           entry_size) != 0) {
+            sstr_free(key);
+            return -1;
+        }
         if (idx >= cap) {
             cap = cap == 0 ? 4 : cap * 2;
             entries = (char*)JGENC_REALLOC(entries, (size_t)cap * entry_size);
@@ -2001,6 +2257,8 @@ static int json_unmarshal_map_object(sstr_t content, struct json_pos* pos,
         *(sstr_t*)entry = key;
         // Value starts after the key (after sstr_t = sizeof(void*))
         void* val_ptr = entry + sizeof(sstr_t);
+        // a struct value only sets the fields present in the input
+        memset(val_ptr, 0, entry_size - sizeof(sstr_t));
 
         int r = 0;
         switch (value_type) {
@@ -2066,6 +2324,7 @@ static int json_unmarshal_map_object(sstr_t content, struct json_pos* pos,
                 sub.field_mask_word_count = 0;
                 sub.nested_masks = NULL;
                 sub.nested_mask_count = 0;
+                sub.merge = 0;
                 r = json_unmarshal_struct_internal(content, pos, &sub, txt);
                 break;
             }
@@ -2073,8 +2332,14 @@ static int json_unmarshal_map_object(sstr_t content, struct json_pos* pos,
                 r = -1;
                 break;
         }
-        if (r < 0) {
-            return r;
+        if (r != 0) {
+            if (value_type == FIELD_TYPE_STRUCT) {
+                json_clear_struct_value(val_ptr, value_type_name);
+            } else if (value_type == FIELD_TYPE_SSTR) {
+                sstr_free(*(sstr_t*)val_ptr);
+            }
+            sstr_free(key);
+            return r < 0 ? r : -1;
         }
         (*len_p)++;
     }
@@ -2089,224 +2354,83 @@ static int json_unmarshal_map_object(sstr_t content, struct json_pos* pos,
     return 0;
 }
 
-static int json_unmarshal_struct_internal(sstr_t content, struct json_pos* pos,
-                                          struct json_parse_param* param,
-                                          sstr_t txt) {
-    // Check recursion depth
-    if (param->depth > JSON_MAX_DEPTH) {
-        sstr_t e = PERROR(pos, "maximum JSON nesting depth (%d) exceeded", JSON_MAX_DEPTH);
-        sstr_append(txt, e);
-        sstr_free(e);
-        return -1;
-    }
-
-    // '{'
-    int tk = json_next_token(content, pos, txt);
-    if (tk == JSON_TOKEN_EOF) {
-        if (!param->in_array) {
-            sstr_t e = PERROR(pos, "expected '{' but got empty input");
-            sstr_append(txt, e);
-            sstr_free(e);
-            return -1;
-        }
-        return 0;
-    }
-    if (tk == JSON_ERROR) {
-        return -1;
-    }
-    if (param->in_array && tk == JSON_TOKEN_RIGHT_BRACKET) {
-        return 1;
-    }
-
-    if (tk != JSON_TOKEN_LEFT_BRACE) {
-        sstr_t e = PERROR(pos, "expected '{' but got '%s'", ptoken(tk, txt));
-        sstr_append(txt, e);
-        sstr_free(e);
-        return -1;
-    }
-
-    // Pre-compute hash prefix for struct_name (avoids re-hashing per field)
-    unsigned int st_hash_ = hash_s(param->struct_name, strlen(param->struct_name),
-                                   0xbc9f1d34);
-
-    // fields
-    while (1) {
-        tk = json_next_token(content, pos, txt);
-        if (tk == JSON_ERROR) {
-            return -1;
-        }
-        if (tk == JSON_TOKEN_EOF) {
-            sstr_t e = PERROR(pos, "expected '}' but reach end of file");
-            sstr_append(txt, e);
-            sstr_free(e);
-            return -1;
-        }
-        if (tk == JSON_TOKEN_RIGHT_BRACE) {
-            break;
-        }
-        if (tk == JSON_TOKEN_COMMA) {
-            // Peek ahead for trailing comma — skip whitespace/comments,
-            // check raw char instead of allocating sstr_t + full token parse.
-            struct json_pos peek = *pos;
-            json_skip_space_comments(content, &peek);
-            if (peek.offset < (long)sstr_length(content) &&
-                SSTR_CSTR_(content)[peek.offset] == '}') {
-                sstr_t e = PERROR(pos, "trailing comma not allowed before '}'");
-                sstr_append(txt, e);
-                sstr_free(e);
+/**
+ * @brief Decode the value of field @p fi into param->instance_ptr.
+ *
+ * Handles every field kind except nested structs and dynamic arrays of
+ * structs, which the iterative decoder below pushes as frames instead of
+ * recursing.  The ':' after the key has already been consumed.
+ *
+ * @return 0 on success, negative on error
+ */
+static int json_unmarshal_field_value(sstr_t content, struct json_pos* pos,
+                                      struct json_parse_param* param,
+                                      struct json_field_offset_item* fi,
+                                      sstr_t txt) {
+    if (fi->field_type == FIELD_TYPE_MAP) {
+        if (fi->is_array) {
+            // array of maps: "field": [{...}, {...}, ...]
+            sstr_t field_len_name = sstr(fi->field_name);
+            sstr_append_cstr(field_len_name, "_len");
+            struct json_field_offset_item* len_fi =
+                json_field_offset_item_find(param->struct_name,
+                                            sstr_cstr(field_len_name));
+            sstr_free(field_len_name);
+            if (len_fi == NULL) {
                 return -1;
             }
-            continue;
-        }
-
-        // field_name
-        if (tk != JSON_TOKEN_STRING) {
-            sstr_t e = PERROR(pos, "expected field_name string but got '%s'",
-                              ptoken(tk, txt));
-            sstr_append(txt, e);
-            sstr_free(e);
-            return -1;
-        }
 
-        struct json_field_offset_item* fi =
-            json_field_offset_item_find_ph(st_hash_, param->struct_name,
-                                           SSTR_CSTR_(txt), sstr_length(txt));
-        if (fi == NULL) {
-#if JSON_DEBUG
-            printf("json_field_offset_item_find NULL, ignoring...\n");
-#endif
-            // Consume the expected colon before skipping the value.
-            tk = json_next_token(content, pos, txt);
-            if (tk != JSON_TOKEN_COLON) {
-                sstr_t e =
-                    PERROR(pos, "expected ':' but got '%s'", ptoken(tk, txt));
-                sstr_append(txt, e);
-                sstr_free(e);
-                return -1;
-            }
-            if (json_unmarshal_ignore_value(content, pos, txt) != 0) {
-                return -1;
+            int tk2 = json_next_token(content, pos, txt);
+            if (tk2 == JSON_TOKEN_NULL) {
+                return 0;
             }
-            continue;
-        }
-#if JSON_DEBUG
-        printf("field found: %s->%s %s is_array: %d\n", (fi->struct_name),
-               (fi->field_name), fi->field_type_name, fi->is_array);
-#endif
-        tk = json_next_token(content, pos, txt);
-        if (tk != JSON_TOKEN_COLON) {
-            sstr_t e =
-                PERROR(pos, "expected ':' but got '%s'", ptoken(tk, txt));
-            sstr_append(txt, e);
-            sstr_free(e);
-            return -1;
-        }
-        if (!json_field_is_selected(param, fi)) {
-            if (json_unmarshal_ignore_value(content, pos, txt) != 0) {
+            if (tk2 != JSON_TOKEN_LEFT_BRACKET) {
+                JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '[',
+                          "expected '[' for map array but got '%s'",
+                          ptoken(tk2, txt));
                 return -1;
             }
-            continue;
-        }
-        if (param->field_mask != NULL) {
-            json_clear_field_value(param->instance_ptr, fi);
-        }
 
-        // Handle nullable fields: accept JSON null
-        if (fi->is_nullable) {
-            struct json_pos peek = *pos;
-            sstr_t peek_txt = sstr_new();
-            int peek_tk = json_next_token(content, &peek, peek_txt);
-            sstr_free(peek_txt);
-            if (peek_tk == JSON_TOKEN_NULL) {
-                *pos = peek;
-                // has_field remains false from init
-                continue;
-            }
-        }
+            // pointer to the map array pointer
+            char** arr_pp = (char**)((char*)param->instance_ptr + fi->offset);
+            char* arr = *arr_pp;
+            int arr_len = 0;
+            int arr_cap = 0;
 
-        if (fi->field_type == FIELD_TYPE_MAP) {
-            if (fi->is_array) {
-                // array of maps: "field": [{...}, {...}, ...]
-                sstr_t field_len_name = sstr(fi->field_name);
-                sstr_append_cstr(field_len_name, "_len");
-                struct json_field_offset_item* len_fi =
-                    json_field_offset_item_find(param->struct_name,
-                                                sstr_cstr(field_len_name));
-                sstr_free(field_len_name);
-                if (len_fi == NULL) {
-                    return -1;
+            while (1) {
+                // peek for ] or ,
+                struct json_pos peek = *pos;
+                sstr_t peek_txt = sstr_new();
+                tk2 = json_next_token(content, &peek, peek_txt);
+                sstr_free(peek_txt);
+                if (tk2 == JSON_TOKEN_RIGHT_BRACKET) {
+                    *pos = peek;
+                    break;
                 }
 
-                int tk2 = json_next_token(content, pos, txt);
-                if (tk2 == JSON_TOKEN_NULL) {
-                    continue;
-                }
-                if (tk2 != JSON_TOKEN_LEFT_BRACKET) {
-                    sstr_t e = PERROR(pos, "expected '[' for map array but got '%s'",
-                                      ptoken(tk2, txt));
-                    sstr_append(txt, e);
-                    sstr_free(e);
+                // grow array
+                if (JSON_LIMIT_CHECK(pos, txt, max_array_len, arr_len + 1,
+                                     "array length") != 0 ||
+                    (arr_len >= arr_cap &&
+                     JSON_LIMIT_ALLOC(pos, txt,
+                                      (size_t)(arr_cap == 0 ? 4 : arr_cap) *
+                                          fi->type_size) != 0)) {
+                    *(int*)((char*)param->instance_ptr + len_fi->offset) =
+                        arr_len;
                     return -1;
                 }
-
-                // pointer to the map array pointer
-                char** arr_pp = (char**)((char*)param->instance_ptr + fi->offset);
-                char* arr = *arr_pp;
-                int arr_len = 0;
-                int arr_cap = 0;
-
-                while (1) {
-                    // peek for ] or ,
-                    struct json_pos peek = *pos;
-                    sstr_t peek_txt = sstr_new();
-                    tk2 = json_next_token(content, &peek, peek_txt);
-                    sstr_free(peek_txt);
-                    if (tk2 == JSON_TOKEN_RIGHT_BRACKET) {
-                        *pos = peek;
-                        break;
-                    }
-
-                    // grow array
-                    if (arr_len >= arr_cap) {
-                        arr_cap = arr_cap == 0 ? 4 : arr_cap * 2;
-                        arr = (char*)JGENC_REALLOC(arr, (size_t)arr_cap * fi->type_size);
-                        if (!arr) return -1;
-                        *arr_pp = arr;
-                    }
-
-                    // Init the new map container: entries=NULL, len=0
-                    char* map_ptr = arr + (size_t)arr_len * fi->type_size;
-                    *(void**)map_ptr = NULL;
-                    *(int*)(map_ptr + sizeof(void*)) = 0;
-
-                    int r = json_unmarshal_map_object(
-                        content, pos, map_ptr,
-                        fi->map_entry_size, fi->map_value_type,
-                        fi->field_type_name,
-                        fi->enum_strings, fi->enum_count,
-                        param->depth + 1, txt);
-                    if (r < 0) return r;
-                    arr_len++;
-
-                    tk2 = json_next_token(content, pos, txt);
-                    if (tk2 == JSON_TOKEN_RIGHT_BRACKET) {
-                        break;
-                    }
-                    if (tk2 == JSON_TOKEN_COMMA) {
-                        continue;
-                    }
-                    return -1;
+                if (arr_len >= arr_cap) {
+                    arr_cap = arr_cap == 0 ? 4 : arr_cap * 2;
+                    arr = (char*)JGENC_REALLOC(arr, (size_t)arr_cap * fi->type_size);
+                    if (!arr) return -1;
+                    *arr_pp = arr;
                 }
 
-                // Shrink to fit
-                if (arr_len > 0 && arr_len < arr_cap) {
-                    arr = (char*)JGENC_REALLOC(arr, (size_t)arr_len * fi->type_size);
-                    if (arr) *arr_pp = arr;
-                }
-                *(int*)((char*)param->instance_ptr + len_fi->offset) = arr_len;
-            } else {
-                // scalar map: "field": {...}
-                void* map_ptr = (char*)param->instance_ptr + fi->offset;
+                // Init the new map container: entries=NULL, len=0
+                char* map_ptr = arr + (size_t)arr_len * fi->type_size;
+                *(void**)map_ptr = NULL;
+                *(int*)(map_ptr + sizeof(void*)) = 0;
+
                 int r = json_unmarshal_map_object(
                     content, pos, map_ptr,
                     fi->map_entry_size, fi->map_value_type,
@@ -2314,149 +2438,7 @@ static int json_unmarshal_struct_internal(sstr_t content, struct json_pos* pos,
                     fi->enum_strings, fi->enum_count,
                     param->depth + 1, txt);
                 if (r < 0) return r;
-            }
-            if (fi->has_field_offset >= 0) {
-                *(bool*)((char*)param->instance_ptr + fi->has_field_offset) = true;
-            }
-            continue;
-        }
-
-        if (fi->is_array && fi->array_size > 0) {
-            // fixed-size array: parse directly into inline buffer
-            int count = 0;
-            int max_size = fi->array_size;
-            void* base = (char*)param->instance_ptr + fi->offset;
-
-            int tk2 = json_next_token(content, pos, txt);
-            if (tk2 != JSON_TOKEN_LEFT_BRACKET) {
-                sstr_t e = PERROR(pos, "expected '[' but got '%s'",
-                                  ptoken(tk2, txt));
-                sstr_append(txt, e);
-                sstr_free(e);
-                return -1;
-            }
-
-            // peek for empty array
-            struct json_pos peek = *pos;
-            sstr_t peek_txt = sstr_new();
-            tk2 = json_next_token(content, &peek, peek_txt);
-            sstr_free(peek_txt);
-            if (tk2 == JSON_TOKEN_RIGHT_BRACKET) {
-                *pos = peek;
-                continue;
-            }
-
-            while (1) {
-                if (count >= max_size) {
-                    sstr_t e = PERROR(pos, "fixed-size array overflow: "
-                                      "max %d elements for field '%s'",
-                                      max_size, fi->field_name);
-                    sstr_append(txt, e);
-                    sstr_free(e);
-                    return -1;
-                }
-                int r;
-                switch (fi->field_type) {
-                    case FIELD_TYPE_INT:
-                    case FIELD_TYPE_BOOL:
-                        r = json_unmarshal_scalar_int(content, pos,
-                            &((int*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_LONG:
-                        r = json_unmarshal_scalar_long(content, pos,
-                            &((long*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_INT8:
-                        r = json_unmarshal_scalar_int8_t(content, pos,
-                            &((int8_t*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_INT16:
-                        r = json_unmarshal_scalar_int16_t(content, pos,
-                            &((int16_t*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_INT32:
-                        r = json_unmarshal_scalar_int32_t(content, pos,
-                            &((int32_t*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_INT64:
-                        r = json_unmarshal_scalar_int64_t(content, pos,
-                            &((int64_t*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_UINT8:
-                        r = json_unmarshal_scalar_uint8_t(content, pos,
-                            &((uint8_t*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_UINT16:
-                        r = json_unmarshal_scalar_uint16_t(content, pos,
-                            &((uint16_t*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_UINT32:
-                        r = json_unmarshal_scalar_uint32_t(content, pos,
-                            &((uint32_t*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_UINT64:
-                        r = json_unmarshal_scalar_uint64_t(content, pos,
-                            &((uint64_t*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_FLOAT:
-                        r = json_unmarshal_scalar_float(content, pos,
-                            &((float*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_DOUBLE:
-                        r = json_unmarshal_scalar_double(content, pos,
-                            &((double*)base)[count], txt);
-                        break;
-                    case FIELD_TYPE_SSTR: {
-                        sstr_t s = NULL;
-                        r = json_unmarshal_scalar_sstr_t(content, pos, &s, txt);
-                        ((sstr_t*)base)[count] = s;
-                        break;
-                    }
-                    case FIELD_TYPE_ENUM:
-                        r = json_unmarshal_scalar_enum(content, pos,
-                            &((int*)base)[count],
-                            fi->enum_strings, fi->enum_count, txt);
-                        break;
-                    case FIELD_TYPE_STRUCT: {
-                        struct json_parse_param sub;
-                        sub.instance_ptr =
-                            (char*)base + count * fi->type_size;
-                        sub.in_array = 1;
-                        sub.in_struct = 0;
-                        sub.depth = param->depth + 1;
-                        sub.struct_name = fi->field_type_name;
-                        sub.field_name = fi->field_name;
-                        sub.field_mask = NULL;
-                        sub.field_mask_word_count = 0;
-                        sub.nested_masks = NULL;
-                        sub.nested_mask_count = 0;
-                        r = json_unmarshal_struct_internal(content, pos,
-                                                           &sub, txt);
-                        break;
-                    }
-                    case FIELD_TYPE_ONEOF:
-                        r = json_unmarshal_oneof_internal(
-                            content, pos,
-                            (char*)base + count * fi->type_size,
-                            fi->oneof_tag_field,
-                            fi->enum_strings,
-                            fi->oneof_variant_structs,
-                            fi->enum_count,
-                            fi->oneof_tag_offset,
-                            fi->oneof_value_offset,
-                            param->depth + 1, txt);
-                        break;
-                    default:
-                        r = -1;
-                        break;
-                }
-                if (r == JSON_TOKEN_RIGHT_BRACKET) {
-                    break;
-                }
-                if (r < 0) {
-                    return r;
-                }
-                count++;
+                arr_len++;
 
                 tk2 = json_next_token(content, pos, txt);
                 if (tk2 == JSON_TOKEN_RIGHT_BRACKET) {
@@ -2465,129 +2447,148 @@ static int json_unmarshal_struct_internal(sstr_t content, struct json_pos* pos,
                 if (tk2 == JSON_TOKEN_COMMA) {
                     continue;
                 }
-                if (tk2 == JSON_ERROR || tk2 == JSON_TOKEN_EOF) {
-                    return -1;
-                }
+                return -1;
             }
-            if (fi->has_field_offset >= 0) {
-                *(bool*)((char*)param->instance_ptr + fi->has_field_offset) = true;
+
+            // Shrink to fit
+            if (arr_len > 0 && arr_len < arr_cap) {
+                arr = (char*)JGENC_REALLOC(arr, (size_t)arr_len * fi->type_size);
+                if (arr) *arr_pp = arr;
             }
-            continue;
+            *(int*)((char*)param->instance_ptr + len_fi->offset) = arr_len;
+        } else {
+            // scalar map: "field": {...}
+            void* map_ptr = (char*)param->instance_ptr + fi->offset;
+            int r = json_unmarshal_map_object(
+                content, pos, map_ptr,
+                fi->map_entry_size, fi->map_value_type,
+                fi->field_type_name,
+                fi->enum_strings, fi->enum_count,
+                param->depth + 1, txt);
+            if (r < 0) return r;
+        }
+        if (fi->has_field_offset >= 0) {
+            *(bool*)((char*)param->instance_ptr + fi->has_field_offset) = true;
         }
+        return 0;
+    }
 
-        if (fi->is_array) {
-            sstr_t field_len_name = sstr(fi->field_name);
-            sstr_append_cstr(field_len_name, "_len");
-            struct json_field_offset_item* len_fi = json_field_offset_item_find(
-                param->struct_name, sstr_cstr(field_len_name));
-            sstr_free(field_len_name);
-            if (len_fi == NULL) {
-                sstr_t e = PERROR(pos, "field %s not found",
-                                  sstr_cstr(field_len_name));
-                sstr_append(txt, e);
-                sstr_free(e);
+    if (fi->is_array && fi->array_size > 0) {
+        // fixed-size array: parse directly into inline buffer
+        int count = 0;
+        int max_size = fi->array_size;
+        void* base = (char*)param->instance_ptr + fi->offset;
+
+        int tk2 = json_next_token(content, pos, txt);
+        if (tk2 != JSON_TOKEN_LEFT_BRACKET) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '[',
+                      "expected '[' but got '%s'",
+                      ptoken(tk2, txt));
+            return -1;
+        }
+
+        // peek for empty array
+        struct json_pos peek = *pos;
+        sstr_t peek_txt = sstr_new();
+        tk2 = json_next_token(content, &peek, peek_txt);
+        sstr_free(peek_txt);
+        if (tk2 == JSON_TOKEN_RIGHT_BRACKET) {
+            *pos = peek;
+            return 0;
+        }
+
+        while (1) {
+            if (count >= max_size) {
+                JSON_FAIL(pos, txt, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE,
+                          "fixed-size array overflow: "
+                          "max %d elements for field '%s'",
+                          max_size, fi->field_name);
                 return -1;
             }
-            int len = 0;
-
+            int r;
             switch (fi->field_type) {
-                case FIELD_TYPE_STRUCT: {
-                    struct json_parse_param ar_param;
-                    ar_param.instance_ptr = fi->offset + param->instance_ptr;
-                    ar_param.in_array = 1;
-                    ar_param.in_struct = 0;
-                    ar_param.depth = param->depth;
-                    ar_param.struct_name = fi->field_type_name;
-                    ar_param.field_name = fi->field_name;
-                    ar_param.field_mask = NULL;
-                    ar_param.field_mask_word_count = 0;
-                    ar_param.nested_masks = NULL;
-                    ar_param.nested_mask_count = 0;
-                    int r = json_unmarshal_array_internal(content, pos,
-                                                          &ar_param, &len, txt);
-                    if (r < 0) {
-                        return r;
-                    }
-
-                    break;
-                }
                 case FIELD_TYPE_INT:
                 case FIELD_TYPE_BOOL:
-                    json_unmarshal_array_internal_int(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_int(content, pos,
+                        &((int*)base)[count], txt);
                     break;
                 case FIELD_TYPE_LONG:
-                    json_unmarshal_array_internal_long(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_long(content, pos,
+                        &((long*)base)[count], txt);
                     break;
                 case FIELD_TYPE_INT8:
-                    json_unmarshal_array_internal_int8_t(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_int8_t(content, pos,
+                        &((int8_t*)base)[count], txt);
                     break;
                 case FIELD_TYPE_INT16:
-                    json_unmarshal_array_internal_int16_t(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_int16_t(content, pos,
+                        &((int16_t*)base)[count], txt);
                     break;
                 case FIELD_TYPE_INT32:
-                    json_unmarshal_array_internal_int32_t(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_int32_t(content, pos,
+                        &((int32_t*)base)[count], txt);
                     break;
                 case FIELD_TYPE_INT64:
-                    json_unmarshal_array_internal_int64_t(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_int64_t(content, pos,
+                        &((int64_t*)base)[count], txt);
                     break;
                 case FIELD_TYPE_UINT8:
-                    json_unmarshal_array_internal_uint8_t(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_uint8_t(content, pos,
+                        &((uint8_t*)base)[count], txt);
                     break;
                 case FIELD_TYPE_UINT16:
-                    json_unmarshal_array_internal_uint16_t(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_uint16_t(content, pos,
+                        &((uint16_t*)base)[count], txt);
                     break;
                 case FIELD_TYPE_UINT32:
-                    json_unmarshal_array_internal_uint32_t(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_uint32_t(content, pos,
+                        &((uint32_t*)base)[count], txt);
                     break;
                 case FIELD_TYPE_UINT64:
-                    json_unmarshal_array_internal_uint64_t(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_uint64_t(content, pos,
+                        &((uint64_t*)base)[count], txt);
                     break;
                 case FIELD_TYPE_FLOAT:
-                    json_unmarshal_array_internal_float(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_float(content, pos,
+                        &((float*)base)[count], txt);
                     break;
                 case FIELD_TYPE_DOUBLE:
-                    json_unmarshal_array_internal_double(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                    r = json_unmarshal_scalar_double(content, pos,
+                        &((double*)base)[count], txt);
                     break;
-                case FIELD_TYPE_SSTR:
-                    json_unmarshal_array_internal_sstr_t(
-                        content, pos, fi->offset + param->instance_ptr, &len,
-                        txt);
+                case FIELD_TYPE_SSTR: {
+                    sstr_t s = NULL;
+                    r = json_unmarshal_scalar_sstr_t(content, pos, &s, txt);
+                    ((sstr_t*)base)[count] = s;
                     break;
+                }
                 case FIELD_TYPE_ENUM:
-                    json_unmarshal_array_internal_enum(
-                        content, pos,
-                        (int**)(fi->offset + param->instance_ptr), &len,
+                    r = json_unmarshal_scalar_enum(content, pos,
+                        &((int*)base)[count],
                         fi->enum_strings, fi->enum_count, txt);
                     break;
-                case FIELD_TYPE_ONEOF: {
-                    int r2 = json_unmarshal_array_internal_oneof(
+                case FIELD_TYPE_STRUCT: {
+                    struct json_parse_param sub;
+                    sub.instance_ptr =
+                        (char*)base + count * fi->type_size;
+                    sub.in_array = 1;
+                    sub.in_struct = 0;
+                    sub.depth = param->depth + 1;
+                    sub.struct_name = fi->field_type_name;
+                    sub.field_name = fi->field_name;
+                    sub.field_mask = NULL;
+                    sub.field_mask_word_count = 0;
+                    sub.nested_masks = NULL;
+                    sub.nested_mask_count = 0;
+                    sub.merge = 0;
+                    r = json_unmarshal_struct_internal(content, pos,
+                                                       &sub, txt);
+                    break;
+                }
+                case FIELD_TYPE_ONEOF:
+                    r = json_unmarshal_oneof_internal(
                         content, pos,
-                        (void**)(fi->offset + param->instance_ptr), &len,
-                        fi->type_size,
+                        (char*)base + count * fi->type_size,
                         fi->oneof_tag_field,
                         fi->enum_strings,
                         fi->oneof_variant_structs,
@@ -2595,178 +2596,133 @@ static int json_unmarshal_struct_internal(sstr_t content, struct json_pos* pos,
                         fi->oneof_tag_offset,
                         fi->oneof_value_offset,
                         param->depth + 1, txt);
-                    if (r2 < 0) return -1;
                     break;
-                }
-                default: {
-                    sstr_t e = PERROR(pos, "unsupported field type %d",
-                                      fi->field_type);
-                    sstr_append(txt, e);
-                    sstr_free(e);
-                    return -1;
-                }
+                default:
+                    r = -1;
+                    break;
             }
-            *(int*)(param->instance_ptr + len_fi->offset) = len;
+            if (r != 0) {
+                return r;
+            }
+            count++;
 
-            if (fi->has_field_offset >= 0) {
-                *(bool*)((char*)param->instance_ptr + fi->has_field_offset) = true;
+            tk2 = json_next_token(content, pos, txt);
+            if (tk2 == JSON_TOKEN_RIGHT_BRACKET) {
+                break;
             }
-            continue;
+            if (tk2 != JSON_TOKEN_COMMA) {
+                if (tk2 != JSON_ERROR) {
+                    JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, ',',
+                              "expected ',' or ']' but got '%s'",
+                              ptoken(tk2, txt));
+                }
+                return -1;
+            }
+            // a ',' before the closing ']' is accepted, as in dynamic arrays
+            peek = *pos;
+            peek_txt = sstr_new();
+            tk2 = json_next_token(content, &peek, peek_txt);
+            sstr_free(peek_txt);
+            if (tk2 == JSON_TOKEN_RIGHT_BRACKET) {
+                *pos = peek;
+                break;
+            }
+        }
+        if (fi->has_field_offset >= 0) {
+            *(bool*)((char*)param->instance_ptr + fi->has_field_offset) = true;
+        }
+        return 0;
+    }
+
+
+    if (fi->is_array) {
+        struct json_field_offset_item* len_fi = json_array_length_field(fi);
+        if (len_fi == NULL) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_NOT_FOUND, JSON_EXPECT_NONE,
+                      "field %s_len not found", fi->field_name);
+            return -1;
         }
+        int len = 0;
+        int r2 = 0;
 
-        int r;
-        // field value
         switch (fi->field_type) {
             case FIELD_TYPE_INT:
             case FIELD_TYPE_BOOL:
-                r = json_unmarshal_scalar_int(
-                    content, pos,
-                    (int*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_int(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
             case FIELD_TYPE_LONG:
-                r = json_unmarshal_scalar_long(
-                    content, pos,
-                    (long*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_long(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
             case FIELD_TYPE_INT8:
-                r = json_unmarshal_scalar_int8_t(
-                    content, pos,
-                    (int8_t*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_int8_t(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
             case FIELD_TYPE_INT16:
-                r = json_unmarshal_scalar_int16_t(
-                    content, pos,
-                    (int16_t*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_int16_t(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
             case FIELD_TYPE_INT32:
-                r = json_unmarshal_scalar_int32_t(
-                    content, pos,
-                    (int32_t*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_int32_t(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
             case FIELD_TYPE_INT64:
-                r = json_unmarshal_scalar_int64_t(
-                    content, pos,
-                    (int64_t*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_int64_t(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
             case FIELD_TYPE_UINT8:
-                r = json_unmarshal_scalar_uint8_t(
-                    content, pos,
-                    (uint8_t*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_uint8_t(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
             case FIELD_TYPE_UINT16:
-                r = json_unmarshal_scalar_uint16_t(
-                    content, pos,
-                    (uint16_t*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_uint16_t(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
             case FIELD_TYPE_UINT32:
-                r = json_unmarshal_scalar_uint32_t(
-                    content, pos,
-                    (uint32_t*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_uint32_t(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
             case FIELD_TYPE_UINT64:
-                r = json_unmarshal_scalar_uint64_t(
-                    content, pos,
-                    (uint64_t*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_uint64_t(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
-
             case FIELD_TYPE_FLOAT:
-                r = json_unmarshal_scalar_float(
-                    content, pos,
-                    (float*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_float(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
             case FIELD_TYPE_DOUBLE:
-                r = json_unmarshal_scalar_double(
-                    content, pos,
-                    (double*)((char*)param->instance_ptr + fi->offset), txt);
-                if (r != 0) {
-                    return r;
-                }
+                r2 = json_unmarshal_array_internal_double(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
-            case FIELD_TYPE_SSTR: {
-                sstr_t s = NULL;
-                r = json_unmarshal_scalar_sstr_t(content, pos, &s, txt);
-                *(sstr_t*)((char*)param->instance_ptr + fi->offset) = (void*)s;
-                if (r != 0) {
-                    return r;
-                }
+            case FIELD_TYPE_SSTR:
+                r2 = json_unmarshal_array_internal_sstr_t(
+                    content, pos, fi->offset + param->instance_ptr, &len,
+                    txt);
                 break;
-            }
-
-            case FIELD_TYPE_STRUCT: {
-                const struct json_nested_mask* nm =
-                    json_find_nested_mask(param, fi->field_index);
-                struct json_parse_param sub_param;
-                sub_param.instance_ptr = param->instance_ptr + fi->offset;
-                sub_param.in_array = 0;
-                sub_param.in_struct = 1;
-                sub_param.depth = param->depth + 1;
-                sub_param.struct_name = fi->field_type_name;
-                sub_param.field_name = fi->field_name;
-                if (nm) {
-                    sub_param.field_mask = nm->mask;
-                    sub_param.field_mask_word_count = nm->mask_word_count;
-                    sub_param.nested_masks = nm->sub_masks;
-                    sub_param.nested_mask_count = nm->sub_mask_count;
-                } else {
-                    sub_param.field_mask = NULL;
-                    sub_param.field_mask_word_count = 0;
-                    sub_param.nested_masks = NULL;
-                    sub_param.nested_mask_count = 0;
-                }
-                tk = json_unmarshal_struct_internal(content, pos, &sub_param,
-                                                    txt);
-                if (tk == -1) {
-                    return -1;
-                }
-            } break;
-
             case FIELD_TYPE_ENUM:
-                r = json_unmarshal_scalar_enum(
+                r2 = json_unmarshal_array_internal_enum(
                     content, pos,
-                    (int*)((char*)param->instance_ptr + fi->offset),
+                    (int**)(fi->offset + param->instance_ptr), &len,
                     fi->enum_strings, fi->enum_count, txt);
-                if (r != 0) {
-                    return r;
-                }
                 break;
-
             case FIELD_TYPE_ONEOF: {
-                r = json_unmarshal_oneof_internal(
+                r2 = json_unmarshal_array_internal_oneof(
                     content, pos,
-                    (char*)param->instance_ptr + fi->offset,
+                    (void**)(fi->offset + param->instance_ptr), &len,
+                    fi->type_size,
                     fi->oneof_tag_field,
                     fi->enum_strings,
                     fi->oneof_variant_structs,
@@ -2774,15 +2730,2084 @@ static int json_unmarshal_struct_internal(sstr_t content, struct json_pos* pos,
                     fi->oneof_tag_offset,
                     fi->oneof_value_offset,
                     param->depth + 1, txt);
-                if (r < 0) {
-                    return -1;
-                }
-            } break;
+                break;
+            }
+            default: {
+                JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE,
+                          "unsupported field type %d",
+                          fi->field_type);
+                return -1;
+            }
         }
+        // store what was decoded so _clear() frees it on failure, too
+        *(int*)(param->instance_ptr + len_fi->offset) = len;
+        if (r2 != 0) {
+            return r2;
+        }
+
         if (fi->has_field_offset >= 0) {
             *(bool*)((char*)param->instance_ptr + fi->has_field_offset) = true;
         }
+        return 0;
+    }
+
+
+    int r;
+    // field value
+    switch (fi->field_type) {
+        case FIELD_TYPE_INT:
+        case FIELD_TYPE_BOOL:
+            r = json_unmarshal_scalar_int(
+                content, pos,
+                (int*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_LONG:
+            r = json_unmarshal_scalar_long(
+                content, pos,
+                (long*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_INT8:
+            r = json_unmarshal_scalar_int8_t(
+                content, pos,
+                (int8_t*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_INT16:
+            r = json_unmarshal_scalar_int16_t(
+                content, pos,
+                (int16_t*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_INT32:
+            r = json_unmarshal_scalar_int32_t(
+                content, pos,
+                (int32_t*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_INT64:
+            r = json_unmarshal_scalar_int64_t(
+                content, pos,
+                (int64_t*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_UINT8:
+            r = json_unmarshal_scalar_uint8_t(
+                content, pos,
+                (uint8_t*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_UINT16:
+            r = json_unmarshal_scalar_uint16_t(
+                content, pos,
+                (uint16_t*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_UINT32:
+            r = json_unmarshal_scalar_uint32_t(
+                content, pos,
+                (uint32_t*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_UINT64:
+            r = json_unmarshal_scalar_uint64_t(
+                content, pos,
+                (uint64_t*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+
+        case FIELD_TYPE_FLOAT:
+            r = json_unmarshal_scalar_float(
+                content, pos,
+                (float*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_DOUBLE:
+            r = json_unmarshal_scalar_double(
+                content, pos,
+                (double*)((char*)param->instance_ptr + fi->offset), txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_FIXSTR:
+            r = json_unmarshal_scalar_fixstr_(
+                content, pos, (char*)param->instance_ptr + fi->offset,
+                fi->type_size, fi->field_name, txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+        case FIELD_TYPE_SSTR: {
+            sstr_t s = NULL;
+            if (JSON_FIELD_IS_INLINE_STR_(fi)) {
+                r = json_unmarshal_scalar_sstr_inline_(
+                    content, pos,
+                    (sstr_t)((char*)param->instance_ptr + fi->offset), txt);
+                if (r != 0) {
+                    return r;
+                }
+                break;
+            }
+            r = json_unmarshal_scalar_sstr_t(content, pos, &s, txt);
+            *(sstr_t*)((char*)param->instance_ptr + fi->offset) = (void*)s;
+            if (r != 0) {
+                return r;
+            }
+            break;
+        }
+
+        case FIELD_TYPE_ENUM:
+            r = json_unmarshal_scalar_enum(
+                content, pos,
+                (int*)((char*)param->instance_ptr + fi->offset),
+                fi->enum_strings, fi->enum_count, txt);
+            if (r != 0) {
+                return r;
+            }
+            break;
+
+        case FIELD_TYPE_ONEOF: {
+            r = json_unmarshal_oneof_internal(
+                content, pos,
+                (char*)param->instance_ptr + fi->offset,
+                fi->oneof_tag_field,
+                fi->enum_strings,
+                fi->oneof_variant_structs,
+                fi->enum_count,
+                fi->oneof_tag_offset,
+                fi->oneof_value_offset,
+                param->depth + 1, txt);
+            if (r < 0) {
+                return -1;
+            }
+        } break;
+    }
+    if (fi->has_field_offset >= 0) {
+        *(bool*)((char*)param->instance_ptr + fi->has_field_offset) = true;
+    }
+    return 0;
+}
+
+/*
+ * Iterative struct decoder.
+ *
+ * Nested struct fields and dynamic arrays of structs are decoded by one loop
+ * over an explicit frame stack rather than by recursing through
+ * json_unmarshal_struct_internal() and json_unmarshal_array_internal().  A
+ * nesting level costs one json_decode_frame instead of a C stack frame of the
+ * whole field switch, so deep documents stay cheap on small-stack threads.
+ * The first JSON_DECODE_INLINE_FRAMES frames live on the C stack; deeper
+ * documents move the stack to the heap, bounded by JSON_MAX_DEPTH.
+ *
+ * Map values, oneof variants and fixed-size struct arrays still re-enter
+ * json_unmarshal_struct_internal(); param->depth keeps counting across those
+ * entries so JSON_MAX_DEPTH applies to the whole document.
+ */
+#ifndef JSON_DECODE_INLINE_FRAMES
+#define JSON_DECODE_INLINE_FRAMES 8
+#endif
+
+#define JSON_FRAME_STRUCT 0
+#define JSON_FRAME_ARRAY 1
+
+struct json_decode_frame {
+    int kind;
+    struct json_parse_param param;  // element struct for JSON_FRAME_ARRAY
+    unsigned int st_hash;           // pre-hashed param.struct_name
+    bool* has_field;                // presence flag set when the frame ends
+    // JSON_FRAME_ARRAY only
+    void** arr_pp;
+    int* len_p;
+    int cap;
+    int type_size;
+    int elem_active;  // element (*len_p) is being decoded by the frame above
+    int after_elem;   // expecting ',' or ']'
+};
+
+struct json_decode_stack {
+    struct json_decode_frame* frames;
+    int count;
+    int cap;
+    struct json_decode_frame inline_frames[JSON_DECODE_INLINE_FRAMES];
+};
+
+static void json_decode_stack_init(struct json_decode_stack* st) {
+    st->frames = st->inline_frames;
+    st->count = 0;
+    st->cap = JSON_DECODE_INLINE_FRAMES;
+}
+
+static void json_decode_stack_free(struct json_decode_stack* st) {
+    if (st->frames != st->inline_frames) {
+        JGENC_FREE(st->frames);
+    }
+}
+
+// Push a zeroed frame. Invalidates pointers to frames already on the stack.
+static struct json_decode_frame* json_decode_push(
+    struct json_decode_stack* st) {
+    if (st->count == st->cap) {
+        int ncap = st->cap * 2;
+        struct json_decode_frame* nf;
+        if (st->frames == st->inline_frames) {
+            nf = (struct json_decode_frame*)JGENC_MALLOC(
+                (size_t)ncap * sizeof(struct json_decode_frame));
+            if (nf != NULL) {
+                memcpy(nf, st->frames,
+                       (size_t)st->count * sizeof(struct json_decode_frame));
+            }
+        } else {
+            nf = (struct json_decode_frame*)JGENC_REALLOC(
+                st->frames, (size_t)ncap * sizeof(struct json_decode_frame));
+        }
+        if (nf == NULL) {
+            return NULL;
+        }
+        st->frames = nf;
+        st->cap = ncap;
+    }
+    struct json_decode_frame* f = &st->frames[st->count++];
+    memset(f, 0, sizeof(*f));
+    return f;
+}
+
+// Pop the top frame once its value is complete.
+static void json_decode_pop(struct json_decode_stack* st) {
+    struct json_decode_frame* f = &st->frames[--st->count];
+    if (f->has_field != NULL) {
+        *f->has_field = true;
+    }
+    if (st->count > 0) {
+        struct json_decode_frame* parent = &st->frames[st->count - 1];
+        if (parent->kind == JSON_FRAME_ARRAY && parent->elem_active) {
+            parent->elem_active = 0;
+            *parent->len_p = *parent->len_p + 1;
+        }
+    }
+}
+
+// Release the element each array frame was decoding when an error hit.
+// Walk top-down so inner slots are cleared before their owners.
+static void json_decode_unwind(struct json_decode_stack* st) {
+    while (st->count > 0) {
+        struct json_decode_frame* f = &st->frames[--st->count];
+        if (f->kind == JSON_FRAME_ARRAY && f->elem_active) {
+            json_clear_struct_value(
+                (char*)*f->arr_pp + (size_t)(*f->len_p) * f->type_size,
+                f->param.struct_name);
+        }
+    }
+}
+
+static int json_decode_depth_check(struct json_pos* pos, int depth,
+                                   sstr_t txt) {
+    if (depth > JSON_MAX_DEPTH) {
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE,
+                  "maximum JSON nesting depth (%d) exceeded",
+                  JSON_MAX_DEPTH);
+        return -1;
+    }
+    return 0;
+}
+
+static int json_decode_push_struct(struct json_decode_stack* st,
+                                   struct json_pos* pos,
+                                   const struct json_parse_param* param,
+                                   bool* has_field, sstr_t txt) {
+    struct json_decode_frame* f = json_decode_push(st);
+    if (f == NULL) {
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_MEMORY, JSON_EXPECT_NONE,
+                  "memory allocation failed for decode stack");
+        return JSON_GEN_ERROR_MEMORY;
+    }
+    f->kind = JSON_FRAME_STRUCT;
+    f->param = *param;
+    f->st_hash =
+        hash_s(param->struct_name, strlen(param->struct_name), 0xbc9f1d34);
+    f->has_field = has_field;
+#ifdef JSON_HAS_CACHED_STRUCTS
+    json_drop_struct_cache(
+        param->instance_ptr,
+        json_field_offset_item_find_ph(f->st_hash, param->struct_name, "", 0));
+#endif
+    return 0;
+}
+
+// Consume the '[' of a dynamic struct array and push its frame.
+static int json_decode_push_array(sstr_t content, struct json_pos* pos,
+                                  struct json_decode_stack* st,
+                                  const struct json_parse_param* param,
+                                  void** arr_pp, int* len_p, bool* has_field,
+                                  sstr_t txt) {
+    *len_p = 0;
+    struct json_field_offset_item* field =
+        json_field_offset_item_find(param->struct_name, "");
+    if (field == NULL) {
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_NOT_FOUND, JSON_EXPECT_NONE,
+                  "struct %s not found", param->struct_name);
+        return JSON_GEN_ERROR_NOT_FOUND;
+    }
+#ifdef JSON_DEBUG
+    printf("array find field struct %s, size %d\n", field->struct_name,
+           field->type_size);
+#endif
+
+    int tk = json_next_token(content, pos, txt);
+    if (tk != JSON_TOKEN_LEFT_BRACKET) {
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '[',
+                  "expected '[' but got %s", ptoken(tk, txt));
+        return JSON_GEN_ERROR_PARSE;
+    }
+
+    struct json_decode_frame* f = json_decode_push(st);
+    if (f == NULL) {
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_MEMORY, JSON_EXPECT_NONE,
+                  "memory allocation failed for decode stack");
+        return JSON_GEN_ERROR_MEMORY;
     }
-    //
+    f->kind = JSON_FRAME_ARRAY;
+    f->param = *param;
+    f->has_field = has_field;
+    f->arr_pp = arr_pp;
+    f->len_p = len_p;
+    f->type_size = field->type_size;
     return 0;
 }
+
+// Advance the array frame on top of the stack by one element.
+static int json_decode_array_step(sstr_t content, struct json_pos* pos,
+                                  struct json_decode_stack* st, sstr_t txt) {
+    struct json_decode_frame* f = &st->frames[st->count - 1];
+    int tk;
+
+    if (f->after_elem) {
+        tk = json_next_token(content, pos, txt);
+        if (tk == JSON_TOKEN_RIGHT_BRACKET) {
+            json_decode_pop(st);
+            return 0;
+        }
+        if (tk == JSON_ERROR) {
+            return JSON_GEN_ERROR_PARSE;
+        }
+        if (tk != JSON_TOKEN_COMMA) {
+            if (tk == JSON_TOKEN_EOF) {
+                JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, ',',
+                          "parsing array, reached EOF unexpectedly");
+            } else {
+                JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, ',',
+                          "expected ',' or ']' but got '%s'",
+                          ptoken(tk, txt));
+            }
+            return JSON_GEN_ERROR_PARSE;
+        }
+        f->after_elem = 0;
+    }
+
+    tk = json_next_token(content, pos, txt);
+    if (tk == JSON_TOKEN_RIGHT_BRACKET) {
+        json_decode_pop(st);
+        return 0;
+    }
+    if (tk == JSON_ERROR) {
+        return JSON_GEN_ERROR_PARSE;
+    }
+    if (tk != JSON_TOKEN_LEFT_BRACE) {
+        if (tk == JSON_TOKEN_EOF) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '{',
+                      "parsing array, reached EOF unexpectedly");
+        } else {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '{',
+                      "expected '{' but got '%s'", ptoken(tk, txt));
+        }
+        return JSON_GEN_ERROR_PARSE;
+    }
+    if (json_decode_depth_check(pos, f->param.depth + 1, txt) != 0) {
+        return JSON_GEN_ERROR_PARSE;
+    }
+
+    // Grow array buffer with capacity doubling
+    int len = *f->len_p;
+    if (JSON_LIMIT_CHECK(pos, txt, max_array_len, len + 1, "array length") != 0 ||
+        (len >= f->cap &&
+         JSON_LIMIT_ALLOC(pos, txt, (size_t)(f->cap == 0 ? 4 : f->cap) *
+                                        f->type_size) != 0)) {
+        return JSON_GEN_ERROR_BOUNDS;
+    }
+    if (len >= f->cap) {
+        int cap = f->cap == 0 ? 4 : f->cap * 2;
+        void* pptr = JGENC_REALLOC(*f->arr_pp, (size_t)cap * f->type_size);
+        if (pptr == NULL) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_MEMORY, JSON_EXPECT_NONE,
+                      "memory reallocation failed for array");
+            return JSON_GEN_ERROR_MEMORY;
+        }
+        *f->arr_pp = pptr;
+        f->cap = cap;
+    }
+    void* elem = (char*)*f->arr_pp + (size_t)len * f->type_size;
+    memset(elem, 0, f->type_size);
+    f->after_elem = 1;
+    f->elem_active = 1;
+
+    struct json_parse_param sub_param;
+    sub_param.instance_ptr = elem;
+    sub_param.in_array = 1;
+    sub_param.in_struct = 0;
+    sub_param.depth = f->param.depth + 1;
+    sub_param.struct_name = f->param.struct_name;
+    sub_param.field_name = f->param.field_name;
+    sub_param.field_mask = NULL;
+    sub_param.field_mask_word_count = 0;
+    sub_param.nested_masks = NULL;
+    sub_param.nested_mask_count = 0;
+    sub_param.merge = 0;
+    return json_decode_push_struct(st, pos, &sub_param, NULL, txt);
+}
+
+// Merge-patch handling of one member before its value is decoded: null
+// removes the field (returns 1 with the null consumed), any other value
+// replaces it, except that a nested struct object is merged into the
+// existing struct (returns 0).
+static int json_merge_prepare_field(sstr_t content, struct json_pos* pos,
+                                    const struct json_parse_param* param,
+                                    const struct json_field_offset_item* fi,
+                                    sstr_t txt) {
+    struct json_pos peek = *pos;
+    json_skip_space_comments(content, &peek);
+    if (peek.offset + 4 <= (long)sstr_length(content) &&
+        memcmp(sstr_cstr_fast(content) + peek.offset, "null", 4) == 0) {
+        if (fi->has_field_offset < 0) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_FORMAT, JSON_EXPECT_NONE,
+                      "field %s is not optional and cannot be removed",
+                      fi->field_name);
+            return -1;
+        }
+        if (json_next_token(content, pos, txt) != JSON_TOKEN_NULL) {
+            return -1;
+        }
+        json_clear_field_value(param->instance_ptr, fi);
+        return 1;
+    }
+    if (fi->field_type != FIELD_TYPE_STRUCT || fi->is_array) {
+        json_clear_field_value(param->instance_ptr, fi);
+    }
+    return 0;
+}
+
+// Decode fields of the struct frame on top of the stack until it ends or a
+// nested struct/struct array needs a frame of its own.
+static int json_decode_struct_step(sstr_t content, struct json_pos* pos,
+                                   struct json_decode_stack* st, sstr_t txt) {
+    struct json_decode_frame* f = &st->frames[st->count - 1];
+    struct json_parse_param* param = &f->param;
+    int tk;
+
+    while (1) {
+        tk = json_next_token(content, pos, txt);
+        if (tk == JSON_ERROR) {
+            return -1;
+        }
+        if (tk == JSON_TOKEN_EOF) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '}',
+                      "expected '}' but reach end of file");
+            return -1;
+        }
+        if (tk == JSON_TOKEN_RIGHT_BRACE) {
+            break;
+        }
+        if (tk == JSON_TOKEN_COMMA) {
+            // Peek ahead for trailing comma — skip whitespace/comments,
+            // check raw char instead of allocating sstr_t + full token parse.
+            struct json_pos peek = *pos;
+            json_skip_space_comments(content, &peek);
+            if (peek.offset < (long)sstr_length(content) &&
+                sstr_cstr_fast(content)[peek.offset] == '}') {
+                JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING,
+                          "trailing comma not allowed before '}'");
+                return -1;
+            }
+            continue;
+        }
+
+        // field_name
+        if (tk != JSON_TOKEN_STRING) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING,
+                      "expected field_name string but got '%s'",
+                      ptoken(tk, txt));
+            return -1;
+        }
+
+        struct json_field_offset_item* fi =
+            json_field_offset_item_find_ph(f->st_hash, param->struct_name,
+                                           sstr_cstr_fast(txt), sstr_length(txt));
+        // the "" key names the struct's own entry, not a field
+        if (fi == NULL || fi->field_index < 0) {
+#if JSON_DEBUG
+            printf("json_field_offset_item_find NULL, ignoring...\n");
+#endif
+            // Consume the expected colon before skipping the value.
+            tk = json_next_token(content, pos, txt);
+            if (tk != JSON_TOKEN_COLON) {
+                JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, ':',
+                          "expected ':' but got '%s'", ptoken(tk, txt));
+                return -1;
+            }
+            if (json_unmarshal_ignore_value(content, pos, txt) != 0) {
+                return -1;
+            }
+            continue;
+        }
+#if JSON_DEBUG
+        printf("field found: %s->%s %s is_array: %d\n", (fi->struct_name),
+               (fi->field_name), fi->field_type_name, fi->is_array);
+#endif
+        tk = json_next_token(content, pos, txt);
+        if (tk != JSON_TOKEN_COLON) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, ':',
+                      "expected ':' but got '%s'", ptoken(tk, txt));
+            return -1;
+        }
+        if (!json_field_is_selected(param, fi)) {
+            if (json_unmarshal_ignore_value(content, pos, txt) != 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (param->merge) {
+            int r = json_merge_prepare_field(content, pos, param, fi, txt);
+            if (r < 0) {
+                return -1;
+            }
+            if (r > 0) {
+                continue;
+            }
+        } else if (param->field_mask != NULL) {
+            json_clear_field_value(param->instance_ptr, fi);
+        }
+
+        // Handle nullable fields: accept JSON null
+        if (fi->is_nullable) {
+            struct json_pos peek = *pos;
+            sstr_t peek_txt = sstr_new();
+            int peek_tk = json_next_token(content, &peek, peek_txt);
+            sstr_free(peek_txt);
+            if (peek_tk == JSON_TOKEN_NULL) {
+                *pos = peek;
+                // has_field remains false from init
+                continue;
+            }
+        }
+
+        if (fi->field_type == FIELD_TYPE_STRUCT &&
+            (!fi->is_array || fi->array_size == 0)) {
+            bool* has_field = fi->has_field_offset >= 0
+                ? (bool*)((char*)param->instance_ptr + fi->has_field_offset)
+                : NULL;
+            struct json_parse_param sub_param;
+            sub_param.instance_ptr = (char*)param->instance_ptr + fi->offset;
+            sub_param.in_struct = 0;
+            sub_param.struct_name = fi->field_type_name;
+            sub_param.field_name = fi->field_name;
+            sub_param.field_mask = NULL;
+            sub_param.field_mask_word_count = 0;
+            sub_param.nested_masks = NULL;
+            sub_param.nested_mask_count = 0;
+            sub_param.merge = 0;
+
+            if (fi->is_array) {
+                struct json_field_offset_item* len_fi =
+                    json_array_length_field(fi);
+                if (len_fi == NULL) {
+                    JSON_FAIL(pos, txt, JSON_GEN_ERROR_NOT_FOUND,
+                              JSON_EXPECT_NONE, "field %s_len not found",
+                              fi->field_name);
+                    return -1;
+                }
+                sub_param.in_array = 1;
+                sub_param.depth = param->depth;
+                return json_decode_push_array(
+                    content, pos, st, &sub_param,
+                    (void**)sub_param.instance_ptr,
+                    (int*)((char*)param->instance_ptr + len_fi->offset),
+                    has_field, txt);
+            }
+
+            const struct json_nested_mask* nm =
+                json_find_nested_mask(param, fi->field_index);
+            if (nm) {
+                sub_param.field_mask = nm->mask;
+                sub_param.field_mask_word_count = nm->mask_word_count;
+                sub_param.nested_masks = nm->sub_masks;
+                sub_param.nested_mask_count = nm->sub_mask_count;
+            }
+            // a nested object in a merge patch is merged, not replaced
+            sub_param.merge = param->merge;
+            sub_param.in_array = 0;
+            sub_param.in_struct = 1;
+            sub_param.depth = param->depth + 1;
+            if (json_decode_depth_check(pos, sub_param.depth, txt) != 0) {
+                return -1;
+            }
+            tk = json_next_token(content, pos, txt);
+            if (tk != JSON_TOKEN_LEFT_BRACE) {
+                if (tk == JSON_TOKEN_EOF) {
+                    JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '{',
+                              "expected '{' but got empty input");
+                } else if (tk != JSON_ERROR) {
+                    JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '{',
+                              "expected '{' but got '%s'", ptoken(tk, txt));
+                }
+                return -1;
+            }
+            return json_decode_push_struct(st, pos, &sub_param, has_field,
+                                           txt);
+        }
+
+        int r = json_unmarshal_field_value(content, pos, param, fi, txt);
+        if (r != 0) {
+            return r;
+        }
+    }
+
+    json_decode_pop(st);
+    return 0;
+}
+
+// Run the decoder until the frame stack is empty.
+static int json_decode_run(sstr_t content, struct json_pos* pos,
+                           struct json_decode_stack* st, sstr_t txt) {
+    int r = 0;
+    while (st->count > 0) {
+        if (st->frames[st->count - 1].kind == JSON_FRAME_ARRAY) {
+            r = json_decode_array_step(content, pos, st, txt);
+        } else {
+            r = json_decode_struct_step(content, pos, st, txt);
+        }
+        if (r != 0) {
+            json_decode_unwind(st);
+            // Scalar helpers report type mismatches with positive tokens.
+            return r < 0 ? r : JSON_GEN_ERROR_PARSE;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Parse JSON array with proper memory management
+ * @param content JSON content string
+ * @param pos Current parsing position
+ * @param param Parse parameters
+ * @param len Output array length
+ * @param txt Error message buffer
+ * @return 0 on success, negative on error
+ */
+static int json_unmarshal_array_internal(sstr_t content, struct json_pos* pos,
+                                         struct json_parse_param* param,
+                                         int* len, sstr_t txt) {
+    struct json_decode_stack st;
+    json_decode_stack_init(&st);
+    int r = json_decode_push_array(content, pos, &st, param,
+                                   (void**)param->instance_ptr, len, NULL,
+                                   txt);
+    if (r == 0) {
+        r = json_decode_run(content, pos, &st, txt);
+    }
+    json_decode_stack_free(&st);
+    return r;
+}
+
+static int json_unmarshal_struct_internal(sstr_t content, struct json_pos* pos,
+                                          struct json_parse_param* param,
+                                          sstr_t txt) {
+    // Check recursion depth
+    if (json_decode_depth_check(pos, param->depth, txt) != 0) {
+        return -1;
+    }
+
+    // '{'
+    int tk = json_next_token(content, pos, txt);
+    if (tk == JSON_TOKEN_EOF) {
+        if (!param->in_array) {
+            JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '{',
+                      "expected '{' but got empty input");
+            return -1;
+        }
+        return 0;
+    }
+    if (tk == JSON_ERROR) {
+        return -1;
+    }
+    if (param->in_array && tk == JSON_TOKEN_RIGHT_BRACKET) {
+        return 1;
+    }
+
+    if (tk != JSON_TOKEN_LEFT_BRACE) {
+        JSON_FAIL(pos, txt, JSON_GEN_ERROR_PARSE, '{',
+                  "expected '{' but got '%s'", ptoken(tk, txt));
+        return -1;
+    }
+
+    struct json_decode_stack st;
+    json_decode_stack_init(&st);
+    int r = json_decode_push_struct(&st, pos, param, NULL, txt);
+    if (r == 0) {
+        r = json_decode_run(content, pos, &st, txt);
+    }
+    json_decode_stack_free(&st);
+    return r;
+}
+
+/* ---------------------------------------------------------------
+ * Validation without decoding.
+ *
+ * json_validate_<S>() checks a document against the same field tables as
+ * json_unmarshal_struct_internal(), but scans the raw bytes with its own
+ * cursor: keys and enum strings are decoded into stack buffers, numbers
+ * are range-checked from a stack copy, and nothing is allocated.  Nested
+ * objects are checked on a fixed stack of JSON_MAX_DEPTH + 1 small frames
+ * instead of by recursion, so a deep document needs no more C stack than a
+ * shallow one; values under unknown keys are skipped iteratively.
+ * --------------------------------------------------------------- */
+
+#define JSON_VALIDATE_BUF 256
+
+struct json_vcur {
+    const char* data;
+    long len;
+    long off;
+    int num_ok;  // last number token had digits where the grammar needs them
+};
+
+// Skip whitespace and comments by the same rules as the tokenizer.
+static void json_v_space(struct json_vcur* c) {
+    const char* data = c->data;
+    long len = c->len;
+    long i = c->off;
+    int skiped;
+
+    do {
+        skiped = 0;
+        while (i < len && JSON_IS_SPACE(data[i])) {
+            i++;
+            skiped = 1;
+        }
+        if (i + 1 < len && data[i] == '/' && data[i + 1] == '/') {
+            i += 2;
+            while (i < len && data[i] != '\n') {
+                i++;
+            }
+            skiped = 1;
+        }
+        if (i + 1 < len && data[i] == '/' && data[i + 1] == '*') {
+            i += 2;
+            while (i + 1 < len && data[i] != '*' && data[i + 1] != '/') {
+                i++;
+            }
+            i += 2;
+            skiped = 1;
+        }
+    } while (skiped);
+    c->off = i;
+}
+
+static int json_v_peek(struct json_vcur* c) {
+    json_v_space(c);
+    return c->off < c->len ? (unsigned char)c->data[c->off] : -1;
+}
+
+// Append k bytes of a decoded token to buf while it still fits.
+static inline void json_v_put(char* buf, size_t cap, size_t* w,
+                              const void* src, size_t k) {
+    if (buf != NULL && *w + k < cap) {
+        memcpy(buf + *w, src, k);
+    }
+    *w += k;
+}
+
+// Scan the string at c->off, checking its escapes. The decoded bytes go to
+// buf (NUL-terminated) when *n < cap on return.
+static int json_v_string(struct json_vcur* c, char* buf, size_t cap,
+                         size_t* n) {
+    const char* data = c->data;
+    long len = c->len;
+    long i = c->off + 1;
+    size_t w = 0;
+
+    while (i < len && data[i] != '"') {
+        if (data[i] != '\\') {
+            long j = i;
+            while (j < len && data[j] != '"' && data[j] != '\\') {
+                j++;
+            }
+            json_v_put(buf, cap, &w, data + i, (size_t)(j - i));
+            i = j;
+            continue;
+        }
+        if (i + 1 >= len) {
+            return JSON_ERROR;
+        }
+        i++;
+        unsigned char u[4];
+        int k = 1;
+        switch (data[i]) {
+            case 'b': u[0] = '\b'; break;
+            case 'f': u[0] = '\f'; break;
+            case 'n': u[0] = '\n'; break;
+            case 'r': u[0] = '\r'; break;
+            case 't': u[0] = '\t'; break;
+            case '"': u[0] = '"'; break;
+            case '\\': u[0] = '\\'; break;
+            case '/': u[0] = '/'; break;
+            case 'u':
+                k = json_decode_u_escape(data, len, &i, u);
+                if (k < 0) {
+                    return JSON_ERROR;
+                }
+                i--;
+                break;
+            default:
+                return JSON_ERROR;
+        }
+        i++;
+        json_v_put(buf, cap, &w, u, (size_t)k);
+    }
+    if (i >= len) {
+        return JSON_ERROR;
+    }
+    if (buf != NULL && w < cap) {
+        buf[w] = '\0';
+    }
+    *n = w;
+    c->off = i + 1;
+    return JSON_TOKEN_STRING;
+}
+
+// Scan the next token. Strings are decoded and numbers copied raw into
+// buf (may be NULL); *n is the full length even when it did not fit.
+static int json_v_token(struct json_vcur* c, char* buf, size_t cap,
+                        size_t* n) {
+    const char* data = c->data;
+    long len = c->len;
+
+    *n = 0;
+    json_v_space(c);
+    long i = c->off;
+    if (i >= len) {
+        return JSON_TOKEN_EOF;
+    }
+    int ch = (unsigned char)data[i];
+    switch (ch) {
+        case '"':
+            return json_v_string(c, buf, cap, n);
+        case '[':
+        case ']':
+        case '{':
+        case '}':
+        case ':':
+        case ',':
+            c->off = i + 1;
+            return ch;
+        default:
+            break;
+    }
+    if (JSON_IS_DIGIT(ch) || ch == '-' || ch == '.') {
+        int tk = JSON_TOKEN_INT;
+        int digits = 0;
+        if (ch != '.') {
+            digits = ch != '-';
+            i++;
+            while (i < len && JSON_IS_DIGIT(data[i])) {
+                i++;
+                digits = 1;
+            }
+        }
+        if (i < len && data[i] == '.') {
+            tk = JSON_TOKEN_FLOAT;
+            i++;
+            while (i < len && JSON_IS_DIGIT(data[i])) {
+                i++;
+                digits = 1;
+            }
+        }
+        c->num_ok = digits;
+        if (i < len && (data[i] == 'e' || data[i] == 'E')) {
+            tk = JSON_TOKEN_FLOAT;
+            i++;
+            if (i < len && (data[i] == '+' || data[i] == '-')) {
+                i++;
+            }
+            if (i >= len || !JSON_IS_DIGIT(data[i])) {
+                c->num_ok = 0;
+            }
+            while (i < len && JSON_IS_DIGIT(data[i])) {
+                i++;
+            }
+        }
+        json_v_put(buf, cap, n, data + c->off, (size_t)(i - c->off));
+        if (buf != NULL && *n < cap) {
+            buf[*n] = '\0';
+        }
+        c->off = i;
+        return tk;
+    }
+    static const struct {
+        const char* word;
+        long len;
+        int tk;
+    } keywords[] = {{"true", 4, JSON_TOKEN_TRUE},
+                    {"false", 5, JSON_TOKEN_FALSE},
+                    {"null", 4, JSON_TOKEN_NULL}};
+    size_t k;
+    for (k = 0; k < sizeof(keywords) / sizeof(keywords[0]); k++) {
+        long wl = keywords[k].len;
+        if (i + wl <= len && memcmp(data + i, keywords[k].word, wl) == 0 &&
+            (i + wl >= len || !isalpha((unsigned char)data[i + wl]))) {
+            c->off = i + wl;
+            return keywords[k].tk;
+        }
+    }
+    return JSON_ERROR;
+}
+
+// Range-check integer text s for field type @p type.
+static int json_v_int(int type, const char* s) {
+    char* end;
+    errno = 0;
+    switch (type) {
+        case FIELD_TYPE_UINT8:
+        case FIELD_TYPE_UINT16:
+        case FIELD_TYPE_UINT32:
+        case FIELD_TYPE_UINT64: {
+            if (*s == '-') {
+                return JSON_GEN_ERROR_BOUNDS;
+            }
+            unsigned long long v = strtoull(s, &end, 10);
+            unsigned long long max =
+                type == FIELD_TYPE_UINT8    ? UINT8_MAX
+                : type == FIELD_TYPE_UINT16 ? UINT16_MAX
+                : type == FIELD_TYPE_UINT32 ? UINT32_MAX
+                                            : UINT64_MAX;
+            if (*end != '\0') {
+                return JSON_GEN_ERROR_PARSE;
+            }
+            return errno == ERANGE || v > max ? JSON_GEN_ERROR_BOUNDS : 0;
+        }
+        default: {
+            long long v = strtoll(s, &end, 10);
+            long long min, max;
+            switch (type) {
+                case FIELD_TYPE_INT8:
+                    min = INT8_MIN;
+                    max = INT8_MAX;
+                    break;
+                case FIELD_TYPE_INT16:
+                    min = INT16_MIN;
+                    max = INT16_MAX;
+                    break;
+                case FIELD_TYPE_LONG:
+                    min = LONG_MIN;
+                    max = LONG_MAX;
+                    break;
+                case FIELD_TYPE_INT64:
+                    min = INT64_MIN;
+                    max = INT64_MAX;
+                    break;
+                default:  // int, bool, enum, int32_t
+                    min = INT_MIN;
+                    max = INT_MAX;
+                    break;
+            }
+            if (*end != '\0') {
+                return JSON_GEN_ERROR_PARSE;
+            }
+            return errno == ERANGE || v < min || v > max
+                       ? JSON_GEN_ERROR_BOUNDS
+                       : 0;
+        }
+    }
+}
+
+// Check one scalar value of FIELD_TYPE_* @p type.
+static int json_v_scalar(struct json_vcur* c, int type,
+                         const char** enum_strings, int enum_count) {
+    char buf[JSON_VALIDATE_BUF];
+    size_t n;
+    int tk = json_v_token(c, buf, sizeof(buf), &n);
+    int i;
+
+    switch (type) {
+        case FIELD_TYPE_SSTR:
+            return tk == JSON_TOKEN_STRING || tk == JSON_TOKEN_NULL
+                       ? 0
+                       : JSON_GEN_ERROR_PARSE;
+        case FIELD_TYPE_FLOAT:
+        case FIELD_TYPE_DOUBLE:
+            return (tk == JSON_TOKEN_INT || tk == JSON_TOKEN_FLOAT) &&
+                           c->num_ok
+                       ? 0
+                       : JSON_GEN_ERROR_PARSE;
+        case FIELD_TYPE_ENUM:
+            if (tk == JSON_TOKEN_STRING) {
+                for (i = 0; n < sizeof(buf) && i < enum_count; i++) {
+                    if (strcmp(buf, enum_strings[i]) == 0) {
+                        return 0;
+                    }
+                }
+                return JSON_GEN_ERROR_PARSE;
+            }
+            if (tk == JSON_TOKEN_INT) {
+                // like json_unmarshal_scalar_enum(): any int is taken as is
+                return n < sizeof(buf) ? json_v_int(type, buf)
+                                       : JSON_GEN_ERROR_BOUNDS;
+            }
+            return JSON_GEN_ERROR_PARSE;
+        default:
+            if (tk == JSON_TOKEN_TRUE || tk == JSON_TOKEN_FALSE) {
+                return 0;
+            }
+            if (tk != JSON_TOKEN_INT || !c->num_ok) {
+                return JSON_GEN_ERROR_PARSE;
+            }
+            // No in-range integer needs this many digits.
+            if (n >= sizeof(buf)) {
+                return JSON_GEN_ERROR_BOUNDS;
+            }
+            return json_v_int(type, buf);
+    }
+}
+
+// Skip one value of any shape, as json_unmarshal_ignore_value() does.
+static int json_v_skip(struct json_vcur* c) {
+    long brace = 0, bracket = 0;
+    size_t n;
+    int tk = json_v_token(c, NULL, 0, &n);
+    if (tk == JSON_ERROR || tk == JSON_TOKEN_EOF || tk == ',' || tk == ':' ||
+        tk == '}' || tk == ']') {
+        return JSON_GEN_ERROR_PARSE;
+    }
+    while (1) {
+        if (tk == '{') {
+            brace++;
+        } else if (tk == '}') {
+            brace--;
+        } else if (tk == '[') {
+            bracket++;
+        } else if (tk == ']') {
+            bracket--;
+        }
+        if (brace == 0 && bracket == 0) {
+            return 0;
+        }
+        tk = json_v_token(c, NULL, 0, &n);
+        if (tk == JSON_ERROR || tk == JSON_TOKEN_EOF) {
+            return JSON_GEN_ERROR_PARSE;
+        }
+    }
+}
+
+#define JSON_VF_KEYS 0       // reading the keys of the object
+#define JSON_VF_ARRAY 1      // inside the array value of fi
+#define JSON_VF_MAP 2        // inside the map value of fi
+#define JSON_VF_ARRAY_MAP 3  // inside a map element of fi's array
+
+// One object being checked. Arrays and maps open in a field are tracked in
+// the frame of the object that holds them, so frames only nest as deep as
+// the structs do.
+struct json_vframe {
+    const char* struct_name;
+    const struct json_field_offset_item* fi;  // the field whose value is open
+    unsigned int st_hash;
+    int mode;
+    int count;  // JSON_VF_ARRAY: elements seen so far
+    int after;  // an element just ended: expect ',' or the closing bracket
+};
+
+struct json_vstack {
+    struct json_vframe frames[JSON_MAX_DEPTH + 1];
+    int n;
+};
+
+// Read the '{' of a struct_name object and push its frame.
+static int json_v_push(struct json_vcur* c, struct json_vstack* st,
+                       const char* struct_name) {
+    struct json_vframe* f;
+    size_t n;
+
+    if (st->n > JSON_MAX_DEPTH) {
+        return JSON_GEN_ERROR_BOUNDS;
+    }
+    if (json_field_offset_item_find(struct_name, "") == NULL) {
+        return JSON_GEN_ERROR_NOT_FOUND;
+    }
+    if (json_v_token(c, NULL, 0, &n) != JSON_TOKEN_LEFT_BRACE) {
+        return JSON_GEN_ERROR_PARSE;
+    }
+    f = &st->frames[st->n++];
+    f->struct_name = struct_name;
+    f->fi = NULL;
+    f->st_hash = hash_s(struct_name, strlen(struct_name), 0xbc9f1d34);
+    f->mode = JSON_VF_KEYS;
+    f->count = 0;
+    f->after = 0;
+    return 0;
+}
+
+// Find the variant a oneof object selects with its tag key. The object
+// itself is left unread.
+static int json_v_oneof_variant(const struct json_vcur* c,
+                                const struct json_field_offset_item* fi,
+                                const char** variant) {
+    struct json_vcur scan = *c;
+    char key[JSON_VALIDATE_BUF];
+    size_t n;
+    int tk;
+
+    if (fi->oneof_variant_structs == NULL) {
+        return JSON_GEN_ERROR_NOT_FOUND;
+    }
+    if (json_v_token(&scan, NULL, 0, &n) != JSON_TOKEN_LEFT_BRACE) {
+        return JSON_GEN_ERROR_PARSE;
+    }
+    // The whole object is then checked as the selected variant, which
+    // skips the tag as an unknown key.
+    while (1) {
+        size_t key_len;
+        tk = json_v_token(&scan, key, sizeof(key), &key_len);
+        if (tk == JSON_TOKEN_RIGHT_BRACE) {
+            return JSON_GEN_ERROR_PARSE;
+        }
+        if (tk == JSON_TOKEN_COMMA) {
+            continue;
+        }
+        if (tk != JSON_TOKEN_STRING ||
+            json_v_token(&scan, NULL, 0, &n) != JSON_TOKEN_COLON) {
+            return JSON_GEN_ERROR_PARSE;
+        }
+        if (key_len < sizeof(key) && strcmp(key, fi->oneof_tag_field) == 0) {
+            int i;
+            if (json_v_token(&scan, key, sizeof(key), &n) !=
+                    JSON_TOKEN_STRING ||
+                n >= sizeof(key)) {
+                return JSON_GEN_ERROR_PARSE;
+            }
+            for (i = 0; i < fi->enum_count; i++) {
+                if (strcmp(key, fi->enum_strings[i]) == 0) {
+                    *variant = fi->oneof_variant_structs[i];
+                    return 0;
+                }
+            }
+            return JSON_GEN_ERROR_PARSE;
+        }
+        if (json_v_skip(&scan) != 0) {
+            return JSON_GEN_ERROR_PARSE;
+        }
+    }
+}
+
+// Check one element of an array field, or the value of a scalar one.
+// A struct or oneof value pushes a frame for the caller's loop to finish.
+static int json_v_element(struct json_vcur* c, struct json_vstack* st,
+                          const struct json_field_offset_item* fi) {
+    switch (fi->field_type) {
+        case FIELD_TYPE_STRUCT:
+            return json_v_push(c, st, fi->field_type_name);
+        case FIELD_TYPE_ONEOF: {
+            const char* variant = NULL;
+            int r = json_v_oneof_variant(c, fi, &variant);
+            return r != 0 ? r : json_v_push(c, st, variant);
+        }
+        case FIELD_TYPE_FIXSTR: {
+            size_t n;
+            int tk = json_v_token(c, NULL, 0, &n);
+            if (tk == JSON_TOKEN_NULL) {
+                return 0;
+            }
+            if (tk != JSON_TOKEN_STRING) {
+                return JSON_GEN_ERROR_PARSE;
+            }
+            return n < (size_t)fi->type_size ? 0 : JSON_GEN_ERROR_BOUNDS;
+        }
+        default:
+            return json_v_scalar(c, fi->field_type, fi->enum_strings,
+                                 fi->enum_count);
+    }
+}
+
+// Read the start of fi's map value. A non-empty map is left open in f.
+static int json_v_map_open(struct json_vcur* c, struct json_vframe* f,
+                           const struct json_field_offset_item* fi,
+                           int mode) {
+    size_t n;
+    int tk = json_v_token(c, NULL, 0, &n);
+    if (tk == JSON_TOKEN_NULL) {
+        return 0;
+    }
+    if (tk != JSON_TOKEN_LEFT_BRACE) {
+        return JSON_GEN_ERROR_PARSE;
+    }
+    if (json_v_peek(c) == '}') {
+        c->off++;
+        return 0;
+    }
+    f->fi = fi;
+    f->mode = mode;
+    f->after = 0;
+    return 0;
+}
+
+// Read the start of fi's array value and leave it open in f.
+static int json_v_array_open(struct json_vcur* c, struct json_vframe* f,
+                             const struct json_field_offset_item* fi) {
+    size_t n;
+    int tk = json_v_token(c, NULL, 0, &n);
+    if (tk == JSON_TOKEN_NULL && fi->array_size == 0 &&
+        (fi->field_type == FIELD_TYPE_MAP || fi->field_type == FIELD_TYPE_ENUM ||
+         fi->field_type == FIELD_TYPE_ONEOF)) {
+        return 0;
+    }
+    if (tk != JSON_TOKEN_LEFT_BRACKET) {
+        return JSON_GEN_ERROR_PARSE;
+    }
+    f->fi = fi;
+    f->mode = JSON_VF_ARRAY;
+    f->count = 0;
+    f->after = 0;
+    return 0;
+}
+
+// Next step of the object's key/value list.
+static int json_v_keys_step(struct json_vcur* c, struct json_vstack* st,
+                            char* key, size_t cap) {
+    struct json_vframe* f = &st->frames[st->n - 1];
+    const struct json_field_offset_item* fi;
+    size_t n, key_len;
+    int tk = json_v_token(c, key, cap, &key_len);
+
+    if (tk == JSON_TOKEN_RIGHT_BRACE) {
+        st->n--;
+        return 0;
+    }
+    if (tk == JSON_TOKEN_COMMA) {
+        return json_v_peek(c) == '}' ? JSON_GEN_ERROR_PARSE : 0;
+    }
+    if (tk != JSON_TOKEN_STRING ||
+        json_v_token(c, NULL, 0, &n) != JSON_TOKEN_COLON) {
+        return JSON_GEN_ERROR_PARSE;
+    }
+    fi = key_len > 0 && key_len < cap
+             ? json_field_offset_item_find_ph(f->st_hash, f->struct_name, key,
+                                              key_len)
+             : NULL;
+    // the "" and <field>_len entries are not keys the decoder reads
+    if (fi == NULL || fi->field_index < 0) {
+        return json_v_skip(c);
+    }
+    if (fi->is_nullable && json_v_peek(c) == 'n') {
+        struct json_vcur peek = *c;
+        if (json_v_token(&peek, NULL, 0, &n) == JSON_TOKEN_NULL) {
+            *c = peek;
+            return 0;
+        }
+    }
+    if (fi->field_type == FIELD_TYPE_MAP && !fi->is_array) {
+        return json_v_map_open(c, f, fi, JSON_VF_MAP);
+    }
+    if (fi->is_array) {
+        return json_v_array_open(c, f, fi);
+    }
+    return json_v_element(c, st, fi);
+}
+
+// Next step of the array open in the top frame.
+static int json_v_array_step(struct json_vcur* c, struct json_vstack* st) {
+    struct json_vframe* f = &st->frames[st->n - 1];
+    size_t n;
+
+    if (f->after) {
+        int tk = json_v_token(c, NULL, 0, &n);
+        if (tk == JSON_TOKEN_RIGHT_BRACKET) {
+            f->mode = JSON_VF_KEYS;
+        } else if (tk != JSON_TOKEN_COMMA) {
+            return JSON_GEN_ERROR_PARSE;
+        }
+        f->after = 0;
+        return 0;
+    }
+    if (json_v_peek(c) == ']') {
+        c->off++;
+        f->mode = JSON_VF_KEYS;
+        return 0;
+    }
+    if (f->fi->array_size > 0 && f->count >= f->fi->array_size) {
+        return JSON_GEN_ERROR_BOUNDS;
+    }
+    f->count++;
+    f->after = 1;
+    if (f->fi->field_type == FIELD_TYPE_MAP) {
+        return json_v_map_open(c, f, f->fi, JSON_VF_ARRAY_MAP);
+    }
+    return json_v_element(c, st, f->fi);
+}
+
+// Next step of the map open in the top frame.
+static int json_v_map_step(struct json_vcur* c, struct json_vstack* st) {
+    struct json_vframe* f = &st->frames[st->n - 1];
+    const struct json_field_offset_item* fi = f->fi;
+    size_t n;
+    int tk;
+
+    if (f->after) {
+        tk = json_v_token(c, NULL, 0, &n);
+        if (tk == JSON_TOKEN_RIGHT_BRACE) {
+            // a map element of an array hands back to the array, which
+            // then expects ',' or ']'
+            f->after = f->mode == JSON_VF_ARRAY_MAP;
+            f->mode = f->after ? JSON_VF_ARRAY : JSON_VF_KEYS;
+            return 0;
+        }
+        if (tk != JSON_TOKEN_COMMA) {
+            return JSON_GEN_ERROR_PARSE;
+        }
+        f->after = 0;
+    }
+    tk = json_v_token(c, NULL, 0, &n);
+    if (tk != JSON_TOKEN_STRING ||
+        json_v_token(c, NULL, 0, &n) != JSON_TOKEN_COLON) {
+        return JSON_GEN_ERROR_PARSE;
+    }
+    f->after = 1;
+    if (fi->map_value_type == FIELD_TYPE_STRUCT) {
+        return json_v_push(c, st, fi->field_type_name);
+    }
+    return json_v_scalar(c, fi->map_value_type, fi->enum_strings,
+                         fi->enum_count);
+}
+
+static int json_validate_struct_(const char* in, size_t len,
+                                 const char* struct_name) {
+    struct json_vcur c;
+    struct json_vstack st;
+    char key[JSON_VALIDATE_BUF];
+    int r;
+
+    if (in == NULL) {
+        return JSON_GEN_ERROR_INVALID_PARAM;
+    }
+    c.data = in;
+    c.len = (long)len;
+    c.off = 0;
+    c.num_ok = 0;
+    st.n = 0;
+    r = json_v_push(&c, &st, struct_name);
+    while (r == 0 && st.n > 0) {
+        switch (st.frames[st.n - 1].mode) {
+            case JSON_VF_KEYS:
+                r = json_v_keys_step(&c, &st, key, sizeof(key));
+                break;
+            case JSON_VF_ARRAY:
+                r = json_v_array_step(&c, &st);
+                break;
+            default:
+                r = json_v_map_step(&c, &st);
+                break;
+        }
+    }
+    // the decoder stops at the closing '}' and ignores what follows
+    return r;
+}
+
+/* ---------------------------------------------------------------
+ * Path extraction.
+ *
+ * json_extract() walks a JSON Pointer through the document with the
+ * validation cursor above, skipping every sibling it passes without
+ * decoding it, and decodes only the value at the end of the path.
+ * --------------------------------------------------------------- */
+
+// Copy the JSON Pointer segment after the '/' at *path into seg, undoing
+// ~0 and ~1. Returns its length, or -1 if it is malformed or too long.
+static long json_x_segment(const char** path, char* seg, size_t cap) {
+    const char* p = *path + 1;
+    size_t w = 0;
+
+    while (*p != '\0' && *p != '/') {
+        char ch = *p++;
+        if (ch == '~') {
+            if (*p == '0') {
+                ch = '~';
+            } else if (*p == '1') {
+                ch = '/';
+            } else {
+                return -1;
+            }
+            p++;
+        }
+        if (w + 1 >= cap) {
+            return -1;
+        }
+        seg[w++] = ch;
+    }
+    seg[w] = '\0';
+    *path = p;
+    return (long)w;
+}
+
+// Advance c to the value selected by one path segment of the container
+// that starts at c.
+static int json_x_step(struct json_vcur* c, const char* seg, long seg_len) {
+    char key[JSON_VALIDATE_BUF];
+    size_t n, key_len;
+    int tk = json_v_token(c, NULL, 0, &n);
+    int r;
+
+    if (tk == JSON_TOKEN_LEFT_BRACE) {
+        while (1) {
+            tk = json_v_token(c, key, sizeof(key), &key_len);
+            if (tk == JSON_TOKEN_RIGHT_BRACE) {
+                return JSON_GEN_ERROR_NOT_FOUND;
+            }
+            if (tk == JSON_TOKEN_COMMA) {
+                continue;
+            }
+            if (tk != JSON_TOKEN_STRING ||
+                json_v_token(c, NULL, 0, &n) != JSON_TOKEN_COLON) {
+                return JSON_GEN_ERROR_PARSE;
+            }
+            if (key_len == (size_t)seg_len && memcmp(key, seg, key_len) == 0) {
+                return 0;
+            }
+            r = json_v_skip(c);
+            if (r != 0) {
+                return r;
+            }
+        }
+    }
+    if (tk == JSON_TOKEN_LEFT_BRACKET) {
+        long idx = 0;
+        long k;
+        if (seg_len == 0 || seg_len > 9) {
+            return JSON_GEN_ERROR_NOT_FOUND;
+        }
+        for (k = 0; k < seg_len; k++) {
+            if (!JSON_IS_DIGIT(seg[k])) {
+                return JSON_GEN_ERROR_NOT_FOUND;
+            }
+            idx = idx * 10 + (seg[k] - '0');
+        }
+        while (1) {
+            if (json_v_peek(c) == ']') {
+                return JSON_GEN_ERROR_NOT_FOUND;
+            }
+            if (idx-- == 0) {
+                return 0;
+            }
+            r = json_v_skip(c);
+            if (r != 0) {
+                return r;
+            }
+            tk = json_v_token(c, NULL, 0, &n);
+            if (tk == JSON_TOKEN_RIGHT_BRACKET) {
+                return JSON_GEN_ERROR_NOT_FOUND;
+            }
+            if (tk != JSON_TOKEN_COMMA) {
+                return JSON_GEN_ERROR_PARSE;
+            }
+        }
+    }
+    if (tk == JSON_ERROR || tk == JSON_TOKEN_EOF) {
+        return JSON_GEN_ERROR_PARSE;
+    }
+    // a scalar has no children
+    return JSON_GEN_ERROR_NOT_FOUND;
+}
+
+// Decode the string at c into out, replacing its contents.
+static int json_x_string(struct json_vcur* c, sstr_t out) {
+    struct json_vcur scan = *c;
+    size_t n;
+
+    // The first pass only measures; the second decodes in place.
+    if (json_v_string(&scan, NULL, 0, &n) != JSON_TOKEN_STRING) {
+        return JSON_GEN_ERROR_PARSE;
+    }
+    sstr_clear(out);
+    sstr_append_zero(out, n);
+    json_v_string(c, sstr_cstr(out), n + 1, &n);
+    return 0;
+}
+
+// Decode the value at c as FIELD_TYPE_* @p type into out.
+static int json_x_value(struct json_vcur* c, int type,
+                        const char** enum_strings, int enum_count,
+                        void* out) {
+    char buf[JSON_VALIDATE_BUF];
+    size_t n;
+    int tk, r, i;
+
+    if (type == FIELD_TYPE_SSTR) {
+        if (json_v_peek(c) == '"') {
+            return json_x_string(c, (sstr_t)out);
+        }
+        if (json_v_token(c, NULL, 0, &n) == JSON_TOKEN_NULL) {
+            sstr_clear((sstr_t)out);
+            return 0;
+        }
+        return JSON_GEN_ERROR_PARSE;
+    }
+
+    tk = json_v_token(c, buf, sizeof(buf), &n);
+    if (type == FIELD_TYPE_FLOAT || type == FIELD_TYPE_DOUBLE) {
+        if ((tk != JSON_TOKEN_INT && tk != JSON_TOKEN_FLOAT) || !c->num_ok) {
+            return JSON_GEN_ERROR_PARSE;
+        }
+        if (n >= sizeof(buf)) {
+            return JSON_GEN_ERROR_BOUNDS;
+        }
+        if (type == FIELD_TYPE_FLOAT) {
+            *(float*)out = strtof(buf, NULL);
+        } else {
+            *(double*)out = strtod(buf, NULL);
+        }
+        return 0;
+    }
+    if (type == FIELD_TYPE_ENUM && tk == JSON_TOKEN_STRING) {
+        for (i = 0; n < sizeof(buf) && i < enum_count; i++) {
+            if (strcmp(buf, enum_strings[i]) == 0) {
+                *(int*)out = i;
+                return 0;
+            }
+        }
+        return JSON_GEN_ERROR_PARSE;
+    }
+    if (tk == JSON_TOKEN_TRUE || tk == JSON_TOKEN_FALSE) {
+        if (type == FIELD_TYPE_ENUM) {
+            return JSON_GEN_ERROR_PARSE;
+        }
+        // Every integer type holds 0 and 1.
+        buf[0] = tk == JSON_TOKEN_TRUE ? '1' : '0';
+        buf[1] = '\0';
+    } else if (tk != JSON_TOKEN_INT || !c->num_ok) {
+        return JSON_GEN_ERROR_PARSE;
+    } else if (n >= sizeof(buf)) {
+        return JSON_GEN_ERROR_BOUNDS;
+    }
+    r = json_v_int(type, buf);
+    if (r != 0) {
+        return r;
+    }
+    switch (type) {
+        case FIELD_TYPE_LONG:
+            *(long*)out = strtol(buf, NULL, 10);
+            break;
+        case FIELD_TYPE_INT8:
+            *(int8_t*)out = (int8_t)strtol(buf, NULL, 10);
+            break;
+        case FIELD_TYPE_INT16:
+            *(int16_t*)out = (int16_t)strtol(buf, NULL, 10);
+            break;
+        case FIELD_TYPE_INT32:
+            *(int32_t*)out = (int32_t)strtol(buf, NULL, 10);
+            break;
+        case FIELD_TYPE_INT64:
+            *(int64_t*)out = (int64_t)strtoll(buf, NULL, 10);
+            break;
+        case FIELD_TYPE_UINT8:
+            *(uint8_t*)out = (uint8_t)strtoul(buf, NULL, 10);
+            break;
+        case FIELD_TYPE_UINT16:
+            *(uint16_t*)out = (uint16_t)strtoul(buf, NULL, 10);
+            break;
+        case FIELD_TYPE_UINT32:
+            *(uint32_t*)out = (uint32_t)strtoul(buf, NULL, 10);
+            break;
+        case FIELD_TYPE_UINT64:
+            *(uint64_t*)out = (uint64_t)strtoull(buf, NULL, 10);
+            break;
+        case FIELD_TYPE_ENUM: {
+            long v = strtol(buf, NULL, 10);
+            if (v < 0 || v >= enum_count) {
+                return JSON_GEN_ERROR_BOUNDS;
+            }
+            *(int*)out = (int)v;
+            break;
+        }
+        default:  // int, bool
+            *(int*)out = (int)strtol(buf, NULL, 10);
+            break;
+    }
+    return 0;
+}
+
+// index, when not NULL, is one more array index appended to path.
+static int json_extract_path_(const char* in, size_t len, const char* path,
+                              const int* index, int type,
+                              const char** enum_strings, int enum_count,
+                              void* out) {
+    struct json_vcur c;
+    char seg[JSON_VALIDATE_BUF];
+    int r;
+
+    if (in == NULL || path == NULL || out == NULL) {
+        return JSON_GEN_ERROR_INVALID_PARAM;
+    }
+    c.data = in;
+    c.len = (long)len;
+    c.off = 0;
+    c.num_ok = 0;
+    while (*path != '\0') {
+        long seg_len;
+        if (*path != '/') {
+            return JSON_GEN_ERROR_INVALID_PARAM;
+        }
+        seg_len = json_x_segment(&path, seg, sizeof(seg));
+        if (seg_len < 0) {
+            return JSON_GEN_ERROR_INVALID_PARAM;
+        }
+        r = json_x_step(&c, seg, seg_len);
+        if (r != 0) {
+            return r;
+        }
+    }
+    if (index != NULL) {
+        if (*index < 0) {
+            return JSON_GEN_ERROR_NOT_FOUND;
+        }
+        int seg_len = snprintf(seg, sizeof(seg), "%d", *index);
+        r = json_x_step(&c, seg, seg_len);
+        if (r != 0) {
+            return r;
+        }
+    }
+    return json_x_value(&c, type, enum_strings, enum_count, out);
+}
+
+int json_extract(const char* in, size_t len, const char* path, int type,
+                 void* out) {
+    switch (type) {
+        case JSON_EXTRACT_INT:
+        case JSON_EXTRACT_LONG:
+        case JSON_EXTRACT_FLOAT:
+        case JSON_EXTRACT_DOUBLE:
+        case JSON_EXTRACT_SSTR:
+        case JSON_EXTRACT_BOOL:
+        case JSON_EXTRACT_INT8:
+        case JSON_EXTRACT_INT16:
+        case JSON_EXTRACT_INT32:
+        case JSON_EXTRACT_INT64:
+        case JSON_EXTRACT_UINT8:
+        case JSON_EXTRACT_UINT16:
+        case JSON_EXTRACT_UINT32:
+        case JSON_EXTRACT_UINT64:
+            return json_extract_path_(in, len, path, NULL, type, NULL, 0, out);
+        default:
+            return JSON_GEN_ERROR_INVALID_PARAM;
+    }
+}
+
+// =====================================================================
+// Parallel array marshal
+// =====================================================================
+
+/* Arrays are split into at most one chunk per thread, and never into
+ * chunks smaller than this many elements. */
+#ifndef JSON_MARSHAL_PARALLEL_MIN_CHUNK
+#define JSON_MARSHAL_PARALLEL_MIN_CHUNK 256
+#endif
+
+struct json_marshal_chunk_ {
+    char* arr;
+    size_t elem_size;
+    json_marshal_elem_fn_ fn;
+    int begin;
+    int end;
+    sstr_t out;
+    // allocator of out, installed while the chunk runs
+    const struct jgenc_allocator* alloc;
+    int ret;
+#ifndef JSON_GEN_C_NO_THREADS
+    int started;
+#ifdef _WIN32
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+#endif
+};
+
+// Elements [begin, end), each preceded by ',' unless it is element 0.
+static void json_marshal_chunk_run_(struct json_marshal_chunk_* c) {
+    const struct jgenc_allocator* prev = jgenc_set_thread_allocator(c->alloc);
+    int i;
+    c->ret = 0;
+    for (i = c->begin; i < c->end; i++) {
+        if (i) {
+            sstr_append_of_fast(c->out, ",", 1);
+        }
+        if (c->fn(c->arr + (size_t)i * c->elem_size, c->out) != 0) {
+            c->ret = -1;
+            break;
+        }
+    }
+    jgenc_set_thread_allocator(prev);
+}
+
+#ifndef JSON_GEN_C_NO_THREADS
+#ifdef _WIN32
+static DWORD WINAPI json_marshal_chunk_thread_(LPVOID p) {
+    json_marshal_chunk_run_((struct json_marshal_chunk_*)p);
+    return 0;
+}
+#else
+static void* json_marshal_chunk_thread_(void* p) {
+    json_marshal_chunk_run_((struct json_marshal_chunk_*)p);
+    return NULL;
+}
+#endif
+
+static int json_cpu_count_(void) {
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    return (int)si.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    return 1;
+#endif
+}
+
+static void json_marshal_chunk_start_(struct json_marshal_chunk_* c) {
+#ifdef _WIN32
+    c->thread = CreateThread(NULL, 0, json_marshal_chunk_thread_, c, 0, NULL);
+    c->started = c->thread != NULL;
+#else
+    c->started =
+        pthread_create(&c->thread, NULL, json_marshal_chunk_thread_, c) == 0;
+#endif
+}
+
+static void json_marshal_chunk_join_(struct json_marshal_chunk_* c) {
+    if (!c->started) {
+        // could not start a thread for it: run it here instead
+        json_marshal_chunk_run_(c);
+        return;
+    }
+#ifdef _WIN32
+    WaitForSingleObject(c->thread, INFINITE);
+    CloseHandle(c->thread);
+#else
+    pthread_join(c->thread, NULL);
+#endif
+}
+#endif
+
+/**
+ * @brief Marshal an array of structs as a json array, splitting it into
+ *        chunks marshaled concurrently into separate buffers.
+ *
+ * The first chunk is written by the calling thread straight into out; the
+ * others are appended to it in order once their threads finish. out grows
+ * through the caller's thread allocator; the other chunks' scratch buffers
+ * use the default one.
+ *
+ * @param threads number of chunks at most; <= 0 uses one per online CPU.
+ * @return 0 on success, -1 if an element failed to marshal or memory ran
+ *         out. out is left holding a partial array on failure.
+ */
+static int json_marshal_array_parallel_(void* arr, int len, size_t elem_size,
+                                        json_marshal_elem_fn_ fn, int threads,
+                                        sstr_t out) {
+    const struct jgenc_allocator* caller_alloc = jgenc_thread_allocator();
+    struct json_marshal_chunk_* chunks;
+    int n, i, ret = 0;
+    size_t total;
+
+#ifdef JSON_GEN_C_NO_THREADS
+    threads = 1;
+#else
+    if (threads <= 0) {
+        threads = json_cpu_count_();
+    }
+#endif
+    n = len / JSON_MARSHAL_PARALLEL_MIN_CHUNK;
+    if (n > threads) {
+        n = threads;
+    }
+    if (n < 1) {
+        n = 1;
+    }
+    chunks = (struct json_marshal_chunk_*)JGENC_MALLOC(
+        sizeof(struct json_marshal_chunk_) * (size_t)n);
+    if (chunks == NULL) {
+        return -1;
+    }
+    jgenc_set_thread_allocator(NULL);
+    for (i = 0; i < n; i++) {
+        struct json_marshal_chunk_* c = &chunks[i];
+        c->arr = (char*)arr;
+        c->elem_size = elem_size;
+        c->fn = fn;
+        c->begin = (int)((long long)len * i / n);
+        c->end = (int)((long long)len * (i + 1) / n);
+        c->ret = 0;
+        if (i == 0) {
+            c->out = out;
+            c->alloc = caller_alloc;
+        } else {
+            // Scratch buffers are grown on other threads, and the caller's
+            // allocator need not be thread safe (a jgenc_pool is not), so
+            // they live on the default allocator from start to free.
+            c->out = sstr_new();
+            c->alloc = NULL;
+        }
+    }
+    jgenc_set_thread_allocator(caller_alloc);
+
+    sstr_append_of_fast(out, "[", 1);
+#ifndef JSON_GEN_C_NO_THREADS
+    for (i = 1; i < n; i++) {
+        json_marshal_chunk_start_(&chunks[i]);
+    }
+#endif
+    json_marshal_chunk_run_(&chunks[0]);
+    ret = chunks[0].ret;
+    total = sstr_length(out) + 1;
+    for (i = 1; i < n; i++) {
+#ifndef JSON_GEN_C_NO_THREADS
+        json_marshal_chunk_join_(&chunks[i]);
+#endif
+        if (chunks[i].ret != 0) {
+            ret = -1;
+        }
+        total += sstr_length(chunks[i].out);
+    }
+    // every chunk is done, so the joined size is known: grow out once
+    if (ret == 0) {
+        sstr_reserve(out, total);
+    }
+    for (i = 1; i < n && ret == 0; i++) {
+        sstr_append(out, chunks[i].out);
+    }
+    jgenc_set_thread_allocator(NULL);
+    for (i = 1; i < n; i++) {
+        sstr_free(chunks[i].out);
+    }
+    jgenc_set_thread_allocator(caller_alloc);
+    JGENC_FREE(chunks);
+    if (ret == 0) {
+        sstr_append_of_fast(out, "]", 1);
+    }
+    return ret;
+}
+
+// =====================================================================
+// Scatter-gather (iovec) marshal
+// =====================================================================
+
+/* Strings shorter than this are copied into io->buf even when they need
+ * no escaping: an extra iovec entry costs more than copying them. */
+#ifndef JSON_IOV_MIN_REF
+#define JSON_IOV_MIN_REF 256
+#endif
+
+/* One piece of output: n bytes at ref, or with ref == NULL the bytes
+ * [off, off + n) of io->buf, kept as an offset since buf may move. */
+struct json_iov_seg_ {
+    const char* ref;
+    size_t off;
+    size_t n;
+};
+
+int json_iov_init(struct json_iov* io) {
+    memset(io, 0, sizeof(*io));
+    io->buf = sstr_new();
+    return io->buf == NULL ? -1 : 0;
+}
+
+void json_iov_reset(struct json_iov* io) {
+    sstr_clear_fast(io->buf);
+    io->seg_count = 0;
+    io->mark = 0;
+}
+
+void json_iov_clear(struct json_iov* io) {
+    sstr_free(io->buf);
+    JGENC_FREE(io->segs);
+    JGENC_FREE(io->vec);
+    memset(io, 0, sizeof(*io));
+}
+
+static int json_iov_push_(struct json_iov* io, const char* ref, size_t off,
+                          size_t n) {
+    if (io->seg_count == io->seg_cap) {
+        int cap = io->seg_cap ? io->seg_cap * 2 : 16;
+        struct json_iov_seg_* segs = (struct json_iov_seg_*)JGENC_REALLOC(
+            io->segs, (size_t)cap * sizeof(struct json_iov_seg_));
+        if (segs == NULL) {
+            return -1;
+        }
+        io->segs = segs;
+        io->seg_cap = cap;
+    }
+    io->segs[io->seg_count].ref = ref;
+    io->segs[io->seg_count].off = off;
+    io->segs[io->seg_count].n = n;
+    io->seg_count++;
+    return 0;
+}
+
+// Close the pending span of io->buf.
+static int json_iov_flush_(struct json_iov* io) {
+    size_t end = sstr_length(io->buf);
+    if (end > io->mark) {
+        if (json_iov_push_(io, NULL, io->mark, end - io->mark) != 0) {
+            return -1;
+        }
+        io->mark = end;
+    }
+    return 0;
+}
+
+static int json_iov_string_(struct json_iov* io, sstr_t out, sstr_t s) {
+    size_t n = s ? sstr_length(s) : 0;
+    if (n < JSON_IOV_MIN_REF || sstr_json_escape_scan(s) != n) {
+        return sstr_json_escape_string_append(out, s);
+    }
+    if (json_iov_flush_(io) != 0) {
+        return -1;
+    }
+    return json_iov_push_(io, sstr_cstr(s), 0, n);
+}
+
+JSON_IOVEC* json_iov_vec(struct json_iov* io, int* count) {
+    int i;
+    *count = 0;
+    if (json_iov_flush_(io) != 0) {
+        return NULL;
+    }
+    if (io->seg_count > io->vec_cap || io->vec == NULL) {
+        int cap = io->seg_count > 0 ? io->seg_count : 1;
+        JSON_IOVEC* vec = (JSON_IOVEC*)JGENC_REALLOC(
+            io->vec, (size_t)cap * sizeof(JSON_IOVEC));
+        if (vec == NULL) {
+            return NULL;
+        }
+        io->vec = vec;
+        io->vec_cap = cap;
+    }
+    for (i = 0; i < io->seg_count; i++) {
+        const struct json_iov_seg_* g = &io->segs[i];
+        io->vec[i].iov_base =
+            (void*)(g->ref ? g->ref : sstr_cstr(io->buf) + g->off);
+        io->vec[i].iov_len = g->n;
+    }
+    *count = io->seg_count;
+    return io->vec;
+}
+
+// =====================================================================
+// Streaming writers (json_sink)
+// =====================================================================
+
+#ifndef JSON_SINK_FLUSH_SIZE
+#define JSON_SINK_FLUSH_SIZE 65536
+#endif
+
+int json_sink_init(struct json_sink* sink, json_sink_write_fn write,
+                   void* ctx, size_t flush_size) {
+    sink->write = write;
+    sink->ctx = ctx;
+    sink->flush_size = flush_size ? flush_size : JSON_SINK_FLUSH_SIZE;
+    sink->err = 0;
+    sink->buf = sstr_new();
+    return sink->buf == NULL ? -1 : 0;
+}
+
+int json_sink_flush(struct json_sink* sink) {
+    size_t len = sstr_length(sink->buf);
+    if (sink->err == 0 && len > 0 &&
+        sink->write(sink->ctx, sstr_cstr(sink->buf), len) != 0) {
+        sink->err = -1;
+    }
+    sstr_clear_fast(sink->buf);
+    return sink->err;
+}
+
+void json_sink_clear(struct json_sink* sink) {
+    sstr_free(sink->buf);
+    sink->buf = NULL;
+}
+
+int json_sink_write_file(void* ctx, const char* data, size_t len) {
+    return fwrite(data, 1, len, (FILE*)ctx) == len ? 0 : -1;
+}
+
+// Flush once enough output has collected.
+static int json_sink_commit_(struct json_sink* sink) {
+    if (sstr_length(sink->buf) >= sink->flush_size) {
+        return json_sink_flush(sink);
+    }
+    return sink->err;
+}
+
+// A half-written record cannot be taken back: the stream stays failed.
+static int json_sink_fail_(struct json_sink* sink) {
+    sink->err = -1;
+    sstr_clear_fast(sink->buf);
+    return -1;
+}
+
+static int json_array_writer_begin_(struct json_array_writer* w,
+                                    struct json_sink* sink) {
+    w->sink = sink;
+    w->count = 0;
+    if (sink->err != 0) {
+        return -1;
+    }
+    sstr_append_of_fast(sink->buf, "[", 1);
+    return json_sink_commit_(sink);
+}
+
+// The separator before the next element.
+static int json_array_writer_next_(struct json_array_writer* w) {
+    if (w->sink->err != 0) {
+        return -1;
+    }
+    if (w->count++) {
+        sstr_append_of_fast(w->sink->buf, ",", 1);
+    }
+    return 0;
+}
+
+static int json_array_writer_end_(struct json_array_writer* w) {
+    if (w->sink->err != 0) {
+        return -1;
+    }
+    sstr_append_of_fast(w->sink->buf, "]", 1);
+    return json_sink_flush(w->sink);
+}
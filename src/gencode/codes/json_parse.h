@@ -63,6 +63,7 @@ enum json_token {
 #define FIELD_TYPE_UINT32 15
 #define FIELD_TYPE_UINT64 16
 #define FIELD_TYPE_ONEOF 17
+#define FIELD_TYPE_FIXSTR 18
 
 #ifndef JSON_MAX_DEPTH
 #define JSON_MAX_DEPTH 256
@@ -92,14 +93,48 @@ struct json_parse_param {
     int field_mask_word_count;
     const struct json_nested_mask* nested_masks;
     int nested_mask_count;
+    int merge;  // apply as an RFC 7386 merge patch onto the existing value
+};
+
+// Limits in force for one decode, plus the bytes it has allocated so far.
+struct json_limit_state {
+    struct json_limits limits;
+    size_t alloc_bytes;
 };
 
 struct json_pos {
     int line;
     int col;
     long offset;
+    struct json_error* err;  // structured error sink; NULL builds text
+    struct json_limit_state* lim;  // NULL when no limits apply
 };
 
+static int json_decode_begin_(sstr_t in, struct json_pos* pos,
+                              struct json_limit_state* lim,
+                              const struct json_limits* limits,
+                              struct json_error* err, sstr_t txt);
+static void json_error_end_(struct json_error* err, const struct json_pos* pos,
+                            int r);
+static int json_validate_struct_(const char* in, size_t len,
+                                 const char* struct_name);
+static int json_extract_path_(const char* in, size_t len, const char* path,
+                              const int* index, int type,
+                              const char** enum_strings, int enum_count,
+                              void* out);
+static const struct json_nested_mask* json_nested_mask_find_(
+        const struct json_nested_mask* masks, int count, int field_index);
+typedef int (*json_marshal_elem_fn_)(void* elem, sstr_t out);
+static int json_marshal_array_parallel_(void* arr, int len, size_t elem_size,
+                                        json_marshal_elem_fn_ fn, int threads,
+                                        sstr_t out);
+static int json_iov_string_(struct json_iov* io, sstr_t out, sstr_t s);
+static int json_sink_commit_(struct json_sink* sink);
+static int json_sink_fail_(struct json_sink* sink);
+static int json_array_writer_begin_(struct json_array_writer* w,
+                                    struct json_sink* sink);
+static int json_array_writer_next_(struct json_array_writer* w);
+static int json_array_writer_end_(struct json_array_writer* w);
 static int json_next_token_(sstr_t content, struct json_pos* pos, sstr_t txt);
 static int json_next_token(sstr_t content, struct json_pos* pos, sstr_t txt);
 static int json_unmarshal_struct_internal(sstr_t content, struct json_pos* pos,
@@ -181,87 +216,87 @@ static int json_unmarshal_ignore_value(sstr_t content, struct json_pos* pos,
 int json_marshal_array_indent_int(int* obj, int len, int indent, int curindent,
                                   sstr_t out) {
     int i;
-    sstr_append_of(out, "[", 1);
+    sstr_append_of_fast(out, "[", 1);
     sstr_append_of_if(out, "\n", 1, indent);
     curindent += indent;
     for (i = 0; i < len; i++) {
         sstr_append_indent(out, curindent);
         sstr_printf_append(out, "%d", obj[i]);
         if (i != len - 1) {
-            sstr_append_of(out, ",", 1);
+            sstr_append_of_fast(out, ",", 1);
         }
         sstr_append_of_if(out, "\n", 1, indent);
     }
     curindent -= indent;
     sstr_append_indent(out, curindent);
-    sstr_append_of(out, "]", 1);
+    sstr_append_of_fast(out, "]", 1);
     return 0;
 }
 
 int json_marshal_array_indent_long(long* obj, int len, int indent,
                                    int curindent, sstr_t out) {
     int i;
-    sstr_append_of(out, "[", 1);
+    sstr_append_of_fast(out, "[", 1);
     sstr_append_of_if(out, "\n", 1, indent);
     curindent += indent;
     for (i = 0; i < len; i++) {
         sstr_append_indent(out, curindent);
         sstr_printf_append(out, "%l", obj[i]);
         if (i != len - 1) {
-            sstr_append_of(out, ",", 1);
+            sstr_append_of_fast(out, ",", 1);
         }
         sstr_append_of_if(out, "\n", 1, indent);
     }
     curindent -= indent;
     sstr_append_indent(out, curindent);
-    sstr_append_of(out, "]", 1);
+    sstr_append_of_fast(out, "]", 1);
     return 0;
 }
 
 int json_marshal_array_indent_float(float* obj, int len, int indent,
                                     int curindent, sstr_t out) {
     int i;
-    sstr_append_of(out, "[", 1);
+    sstr_append_of_fast(out, "[", 1);
     sstr_append_of_if(out, "\n", 1, indent);
     curindent += indent;
     for (i = 0; i < len; i++) {
         sstr_append_indent(out, curindent);
         sstr_append_float_str(out, obj[i], -1);
         if (i != len - 1) {
-            sstr_append_of(out, ",", 1);
+            sstr_append_of_fast(out, ",", 1);
         }
         sstr_append_of_if(out, "\n", 1, indent);
     }
     curindent -= indent;
     sstr_append_indent(out, curindent);
-    sstr_append_of(out, "]", 1);
+    sstr_append_of_fast(out, "]", 1);
     return 0;
 }
 
 int json_marshal_array_indent_double(double* obj, int len, int indent,
                                      int curindent, sstr_t out) {
     int i;
-    sstr_append_of(out, "[", 1);
+    sstr_append_of_fast(out, "[", 1);
     sstr_append_of_if(out, "\n", 1, indent);
     curindent += indent;
     for (i = 0; i < len; i++) {
         sstr_append_indent(out, curindent);
         sstr_append_double_str(out, obj[i], -1);
         if (i != len - 1) {
-            sstr_append_of(out, ",", 1);
+            sstr_append_of_fast(out, ",", 1);
         }
         sstr_append_of_if(out, "\n", 1, indent);
     }
     curindent -= indent;
     sstr_append_indent(out, curindent);
-    sstr_append_of(out, "]", 1);
+    sstr_append_of_fast(out, "]", 1);
     return 0;
 }
 
 int json_marshal_array_indent_sstr_t(sstr_t* obj, int len, int indent,
                                      int curindent, sstr_t out) {
     int i;
-    sstr_append_of(out, "[", 1);
+    sstr_append_of_fast(out, "[", 1);
     sstr_append_of_if(out, "\n", 1, indent);
     curindent += indent;
     for (i = 0; i < len; i++) {
@@ -270,13 +305,13 @@ int json_marshal_array_indent_sstr_t(sstr_t* obj, int len, int indent,
         sstr_json_escape_string_append(out, obj[i]);
         sstr_append_cstr(out, "\"");
         if (i != len - 1) {
-            sstr_append_of(out, ",", 1);
+            sstr_append_of_fast(out, ",", 1);
         }
         sstr_append_of_if(out, "\n", 1, indent);
     }
     curindent -= indent;
     sstr_append_indent(out, curindent);
-    sstr_append_of(out, "]", 1);
+    sstr_append_of_fast(out, "]", 1);
     return 0;
 }
 
@@ -284,20 +319,20 @@ int json_marshal_array_indent_sstr_t(sstr_t* obj, int len, int indent,
 int json_marshal_array_indent_##TYPE(TYPE* obj, int len, int indent,           \
                                      int curindent, sstr_t out) {              \
     int i;                                                                     \
-    sstr_append_of(out, "[", 1);                                               \
+    sstr_append_of_fast(out, "[", 1);                                          \
     sstr_append_of_if(out, "\n", 1, indent);                                   \
     curindent += indent;                                                        \
     for (i = 0; i < len; i++) {                                                \
         sstr_append_indent(out, curindent);                                     \
         APPEND_FN(out, (CAST)obj[i]);                                          \
         if (i != len - 1) {                                                    \
-            sstr_append_of(out, ",", 1);                                       \
+            sstr_append_of_fast(out, ",", 1);                                  \
         }                                                                      \
         sstr_append_of_if(out, "\n", 1, indent);                               \
     }                                                                          \
     curindent -= indent;                                                        \
     sstr_append_indent(out, curindent);                                         \
-    sstr_append_of(out, "]", 1);                                               \
+    sstr_append_of_fast(out, "]", 1);                                          \
     return 0;                                                                  \
 }
 
@@ -309,3 +344,140 @@ DEFINE_MARSHAL_ARRAY_INDENT_INTTYPE(uint8_t, sstr_append_int_str, int)
 DEFINE_MARSHAL_ARRAY_INDENT_INTTYPE(uint16_t, sstr_append_int_str, int)
 DEFINE_MARSHAL_ARRAY_INDENT_INTTYPE(uint32_t, sstr_append_uint32_str, uint32_t)
 DEFINE_MARSHAL_ARRAY_INDENT_INTTYPE(uint64_t, sstr_append_uint64_str, uint64_t)
+
+/* Compact array marshal: no indentation, one ',' between elements. */
+#define DEFINE_MARSHAL_ARRAY_COMPACT(TYPE, APPEND_ELEM)                        \
+int json_marshal_array_##TYPE(TYPE* obj, int len, sstr_t out) {                \
+    int i;                                                                     \
+    sstr_append_of_fast(out, "[", 1);                                          \
+    for (i = 0; i < len; i++) {                                                \
+        if (i) {                                                               \
+            sstr_append_of_fast(out, ",", 1);                                  \
+        }                                                                      \
+        APPEND_ELEM;                                                           \
+    }                                                                          \
+    sstr_append_of_fast(out, "]", 1);                                          \
+    return 0;                                                                  \
+}
+
+DEFINE_MARSHAL_ARRAY_COMPACT(int, sstr_append_int_str(out, obj[i]))
+DEFINE_MARSHAL_ARRAY_COMPACT(long, sstr_append_long_str(out, obj[i]))
+DEFINE_MARSHAL_ARRAY_COMPACT(float, sstr_append_float_str(out, obj[i], -1))
+DEFINE_MARSHAL_ARRAY_COMPACT(double, sstr_append_double_str(out, obj[i], -1))
+DEFINE_MARSHAL_ARRAY_COMPACT(sstr_t,
+                             sstr_append_of_fast(out, "\"", 1);
+                             sstr_json_escape_string_append(out, obj[i]);
+                             sstr_append_of_fast(out, "\"", 1))
+DEFINE_MARSHAL_ARRAY_COMPACT(int8_t, sstr_append_int_str(out, (int)obj[i]))
+DEFINE_MARSHAL_ARRAY_COMPACT(int16_t, sstr_append_int_str(out, (int)obj[i]))
+DEFINE_MARSHAL_ARRAY_COMPACT(int32_t, sstr_append_int_str(out, (int)obj[i]))
+DEFINE_MARSHAL_ARRAY_COMPACT(int64_t, sstr_append_long_str(out, (long)obj[i]))
+DEFINE_MARSHAL_ARRAY_COMPACT(uint8_t, sstr_append_int_str(out, (int)obj[i]))
+DEFINE_MARSHAL_ARRAY_COMPACT(uint16_t, sstr_append_int_str(out, (int)obj[i]))
+DEFINE_MARSHAL_ARRAY_COMPACT(uint32_t, sstr_append_uint32_str(out, obj[i]))
+DEFINE_MARSHAL_ARRAY_COMPACT(uint64_t, sstr_append_uint64_str(out, obj[i]))
+
+/* Value comparisons for the generated json_marshal_diff_<S>(). A NULL
+ * sstr_t marshals as "" and so compares equal to an empty string. */
+static inline int json_diff_sstr_ne_(sstr_t a, sstr_t b) {
+    size_t la = a ? sstr_length(a) : 0;
+    size_t lb = b ? sstr_length(b) : 0;
+    return la != lb || (la && memcmp(sstr_cstr(a), sstr_cstr(b), la) != 0);
+}
+
+static inline int json_diff_sstr_array_ne_(const sstr_t* a, int alen,
+                                           const sstr_t* b, int blen) {
+    int i;
+    if (alen != blen) {
+        return 1;
+    }
+    for (i = 0; i < alen; i++) {
+        if (json_diff_sstr_ne_(a[i], b[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static inline int json_diff_mem_ne_(const void* a, int alen, const void* b,
+                                    int blen, size_t elem_size) {
+    return alen != blen ||
+           (alen > 0 && memcmp(a, b, (size_t)alen * elem_size) != 0);
+}
+
+/* Serialized fragments of a @cached struct, one per field, each holding
+ * '"key":value' (empty when the field is omitted). A set dirty bit means
+ * the fragment must be rebuilt on the next json_marshal_<S>(). */
+struct json_cache {
+    int field_count;
+    sstr_t* frags;
+    uint64_t dirty[];
+};
+
+static inline struct json_cache* json_cache_new_(int field_count) {
+    int words = JSON_GEN_C_FIELD_MASK_WORD_COUNT(field_count);
+    size_t head = sizeof(struct json_cache) + (size_t)words * sizeof(uint64_t);
+    struct json_cache* c = (struct json_cache*)JGENC_MALLOC(
+        head + (size_t)field_count * sizeof(sstr_t));
+    if (c == NULL) {
+        return NULL;
+    }
+    c->field_count = field_count;
+    c->frags = (sstr_t*)((char*)c + head);
+    memset(c->dirty, 0xff, (size_t)words * sizeof(uint64_t));
+    memset(c->frags, 0, (size_t)field_count * sizeof(sstr_t));
+    return c;
+}
+
+static inline void json_cache_free_(struct json_cache* c) {
+    int i;
+    if (c == NULL) {
+        return;
+    }
+    for (i = 0; i < c->field_count; i++) {
+        sstr_free(c->frags[i]);
+    }
+    JGENC_FREE(c);
+}
+
+// field_index < 0 marks every field.
+static inline void json_cache_mark_(struct json_cache* c, int field_index) {
+    if (c == NULL) {
+        return;
+    }
+    if (field_index < 0) {
+        memset(c->dirty, 0xff,
+               (size_t)JSON_GEN_C_FIELD_MASK_WORD_COUNT(c->field_count) *
+                   sizeof(uint64_t));
+    } else if (field_index < c->field_count) {
+        JSON_GEN_C_FIELD_MASK_SET(c->dirty, field_index);
+    }
+}
+
+// Empty fragment of a dirty field, to be refilled; NULL when it is clean.
+static inline sstr_t json_cache_refill_(struct json_cache* c,
+                                        int field_index) {
+    if (!JSON_GEN_C_FIELD_MASK_TEST(c->dirty, field_index)) {
+        return NULL;
+    }
+    if (c->frags[field_index] == NULL) {
+        c->frags[field_index] = sstr_new();
+    } else {
+        sstr_clear(c->frags[field_index]);
+    }
+    JSON_GEN_C_FIELD_MASK_CLEAR(c->dirty, field_index);
+    return c->frags[field_index];
+}
+
+static inline void json_cache_splice_(sstr_t out, const struct json_cache* c,
+                                      int field_index, int* first) {
+    sstr_t frag = c->frags[field_index];
+    if (frag == NULL || sstr_length(frag) == 0) {
+        return;
+    }
+    if (!*first) {
+        sstr_append_of_fast(out, ",", 1);
+    }
+    sstr_append(out, frag);
+    *first = 0;
+}
@@ -64,35 +64,35 @@ static inline MP_UNUSED uint64_t mp_load_be64(const unsigned char *p) {
 
 static MP_UNUSED void mp_pack_nil(sstr_t out) {
     unsigned char b = MP_NIL;
-    sstr_append_of(out, (const char *)&b, 1);
+    sstr_append_of_fast(out, (const char *)&b, 1);
 }
 
 static MP_UNUSED void mp_pack_bool(sstr_t out, int v) {
     unsigned char b = v ? MP_TRUE : MP_FALSE;
-    sstr_append_of(out, (const char *)&b, 1);
+    sstr_append_of_fast(out, (const char *)&b, 1);
 }
 
 static MP_UNUSED void mp_pack_uint(sstr_t out, uint64_t v) {
     unsigned char buf[9];
     if (v <= MP_FIXINT_MAX) {
         buf[0] = (unsigned char)v;
-        sstr_append_of(out, (const char *)buf, 1);
+        sstr_append_of_fast(out, (const char *)buf, 1);
     } else if (v <= 0xff) {
         buf[0] = MP_UINT8;
         buf[1] = (unsigned char)v;
-        sstr_append_of(out, (const char *)buf, 2);
+        sstr_append_of_fast(out, (const char *)buf, 2);
     } else if (v <= 0xffff) {
         buf[0] = MP_UINT16;
         mp_store_be16(buf + 1, (uint16_t)v);
-        sstr_append_of(out, (const char *)buf, 3);
+        sstr_append_of_fast(out, (const char *)buf, 3);
     } else if (v <= 0xffffffffULL) {
         buf[0] = MP_UINT32;
         mp_store_be32(buf + 1, (uint32_t)v);
-        sstr_append_of(out, (const char *)buf, 5);
+        sstr_append_of_fast(out, (const char *)buf, 5);
     } else {
         buf[0] = MP_UINT64;
         mp_store_be64(buf + 1, v);
-        sstr_append_of(out, (const char *)buf, 9);
+        sstr_append_of_fast(out, (const char *)buf, 9);
     }
 }
 
@@ -104,23 +104,23 @@ static MP_UNUSED void mp_pack_int(sstr_t out, int64_t v) {
     unsigned char buf[9];
     if (v >= -32) {
         buf[0] = (unsigned char)(v & 0xff);  /* negative fixint */
-        sstr_append_of(out, (const char *)buf, 1);
+        sstr_append_of_fast(out, (const char *)buf, 1);
     } else if (v >= -128) {
         buf[0] = MP_INT8;
         buf[1] = (unsigned char)(int8_t)v;
-        sstr_append_of(out, (const char *)buf, 2);
+        sstr_append_of_fast(out, (const char *)buf, 2);
     } else if (v >= -32768) {
         buf[0] = MP_INT16;
         mp_store_be16(buf + 1, (uint16_t)(int16_t)v);
-        sstr_append_of(out, (const char *)buf, 3);
+        sstr_append_of_fast(out, (const char *)buf, 3);
     } else if (v >= -2147483648LL) {
         buf[0] = MP_INT32;
         mp_store_be32(buf + 1, (uint32_t)(int32_t)v);
-        sstr_append_of(out, (const char *)buf, 5);
+        sstr_append_of_fast(out, (const char *)buf, 5);
     } else {
         buf[0] = MP_INT64;
         mp_store_be64(buf + 1, (uint64_t)v);
-        sstr_append_of(out, (const char *)buf, 9);
+        sstr_append_of_fast(out, (const char *)buf, 9);
     }
 }
 
@@ -130,7 +130,7 @@ static MP_UNUSED void mp_pack_float(sstr_t out, float v) {
     buf[0] = MP_FLOAT32;
     memcpy(&u, &v, 4);
     mp_store_be32(buf + 1, u);
-    sstr_append_of(out, (const char *)buf, 5);
+    sstr_append_of_fast(out, (const char *)buf, 5);
 }
 
 static MP_UNUSED void mp_pack_double(sstr_t out, double v) {
@@ -139,29 +139,31 @@ static MP_UNUSED void mp_pack_double(sstr_t out, double v) {
     buf[0] = MP_FLOAT64;
     memcpy(&u, &v, 8);
     mp_store_be64(buf + 1, u);
-    sstr_append_of(out, (const char *)buf, 9);
+    sstr_append_of_fast(out, (const char *)buf, 9);
 }
 
 static MP_UNUSED void mp_pack_str(sstr_t out, const char *s, uint32_t len) {
     unsigned char buf[5];
+    /* One reservation covers the header and the payload. */
+    (void)sstr_reserve_fast(out, 5 + (size_t)len);
     if (len <= MP_FIXSTR_MASK) {
         buf[0] = (unsigned char)(MP_FIXSTR | len);
-        sstr_append_of(out, (const char *)buf, 1);
+        sstr_append_of_fast(out, (const char *)buf, 1);
     } else if (len <= 0xff) {
         buf[0] = MP_STR8;
         buf[1] = (unsigned char)len;
-        sstr_append_of(out, (const char *)buf, 2);
+        sstr_append_of_fast(out, (const char *)buf, 2);
     } else if (len <= 0xffff) {
         buf[0] = MP_STR16;
         mp_store_be16(buf + 1, (uint16_t)len);
-        sstr_append_of(out, (const char *)buf, 3);
+        sstr_append_of_fast(out, (const char *)buf, 3);
     } else {
         buf[0] = MP_STR32;
         mp_store_be32(buf + 1, len);
-        sstr_append_of(out, (const char *)buf, 5);
+        sstr_append_of_fast(out, (const char *)buf, 5);
     }
     if (len > 0) {
-        sstr_append_of(out, s, len);
+        sstr_append_of_fast(out, s, len);
     }
 }
 
@@ -173,15 +175,15 @@ static MP_UNUSED void mp_pack_array_header(sstr_t out, uint32_t count) {
     unsigned char buf[5];
     if (count <= MP_FIXARRAY_MASK) {
         buf[0] = (unsigned char)(MP_FIXARRAY | count);
-        sstr_append_of(out, (const char *)buf, 1);
+        sstr_append_of_fast(out, (const char *)buf, 1);
     } else if (count <= 0xffff) {
         buf[0] = MP_ARRAY16;
         mp_store_be16(buf + 1, (uint16_t)count);
-        sstr_append_of(out, (const char *)buf, 3);
+        sstr_append_of_fast(out, (const char *)buf, 3);
     } else {
         buf[0] = MP_ARRAY32;
         mp_store_be32(buf + 1, count);
-        sstr_append_of(out, (const char *)buf, 5);
+        sstr_append_of_fast(out, (const char *)buf, 5);
     }
 }
 
@@ -189,15 +191,15 @@ static MP_UNUSED void mp_pack_map_header(sstr_t out, uint32_t count) {
     unsigned char buf[5];
     if (count <= MP_FIXMAP_MASK) {
         buf[0] = (unsigned char)(MP_FIXMAP | count);
-        sstr_append_of(out, (const char *)buf, 1);
+        sstr_append_of_fast(out, (const char *)buf, 1);
     } else if (count <= 0xffff) {
         buf[0] = MP_MAP16;
         mp_store_be16(buf + 1, (uint16_t)count);
-        sstr_append_of(out, (const char *)buf, 3);
+        sstr_append_of_fast(out, (const char *)buf, 3);
     } else {
         buf[0] = MP_MAP32;
         mp_store_be32(buf + 1, count);
-        sstr_append_of(out, (const char *)buf, 5);
+        sstr_append_of_fast(out, (const char *)buf, 5);
     }
 }
 
@@ -421,6 +423,35 @@ static MP_UNUSED int mp_unpack_str(struct mp_reader *r, const char **out, uint32
     return 0;
 }
 
+/* ── Borrowed strings ───────────────────────────────────────────────── */
+
+#if defined(_MSC_VER)
+  #define MP_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && \
+    !defined(__STDC_NO_THREADS__)
+  #define MP_THREAD_LOCAL _Thread_local
+#else
+  #define MP_THREAD_LOCAL __thread
+#endif
+
+/* Set by msgpack_unpack_<struct>_borrow() for the duration of the call:
+ * decoded sstr_t then point into the input instead of copying it. */
+static MP_THREAD_LOCAL int mp_borrow_strs;
+
+static inline MP_UNUSED void mp_store_sstr(sstr_t dst, const char *s,
+                                           uint32_t n) {
+    if (mp_borrow_strs) {
+        sstr_set_ref(dst, s, n);
+    } else {
+        sstr_clear_fast(dst);
+        sstr_append_of_fast(dst, s, n);
+    }
+}
+
+static inline MP_UNUSED sstr_t mp_new_sstr(const char *s, uint32_t n) {
+    return mp_borrow_strs ? sstr_ref(s, n) : sstr_of(s, n);
+}
+
 static MP_UNUSED int mp_unpack_array_header(struct mp_reader *r, uint32_t *count) {
     unsigned char b;
     const unsigned char *p;
@@ -593,6 +624,86 @@ static MP_UNUSED int mp_unpack_skip(struct mp_reader *r) {
     }
 }
 
+/* ── Framing ────────────────────────────────────────────────────────── */
+
+/*
+ * Scan *pending values starting at *pos without decoding them, to find
+ * where a message ends in a stream of back-to-back messages. Iterative,
+ * so nesting depth costs no stack. Returns 1 when every pending value is
+ * complete (*pos is then the end of the last one), 0 when data ends first
+ * and -1 on a byte that starts no MessagePack value. On 0, *pos and
+ * *pending are left at the last value boundary, so the scan resumes there
+ * once more bytes arrive.
+ */
+static MP_UNUSED int mp_frame_scan(const unsigned char *data, size_t len,
+                                   size_t *pos, uint64_t *pending) {
+    size_t p = *pos;
+    uint64_t n = *pending;
+    int rc = 1;
+
+    while (n > 0) {
+        size_t fixed = 0;  /* bytes after the type byte, no length */
+        size_t lw = 0;     /* width of the length after the type byte */
+        int kind = 0;      /* 0 scalar, 1 payload, 2 array, 3 map */
+        uint64_t count = 0;
+        unsigned char b;
+
+        if (p >= len) { rc = 0; break; }
+        b = data[p];
+        if (b <= MP_FIXINT_MAX || b >= MP_NEG_FIXINT) {
+            /* fixint */
+        } else if ((b & 0xe0) == MP_FIXSTR) {
+            kind = 1;
+            count = b & MP_FIXSTR_MASK;
+        } else if ((b & 0xf0) == MP_FIXARRAY) {
+            kind = 2;
+            count = b & MP_FIXARRAY_MASK;
+        } else if ((b & 0xf0) == MP_FIXMAP) {
+            kind = 3;
+            count = b & MP_FIXMAP_MASK;
+        } else if (b >= MP_FIXEXT1 && b <= MP_FIXEXT16) {
+            fixed = 1 + ((size_t)1 << (b - MP_FIXEXT1));
+        } else {
+            switch (b) {
+            case MP_NIL: case MP_FALSE: case MP_TRUE: break;
+            case MP_UINT8: case MP_INT8: fixed = 1; break;
+            case MP_UINT16: case MP_INT16: fixed = 2; break;
+            case MP_UINT32: case MP_INT32: case MP_FLOAT32: fixed = 4; break;
+            case MP_UINT64: case MP_INT64: case MP_FLOAT64: fixed = 8; break;
+            case MP_STR8: case MP_BIN8: lw = 1; kind = 1; break;
+            case MP_STR16: case MP_BIN16: lw = 2; kind = 1; break;
+            case MP_STR32: case MP_BIN32: lw = 4; kind = 1; break;
+            case MP_EXT8: lw = 1; fixed = 1; kind = 1; break;
+            case MP_EXT16: lw = 2; fixed = 1; kind = 1; break;
+            case MP_EXT32: lw = 4; fixed = 1; kind = 1; break;
+            case MP_ARRAY16: lw = 2; kind = 2; break;
+            case MP_ARRAY32: lw = 4; kind = 2; break;
+            case MP_MAP16: lw = 2; kind = 3; break;
+            case MP_MAP32: lw = 4; kind = 3; break;
+            default: return -1;  /* 0xc1, never used */
+            }
+        }
+
+        if (len - p < 1 + lw + fixed) { rc = 0; break; }
+        if (lw == 1) count = data[p + 1];
+        else if (lw == 2) count = mp_load_be16(data + p + 1);
+        else if (lw == 4) count = mp_load_be32(data + p + 1);
+
+        if (kind == 1) {
+            if (len - p - 1 - lw - fixed < count) { rc = 0; break; }
+            p += 1 + lw + fixed + (size_t)count;
+        } else {
+            p += 1 + lw + fixed;
+        }
+        n--;
+        if (kind == 2) n += count;
+        if (kind == 3) n += 2 * count;
+    }
+    *pos = p;
+    *pending = n;
+    return rc;
+}
+
 /* Generic numeric helpers */
 static MP_UNUSED int mp_unpack_number_as_int64(struct mp_reader *r, int64_t *out) {
     unsigned char b = r->data[r->pos];
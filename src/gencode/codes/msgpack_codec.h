@@ -61,6 +61,17 @@
 #define MP_MAP16         0xde
 #define MP_MAP32         0xdf
 
+/* Binary and extension types: not produced by the generated code, but a
+ * stream may carry them, so framing must know their sizes. */
+#define MP_BIN8          0xc4
+#define MP_BIN16         0xc5
+#define MP_BIN32         0xc6
+#define MP_EXT8          0xc7
+#define MP_EXT16         0xc8
+#define MP_EXT32         0xc9
+#define MP_FIXEXT1       0xd4  /* .. MP_FIXEXT16 0xd8: type + 1..16 bytes */
+#define MP_FIXEXT16      0xd8
+
 /* ── Read cursor ────────────────────────────────────────────────────── */
 
 struct mp_reader {
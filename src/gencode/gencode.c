@@ -120,6 +120,28 @@ static void gen_code_struct_header(struct struct_container* st, sstr_t header) {
             field = field->next;
             continue;
         }
+        if (field->is_inline_str) {
+            // @inline_str: a one-element array decays to an sstr_t, so the
+            // field is read and appended to like any other string field.
+            sstr_printf_append(header, "struct sstr_s %S[1];\n", field->name);
+            if (field->is_optional || field->is_nullable) {
+                sstr_printf_append(header, "    bool has_%S;\n", field->name);
+            }
+            field = field->next;
+            continue;
+        }
+        if (field->type == FIELD_TYPE_FIXSTR) {
+            // str<N>: the bytes and a trailing '\0', then their length;
+            // the runtime finds the length byte right after the array.
+            sstr_printf_append(header, "char %S[%d];\n    uint8_t %S_len;\n",
+                               field->name, field->str_size + 1,
+                               field->name);
+            if (field->is_optional || field->is_nullable) {
+                sstr_printf_append(header, "    bool has_%S;\n", field->name);
+            }
+            field = field->next;
+            continue;
+        }
         if (field->type == FIELD_TYPE_STRUCT) {
             sstr_append_cstr(header, "struct ");
         }
@@ -157,6 +179,10 @@ static void gen_code_struct_header(struct struct_container* st, sstr_t header) {
 
         field = field->next;
     }
+    if (st->is_cached) {
+        // @cached: serialized fragments, owned by the struct
+        sstr_append_cstr(header, "    struct json_cache* _json_cache;\n");
+    }
     sstr_append_cstr(header, "};\n\n");
 
     // init/uninit functions
@@ -226,15 +252,15 @@ static void gen_code_struct_header(struct struct_container* st, sstr_t header) {
     sstr_printf_append(
         header,
         "/**\n"
-        " * @brief Convert (marshal) struct %S to a not indented json "
-        "string.\n"
+        " * @brief Convert (marshal) struct %S to a compact json string.\n"
+        " * Same output as json_marshal_indent_%S(obj, 0, 0, out), without\n"
+        " * any of its indentation logic.\n"
         " * @param obj the struct object to be marshaled\n"
         " * @param out the output json string.\n"
         " */\n",
-        st->name);
+        st->name, st->name);
     sstr_printf_append(header,
-                       "#define json_marshal_%S(obj, out) "
-                       "json_marshal_indent_%S(obj, 0, 0, out)\n",
+                       "int json_marshal_%S(struct %S* obj, sstr_t out);\n",
                        st->name, st->name);
 
     sstr_printf_append(
@@ -257,15 +283,79 @@ static void gen_code_struct_header(struct struct_container* st, sstr_t header) {
     sstr_printf_append(
         header,
         "/**\n"
-        " * @brief Convert (marshal) array of struct %S to a (un)indented json "
+        " * @brief Convert (marshal) array of struct %S to a compact json "
         "string.\n"
         " * @param obj the struct object to be marshaled\n"
         " * @param out the output json string.\n"
         " */\n",
         st->name);
     sstr_printf_append(header,
-                       "#define json_marshal_array_%S(obj, len, out) "
-                       "json_marshal_array_indent_%S(obj, len, 0, 0, out)\n",
+                       "int json_marshal_array_%S(struct %S* obj, int len, "
+                       "sstr_t out);\n",
+                       st->name, st->name);
+    sstr_printf_append(
+        header,
+        "/**\n"
+        " * @brief Same output as json_marshal_array_%S(), with the array\n"
+        " * split into chunks that are marshaled on up to @p threads threads\n"
+        " * (<= 0: one per online CPU). Small arrays stay on the calling\n"
+        " * thread. Elements must not be modified while this runs.\n"
+        " * @return 0 on success, -1 on error.\n"
+        " */\n",
+        st->name);
+    sstr_printf_append(header,
+                       "int json_marshal_array_parallel_%S(struct %S* obj, "
+                       "int len, int threads, sstr_t out);\n",
+                       st->name, st->name);
+    sstr_printf_append(
+        header,
+        "/**\n"
+        " * @brief Same output as json_marshal_%S(), appended to @p io as\n"
+        " * scatter-gather pieces: long strings that need no escaping are\n"
+        " * referenced in place, everything else goes to io->buf. *obj must\n"
+        " * stay alive and unmodified until json_iov_vec() has been used.\n"
+        " * @return 0 on success, -1 on error.\n"
+        " */\n",
+        st->name);
+    sstr_printf_append(header,
+                       "int json_marshal_iov_%S(struct %S* obj, "
+                       "struct json_iov* io);\n",
+                       st->name, st->name);
+    sstr_printf_append(header,
+                       "/**\n"
+                       " * @brief json_marshal_array_%S() into a json_iov.\n"
+                       " */\n",
+                       st->name);
+    sstr_printf_append(header,
+                       "int json_marshal_array_iov_%S(struct %S* obj, "
+                       "int len, struct json_iov* io);\n",
+                       st->name, st->name);
+    sstr_printf_append(
+        header,
+        "/**\n"
+        " * @brief Stream a json array of struct %S to @p sink: call begin,\n"
+        " * append once per element as it is produced, then end, which also\n"
+        " * flushes the sink.\n"
+        " * @return 0 on success, -1 once the sink or a marshal failed.\n"
+        " */\n",
+        st->name);
+    sstr_printf_append(header,
+                       "int json_array_writer_begin_%S(struct json_array_writer* w, "
+                       "struct json_sink* sink);\n"
+                       "int json_array_writer_append_%S(struct json_array_writer* w, "
+                       "struct %S* obj);\n"
+                       "int json_array_writer_end_%S(struct json_array_writer* w);\n",
+                       st->name, st->name, st->name, st->name);
+    sstr_printf_append(
+        header,
+        "/**\n"
+        " * @brief Write @p obj to @p sink as one newline-terminated line of\n"
+        " * compact json (NDJSON). Call json_sink_flush() after the last one.\n"
+        " * @return 0 on success, -1 once the sink or a marshal failed.\n"
+        " */\n");
+    sstr_printf_append(header,
+                       "int json_ndjson_write_%S(struct json_sink* sink, "
+                       "struct %S* obj);\n",
                        st->name, st->name);
 
     sstr_printf_append(header,
@@ -279,6 +369,29 @@ static void gen_code_struct_header(struct struct_container* st, sstr_t header) {
     sstr_printf_append(header,
                        "int json_unmarshal_%S(sstr_t in, struct %S* obj);\n",
                        st->name, st->name);
+    sstr_printf_append(header,
+                       "/**\n"
+                       " * @brief Same as json_unmarshal_%S(), but reports a "
+                       "failure in @p err\n"
+                       " * (may be NULL) without building an error message.\n"
+                       " */\n",
+                       st->name);
+    sstr_printf_append(header,
+                       "int json_unmarshal_%S_ex(sstr_t in, struct %S* obj, "
+                       "struct json_error* err);\n",
+                       st->name, st->name);
+    sstr_printf_append(header,
+                       "/**\n"
+                       " * @brief Same as json_unmarshal_%S_ex(), but enforces "
+                       "@p limits\n"
+                       " * (NULL uses the json_gen_c_set_limits() default).\n"
+                       " */\n",
+                       st->name);
+    sstr_printf_append(header,
+                       "int json_unmarshal_%S_limited(sstr_t in, struct %S* "
+                       "obj, const struct json_limits* limits, "
+                       "struct json_error* err);\n",
+                       st->name, st->name);
     sstr_printf_append(header,
                        "/**\n"
                        " * @brief Convert (unmarshal) a json string to an "
@@ -290,7 +403,32 @@ static void gen_code_struct_header(struct struct_container* st, sstr_t header) {
                        st->name);
     sstr_printf_append(header,
                        "int json_unmarshal_array_%S(sstr_t in, struct %S** "
-                       "obj, int* len);\n\n",
+                       "obj, int* len);\n",
+                       st->name, st->name);
+    sstr_printf_append(header,
+                       "/**\n"
+                       " * @brief Same as json_unmarshal_array_%S(), but "
+                       "reports a failure in\n"
+                       " * @p err (may be NULL) without building an error "
+                       "message.\n"
+                       " */\n",
+                       st->name);
+    sstr_printf_append(header,
+                       "int json_unmarshal_array_%S_ex(sstr_t in, struct %S** "
+                       "obj, int* len, struct json_error* err);\n",
+                       st->name, st->name);
+    sstr_printf_append(header,
+                       "/**\n"
+                       " * @brief Same as json_unmarshal_array_%S_ex(), but "
+                       "enforces @p limits\n"
+                       " * (NULL uses the json_gen_c_set_limits() default).\n"
+                       " */\n",
+                       st->name);
+    sstr_printf_append(header,
+                       "int json_unmarshal_array_%S_limited(sstr_t in, "
+                       "struct %S** obj, int* len, "
+                       "const struct json_limits* limits, "
+                       "struct json_error* err);\n\n",
                        st->name, st->name);
 }
 
@@ -337,11 +475,32 @@ static void gen_code_struct_selective_unmarshal_header(
 static void gen_code_struct_unmarshal_struct(struct struct_container* st,
                                              sstr_t source) {
     sstr_printf_append(source,
-                       "int json_unmarshal_%S(sstr_t in, struct %S* obj) {\n",
+                       "int json_unmarshal_%S(sstr_t in, struct %S* obj) {\n"
+                       "    return json_unmarshal_%S_ex(in, obj, NULL);\n"
+                       "}\n\n",
+                       st->name, st->name, st->name);
+    sstr_printf_append(source,
+                       "int json_unmarshal_%S_ex(sstr_t in, struct %S* obj, "
+                       "struct json_error* err) {\n"
+                       "    return json_unmarshal_%S_limited(in, obj, NULL, "
+                       "err);\n"
+                       "}\n\n",
+                       st->name, st->name, st->name);
+    sstr_printf_append(source,
+                       "int json_unmarshal_%S_limited(sstr_t in, struct %S* "
+                       "obj, const struct json_limits* limits, "
+                       "struct json_error* err) {\n",
                        st->name, st->name);
     sstr_append_cstr(source,
                      "    struct json_pos pos;\n"
-                     "    pos.col = 0; pos.line = 0; pos.offset = 0;\n"
+                     "    struct json_limit_state lim;\n"
+                     "    SSTR_LOCAL(txt);\n"
+                     "    int r = json_decode_begin_(in, &pos, &lim, limits, "
+                     "err, txt);\n"
+                     "    if (r != 0) {\n"
+                     "        sstr_clear(txt);\n"
+                     "        return r;\n"
+                     "    }\n"
                      "    struct json_parse_param param;\n"
                      "    param.instance_ptr = obj;\n"
                       "    param.field_name = \"\";\n"
@@ -351,19 +510,20 @@ static void gen_code_struct_unmarshal_struct(struct struct_container* st,
                       "    param.field_mask = NULL;\n"
                       "    param.field_mask_word_count = 0;\n"
                       "    param.nested_masks = NULL;\n"
-                      "    param.nested_mask_count = 0;\n");
+                      "    param.nested_mask_count = 0;\n"
+                      "    param.merge = 0;\n");
     sstr_printf_append(source, "    param.struct_name = \"%S\";\n", st->name);
     sstr_append_cstr(
         source,
-        "    sstr_t txt = sstr_new();\n"
-        "    int r = json_unmarshal_struct_internal(in, &pos, &param, txt);\n"
-        "    if (r < 0) {\n"
+        "    r = json_unmarshal_struct_internal(in, &pos, &param, txt);\n"
+        "    if (r < 0 && err == NULL) {\n"
         "#ifdef JSON_DEBUG\n"
         "        printf(\"ERROR: %s\", sstr_cstr(txt));\n"
         "#endif\n");
     sstr_append_cstr(source,
                      "    }\n"
-                     "    sstr_free(txt);\n"
+                     "    sstr_clear(txt);\n"
+                     "    json_error_end_(err, &pos, r);\n"
                      "    return r;\n"
                      "}\n\n");
 }
@@ -372,13 +532,35 @@ static void gen_code_struct_unmarshal_array_struct(struct struct_container* st,
                                                    sstr_t source) {
     sstr_printf_append(source,
                        "int json_unmarshal_array_%S(sstr_t in, struct %S** "
-                       "obj, int *len) {\n",
+                       "obj, int *len) {\n"
+                       "    return json_unmarshal_array_%S_ex(in, obj, len, "
+                       "NULL);\n"
+                       "}\n\n",
+                       st->name, st->name, st->name);
+    sstr_printf_append(source,
+                       "int json_unmarshal_array_%S_ex(sstr_t in, struct %S** "
+                       "obj, int *len, struct json_error* err) {\n"
+                       "    return json_unmarshal_array_%S_limited(in, obj, "
+                       "len, NULL, err);\n"
+                       "}\n\n",
+                       st->name, st->name, st->name);
+    sstr_printf_append(source,
+                       "int json_unmarshal_array_%S_limited(sstr_t in, "
+                       "struct %S** obj, int *len, "
+                       "const struct json_limits* limits, "
+                       "struct json_error* err) {\n",
                        st->name, st->name);
     sstr_append_cstr(source,
                      "    *len = 0;\n"
-                     "    sstr_t txt = sstr_new();\n"
+                     "    SSTR_LOCAL(txt);\n"
                      "    struct json_pos pos;\n"
-                     "    pos.col = 0; pos.line = 0; pos.offset = 0;\n"
+                     "    struct json_limit_state lim;\n"
+                     "    int r = json_decode_begin_(in, &pos, &lim, limits, "
+                     "err, txt);\n"
+                     "    if (r != 0) {\n"
+                     "        sstr_clear(txt);\n"
+                     "        return r;\n"
+                     "    }\n"
                      "    struct json_parse_param ar_param;\n"
                       "    ar_param.instance_ptr = obj;\n"
                       "    ar_param.in_array = 1;\n"
@@ -387,17 +569,20 @@ static void gen_code_struct_unmarshal_array_struct(struct struct_container* st,
                       "    ar_param.field_mask = NULL;\n"
                       "    ar_param.field_mask_word_count = 0;\n"
                       "    ar_param.nested_masks = NULL;\n"
-                      "    ar_param.nested_mask_count = 0;\n");
+                      "    ar_param.nested_mask_count = 0;\n"
+                      "    ar_param.merge = 0;\n");
     sstr_printf_append(source, "    ar_param.struct_name = \"%S\";\n",
                        st->name);
     sstr_append_cstr(source,
                      "    ar_param.field_name=\"\";\n"
-                     "    int r = json_unmarshal_array_internal(in, &pos, "
+                     "    r = json_unmarshal_array_internal(in, &pos, "
                      "&ar_param, len, txt);\n");
     sstr_printf_append(source,
                        "    if (r < 0) {\n"
                        "#ifdef JSON_DEBUG\n"
-                       "        printf(\"ERROR: %%s\", sstr_cstr(txt));\n"
+                       "        if (err == NULL) {\n"
+                       "            printf(\"ERROR: %%s\", sstr_cstr(txt));\n"
+                       "        }\n"
                        "#endif\n"
                        "        int i;\n"
                        "        for (i = 0; i < *len; ++i) {\n"
@@ -409,7 +594,8 @@ static void gen_code_struct_unmarshal_array_struct(struct struct_container* st,
                        "    }\n",
                        st->name);
 
-    sstr_append_cstr(source, "    sstr_free(txt);\n");
+    sstr_append_cstr(source, "    sstr_clear(txt);\n");
+    sstr_append_cstr(source, "    json_error_end_(err, &pos, r);\n");
     sstr_append_cstr(source, "    return r;\n");
     sstr_append_cstr(source, "}\n\n");
 }
@@ -430,7 +616,14 @@ static void gen_code_struct_unmarshal_selected_struct(
         st->name);
     sstr_append_cstr(source,
                      "    struct json_pos pos;\n"
-                     "    pos.col = 0; pos.line = 0; pos.offset = 0;\n"
+                     "    struct json_limit_state lim;\n"
+                     "    SSTR_LOCAL(txt);\n"
+                     "    int r = json_decode_begin_(in, &pos, &lim, NULL, "
+                     "NULL, txt);\n"
+                     "    if (r != 0) {\n"
+                     "        sstr_clear(txt);\n"
+                     "        return r;\n"
+                     "    }\n"
                      "    struct json_parse_param param;\n"
                      "    param.instance_ptr = obj;\n"
                      "    param.field_name = \"\";\n"
@@ -440,12 +633,12 @@ static void gen_code_struct_unmarshal_selected_struct(
                      "    param.field_mask = field_mask;\n"
                      "    param.field_mask_word_count = field_mask_word_count;\n"
                      "    param.nested_masks = NULL;\n"
-                     "    param.nested_mask_count = 0;\n");
+                     "    param.nested_mask_count = 0;\n"
+                      "    param.merge = 0;\n");
     sstr_printf_append(source, "    param.struct_name = \"%S\";\n", st->name);
     sstr_append_cstr(
         source,
-        "    sstr_t txt = sstr_new();\n"
-        "    int r = json_unmarshal_struct_internal(in, &pos, &param, txt);\n"
+        "    r = json_unmarshal_struct_internal(in, &pos, &param, txt);\n"
         "    if (r < 0) {\n"
         "#ifdef JSON_DEBUG\n"
         "        printf(\"ERROR: %s\", sstr_cstr(txt));\n"
@@ -453,7 +646,7 @@ static void gen_code_struct_unmarshal_selected_struct(
     sstr_printf_append(source, "        %S_clear(obj);\n", st->name);
     sstr_append_cstr(source,
                      "    }\n"
-                     "    sstr_free(txt);\n"
+                     "    sstr_clear(txt);\n"
                      "    return r;\n"
                      "}\n\n");
 }
@@ -495,7 +688,14 @@ static void gen_code_struct_unmarshal_selected_deep_struct(
         st->name);
     sstr_append_cstr(source,
                      "    struct json_pos pos;\n"
-                     "    pos.col = 0; pos.line = 0; pos.offset = 0;\n"
+                     "    struct json_limit_state lim;\n"
+                     "    SSTR_LOCAL(txt);\n"
+                     "    int r = json_decode_begin_(in, &pos, &lim, NULL, "
+                     "NULL, txt);\n"
+                     "    if (r != 0) {\n"
+                     "        sstr_clear(txt);\n"
+                     "        return r;\n"
+                     "    }\n"
                      "    struct json_parse_param param;\n"
                      "    param.instance_ptr = obj;\n"
                      "    param.field_name = \"\";\n"
@@ -505,12 +705,12 @@ static void gen_code_struct_unmarshal_selected_deep_struct(
                      "    param.field_mask = field_mask;\n"
                      "    param.field_mask_word_count = field_mask_word_count;\n"
                      "    param.nested_masks = nested_masks;\n"
-                     "    param.nested_mask_count = nested_mask_count;\n");
+                     "    param.nested_mask_count = nested_mask_count;\n"
+                      "    param.merge = 0;\n");
     sstr_printf_append(source, "    param.struct_name = \"%S\";\n", st->name);
     sstr_append_cstr(
         source,
-        "    sstr_t txt = sstr_new();\n"
-        "    int r = json_unmarshal_struct_internal(in, &pos, &param, txt);\n"
+        "    r = json_unmarshal_struct_internal(in, &pos, &param, txt);\n"
         "    if (r < 0) {\n"
         "#ifdef JSON_DEBUG\n"
         "        printf(\"ERROR: %s\", sstr_cstr(txt));\n"
@@ -518,11 +718,177 @@ static void gen_code_struct_unmarshal_selected_deep_struct(
     sstr_printf_append(source, "        %S_clear(obj);\n", st->name);
     sstr_append_cstr(source,
                      "    }\n"
-                     "    sstr_free(txt);\n"
+                     "    sstr_clear(txt);\n"
                      "    return r;\n"
                      "}\n\n");
 }
 
+static void gen_code_struct_marshal_selected_header(
+    struct struct_container* st, sstr_t header) {
+    sstr_printf_append(
+        header,
+        "/**\n"
+        " * @brief Marshal only the chosen fields of struct %S to a compact\n"
+        " * json string. Unselected fields are omitted from the output, as\n"
+        " * are optional fields that are not set.\n"
+        " *\n"
+        " * @param obj the struct object to be marshaled.\n"
+        " * @param field_mask field-mask words populated with\n"
+        " *        JSON_GEN_C_FIELD_MASK_SET().\n"
+        " * @param field_mask_word_count number of words in field_mask.\n"
+        " * @param out the output json string.\n"
+        " * @return 0 on success, -1 if field_mask is NULL or too short.\n"
+        " */\n",
+        st->name);
+    sstr_printf_append(header,
+                       "int json_marshal_selected_%S(struct %S* obj, "
+                       "const uint64_t* field_mask, int field_mask_word_count, "
+                       "sstr_t out);\n",
+                       st->name, st->name);
+    sstr_printf_append(
+        header,
+        "/**\n"
+        " * @brief Like json_marshal_selected_%S, with sub-masks for struct\n"
+        " * fields via json_nested_mask. A sub-mask on a struct array field\n"
+        " * applies to every element; struct fields without a sub-mask are\n"
+        " * written in full.\n"
+        " */\n",
+        st->name);
+    sstr_printf_append(header,
+                       "int json_marshal_selected_%S_deep(struct %S* obj, "
+                       "const uint64_t* field_mask, int field_mask_word_count, "
+                       "const struct json_nested_mask* nested_masks, "
+                       "int nested_mask_count, sstr_t out);\n\n",
+                       st->name, st->name);
+}
+
+static void gen_code_struct_marshal_selected_struct(
+    struct struct_container* st, sstr_t source) {
+    sstr_printf_append(source,
+                       "int json_marshal_selected_%S(struct %S* obj, "
+                       "const uint64_t* field_mask, int field_mask_word_count, "
+                       "sstr_t out) {\n"
+                       "    return json_marshal_selected_%S_deep(obj, field_mask, "
+                       "field_mask_word_count, NULL, 0, out);\n"
+                       "}\n\n",
+                       st->name, st->name, st->name);
+}
+
+static void gen_code_struct_diff_header(struct struct_container* st,
+                                        sstr_t header) {
+    sstr_printf_append(
+        header,
+        "/**\n"
+        " * @brief Write an RFC 7386 merge patch that turns *old_obj into\n"
+        " * *new_obj: only changed fields, nested structs as nested patches,\n"
+        " * and null for optional/nullable fields that were unset.\n"
+        " * @param out the output json string, or NULL to only compare.\n"
+        " * @return the number of fields in the patch (0 when equal), or -1.\n"
+        " */\n");
+    sstr_printf_append(header,
+                       "int json_marshal_diff_%S(const struct %S* old_obj, "
+                       "const struct %S* new_obj, sstr_t out);\n",
+                       st->name, st->name, st->name);
+    sstr_printf_append(
+        header,
+        "/**\n"
+        " * @brief Apply an RFC 7386 merge patch to *obj in place. Members\n"
+        " * present in the patch replace fields, nested objects are merged\n"
+        " * and null unsets an optional or nullable field; other fields are\n"
+        " * not touched. On error obj may be partially patched but is valid.\n"
+        " * @return 0 on success, negative on error.\n"
+        " */\n");
+    sstr_printf_append(header,
+                       "int json_apply_patch_%S(struct %S* obj, sstr_t patch);\n\n",
+                       st->name, st->name);
+}
+
+// C type of the value argument of a @cached struct's field setter
+static const char* field_setter_c_type(struct struct_field* field) {
+    if (field->type == FIELD_TYPE_ENUM) {
+        return "int";
+    }
+    if (field->type == FIELD_TYPE_FIXSTR) {
+        return "const char*";
+    }
+    return sstr_cstr(field->type_name);
+}
+
+static void gen_code_struct_cache_header(struct struct_container* st,
+                                         sstr_t header) {
+    struct struct_field* field;
+    if (!st->is_cached) {
+        return;
+    }
+    sstr_printf_append(
+        header,
+        "/**\n"
+        " * @brief Mark fields of a @cached struct %S as changed, so that\n"
+        " * json_marshal_%S() re-encodes them instead of reusing their cached\n"
+        " * json. Needed after writing a field directly rather than through\n"
+        " * a %S_set_<field>() setter, including edits inside arrays, maps,\n"
+        " * oneofs and nested structs that are not @cached themselves.\n"
+        " * @param field_index a %S_FIELD_<field> constant, or -1 for all.\n"
+        " */\n",
+        st->name, st->name, st->name, st->name);
+    sstr_printf_append(header,
+                       "int %S_mark_dirty(struct %S* obj, int field_index);\n",
+                       st->name, st->name);
+    for (field = st->fields; field; field = field->next) {
+        if (field->is_array || field->type == FIELD_TYPE_MAP ||
+            field->type == FIELD_TYPE_STRUCT ||
+            field->type == FIELD_TYPE_ONEOF) {
+            continue;
+        }
+        if (field->type == FIELD_TYPE_SSTR) {
+            sstr_printf_append(header,
+                "/** @brief Set %S.%S and mark it dirty; takes ownership of value. */\n",
+                st->name, field->name);
+        } else if (field->type == FIELD_TYPE_FIXSTR) {
+            sstr_printf_append(header,
+                "/** @brief Copy value into %S.%S and mark it dirty; -1 if it is "
+                "longer than %d bytes. */\n",
+                st->name, field->name, field->str_size);
+        } else {
+            sstr_printf_append(header,
+                "/** @brief Set %S.%S and mark it dirty. */\n",
+                st->name, field->name);
+        }
+        sstr_printf_append(header, "int %S_set_%S(struct %S* obj, %s value);\n",
+                           st->name, field->name, st->name,
+                           field_setter_c_type(field));
+    }
+    sstr_append_cstr(header, "\n");
+}
+
+static void gen_code_struct_validate_header(struct struct_container* st,
+                                            sstr_t header) {
+    sstr_printf_append(
+        header,
+        "/**\n"
+        " * @brief Check that @p in is a valid json encoding of struct %S\n"
+        " * without decoding it. It accepts exactly what json_unmarshal_%S()\n"
+        " * accepts: field types, integer ranges, fixed-size array bounds and\n"
+        " * oneof tags are checked, and nothing is allocated.\n"
+        " * @return 0 if valid; JSON_GEN_ERROR_PARSE for malformed input or a\n"
+        " * value of the wrong type, JSON_GEN_ERROR_BOUNDS for an out-of-range\n"
+        " * value or an overlong fixed array.\n"
+        " */\n",
+        st->name, st->name);
+    sstr_printf_append(header,
+                       "int json_validate_%S(const char* in, size_t len);\n\n",
+                       st->name);
+}
+
+static void gen_code_struct_validate_struct(struct struct_container* st,
+                                            sstr_t source) {
+    sstr_printf_append(source,
+                       "int json_validate_%S(const char* in, size_t len) {\n"
+                       "    return json_validate_struct_(in, len, \"%S\");\n"
+                       "}\n\n",
+                       st->name, st->name);
+}
+
 // Table-driven numeric marshal: maps FIELD_TYPE_* to the sstr_append function,
 // optional cast, and whether precision ("-1") is appended.
 struct marshal_numeric_info {
@@ -531,7 +897,7 @@ struct marshal_numeric_info {
     int has_precision;      // 1 for float/double
 };
 
-#define FIELD_TYPE_MAX 17
+#define FIELD_TYPE_MAX 18
 static const struct marshal_numeric_info marshal_numeric_table[FIELD_TYPE_MAX + 1] = {
     [FIELD_TYPE_INT]    = { "sstr_append_int_str",    "", 0 },
     [FIELD_TYPE_LONG]   = { "sstr_append_long_str",   "", 0 },
@@ -551,6 +917,7 @@ static const struct marshal_numeric_info marshal_numeric_table[FIELD_TYPE_MAX +
     [FIELD_TYPE_UINT32] = { "sstr_append_uint32_str", "",       0 },
     [FIELD_TYPE_UINT64] = { "sstr_append_uint64_str", "",       0 },
     [FIELD_TYPE_ONEOF]  = { NULL, NULL, 0 },
+    [FIELD_TYPE_FIXSTR] = { NULL, NULL, 0 },
 };
 
 // Emit a numeric marshal line: "<indent><fn>(out, <cast><expr>[, -1]);\n"
@@ -575,7 +942,7 @@ static int emit_numeric_marshal(sstr_t source, int field_type,
 // to form the value expression (e.g. ".entries[_mk].value").
 static void gen_marshal_map_value(struct struct_field* field,
                                   const char* field_name,
-                                  const char* val_suffix,
+                                  const char* val_suffix, int compact,
                                   sstr_t source) {
     char expr[256];
     snprintf(expr, sizeof(expr), "obj->%s%s", field_name, val_suffix);
@@ -586,22 +953,28 @@ static void gen_marshal_map_value(struct struct_field* field,
     switch (field->map_value_type) {
         case FIELD_TYPE_SSTR:
             sstr_printf_append(source,
-                "            sstr_append_of(out, \"\\\"\", 1);\n"
+                "            sstr_append_of_fast(out, \"\\\"\", 1);\n"
                 "            sstr_json_escape_string_append(out, %s);\n"
-                "            sstr_append_of(out, \"\\\"\", 1);\n",
+                "            sstr_append_of_fast(out, \"\\\"\", 1);\n",
                 expr);
             break;
         case FIELD_TYPE_STRUCT:
-            sstr_printf_append(source,
-                "            json_marshal_indent_%S(&%s, indent, curindent, out);\n",
-                field->map_value_type_name, expr);
+            if (compact) {
+                sstr_printf_append(source,
+                    "            json_marshal_%S(&%s, out);\n",
+                    field->map_value_type_name, expr);
+            } else {
+                sstr_printf_append(source,
+                    "            json_marshal_indent_%S(&%s, indent, curindent, out);\n",
+                    field->map_value_type_name, expr);
+            }
             break;
         case FIELD_TYPE_ENUM:
             sstr_printf_append(source,
                 "            if (%s >= 0 && %s < %S_enum_count) {\n"
-                "                sstr_append_of(out, \"\\\"\", 1);\n"
+                "                sstr_append_of_fast(out, \"\\\"\", 1);\n"
                 "                sstr_append_cstr(out, %S_enum_strings[%s]);\n"
-                "                sstr_append_of(out, \"\\\"\", 1);\n"
+                "                sstr_append_of_fast(out, \"\\\"\", 1);\n"
                 "            } else {\n"
                 "                sstr_append_int_str(out, %s);\n"
                 "            }\n",
@@ -628,8 +1001,6 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
                        "int json_marshal_indent_%S(struct %S* obj, int indent, "
                        "int curindent, sstr_t out) {\n",
                        st->name, st->name);
-    sstr_append_cstr(source,
-                     "    char tmp_cstr[64];\n    (void)tmp_cstr;\n");
     if (has_optional) {
         sstr_append_cstr(source, "    int _first = 1;\n");
     }
@@ -638,7 +1009,7 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
                      "sstr_cstr(out)[sstr_length(out)-1] != ':') {\n"
                      "        sstr_append_indent(out, curindent);\n"
                      "    }\n"
-                     "    sstr_append_of(out, \"{\", 1);\n");
+                     "    sstr_append_of_fast(out, \"{\", 1);\n");
     if (!has_optional) {
         sstr_append_cstr(source,
                          "    sstr_append_of_if(out, \"\\n\", 1, indent);\n");
@@ -655,12 +1026,12 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
                     "    if (obj->has_%S) {\n", field->name);
             }
             sstr_append_cstr(source,
-                "    if (!_first) { sstr_append_of(out, \",\", 1); }\n"
+                "    if (!_first) { sstr_append_of_fast(out, \",\", 1); }\n"
                 "    sstr_append_of_if(out, \"\\n\", 1, indent);\n");
             sstr_append_cstr(source,
                 "    sstr_append_indent(out, curindent);\n");
             sstr_printf_append(source,
-                "    sstr_append_of(out, \"\\\"%S\\\":\", %d);\n",
+                "    sstr_append_of_fast(out, \"\\\"%S\\\":\", %d);\n",
                 JSON_KEY(field),
                 (int)(sstr_length(JSON_KEY(field)) + 3));
         } else if (is_first_field) {
@@ -668,7 +1039,7 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
             sstr_append_cstr(source,
                 "    if (indent) { sstr_append_indent(out, curindent); }\n");
             sstr_printf_append(source,
-                "    sstr_append_of(out, \"\\\"%S\\\":\", %d);\n",
+                "    sstr_append_of_fast(out, \"\\\"%S\\\":\", %d);\n",
                 JSON_KEY(field),
                 (int)(sstr_length(JSON_KEY(field)) + 3));
         } else {
@@ -677,11 +1048,11 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
             int key_len = (int)sstr_length(JSON_KEY(field)) + 3;
             sstr_printf_append(source,
                 "    if (indent) {\n"
-                "        sstr_append_of(out, \",\\n\", 2);\n"
+                "        sstr_append_of_fast(out, \",\\n\", 2);\n"
                 "        sstr_append_indent(out, curindent);\n"
-                "        sstr_append_of(out, \"\\\"%S\\\":\", %d);\n"
+                "        sstr_append_of_fast(out, \"\\\"%S\\\":\", %d);\n"
                 "    } else {\n"
-                "        sstr_append_of(out, \",\\\"%S\\\":\", %d);\n"
+                "        sstr_append_of_fast(out, \",\\\"%S\\\":\", %d);\n"
                 "    }\n",
                 JSON_KEY(field), key_len,
                 JSON_KEY(field), key_len + 1);
@@ -691,7 +1062,7 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
         if (has_optional && field->is_nullable && !field->is_optional) {
             sstr_printf_append(source,
                 "    if (!obj->has_%S) {\n"
-                "        sstr_append_of(out, \"null\", 4);\n"
+                "        sstr_append_of_fast(out, \"null\", 4);\n"
                 "    } else {\n", field->name);
         }
 
@@ -700,14 +1071,14 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
             if (field->is_array && field->array_size == 0) {
                 // array of maps: output [{ ... }, { ... }]
                 sstr_append_cstr(source,
-                    "    sstr_append_of(out, \"[\", 1);\n"
+                    "    sstr_append_of_fast(out, \"[\", 1);\n"
                     "    sstr_append_of_if(out, \"\\n\", 1, indent);\n"
                     "    curindent += indent;\n"
                     "    { int _aj;\n");
                 sstr_printf_append(source,
                     "    for (_aj = 0; _aj < obj->%S_len; _aj++) {\n"
                     "        sstr_append_indent(out, curindent);\n"
-                    "        sstr_append_of(out, \"{\", 1);\n"
+                    "        sstr_append_of_fast(out, \"{\", 1);\n"
                     "        sstr_append_of_if(out, \"\\n\", 1, indent);\n"
                     "        curindent += indent;\n"
                     "        { int _mk;\n",
@@ -715,59 +1086,59 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
                 sstr_printf_append(source,
                     "        for (_mk = 0; _mk < obj->%S[_aj].len; _mk++) {\n"
                     "            sstr_append_indent(out, curindent);\n"
-                    "            sstr_append_of(out, \"\\\"\", 1);\n",
+                    "            sstr_append_of_fast(out, \"\\\"\", 1);\n",
                     field->name);
                 sstr_printf_append(source,
                     "            sstr_json_escape_string_append(out, obj->%S[_aj].entries[_mk].key);\n"
-                    "            sstr_append_of(out, \"\\\":\", 2);\n",
+                    "            sstr_append_of_fast(out, \"\\\":\", 2);\n",
                     field->name);
                 // emit value marshal
                 gen_marshal_map_value(field,
-                    sstr_cstr(field->name), "[_aj].entries[_mk].value",
+                    sstr_cstr(field->name), "[_aj].entries[_mk].value", 0,
                     source);
                 sstr_printf_append(source,
-                    "            if (_mk < obj->%S[_aj].len - 1) sstr_append_of(out, \",\", 1);\n"
+                    "            if (_mk < obj->%S[_aj].len - 1) sstr_append_of_fast(out, \",\", 1);\n"
                     "            sstr_append_of_if(out, \"\\n\", 1, indent);\n"
                     "        } }\n"
                     "        curindent -= indent;\n"
                     "        sstr_append_indent(out, curindent);\n"
-                    "        sstr_append_of(out, \"}\", 1);\n",
+                    "        sstr_append_of_fast(out, \"}\", 1);\n",
                     field->name);
                 sstr_printf_append(source,
-                    "        if (_aj < obj->%S_len - 1) sstr_append_of(out, \",\", 1);\n"
+                    "        if (_aj < obj->%S_len - 1) sstr_append_of_fast(out, \",\", 1);\n"
                     "        sstr_append_of_if(out, \"\\n\", 1, indent);\n"
                     "    } }\n"
                     "    curindent -= indent;\n"
                     "    sstr_append_indent(out, curindent);\n"
-                    "    sstr_append_of(out, \"]\", 1);\n",
+                    "    sstr_append_of_fast(out, \"]\", 1);\n",
                     field->name);
             } else {
                 // scalar map: output { "k1":v1, "k2":v2 }
                 sstr_append_cstr(source,
-                    "    sstr_append_of(out, \"{\", 1);\n"
+                    "    sstr_append_of_fast(out, \"{\", 1);\n"
                     "    sstr_append_of_if(out, \"\\n\", 1, indent);\n"
                     "    curindent += indent;\n"
                     "    { int _mk;\n");
                 sstr_printf_append(source,
                     "    for (_mk = 0; _mk < obj->%S.len; _mk++) {\n"
                     "        sstr_append_indent(out, curindent);\n"
-                    "        sstr_append_of(out, \"\\\"\", 1);\n",
+                    "        sstr_append_of_fast(out, \"\\\"\", 1);\n",
                     field->name);
                 sstr_printf_append(source,
                     "        sstr_json_escape_string_append(out, obj->%S.entries[_mk].key);\n"
-                    "        sstr_append_of(out, \"\\\":\", 2);\n",
+                    "        sstr_append_of_fast(out, \"\\\":\", 2);\n",
                     field->name);
                 // emit value marshal
                 gen_marshal_map_value(field,
-                    sstr_cstr(field->name), ".entries[_mk].value",
+                    sstr_cstr(field->name), ".entries[_mk].value", 0,
                     source);
                 sstr_printf_append(source,
-                    "        if (_mk < obj->%S.len - 1) sstr_append_of(out, \",\", 1);\n"
+                    "        if (_mk < obj->%S.len - 1) sstr_append_of_fast(out, \",\", 1);\n"
                     "        sstr_append_of_if(out, \"\\n\", 1, indent);\n"
                     "    } }\n"
                     "    curindent -= indent;\n"
                     "    sstr_append_indent(out, curindent);\n"
-                    "    sstr_append_of(out, \"}\", 1);\n",
+                    "    sstr_append_of_fast(out, \"}\", 1);\n",
                     field->name);
             }
             if (has_optional) {
@@ -779,11 +1150,11 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
                     sstr_append_cstr(source, "    }\n");
                 }
             } else {
-                if (field->next != NULL) {
-                    sstr_append_cstr(source, "    sstr_append_of(out, \",\", 1);\n");
+                /* the comma is merged into the next field's key emit */
+                if (field->next == NULL) {
+                    sstr_append_cstr(source,
+                        "    sstr_append_of_if(out, \"\\n\", 1, indent);\n");
                 }
-                sstr_append_cstr(source,
-                    "    sstr_append_of_if(out, \"\\n\", 1, indent);\n");
             }
             continue;
         }
@@ -794,7 +1165,7 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
                 sstr_append_cstr(source,
                     "    {\n"
                     "        int _ei;\n"
-                    "        sstr_append_of(out, \"[\", 1);\n"
+                    "        sstr_append_of_fast(out, \"[\", 1);\n"
                     "        sstr_append_of_if(out, \"\\n\", 1, indent);\n"
                     "        curindent += indent;\n");
                 if (field->array_size > 0) {
@@ -809,9 +1180,9 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
                 sstr_printf_append(source,
                     "            sstr_append_indent(out, curindent);\n"
                     "            if (obj->%S[_ei] >= 0 && obj->%S[_ei] < %S_enum_count) {\n"
-                    "                sstr_append_of(out, \"\\\"\", 1);\n"
+                    "                sstr_append_of_fast(out, \"\\\"\", 1);\n"
                     "                sstr_append_cstr(out, %S_enum_strings[obj->%S[_ei]]);\n"
-                    "                sstr_append_of(out, \"\\\"\", 1);\n"
+                    "                sstr_append_of_fast(out, \"\\\"\", 1);\n"
                     "            } else {\n"
                     "                sstr_append_int_str(out, obj->%S[_ei]);\n"
                     "            }\n",
@@ -828,14 +1199,14 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
                         field->name);
                 }
                 sstr_append_cstr(source,
-                    "                sstr_append_of(out, \",\", 1);\n"
+                    "                sstr_append_of_fast(out, \",\", 1);\n"
                     "            }\n"
                     "            sstr_append_of_if(out, \"\\n\", 1, indent);\n"
                     "        }\n");
                 sstr_append_cstr(source,
                     "        curindent -= indent;\n"
                     "        sstr_append_indent(out, curindent);\n"
-                    "        sstr_append_of(out, \"]\", 1);\n"
+                    "        sstr_append_of_fast(out, \"]\", 1);\n"
                     "    }\n");
             } else if (field->array_size > 0) {
                 // fixed-size non-enum array
@@ -865,79 +1236,881 @@ static void gen_code_struct_marshal_struct(struct struct_container* st,
             }
             continue;
         }
-        if (field->type == FIELD_TYPE_BOOL) {
-            sstr_printf_append(source, "    if (obj->%S) {\n", field->name);
-            sstr_append_cstr(source,
-                             "        sstr_append_of(out, \"true\", 4);\n"
-                             "    } else {\n"
-                             "        sstr_append_of(out, \"false\", 5);\n"
-                             "    }\n");
-        } else {
-            char expr[256];
-            snprintf(expr, sizeof(expr), "obj->%s", sstr_cstr(field->name));
-            if (!emit_numeric_marshal(source, field->type, "    ", expr)) {
-                switch (field->type) {
-                    case FIELD_TYPE_SSTR:
-                        sstr_printf_append(
-                            source,
-                            "    sstr_append_of(out, \"\\\"\", 1);\n"
-                            "    sstr_json_escape_string_append(out, %s);\n"
-                            "    sstr_append_of(out, \"\\\"\", 1);\n",
-                            expr);
-                        break;
-                    case FIELD_TYPE_STRUCT:
-                    case FIELD_TYPE_ONEOF:
-                        sstr_printf_append(source,
-                                           "    json_marshal_indent_%S(&%s, "
-                                           "indent, curindent, out);\n",
-                                           field->type_name, expr);
-                        break;
-                    case FIELD_TYPE_ENUM:
-                        sstr_printf_append(source,
-                                           "    if (%s >= 0 && %s < %S_enum_count) {\n"
-                                           "        sstr_append_of(out, \"\\\"\", 1);\n"
-                                           "        sstr_append_cstr(out, %S_enum_strings[%s]);\n"
-                                           "        sstr_append_of(out, \"\\\"\", 1);\n"
-                                           "    } else {\n"
-                                           "        sstr_append_int_str(out, %s);\n"
-                                           "    }\n",
-                                           expr, expr, field->type_name,
-                                           field->type_name, expr, expr);
-                        break;
-                    default:
-                        break;
-                }
-            }
+        if (field->type == FIELD_TYPE_BOOL) {
+            sstr_printf_append(source, "    if (obj->%S) {\n", field->name);
+            sstr_append_cstr(source,
+                             "        sstr_append_of_fast(out, \"true\", 4);\n"
+                             "    } else {\n"
+                             "        sstr_append_of_fast(out, \"false\", 5);\n"
+                             "    }\n");
+        } else {
+            char expr[256];
+            snprintf(expr, sizeof(expr), "obj->%s", sstr_cstr(field->name));
+            if (!emit_numeric_marshal(source, field->type, "    ", expr)) {
+                switch (field->type) {
+                    case FIELD_TYPE_SSTR:
+                        sstr_printf_append(
+                            source,
+                            "    sstr_append_of_fast(out, \"\\\"\", 1);\n"
+                            "    sstr_json_escape_string_append(out, %s);\n"
+                            "    sstr_append_of_fast(out, \"\\\"\", 1);\n",
+                            expr);
+                        break;
+                    case FIELD_TYPE_FIXSTR:
+                        sstr_printf_append(
+                            source,
+                            "    sstr_append_of_fast(out, \"\\\"\", 1);\n"
+                            "    sstr_json_escape_append_of(out, %s, %s_len);\n"
+                            "    sstr_append_of_fast(out, \"\\\"\", 1);\n",
+                            expr, expr);
+                        break;
+                    case FIELD_TYPE_STRUCT:
+                    case FIELD_TYPE_ONEOF:
+                        sstr_printf_append(source,
+                                           "    json_marshal_indent_%S(&%s, "
+                                           "indent, curindent, out);\n",
+                                           field->type_name, expr);
+                        break;
+                    case FIELD_TYPE_ENUM:
+                        sstr_printf_append(source,
+                                           "    if (%s >= 0 && %s < %S_enum_count) {\n"
+                                           "        sstr_append_of_fast(out, \"\\\"\", 1);\n"
+                                           "        sstr_append_cstr(out, %S_enum_strings[%s]);\n"
+                                           "        sstr_append_of_fast(out, \"\\\"\", 1);\n"
+                                           "    } else {\n"
+                                           "        sstr_append_int_str(out, %s);\n"
+                                           "    }\n",
+                                           expr, expr, field->type_name,
+                                           field->type_name, expr, expr);
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+
+        if (has_optional) {
+            if (field->is_nullable && !field->is_optional) {
+                sstr_append_cstr(source, "    }\n");
+            }
+            sstr_append_cstr(source, "    _first = 0;\n");
+            if (field->is_optional) {
+                sstr_append_cstr(source, "    }\n");
+            }
+        } else {
+            /* For non-optional structs the comma is merged into the
+               start-of-next-field emit above; only the trailing newline
+               after the last field is needed here. */
+            if (field->next == NULL) {
+                sstr_append_cstr(source,
+                    "    sstr_append_of_if(out, \"\\n\", 1, indent);\n");
+            }
+        }
+    }
+    if (has_optional) {
+        sstr_append_cstr(source,
+                         "    sstr_append_of_if(out, \"\\n\", 1, indent);\n");
+    }
+    sstr_append_cstr(source, "    curindent -= indent;\n");
+
+    sstr_append_cstr(source,
+                     "    sstr_append_indent(out, curindent);\n"
+                     "    sstr_append_of_fast(out, \"}\", 1);\n"
+                     "    return 0;\n}\n\n");
+}
+
+// Append `s` to a generated C string literal, escaping quotes.
+static void append_c_literal(sstr_t lit, const char* s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            sstr_append_of(lit, "\\", 1);
+        }
+        sstr_append_of(lit, s, 1);
+    }
+}
+
+// A non-array sstr_t or str<N> field: its json value is always a string.
+static int is_string_field(struct struct_field* field) {
+    return (field->type == FIELD_TYPE_SSTR ||
+            field->type == FIELD_TYPE_FIXSTR) &&
+           !field->is_array;
+}
+
+// Which function gen_code_struct_marshal_compact() generates.
+enum compact_mode {
+    COMPACT_PLAIN,     // json_marshal_<S>()
+    COMPACT_SELECTED,  // json_marshal_selected_<S>_deep()
+    COMPACT_IOV,       // json_marshal_iov_<S>()
+};
+
+// Compact json for the value of one field of *obj, written to out. A
+// string's opening quote is left out when quote_open is set (the caller
+// merged it into the key literal), and its closing quote when quote_close
+// is set (the caller merges it into the next literal). In COMPACT_IOV mode
+// strings go through json_iov_string_() and structs recurse into
+// json_marshal_iov_<T>().
+static void gen_compact_field_value(struct struct_container* st,
+                                    struct struct_field* field,
+                                    int quote_open, int quote_close,
+                                    enum compact_mode mode, sstr_t source) {
+    if (field->type == FIELD_TYPE_MAP) {
+        const char* idx = field->is_array ? "[_aj]" : "";
+        char val_suffix[64];
+        snprintf(val_suffix, sizeof(val_suffix), "%s.entries[_mk].value",
+                 idx);
+        if (field->is_array) {
+            sstr_printf_append(source,
+                "    sstr_append_of_fast(out, \"[\", 1);\n"
+                "    { int _aj;\n"
+                "    for (_aj = 0; _aj < obj->%S_len; _aj++) {\n"
+                "        if (_aj) sstr_append_of_fast(out, \",\", 1);\n",
+                field->name);
+        }
+        sstr_printf_append(source,
+            "    sstr_append_of_fast(out, \"{\", 1);\n"
+            "    { int _mk;\n"
+            "    for (_mk = 0; _mk < obj->%S%s.len; _mk++) {\n"
+            "        sstr_append_of_fast(out, _mk ? \",\\\"\" : \"\\\"\", _mk ? 2 : 1);\n"
+            "        sstr_json_escape_string_append(out, obj->%S%s.entries[_mk].key);\n"
+            "        sstr_append_of_fast(out, \"\\\":\", 2);\n",
+            field->name, idx, field->name, idx);
+        gen_marshal_map_value(field, sstr_cstr(field->name), val_suffix, 1,
+                              source);
+        sstr_append_cstr(source,
+            "    } }\n"
+            "    sstr_append_of_fast(out, \"}\", 1);\n");
+        if (field->is_array) {
+            sstr_append_cstr(source,
+                "    } }\n"
+                "    sstr_append_of_fast(out, \"]\", 1);\n");
+        }
+    } else if (field->is_array && field->type == FIELD_TYPE_ENUM) {
+        sstr_append_cstr(source,
+            "    {\n"
+            "        int _ei;\n"
+            "        sstr_append_of_fast(out, \"[\", 1);\n");
+        if (field->array_size > 0) {
+            sstr_printf_append(source,
+                "        for (_ei = 0; _ei < %d; _ei++) {\n",
+                field->array_size);
+        } else {
+            sstr_printf_append(source,
+                "        for (_ei = 0; _ei < obj->%S_len; _ei++) {\n",
+                field->name);
+        }
+        sstr_printf_append(source,
+            "            if (_ei) sstr_append_of_fast(out, \",\", 1);\n"
+            "            if (obj->%S[_ei] >= 0 && obj->%S[_ei] < %S_enum_count) {\n"
+            "                sstr_append_of_fast(out, \"\\\"\", 1);\n"
+            "                sstr_append_cstr(out, %S_enum_strings[obj->%S[_ei]]);\n"
+            "                sstr_append_of_fast(out, \"\\\"\", 1);\n"
+            "            } else {\n"
+            "                sstr_append_int_str(out, obj->%S[_ei]);\n"
+            "            }\n"
+            "        }\n"
+            "        sstr_append_of_fast(out, \"]\", 1);\n"
+            "    }\n",
+            field->name, field->name, field->type_name,
+            field->type_name, field->name, field->name);
+    } else if (mode == COMPACT_IOV && field->is_array &&
+               (field->type == FIELD_TYPE_STRUCT ||
+                field->type == FIELD_TYPE_SSTR)) {
+        char len_expr[256];
+        if (field->array_size > 0) {
+            snprintf(len_expr, sizeof(len_expr), "%d", field->array_size);
+        } else {
+            snprintf(len_expr, sizeof(len_expr), "obj->%s_len",
+                     sstr_cstr(field->name));
+        }
+        sstr_printf_append(source,
+            "    {\n"
+            "        int _ii;\n"
+            "        sstr_append_of_fast(out, \"[\", 1);\n"
+            "        for (_ii = 0; _ii < %s; _ii++) {\n"
+            "            if (_ii) sstr_append_of_fast(out, \",\", 1);\n",
+            len_expr);
+        if (field->type == FIELD_TYPE_STRUCT) {
+            sstr_printf_append(source,
+                "            if (json_marshal_iov_%S(&obj->%S[_ii], io) != 0) {\n"
+                "                return -1;\n"
+                "            }\n",
+                field->type_name, field->name);
+        } else {
+            sstr_printf_append(source,
+                "            sstr_append_of_fast(out, \"\\\"\", 1);\n"
+                "            if (json_iov_string_(io, out, obj->%S[_ii]) != 0) {\n"
+                "                return -1;\n"
+                "            }\n"
+                "            sstr_append_of_fast(out, \"\\\"\", 1);\n",
+                field->name);
+        }
+        sstr_append_cstr(source,
+            "        }\n"
+            "        sstr_append_of_fast(out, \"]\", 1);\n"
+            "    }\n");
+    } else if (mode == COMPACT_SELECTED && field->type == FIELD_TYPE_STRUCT) {
+        sstr_printf_append(source,
+            "    {\n"
+            "        const struct json_nested_mask* _nm = json_nested_mask_find_(\n"
+            "            nested_masks, nested_mask_count, %S_FIELD_%S);\n",
+            st->name, field->name);
+        if (field->is_array) {
+            char len_expr[256];
+            if (field->array_size > 0) {
+                snprintf(len_expr, sizeof(len_expr), "%d",
+                         field->array_size);
+            } else {
+                snprintf(len_expr, sizeof(len_expr), "obj->%s_len",
+                         sstr_cstr(field->name));
+            }
+            // the sub-mask projects every element of the array
+            sstr_printf_append(source,
+                "        if (_nm == NULL) {\n"
+                "            json_marshal_array_%S(obj->%S, %s, out);\n"
+                "        } else {\n"
+                "            int _si;\n"
+                "            sstr_append_of_fast(out, \"[\", 1);\n"
+                "            for (_si = 0; _si < %s; _si++) {\n"
+                "                if (_si) sstr_append_of_fast(out, \",\", 1);\n"
+                "                if (json_marshal_selected_%S_deep(&obj->%S[_si], "
+                "_nm->mask, _nm->mask_word_count, _nm->sub_masks, "
+                "_nm->sub_mask_count, out) != 0) {\n"
+                "                    return -1;\n"
+                "                }\n"
+                "            }\n"
+                "            sstr_append_of_fast(out, \"]\", 1);\n"
+                "        }\n",
+                field->type_name, field->name, len_expr, len_expr,
+                field->type_name, field->name);
+        } else {
+            sstr_printf_append(source,
+                "        if (_nm == NULL) {\n"
+                "            json_marshal_%S(&obj->%S, out);\n"
+                "        } else if (json_marshal_selected_%S_deep(&obj->%S, "
+                "_nm->mask, _nm->mask_word_count, _nm->sub_masks, "
+                "_nm->sub_mask_count, out) != 0) {\n"
+                "            return -1;\n"
+                "        }\n",
+                field->type_name, field->name, field->type_name,
+                field->name);
+        }
+        sstr_append_cstr(source, "    }\n");
+    } else if (field->is_array) {
+        if (field->array_size > 0) {
+            sstr_printf_append(source,
+                "    json_marshal_array_%S(obj->%S, %d, out);\n",
+                field->type_name, field->name, field->array_size);
+        } else {
+            sstr_printf_append(source,
+                "    json_marshal_array_%S(obj->%S, obj->%S_len, out);\n",
+                field->type_name, field->name, field->name);
+        }
+    } else if (field->type == FIELD_TYPE_BOOL) {
+        sstr_printf_append(source,
+            "    sstr_append_of_fast(out, obj->%S ? \"true\" : \"false\", "
+            "obj->%S ? 4 : 5);\n",
+            field->name, field->name);
+    } else {
+        char expr[256];
+        snprintf(expr, sizeof(expr), "obj->%s", sstr_cstr(field->name));
+        if (!emit_numeric_marshal(source, field->type, "    ", expr)) {
+            switch (field->type) {
+                case FIELD_TYPE_SSTR:
+                    if (!quote_open) {
+                        sstr_append_cstr(source,
+                            "    sstr_append_of_fast(out, \"\\\"\", 1);\n");
+                    }
+                    if (mode == COMPACT_IOV) {
+                        sstr_printf_append(source,
+                            "    if (json_iov_string_(io, out, %s) != 0) {\n"
+                            "        return -1;\n"
+                            "    }\n",
+                            expr);
+                    } else {
+                        sstr_printf_append(source,
+                            "    sstr_json_escape_string_append(out, %s);\n",
+                            expr);
+                    }
+                    if (!quote_close) {
+                        sstr_append_cstr(source,
+                            "    sstr_append_of_fast(out, \"\\\"\", 1);\n");
+                    }
+                    break;
+                case FIELD_TYPE_FIXSTR:
+                    // at most 255 bytes: always escaped inline, even for iov
+                    if (!quote_open) {
+                        sstr_append_cstr(source,
+                            "    sstr_append_of_fast(out, \"\\\"\", 1);\n");
+                    }
+                    sstr_printf_append(source,
+                        "    sstr_json_escape_append_of(out, %s, %s_len);\n",
+                        expr, expr);
+                    if (!quote_close) {
+                        sstr_append_cstr(source,
+                            "    sstr_append_of_fast(out, \"\\\"\", 1);\n");
+                    }
+                    break;
+                case FIELD_TYPE_STRUCT:
+                    if (mode == COMPACT_IOV) {
+                        sstr_printf_append(source,
+                            "    if (json_marshal_iov_%S(&%s, io) != 0) {\n"
+                            "        return -1;\n"
+                            "    }\n",
+                            field->type_name, expr);
+                        break;
+                    }
+                    // fall through
+                case FIELD_TYPE_ONEOF:
+                    sstr_printf_append(source,
+                        "    json_marshal_%S(&%s, out);\n",
+                        field->type_name, expr);
+                    break;
+                case FIELD_TYPE_ENUM:
+                    sstr_printf_append(source,
+                        "    if (%s >= 0 && %s < %S_enum_count) {\n"
+                        "        sstr_append_of_fast(out, \"\\\"\", 1);\n"
+                        "        sstr_append_cstr(out, %S_enum_strings[%s]);\n"
+                        "        sstr_append_of_fast(out, \"\\\"\", 1);\n"
+                        "    } else {\n"
+                        "        sstr_append_int_str(out, %s);\n"
+                        "    }\n",
+                        expr, expr, field->type_name,
+                        field->type_name, expr, expr);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+// Compact marshal: no indentation logic. The punctuation before each value
+// ('{' or ',', the quoted key, ':' and the opening quote of a string) is
+// one constant append; it only depends on a runtime flag while every
+// earlier field is optional. The closing quote of an always-written string
+// is carried into that append of the next field, or into the final '}'. COMPACT_SELECTED generates
+// json_marshal_selected_<S>_deep() instead, where every field is
+// conditional on the field mask and struct fields may recurse with a
+// nested mask. COMPACT_IOV generates json_marshal_iov_<S>(), which writes
+// to io->buf and references long strings in place.
+static void gen_code_struct_marshal_compact(struct struct_container* st,
+                                            enum compact_mode mode,
+                                            sstr_t source) {
+    struct struct_field* field;
+    int selected = mode == COMPACT_SELECTED;
+    int open_pending = 1;   // '{' not written yet
+    int quote_pending = 0;  // closing '"' of the last string not written yet
+    int always = 0;         // some earlier field is always written
+    int need_first = 0;
+    int min_size = 1;  // '}'
+
+    // Dry run of the separator choice below.
+    for (field = st->fields; field; field = field->next) {
+        int cond = field->is_optional || selected;
+        if (!cond) {
+            // '{' or ',', the quoted key, ':' and one byte of value
+            min_size += (int)sstr_length(JSON_KEY(field)) + 5;
+        }
+        if (open_pending && !cond) {
+            open_pending = 0;
+        } else if (!always) {
+            open_pending = 0;
+            need_first = 1;
+        }
+        always |= !cond;
+    }
+    open_pending = 1;
+    always = 0;
+
+    if (selected) {
+        sstr_printf_append(source,
+            "int json_marshal_selected_%S_deep(struct %S* obj, "
+            "const uint64_t* field_mask, int field_mask_word_count, "
+            "const struct json_nested_mask* nested_masks, "
+            "int nested_mask_count, sstr_t out) {\n"
+            "    if (field_mask == NULL || field_mask_word_count < "
+            "%S_FIELD_MASK_WORD_COUNT) {\n"
+            "        return -1;\n"
+            "    }\n"
+            "    (void)nested_masks;\n"
+            "    (void)nested_mask_count;\n",
+            st->name, st->name, st->name);
+    } else if (mode == COMPACT_IOV) {
+        sstr_printf_append(source,
+                           "int json_marshal_iov_%S(struct %S* obj, "
+                           "struct json_iov* io) {\n"
+                           "    sstr_t out = io->buf;\n",
+                           st->name, st->name);
+    } else {
+        sstr_printf_append(source,
+                           "int json_marshal_%S(struct %S* obj, sstr_t out) {\n",
+                           st->name, st->name);
+    }
+    if (need_first) {
+        sstr_append_cstr(source, "    int _first = 1;\n");
+    }
+    if (min_size > 1) {
+        // the always-written punctuation and keys in one reservation
+        sstr_printf_append(source, "    (void)sstr_reserve_fast(out, %d);\n",
+                           min_size);
+    }
+
+    for (field = st->fields; field; field = field->next) {
+        sstr_t prefix = sstr_new();
+        int runtime_sep = 0;
+        int quote_open = is_string_field(field) && !field->is_nullable;
+        int cond = field->is_optional || selected;
+        int quote_close = quote_open && !cond;
+
+        if (cond) {
+            if (quote_pending) {
+                sstr_append_cstr(source, "    sstr_append_of_fast(out, \"\\\"\", 1);\n");
+                quote_pending = 0;
+            }
+            if (open_pending) {
+                sstr_append_cstr(source, "    sstr_append_of_fast(out, \"{\", 1);\n");
+                open_pending = 0;
+            }
+            if (selected) {
+                sstr_printf_append(source,
+                    "    if (JSON_GEN_C_FIELD_MASK_TEST(field_mask, %S_FIELD_%S)%s",
+                    st->name, field->name,
+                    field->is_optional ? " && obj->has_" : ") {\n");
+                if (field->is_optional) {
+                    sstr_printf_append(source, "%S) {\n", field->name);
+                }
+            } else {
+                sstr_printf_append(source, "    if (obj->has_%S) {\n",
+                                   field->name);
+            }
+        }
+        if (quote_pending) {
+            sstr_append_cstr(prefix, "\"");
+            quote_pending = 0;
+        }
+        if (open_pending) {
+            sstr_append_cstr(prefix, "{");
+            open_pending = 0;
+        } else if (always) {
+            sstr_append_cstr(prefix, ",");
+        } else {
+            sstr_append_cstr(prefix, ",");
+            runtime_sep = 1;
+        }
+        sstr_append_cstr(prefix, "\"");
+        sstr_append(prefix, JSON_KEY(field));
+        sstr_append_cstr(prefix, "\":");
+        if (quote_open) {
+            sstr_append_cstr(prefix, "\"");
+        }
+        {
+            sstr_t lit = sstr_new();
+            append_c_literal(lit, sstr_cstr(prefix));
+            if (runtime_sep) {
+                // _first is 0 or 1: skip the leading ',' on the first field.
+                sstr_printf_append(source,
+                    "    sstr_append_of_fast(out, &\"%S\"[_first], %d - _first);\n",
+                    lit, (int)sstr_length(prefix));
+            } else {
+                sstr_printf_append(source, "    sstr_append_of_fast(out, \"%S\", %d);\n",
+                                   lit, (int)sstr_length(prefix));
+            }
+            sstr_free(lit);
+        }
+        sstr_free(prefix);
+
+        if (field->is_nullable && !field->is_optional) {
+            sstr_printf_append(source,
+                "    if (!obj->has_%S) {\n"
+                "        sstr_append_of_fast(out, \"null\", 4);\n"
+                "    } else {\n", field->name);
+        }
+
+        gen_compact_field_value(st, field, quote_open, quote_close, mode,
+                                source);
+        quote_pending = quote_close;
+
+        if (field->is_nullable && !field->is_optional) {
+            sstr_append_cstr(source, "    }\n");
+        }
+        if (runtime_sep && cond) {
+            sstr_append_cstr(source, "    _first = 0;\n");
+        }
+        if (cond) {
+            sstr_append_cstr(source, "    }\n");
+        } else {
+            always = 1;
+        }
+    }
+    sstr_printf_append(source,
+                       "    sstr_append_of_fast(out, \"%s%s}\", %d);\n"
+                       "    return 0;\n}\n\n",
+                       quote_pending ? "\\\"" : "", open_pending ? "{" : "",
+                       1 + quote_pending + open_pending);
+}
+
+static int field_is_cached_struct(struct hash_map* struct_map,
+                                  struct struct_field* field) {
+    void* v = NULL;
+    if (field->type != FIELD_TYPE_STRUCT ||
+        hash_map_find(struct_map, field->type_name, &v) != HASH_MAP_OK) {
+        return 0;
+    }
+    return ((struct struct_container*)v)->is_cached;
+}
+
+// json_marshal_<S>() of a @cached struct. Each field's '"key":value' is
+// kept in obj->_json_cache and only re-encoded while its dirty bit is
+// set; clean fragments are spliced into out as they are. Fields whose
+// type is a @cached struct are not kept here: their own json_marshal_<T>()
+// splices their fragments, so edits below them need no marking up here.
+static void gen_code_struct_marshal_cached(struct struct_container* st,
+                                           struct hash_map* struct_map,
+                                           sstr_t source) {
+    struct struct_field* field;
+    sstr_printf_append(source,
+        "int json_marshal_%S(struct %S* obj, sstr_t out) {\n"
+        "    struct json_cache* _c = obj->_json_cache;\n"
+        "    sstr_t _out = out;\n"
+        "    int _first = 1;\n"
+        "    if (_c == NULL) {\n"
+        "        _c = obj->_json_cache = json_cache_new_(%S_FIELD_COUNT);\n"
+        "        if (_c == NULL) {\n"
+        "            return -1;\n"
+        "        }\n"
+        "    }\n"
+        "    sstr_append_of_fast(_out, \"{\", 1);\n",
+        st->name, st->name, st->name);
+    if (st->fields == NULL) {
+        sstr_append_cstr(source, "    (void)_first;\n");
+    }
+
+    for (field = st->fields; field; field = field->next) {
+        int live = field_is_cached_struct(struct_map, field);
+        int quote_open = is_string_field(field) && !field->is_nullable;
+        sstr_t prefix = sstr_new();
+        sstr_t lit = sstr_new();
+
+        // a fragment leaves out the ','; json_cache_splice_() adds it
+        sstr_append_cstr(prefix, live ? ",\"" : "\"");
+        sstr_append(prefix, JSON_KEY(field));
+        sstr_append_cstr(prefix, "\":");
+        if (quote_open) {
+            sstr_append_cstr(prefix, "\"");
+        }
+        append_c_literal(lit, sstr_cstr(prefix));
+
+        if (live) {
+            sstr_append_cstr(source, "    out = _out;\n");
+        } else {
+            sstr_printf_append(source,
+                "    if ((out = json_cache_refill_(_c, %S_FIELD_%S)) != NULL) {\n",
+                st->name, field->name);
+        }
+        if (field->is_optional) {
+            sstr_printf_append(source, "    if (obj->has_%S) {\n",
+                               field->name);
+        }
+        if (live) {
+            sstr_printf_append(source,
+                "    sstr_append_of_fast(out, &\"%S\"[_first], %d - _first);\n"
+                "    _first = 0;\n",
+                lit, (int)sstr_length(prefix));
+        } else {
+            sstr_printf_append(source, "    sstr_append_of_fast(out, \"%S\", %d);\n",
+                               lit, (int)sstr_length(prefix));
+        }
+        if (field->is_nullable && !field->is_optional) {
+            sstr_printf_append(source,
+                "    if (!obj->has_%S) {\n"
+                "        sstr_append_of_fast(out, \"null\", 4);\n"
+                "    } else {\n", field->name);
+        }
+        gen_compact_field_value(st, field, quote_open, 0, COMPACT_PLAIN, source);
+        if (field->is_nullable && !field->is_optional) {
+            sstr_append_cstr(source, "    }\n");
+        }
+        if (field->is_optional) {
+            sstr_append_cstr(source, "    }\n");
+        }
+        if (!live) {
+            sstr_printf_append(source,
+                "    }\n"
+                "    json_cache_splice_(_out, _c, %S_FIELD_%S, &_first);\n",
+                st->name, field->name);
+        }
+        sstr_free(lit);
+        sstr_free(prefix);
+    }
+    sstr_append_cstr(source,
+        "    sstr_append_of_fast(_out, \"}\", 1);\n"
+        "    return 0;\n}\n\n");
+}
+
+// <S>_mark_dirty() and the <S>_set_<field>() setters of a @cached struct.
+static void gen_code_struct_cache_setters(struct struct_container* st,
+                                          sstr_t source) {
+    struct struct_field* field;
+    if (!st->is_cached) {
+        return;
+    }
+    sstr_printf_append(source,
+        "int %S_mark_dirty(struct %S* obj, int field_index) {\n"
+        "    if (obj == NULL) {\n"
+        "        return -1;\n"
+        "    }\n"
+        "    json_cache_mark_(obj->_json_cache, field_index);\n"
+        "    return 0;\n"
+        "}\n\n",
+        st->name, st->name);
+    for (field = st->fields; field; field = field->next) {
+        if (field->is_array || field->type == FIELD_TYPE_MAP ||
+            field->type == FIELD_TYPE_STRUCT ||
+            field->type == FIELD_TYPE_ONEOF) {
+            continue;
+        }
+        sstr_printf_append(source,
+            "int %S_set_%S(struct %S* obj, %s value) {\n"
+            "    if (obj == NULL) {\n"
+            "        return -1;\n"
+            "    }\n",
+            st->name, field->name, st->name, field_setter_c_type(field));
+        if (field->type == FIELD_TYPE_FIXSTR) {
+            sstr_printf_append(source,
+                "    {\n"
+                "        size_t _n = strlen(value);\n"
+                "        if (_n > %d) {\n"
+                "            return -1;\n"
+                "        }\n"
+                "        memmove(obj->%S, value, _n + 1);\n"
+                "        obj->%S_len = (uint8_t)_n;\n"
+                "    }\n",
+                field->str_size, field->name, field->name);
+        } else if (field->is_inline_str) {
+            sstr_printf_append(source,
+                "    if (value != (sstr_t)obj->%S) {\n"
+                "        sstr_clear_fast(obj->%S);\n"
+                "        sstr_append(obj->%S, value);\n"
+                "        sstr_free(value);\n"
+                "    }\n",
+                field->name, field->name, field->name);
+        } else if (field->type == FIELD_TYPE_SSTR) {
+            sstr_printf_append(source,
+                "    if (obj->%S != value) {\n"
+                "        sstr_free(obj->%S);\n"
+                "    }\n",
+                field->name, field->name);
+        }
+        if (!field->is_inline_str && field->type != FIELD_TYPE_FIXSTR) {
+            sstr_printf_append(source, "    obj->%S = value;\n", field->name);
+        }
+        if (field->is_optional || field->is_nullable) {
+            sstr_printf_append(source, "    obj->has_%S = true;\n",
+                               field->name);
         }
+        sstr_printf_append(source,
+            "    json_cache_mark_(obj->_json_cache, %S_FIELD_%S);\n"
+            "    return 0;\n"
+            "}\n\n",
+            st->name, field->name);
+    }
+}
 
-        if (has_optional) {
-            if (field->is_nullable && !field->is_optional) {
-                sstr_append_cstr(source, "    }\n");
-            }
-            sstr_append_cstr(source, "    _first = 0;\n");
-            if (field->is_optional) {
-                sstr_append_cstr(source, "    }\n");
-            }
+// Statements that set _ne when field differs between *old and *obj. Maps
+// and oneofs are compared by their compact json, everything else directly.
+static void gen_diff_field_ne(struct struct_container* st,
+                              struct struct_field* field, sstr_t source) {
+    char len_old[256], len_new[256];
+    const char* name = sstr_cstr(field->name);
+
+    if (field->array_size > 0) {
+        snprintf(len_old, sizeof(len_old), "%d", field->array_size);
+        snprintf(len_new, sizeof(len_new), "%d", field->array_size);
+    } else {
+        snprintf(len_old, sizeof(len_old), "old->%s_len", name);
+        snprintf(len_new, sizeof(len_new), "obj->%s_len", name);
+    }
+
+    if (field->type == FIELD_TYPE_MAP || field->type == FIELD_TYPE_ONEOF) {
+        sstr_append_cstr(source,
+            "    {\n"
+            "        sstr_t _out = out;\n"
+            "        sstr_t _va = sstr_new();\n"
+            "        sstr_t _vb = sstr_new();\n"
+            "        obj = old;\n"
+            "        out = _va;\n");
+        gen_compact_field_value(st, field, 0, 0, COMPACT_PLAIN, source);
+        sstr_printf_append(source,
+            "        obj = (struct %S*)new_obj;\n"
+            "        out = _vb;\n",
+            st->name);
+        gen_compact_field_value(st, field, 0, 0, COMPACT_PLAIN, source);
+        sstr_append_cstr(source,
+            "        out = _out;\n"
+            "        _ne = sstr_compare(_va, _vb) != 0;\n"
+            "        sstr_free(_va);\n"
+            "        sstr_free(_vb);\n"
+            "    }\n");
+    } else if (field->type == FIELD_TYPE_STRUCT && field->is_array) {
+        sstr_printf_append(source,
+            "    _ne = %s != %s;\n"
+            "    { int _i;\n"
+            "    for (_i = 0; !_ne && _i < %s; _i++) {\n"
+            "        _ne = json_marshal_diff_%S(&old->%s[_i], &obj->%s[_i], "
+            "NULL) > 0;\n"
+            "    } }\n",
+            len_old, len_new, len_new, field->type_name, name, name);
+    } else if (field->type == FIELD_TYPE_STRUCT) {
+        sstr_printf_append(source,
+            "    _ne = json_marshal_diff_%S(&old->%s, &obj->%s, NULL) > 0;\n",
+            field->type_name, name, name);
+    } else if (field->type == FIELD_TYPE_SSTR && field->is_array) {
+        sstr_printf_append(source,
+            "    _ne = json_diff_sstr_array_ne_(old->%s, %s, obj->%s, %s);\n",
+            name, len_old, name, len_new);
+    } else if (field->type == FIELD_TYPE_SSTR) {
+        sstr_printf_append(source,
+            "    _ne = json_diff_sstr_ne_(old->%s, obj->%s);\n", name, name);
+    } else if (field->type == FIELD_TYPE_FIXSTR) {
+        sstr_printf_append(source,
+            "    _ne = old->%s_len != obj->%s_len ||\n"
+            "          memcmp(old->%s, obj->%s, obj->%s_len) != 0;\n",
+            name, name, name, name, name);
+    } else if (field->is_array) {
+        sstr_printf_append(source,
+            "    _ne = json_diff_mem_ne_(old->%s, %s, obj->%s, %s, "
+            "sizeof(obj->%s[0]));\n",
+            name, len_old, name, len_new, name);
+    } else {
+        sstr_printf_append(source, "    _ne = old->%s != obj->%s;\n", name,
+                           name);
+    }
+}
+
+// json_marshal_diff_<S>(): an RFC 7386 merge patch from *old_obj to
+// *new_obj. With out == NULL nothing is written, which the generated code
+// itself uses to compare nested structs.
+static void gen_code_struct_marshal_diff(struct struct_container* st,
+                                         sstr_t source) {
+    struct struct_field* field;
+
+    sstr_printf_append(source,
+        "int json_marshal_diff_%S(const struct %S* old_obj, "
+        "const struct %S* new_obj, sstr_t out) {\n"
+        "    struct %S* old = (struct %S*)old_obj;\n"
+        "    struct %S* obj = (struct %S*)new_obj;\n"
+        "    int _n = 0;\n"
+        "    int _ne;\n"
+        "    if (old_obj == NULL || new_obj == NULL) {\n"
+        "        return -1;\n"
+        "    }\n"
+        "    (void)_ne;\n"
+        "    if (out) sstr_append_of_fast(out, \"{\", 1);\n",
+        st->name, st->name, st->name, st->name, st->name, st->name, st->name);
+
+    for (field = st->fields; field; field = field->next) {
+        int has_flag = field->is_optional || field->is_nullable;
+        int quote_open = is_string_field(field) && !has_flag;
+        sstr_t prefix = sstr_new();
+        sstr_t lit = sstr_new();
+
+        sstr_append_cstr(prefix, ",\"");
+        sstr_append(prefix, JSON_KEY(field));
+        sstr_append_cstr(prefix, "\":");
+        if (quote_open) {
+            sstr_append_cstr(prefix, "\"");
+        }
+        append_c_literal(lit, sstr_cstr(prefix));
+
+        if (has_flag) {
+            sstr_printf_append(source,
+                "    _ne = old->has_%S != obj->has_%S;\n"
+                "    if (!_ne && obj->has_%S) {\n",
+                field->name, field->name, field->name);
+            gen_diff_field_ne(st, field, source);
+            sstr_append_cstr(source, "    }\n");
         } else {
-            /* For non-optional structs the comma is merged into the
-               start-of-next-field emit above; only the trailing newline
-               after the last field is needed here. */
-            if (field->next == NULL) {
-                sstr_append_cstr(source,
-                    "    sstr_append_of_if(out, \"\\n\", 1, indent);\n");
+            gen_diff_field_ne(st, field, source);
+        }
+        sstr_printf_append(source,
+            "    if (_ne && out) {\n"
+            "    sstr_append_of_fast(out, &\"%S\"[_n == 0], %d - (_n == 0));\n",
+            lit, (int)sstr_length(prefix));
+        if (has_flag) {
+            sstr_printf_append(source,
+                "    if (!obj->has_%S) {\n"
+                "        sstr_append_of_fast(out, \"null\", 4);\n",
+                field->name);
+            if (field->type == FIELD_TYPE_STRUCT && !field->is_array) {
+                // merge into a struct the old side already has
+                sstr_printf_append(source,
+                    "    } else if (old->has_%S) {\n"
+                    "        json_marshal_diff_%S(&old->%S, &obj->%S, out);\n",
+                    field->name, field->type_name, field->name, field->name);
             }
+            sstr_append_cstr(source, "    } else {\n");
+            gen_compact_field_value(st, field, 0, 0, COMPACT_PLAIN, source);
+            sstr_append_cstr(source, "    }\n");
+        } else if (field->type == FIELD_TYPE_STRUCT && !field->is_array) {
+            sstr_printf_append(source,
+                "    json_marshal_diff_%S(&old->%S, &obj->%S, out);\n",
+                field->type_name, field->name, field->name);
+        } else {
+            gen_compact_field_value(st, field, quote_open, 0, COMPACT_PLAIN, source);
         }
-    }
-    if (has_optional) {
         sstr_append_cstr(source,
-                         "    sstr_append_of_if(out, \"\\n\", 1, indent);\n");
+            "    }\n"
+            "    _n += _ne;\n");
+        sstr_free(lit);
+        sstr_free(prefix);
     }
-    sstr_append_cstr(source, "    curindent -= indent;\n");
+    sstr_append_cstr(source,
+        "    if (out) sstr_append_of_fast(out, \"}\", 1);\n"
+        "    return _n;\n"
+        "}\n\n");
+}
 
+static void gen_code_struct_apply_patch(struct struct_container* st,
+                                        sstr_t source) {
+    sstr_printf_append(source,
+                       "int json_apply_patch_%S(struct %S* obj, sstr_t patch) {\n",
+                       st->name, st->name);
     sstr_append_cstr(source,
-                     "    sstr_append_indent(out, curindent);\n"
-                     "    sstr_append_of(out, \"}\", 1);\n"
-                     "    return 0;\n}\n\n");
+                     "    struct json_pos pos;\n"
+                     "    struct json_limit_state lim;\n"
+                     "    struct json_parse_param param;\n"
+                     "    param.instance_ptr = obj;\n"
+                     "    param.field_name = \"\";\n"
+                     "    param.in_array = 0;\n"
+                     "    param.in_struct = 1;\n"
+                     "    param.depth = 0;\n"
+                     "    param.field_mask = NULL;\n"
+                     "    param.field_mask_word_count = 0;\n"
+                     "    param.nested_masks = NULL;\n"
+                     "    param.nested_mask_count = 0;\n"
+                     "    param.merge = 1;\n");
+    sstr_printf_append(source, "    param.struct_name = \"%S\";\n", st->name);
+    // no %S_clear() on failure: a patch only ever touches some fields
+    sstr_append_cstr(
+        source,
+        "    if (obj == NULL || patch == NULL) {\n"
+        "        return -1;\n"
+        "    }\n"
+        "    SSTR_LOCAL(txt);\n"
+        "    int r = json_decode_begin_(patch, &pos, &lim, NULL, NULL, txt);\n"
+        "    if (r != 0) {\n"
+        "        sstr_clear(txt);\n"
+        "        return r;\n"
+        "    }\n"
+        "    r = json_unmarshal_struct_internal(patch, &pos, &param, txt);\n"
+        "#ifdef JSON_DEBUG\n"
+        "    if (r < 0) {\n"
+        "        printf(\"ERROR: %s\", sstr_cstr(txt));\n"
+        "    }\n"
+        "#endif\n"
+        "    sstr_clear(txt);\n"
+        "    return r;\n"
+        "}\n\n");
 }
 
 static void gen_code_struct_marshal_array(struct struct_container* st,
@@ -949,7 +2122,7 @@ static void gen_code_struct_marshal_array(struct struct_container* st,
 
     sstr_append_cstr(source,
                      "    int i;\n"
-                     "    sstr_append_of(out, \"[\", 1);\n"
+                     "    sstr_append_of_fast(out, \"[\", 1);\n"
                      "    sstr_append_of_if(out, \"\\n\", 1, indent);\n"
                      "    curindent += indent;\n"
                      "    for (i = 0; i < len; i++) {\n");
@@ -959,16 +2132,95 @@ static void gen_code_struct_marshal_array(struct struct_container* st,
         st->name);
     sstr_append_cstr(source,
                      "        if (i < len - 1) {\n"
-                     "            sstr_append_of(out, \",\", 1);\n"
+                     "            sstr_append_of_fast(out, \",\", 1);\n"
                      "        }\n"
                      "        sstr_append_of_if(out, \"\\n\", 1, indent);\n"
                      "    }\n"
                      "    curindent -= indent;\n"
                      "    sstr_append_indent(out, curindent);\n"
-                     "    sstr_append_of(out, \"]\", 1);\n"
+                     "    sstr_append_of_fast(out, \"]\", 1);\n"
                      "\n    return 0;\n}\n\n");
 }
 
+static void gen_code_struct_marshal_array_compact(struct struct_container* st,
+                                                  sstr_t source) {
+    sstr_printf_append(source,
+                       "int json_marshal_array_%S(struct %S* obj, int len, "
+                       "sstr_t out) {\n"
+                       "    int i;\n"
+                       "    sstr_append_of_fast(out, \"[\", 1);\n"
+                       "    for (i = 0; i < len; i++) {\n"
+                       "        if (i) {\n"
+                       "            sstr_append_of_fast(out, \",\", 1);\n"
+                       "        }\n"
+                       "        json_marshal_%S(&obj[i], out);\n"
+                       "    }\n"
+                       "    sstr_append_of_fast(out, \"]\", 1);\n"
+                       "    return 0;\n}\n\n",
+                       st->name, st->name, st->name);
+    sstr_printf_append(source,
+                       "static int json_marshal_elem_%S_(void* elem, sstr_t out) {\n"
+                       "    return json_marshal_%S((struct %S*)elem, out);\n"
+                       "}\n\n"
+                       "int json_marshal_array_parallel_%S(struct %S* obj, int len, "
+                       "int threads, sstr_t out) {\n"
+                       "    return json_marshal_array_parallel_(obj, len, "
+                       "sizeof(struct %S), json_marshal_elem_%S_, threads, out);\n"
+                       "}\n\n",
+                       st->name, st->name, st->name, st->name, st->name,
+                       st->name, st->name);
+}
+
+static void gen_code_struct_marshal_array_iov(struct struct_container* st,
+                                              sstr_t source) {
+    sstr_printf_append(source,
+                       "int json_marshal_array_iov_%S(struct %S* obj, int len, "
+                       "struct json_iov* io) {\n"
+                       "    int i;\n"
+                       "    sstr_append_of_fast(io->buf, \"[\", 1);\n"
+                       "    for (i = 0; i < len; i++) {\n"
+                       "        if (i) {\n"
+                       "            sstr_append_of_fast(io->buf, \",\", 1);\n"
+                       "        }\n"
+                       "        if (json_marshal_iov_%S(&obj[i], io) != 0) {\n"
+                       "            return -1;\n"
+                       "        }\n"
+                       "    }\n"
+                       "    sstr_append_of_fast(io->buf, \"]\", 1);\n"
+                       "    return 0;\n}\n\n",
+                       st->name, st->name, st->name);
+}
+
+// json_array_writer_{begin,append,end}_<S>() and json_ndjson_write_<S>().
+static void gen_code_struct_marshal_stream(struct struct_container* st,
+                                           sstr_t source) {
+    sstr_printf_append(source,
+        "int json_array_writer_begin_%S(struct json_array_writer* w, "
+        "struct json_sink* sink) {\n"
+        "    return json_array_writer_begin_(w, sink);\n"
+        "}\n\n"
+        "int json_array_writer_append_%S(struct json_array_writer* w, "
+        "struct %S* obj) {\n"
+        "    if (json_array_writer_next_(w) != 0 ||\n"
+        "        json_marshal_%S(obj, w->sink->buf) != 0) {\n"
+        "        return json_sink_fail_(w->sink);\n"
+        "    }\n"
+        "    return json_sink_commit_(w->sink);\n"
+        "}\n\n"
+        "int json_array_writer_end_%S(struct json_array_writer* w) {\n"
+        "    return json_array_writer_end_(w);\n"
+        "}\n\n"
+        "int json_ndjson_write_%S(struct json_sink* sink, struct %S* obj) {\n"
+        "    if (sink->err != 0 || json_marshal_%S(obj, sink->buf) != 0) {\n"
+        "        return json_sink_fail_(sink);\n"
+        "    }\n"
+        "    sstr_append_of_fast(sink->buf, \"\\n\", 1);\n"
+        "    return json_sink_commit_(sink);\n"
+        "}\n\n",
+        st->name, st->name, st->name, st->name, st->name, st->name,
+        st->name, st->name);
+}
+
 static void gen_code_scalar_marshal_array(sstr_t source) {
     // NOTE: move to json_parse.h
     (void)source;
@@ -978,6 +2230,9 @@ static void gen_code_scalar_marshal_array(sstr_t source) {
 static void gen_code_struct_init(struct struct_container* st, sstr_t source) {
     sstr_printf_append(source, "int %S_init(struct %S*obj) {\n", st->name,
                        st->name);
+    if (st->is_cached) {
+        sstr_append_cstr(source, "    obj->_json_cache = NULL;\n");
+    }
     struct struct_field* field = st->fields;
     for (; field; field = field->next) {
         if (field->is_optional || field->is_nullable) {
@@ -1046,7 +2301,16 @@ static void gen_code_struct_init(struct struct_container* st, sstr_t source) {
                 }
                 break;
             case FIELD_TYPE_SSTR:
-                if (field->has_default) {
+                if (field->is_inline_str) {
+                    sstr_printf_append(source,
+                                       "    memset(obj->%S, 0, sizeof(obj->%S));\n",
+                                       field->name, field->name);
+                    if (field->has_default) {
+                        sstr_printf_append(source,
+                                           "    sstr_append_cstr(obj->%S, \"%S\");\n",
+                                           field->name, field->default_value);
+                    }
+                } else if (field->has_default) {
                     sstr_printf_append(source, "    obj->%S = sstr(\"%S\");\n",
                                        field->name, field->default_value);
                 } else {
@@ -1054,6 +2318,21 @@ static void gen_code_struct_init(struct struct_container* st, sstr_t source) {
                                        field->name);
                 }
                 break;
+            case FIELD_TYPE_FIXSTR:
+                if (field->has_default) {
+                    sstr_printf_append(source,
+                                       "    memcpy(obj->%S, \"%S\", sizeof(\"%S\"));\n"
+                                       "    obj->%S_len = (uint8_t)(sizeof(\"%S\") - 1);\n",
+                                       field->name, field->default_value,
+                                       field->default_value, field->name,
+                                       field->default_value);
+                } else {
+                    sstr_printf_append(source,
+                                       "    obj->%S[0] = '\\0';\n"
+                                       "    obj->%S_len = 0;\n",
+                                       field->name, field->name);
+                }
+                break;
             case FIELD_TYPE_STRUCT:
             case FIELD_TYPE_ONEOF:
                 sstr_printf_append(source, "    %S_init(&obj->%S);\n",
@@ -1108,6 +2387,11 @@ static void gen_code_struct_clear(struct struct_container* st, sstr_t source) {
     sstr_printf_append(source, "int %S_clear(struct %S*obj) {\n", st->name,
                        st->name);
     int have_i = 0;
+    if (st->is_cached) {
+        sstr_append_cstr(source,
+            "    json_cache_free_(obj->_json_cache);\n"
+            "    obj->_json_cache = NULL;\n");
+    }
     struct struct_field* field = st->fields;
     for (; field; field = field->next) {
         if (field->is_optional || field->is_nullable) {
@@ -1216,11 +2500,22 @@ static void gen_code_struct_clear(struct struct_container* st, sstr_t source) {
                 sstr_printf_append(source, "    obj->%S = 0.0;\n", field->name);
                 break;
             case FIELD_TYPE_SSTR:
+                if (field->is_inline_str) {
+                    sstr_printf_append(source, "    sstr_reset(obj->%S);\n",
+                                       field->name);
+                    break;
+                }
                 sstr_printf_append(source, "    sstr_free(obj->%S);\n",
                                    field->name);
                 sstr_printf_append(source, "    obj->%S = NULL;\n",
                                    field->name);
                 break;
+            case FIELD_TYPE_FIXSTR:
+                sstr_printf_append(source,
+                                   "    obj->%S[0] = '\\0';\n"
+                                   "    obj->%S_len = 0;\n",
+                                   field->name, field->name);
+                break;
             case FIELD_TYPE_STRUCT:
             case FIELD_TYPE_ONEOF:
                 sstr_printf_append(source, "    %S_clear(&obj->%S);\n",
@@ -1484,6 +2779,23 @@ static void emit_copy_field_body(struct struct_field* field, sstr_t source,
         return;
     }
 
+    if (field->type == FIELD_TYPE_FIXSTR) {
+        sstr_printf_append(source,
+            "%smemcpy(dest->%S, src->%S, sizeof(dest->%S));\n"
+            "%sdest->%S_len = src->%S_len;\n",
+            indent, field->name, field->name, field->name,
+            indent, field->name, field->name);
+        return;
+    }
+    if (field->is_inline_str) {
+        // dest was cleared, so this only appends to an empty string; a
+        // value too long for the embedded buffer allocates
+        sstr_printf_append(source,
+            "%sif (sstr_append(dest->%S, (sstr_t)src->%S) != 0) goto fail;\n",
+            indent, field->name, field->name);
+        return;
+    }
+
     char dest_expr[256];
     char src_expr[256];
     snprintf(dest_expr, sizeof(dest_expr), "dest->%s", sstr_cstr(field->name));
@@ -1736,7 +3048,6 @@ static void gen_oneof_marshal(struct oneof_container* oc, sstr_t source) {
         "int curindent, sstr_t out) {\n",
         oc->name, oc->name);
     sstr_append_cstr(source,
-        "    char tmp_cstr[64];\n    (void)tmp_cstr;\n"
         "    if (indent && sstr_length(out) && "
         "sstr_cstr(out)[sstr_length(out)-1] != ':') {\n"
         "        sstr_append_indent(out, curindent);\n"
@@ -1748,17 +3059,17 @@ static void gen_oneof_marshal(struct oneof_container* oc, sstr_t source) {
     // Marshal tag field
     sstr_append_cstr(source, "    sstr_append_indent(out, curindent);\n");
     sstr_printf_append(source,
-        "    sstr_append_of(out, \"\\\"%S\\\":\", %d);\n",
+        "    sstr_append_of_fast(out, \"\\\"%S\\\":\", %d);\n",
         oc->tag_field, (int)(sstr_length(oc->tag_field) + 3));
     sstr_append_cstr(source,
-        "    sstr_append_of(out, \"\\\"\", 1);\n");
+        "    sstr_append_of_fast(out, \"\\\"\", 1);\n");
     sstr_printf_append(source,
         "    if ((int)obj->tag >= 0 && (int)obj->tag < %S_tag_count) {\n"
         "        sstr_append_cstr(out, %S_tag_strings[(int)obj->tag]);\n"
         "    }\n",
         oc->name, oc->name);
     sstr_append_cstr(source,
-        "    sstr_append_of(out, \"\\\"\", 1);\n");
+        "    sstr_append_of_fast(out, \"\\\"\", 1);\n");
 
     // Marshal variant fields via temp buffer
     sstr_append_cstr(source, "    switch (obj->tag) {\n");
@@ -1776,8 +3087,8 @@ static void gen_oneof_marshal(struct oneof_container* oc, sstr_t source) {
             "                while (_end > _start && _s[_end] != '}') _end--;\n"
             "                _start++;\n"
             "                if (_start < _end) {\n"
-            "                    sstr_append_of(out, \",\", 1);\n"
-            "                    sstr_append_of(out, _s + _start, _end - _start);\n"
+            "                    sstr_append_of_fast(out, \",\", 1);\n"
+            "                    sstr_append_of_fast(out, _s + _start, _end - _start);\n"
             "                }\n"
             "            }\n"
             "            sstr_free(_tmp);\n"
@@ -1794,7 +3105,7 @@ static void gen_oneof_marshal(struct oneof_container* oc, sstr_t source) {
         "    sstr_append_of_if(out, \"\\n\", 1, indent);\n"
         "    curindent -= indent;\n"
         "    sstr_append_indent(out, curindent);\n"
-        "    sstr_append_of(out, \"}\", 1);\n"
+        "    sstr_append_of_fast(out, \"}\", 1);\n"
         "    return 0;\n}\n\n");
 }
 
@@ -1804,29 +3115,30 @@ static void gen_oneof_unmarshal(struct oneof_container* oc, sstr_t source) {
         "    memset(obj, 0, sizeof(struct %S));\n"
         "    obj->tag = -1;\n"
         "    struct json_pos pos;\n"
-        "    pos.col = 0; pos.line = 0; pos.offset = 0;\n"
-        "    sstr_t txt = sstr_new();\n"
-        "    int tk;\n",
+        "    struct json_limit_state lim;\n"
+        "    SSTR_LOCAL(txt);\n"
+        "    int tk = json_decode_begin_(in, &pos, &lim, NULL, NULL, txt);\n"
+        "    if (tk != 0) { sstr_clear(txt); return tk; }\n",
         oc->name, oc->name, oc->name);
 
     // Phase 1: scan for tag field
     sstr_append_cstr(source,
         "    tk = json_next_token(in, &pos, txt);\n"
-        "    if (tk != JSON_TOKEN_LEFT_BRACE) { sstr_free(txt); return -1; }\n"
+        "    if (tk != JSON_TOKEN_LEFT_BRACE) { sstr_clear(txt); return -1; }\n"
         "    while (1) {\n"
         "        tk = json_next_token(in, &pos, txt);\n"
         "        if (tk == JSON_TOKEN_RIGHT_BRACE || tk == JSON_TOKEN_EOF) break;\n"
         "        if (tk == JSON_TOKEN_COMMA) continue;\n"
-        "        if (tk != JSON_TOKEN_STRING) { sstr_free(txt); return -1; }\n");
+        "        if (tk != JSON_TOKEN_STRING) { sstr_clear(txt); return -1; }\n");
     sstr_printf_append(source,
         "        int _is_tag = (strcmp(sstr_cstr(txt), \"%S\") == 0);\n",
         oc->tag_field);
     sstr_append_cstr(source,
         "        tk = json_next_token(in, &pos, txt);\n"
-        "        if (tk != JSON_TOKEN_COLON) { sstr_free(txt); return -1; }\n"
+        "        if (tk != JSON_TOKEN_COLON) { sstr_clear(txt); return -1; }\n"
         "        if (_is_tag) {\n"
         "            tk = json_next_token(in, &pos, txt);\n"
-        "            if (tk != JSON_TOKEN_STRING) { sstr_free(txt); return -1; }\n");
+        "            if (tk != JSON_TOKEN_STRING) { sstr_clear(txt); return -1; }\n");
     sstr_printf_append(source,
         "            { int _i;\n"
         "            for (_i = 0; _i < %S_tag_count; _i++) {\n"
@@ -1847,14 +3159,14 @@ static void gen_oneof_unmarshal(struct oneof_container* oc, sstr_t source) {
         "                int _close = (tk == JSON_TOKEN_LEFT_BRACE) ? JSON_TOKEN_RIGHT_BRACE : JSON_TOKEN_RIGHT_BRACKET;\n"
         "                while (_depth > 0) {\n"
         "                    tk = json_next_token(in, &pos, txt);\n"
-        "                    if (tk == JSON_TOKEN_EOF) { sstr_free(txt); return -1; }\n"
+        "                    if (tk == JSON_TOKEN_EOF) { sstr_clear(txt); return -1; }\n"
         "                    if (tk == _open) _depth++;\n"
         "                    else if (tk == _close) _depth--;\n"
         "                }\n"
         "            }\n"
         "        }\n"
         "    }\n"
-        "    sstr_free(txt);\n");
+        "    sstr_clear(txt);\n");
 
     // Phase 2: unmarshal variant struct
     sstr_append_cstr(source, "    switch (obj->tag) {\n");
@@ -1879,11 +3191,12 @@ static void gen_oneof_unmarshal_array(struct oneof_container* oc, sstr_t source)
         oc->name, oc->name);
     sstr_append_cstr(source,
         "    struct json_pos pos;\n"
-        "    pos.col = 0; pos.line = 0; pos.offset = 0;\n"
-        "    sstr_t txt = sstr_new();\n"
-        "    int tk;\n"
+        "    struct json_limit_state lim;\n"
+        "    SSTR_LOCAL(txt);\n"
+        "    int tk = json_decode_begin_(in, &pos, &lim, NULL, NULL, txt);\n"
+        "    if (tk != 0) { *len = 0; *obj = NULL; sstr_clear(txt); return tk; }\n"
         "    tk = json_next_token(in, &pos, txt);\n"
-        "    if (tk != JSON_TOKEN_LEFT_BRACKET) { sstr_free(txt); return -1; }\n"
+        "    if (tk != JSON_TOKEN_LEFT_BRACKET) { sstr_clear(txt); return -1; }\n"
         "    *len = 0;\n"
         "    *obj = NULL;\n"
         "    int _cap = 0;\n"
@@ -1908,11 +3221,11 @@ static void gen_oneof_unmarshal_array(struct oneof_container* oc, sstr_t source)
         "            int _depth = 1;\n"
         "            while (_depth > 0) {\n"
         "                tk = json_next_token(in, &pos, txt);\n"
-        "                if (tk == JSON_TOKEN_EOF) { sstr_free(txt); return -1; }\n"
+        "                if (tk == JSON_TOKEN_EOF) { sstr_clear(txt); return -1; }\n"
         "                if (tk == JSON_TOKEN_LEFT_BRACE) _depth++;\n"
         "                else if (tk == JSON_TOKEN_RIGHT_BRACE) _depth--;\n"
         "            }\n"
-        "        } else { sstr_free(txt); return -1; }\n"
+        "        } else { sstr_clear(txt); return -1; }\n"
         "        int _elem_end = pos.offset;\n"
         "        sstr_t _elem = sstr_of(sstr_cstr(in) + _elem_start, _elem_end - _elem_start);\n");
     sstr_printf_append(source,
@@ -1921,10 +3234,10 @@ static void gen_oneof_unmarshal_array(struct oneof_container* oc, sstr_t source)
         oc->name, oc->name);
     sstr_append_cstr(source,
         "        sstr_free(_elem);\n"
-        "        if (_r != 0) { sstr_free(txt); return -1; }\n"
+        "        if (_r != 0) { sstr_clear(txt); return -1; }\n"
         "        (*len)++;\n"
         "    }\n"
-        "    sstr_free(txt);\n"
+        "    sstr_clear(txt);\n"
         "    return 0;\n"
         "}\n\n");
 }
@@ -1936,7 +3249,7 @@ static void gen_oneof_marshal_array(struct oneof_container* oc, sstr_t source) {
         oc->name, oc->name);
     sstr_append_cstr(source,
         "    int i;\n"
-        "    sstr_append_of(out, \"[\", 1);\n"
+        "    sstr_append_of_fast(out, \"[\", 1);\n"
         "    sstr_append_of_if(out, \"\\n\", 1, indent);\n"
         "    curindent += indent;\n"
         "    for (i = 0; i < len; i++) {\n");
@@ -1944,12 +3257,12 @@ static void gen_oneof_marshal_array(struct oneof_container* oc, sstr_t source) {
         "        json_marshal_indent_%S(&obj[i], indent, curindent, out);\n",
         oc->name);
     sstr_append_cstr(source,
-        "        if (i < len - 1) sstr_append_of(out, \",\", 1);\n"
+        "        if (i < len - 1) sstr_append_of_fast(out, \",\", 1);\n"
         "        sstr_append_of_if(out, \"\\n\", 1, indent);\n"
         "    }\n"
         "    curindent -= indent;\n"
         "    sstr_append_indent(out, curindent);\n"
-        "    sstr_append_of(out, \"]\", 1);\n"
+        "    sstr_append_of_fast(out, \"]\", 1);\n"
         "    return 0;\n}\n\n");
 }
 
@@ -1967,12 +3280,205 @@ static void gen_code_oneof(struct oneof_container* oc, sstr_t source, sstr_t hea
 }
 
 // generate the struct codes
-static void gen_code_struct(struct struct_container* st, sstr_t source,
+// The JSON_EXTRACT_* name of a scalar field type. A str<N> is extracted
+// like any string, without the limit; enums have no public id and pass
+// their strings along with FIELD_TYPE_ENUM.
+static const char* json_extract_type_name(int type) {
+    switch (type) {
+        case FIELD_TYPE_INT: return "JSON_EXTRACT_INT";
+        case FIELD_TYPE_LONG: return "JSON_EXTRACT_LONG";
+        case FIELD_TYPE_FLOAT: return "JSON_EXTRACT_FLOAT";
+        case FIELD_TYPE_DOUBLE: return "JSON_EXTRACT_DOUBLE";
+        case FIELD_TYPE_SSTR: return "JSON_EXTRACT_SSTR";
+        case FIELD_TYPE_FIXSTR: return "JSON_EXTRACT_SSTR";
+        case FIELD_TYPE_BOOL: return "JSON_EXTRACT_BOOL";
+        case FIELD_TYPE_INT8: return "JSON_EXTRACT_INT8";
+        case FIELD_TYPE_INT16: return "JSON_EXTRACT_INT16";
+        case FIELD_TYPE_INT32: return "JSON_EXTRACT_INT32";
+        case FIELD_TYPE_INT64: return "JSON_EXTRACT_INT64";
+        case FIELD_TYPE_UINT8: return "JSON_EXTRACT_UINT8";
+        case FIELD_TYPE_UINT16: return "JSON_EXTRACT_UINT16";
+        case FIELD_TYPE_UINT32: return "JSON_EXTRACT_UINT32";
+        case FIELD_TYPE_UINT64: return "JSON_EXTRACT_UINT64";
+        case FIELD_TYPE_ENUM:
+        default: return "FIELD_TYPE_ENUM";
+    }
+}
+
+// Emit json_extract_<S>_<field>[_<field>...]() for every scalar field, and
+// every element of a scalar array, reachable from the root struct through
+// nested struct fields. Struct arrays, maps and oneofs are left to
+// json_extract().
+static void gen_code_struct_extract(struct struct_container* st,
+                                    struct hash_map* struct_map, sstr_t root,
+                                    sstr_t name, sstr_t path, sstr_t source,
+                                    sstr_t header) {
+    struct struct_field* field;
+
+    for (field = st->fields; field; field = field->next) {
+        sstr_t key = JSON_KEY(field);
+        sstr_t sub_name = sstr_dup(name);
+        sstr_t sub_path = sstr_dup(path);
+        size_t i;
+
+        sstr_printf_append(sub_name, "_%S", field->name);
+        sstr_append_cstr(sub_path, "/");
+        for (i = 0; i < sstr_length(key); i++) {
+            char ch = sstr_cstr(key)[i];
+            if (ch == '~') {
+                sstr_append_cstr(sub_path, "~0");
+            } else if (ch == '/') {
+                sstr_append_cstr(sub_path, "~1");
+            } else {
+                if (ch == '"' || ch == '\\') {
+                    sstr_append_cstr(sub_path, "\\");
+                }
+                sstr_append_of(sub_path, &ch, 1);
+            }
+        }
+
+        if (field->type == FIELD_TYPE_STRUCT && !field->is_array) {
+            void* sub = NULL;
+            if (hash_map_find(struct_map, field->type_name, &sub) ==
+                HASH_MAP_OK) {
+                gen_code_struct_extract((struct struct_container*)sub,
+                                        struct_map, root, sub_name, sub_path,
+                                        source, header);
+            }
+        } else if (field->type != FIELD_TYPE_STRUCT &&
+                   field->type != FIELD_TYPE_MAP &&
+                   field->type != FIELD_TYPE_ONEOF) {
+            sstr_t out = sstr_new();
+            sstr_t proto = sstr_new();
+            if (field->type == FIELD_TYPE_SSTR ||
+                field->type == FIELD_TYPE_FIXSTR) {
+                sstr_append_cstr(out, "sstr_t out");
+            } else {
+                field_value_c_type(field, out);
+                sstr_append_cstr(out, "* out");
+            }
+            sstr_printf_append(proto, "int json_extract_%S(const char* in, size_t len",
+                        sub_name);
+            sstr_printf_append(proto, "%s, %S)",
+                               field->is_array ? ", int index" : "", out);
+
+            sstr_printf_append(
+                header,
+                "/**\n"
+                " * @brief Decode only \"%S%s\" of a json %S; see\n"
+                " * json_extract().\n"
+                " */\n"
+                "%S;\n\n",
+                sub_path, field->is_array ? "/<index>" : "", root, proto);
+
+            sstr_printf_append(source, "%S {\n", proto);
+            sstr_printf_append(
+                source,
+                "    return json_extract_path_(in, len, \"%S\", %s, %s, ",
+                sub_path, field->is_array ? "&index" : "NULL",
+                json_extract_type_name(field->type));
+            if (field->type == FIELD_TYPE_ENUM) {
+                sstr_printf_append(source, "%S_enum_strings, %S_enum_count",
+                                   field->type_name, field->type_name);
+            } else {
+                sstr_append_cstr(source, "NULL, 0");
+            }
+            sstr_append_cstr(source, ", out);\n}\n\n");
+            sstr_free(proto);
+            sstr_free(out);
+        }
+        sstr_free(sub_path);
+        sstr_free(sub_name);
+    }
+}
+
+static void gen_code_struct_alloc_header(struct struct_container* st,
+                                         sstr_t header) {
+    sstr_printf_append(
+        header,
+        "/**\n"
+        " * @brief Same as %S_init(), %S_clear() and %S_copy(), with every\n"
+        " * allocation and free going through @p alloc, which is installed\n"
+        " * as the thread allocator for the call (NULL: the calling thread's\n"
+        " * allocator).\n"
+        " *\n"
+        " * Objects do not record their allocator, and the previous thread\n"
+        " * allocator is back in place when these return. Clear or free an\n"
+        " * object with %S_clear_ex() and the same @p alloc that built it;\n"
+        " * a plain %S_clear() frees through whatever allocator the thread\n"
+        " * has at that time.\n"
+        " */\n"
+        "int %S_init_ex(struct %S* obj, const struct jgenc_allocator* alloc);\n"
+        "int %S_clear_ex(struct %S* obj, const struct jgenc_allocator* alloc);\n"
+        "int %S_copy_ex(struct %S* dest, const struct %S* src,\n"
+        "    const struct jgenc_allocator* alloc);\n"
+        "/**\n"
+        " * @brief Same as json_unmarshal_%S_ex(), allocating through @p alloc.\n"
+        " * Release @p obj with %S_clear_ex(obj, alloc).\n"
+        " */\n"
+        "int json_unmarshal_%S_alloc(sstr_t in, struct %S* obj,\n"
+        "    const struct jgenc_allocator* alloc, struct json_error* err);\n\n",
+        st->name, st->name, st->name, st->name, st->name, st->name, st->name,
+        st->name, st->name, st->name, st->name, st->name, st->name, st->name,
+        st->name, st->name);
+}
+
+// One allocator-taking wrapper: @p call runs with alloc installed as the
+// thread allocator, and the previous one is restored afterwards.
+static void gen_code_alloc_wrapper(sstr_t source, sstr_t signature,
+                                   sstr_t call) {
+    sstr_printf_append(source,
+        "%S {\n"
+        "    const struct jgenc_allocator* _prev =\n"
+        "        alloc ? jgenc_set_thread_allocator(alloc)\n"
+        "              : jgenc_thread_allocator();\n"
+        "    int _r = %S;\n"
+        "    jgenc_set_thread_allocator(_prev);\n"
+        "    return _r;\n"
+        "}\n\n",
+        signature, call);
+    sstr_free(signature);
+    sstr_free(call);
+}
+
+// XXX_init_ex(), XXX_clear_ex(), XXX_copy_ex(), json_unmarshal_XXX_alloc()
+static void gen_code_struct_alloc_wrappers(struct struct_container* st,
+                                           sstr_t source) {
+    gen_code_alloc_wrapper(source,
+        sstr_printf("int %S_init_ex(struct %S* obj, "
+                    "const struct jgenc_allocator* alloc)",
+                    st->name, st->name),
+        sstr_printf("%S_init(obj)", st->name));
+    gen_code_alloc_wrapper(source,
+        sstr_printf("int %S_clear_ex(struct %S* obj, "
+                    "const struct jgenc_allocator* alloc)",
+                    st->name, st->name),
+        sstr_printf("%S_clear(obj)", st->name));
+    gen_code_alloc_wrapper(source,
+        sstr_printf("int %S_copy_ex(struct %S* dest, const struct %S* src, "
+                    "const struct jgenc_allocator* alloc)",
+                    st->name, st->name, st->name),
+        sstr_printf("%S_copy(dest, src)", st->name));
+    gen_code_alloc_wrapper(source,
+        sstr_printf("int json_unmarshal_%S_alloc(sstr_t in, struct %S* obj, "
+                    "const struct jgenc_allocator* alloc, "
+                    "struct json_error* err)",
+                    st->name, st->name),
+        sstr_printf("json_unmarshal_%S_ex(in, obj, err)", st->name));
+}
+
+static void gen_code_struct(struct struct_container* st,
+                            struct hash_map* struct_map, sstr_t source,
                             sstr_t header) {
     // type definitions and function declares.
     gen_code_struct_header(st, header);
     gen_code_struct_selective_unmarshal_header(st, header);
     gen_code_struct_unmarshal_selected_deep_header(st, header);
+    gen_code_struct_marshal_selected_header(st, header);
+    gen_code_struct_diff_header(st, header);
+    gen_code_struct_cache_header(st, header);
+    gen_code_struct_validate_header(st, header);
+    gen_code_struct_alloc_header(st, header);
     // XXX_init()
     gen_code_struct_init(st, source);
     // XXX_clear()
@@ -1981,6 +3487,8 @@ static void gen_code_struct(struct struct_container* st, sstr_t source,
     gen_code_struct_copy(st, source);
     // XXX_move()
     gen_code_struct_move(st, source);
+    // XXX_init_ex(), XXX_clear_ex(), XXX_copy_ex(), json_unmarshal_XXX_alloc()
+    gen_code_struct_alloc_wrappers(st, source);
     // json_marshal_XXX()
     gen_code_struct_marshal_struct(st, source);
     // json_unmarshal_XXX()
@@ -1991,8 +3499,30 @@ static void gen_code_struct(struct struct_container* st, sstr_t source,
     gen_code_struct_unmarshal_selected_deep_struct(st, source);
     // json_unmarshal_array_XXX()
     gen_code_struct_unmarshal_array_struct(st, source);
-    // json_marshal_array_XXX()
+    // json_validate_XXX()
+    gen_code_struct_validate_struct(st, source);
+    // json_marshal_array_indent_XXX()
     gen_code_struct_marshal_array(st, source);
+    // json_marshal_XXX(), json_marshal_array_XXX()
+    if (st->is_cached) {
+        gen_code_struct_marshal_cached(st, struct_map, source);
+    } else {
+        gen_code_struct_marshal_compact(st, COMPACT_PLAIN, source);
+    }
+    gen_code_struct_marshal_array_compact(st, source);
+    // json_marshal_iov_XXX(), json_marshal_array_iov_XXX()
+    gen_code_struct_marshal_compact(st, COMPACT_IOV, source);
+    gen_code_struct_marshal_array_iov(st, source);
+    // json_array_writer_XXX_XXX(), json_ndjson_write_XXX()
+    gen_code_struct_marshal_stream(st, source);
+    // XXX_mark_dirty(), XXX_set_XXX()
+    gen_code_struct_cache_setters(st, source);
+    // json_marshal_selected_XXX(), json_marshal_selected_XXX_deep()
+    gen_code_struct_marshal_selected_struct(st, source);
+    gen_code_struct_marshal_compact(st, COMPACT_SELECTED, source);
+    // json_marshal_diff_XXX(), json_apply_patch_XXX()
+    gen_code_struct_marshal_diff(st, source);
+    gen_code_struct_apply_patch(st, source);
 }
 
 // Generate oneof static data (tag strings, variant struct names) early,
@@ -2057,10 +3587,19 @@ static void gen_fields_list_fn(void* key, void* value, void* ptr) {
     struct struct_field* field = st->fields;
     int field_index = 0;
 
+    // a @cached struct's own entry keeps the offset of its fragment cache
+    // in has_field_offset, so the decoder can drop it.
     sstr_printf_append(param->source,
                        "    {0, sizeof(struct %S), %d, \"\", \"\", \"%S\", 0"
-                       ", NULL, 0, 0, 0, 0, 0, 0, -1, NULL, NULL, 0, 0, -1},\n",
+                       ", NULL, 0, 0, 0, 0, 0, 0, ",
                        st->name, FIELD_TYPE_STRUCT, st->name);
+    if (st->is_cached) {
+        sstr_printf_append(param->source, "offsetof(struct %S, _json_cache)",
+                           st->name);
+    } else {
+        sstr_append_cstr(param->source, "-1");
+    }
+    sstr_append_cstr(param->source, ", NULL, NULL, 0, 0, -1, 0},\n");
     sstr_t empty_s = sstr_new();
     gen_hash_arr(st->name, empty_s, param);
     sstr_free(empty_s);
@@ -2096,20 +3635,20 @@ static void gen_fields_list_fn(void* key, void* value, void* ptr) {
                 if (field->is_optional || field->is_nullable) {
                     sstr_printf_append(
                         param->source,
-                        ", %d, offsetof(struct %S, has_%S), NULL, NULL, 0, 0, %d},\n",
+                        ", %d, offsetof(struct %S, has_%S), NULL, NULL, 0, 0, %d, 0},\n",
                         field->is_nullable, st->name, field->name,
                         field_index);
                 } else {
                     sstr_printf_append(
                         param->source,
-                        ", 0, -1, NULL, NULL, 0, 0, %d},\n", field_index);
+                        ", 0, -1, NULL, NULL, 0, 0, %d, 0},\n", field_index);
                 }
                 gen_hash_arr(st->name, JSON_KEY(field), param);
                 // _len field
                 sstr_printf_append(param->source,
                     "    {offsetof(struct %S, %S_len), sizeof(int), "
                     "%d, \"int\", \"%S_len\", \"%S\", 0, NULL, 0, 0, 0, 0, 0, "
-                    "0, -1, NULL, NULL, 0, 0, -1},\n",
+                    "0, -1, NULL, NULL, 0, 0, -1, 0},\n",
                     st->name, field->name, FIELD_TYPE_INT,
                     JSON_KEY(field), st->name);
                 sstr_t tmp = sstr_dup(JSON_KEY(field));
@@ -2131,13 +3670,13 @@ static void gen_fields_list_fn(void* key, void* value, void* ptr) {
                 if (field->is_optional || field->is_nullable) {
                     sstr_printf_append(
                         param->source,
-                        ", %d, offsetof(struct %S, has_%S), NULL, NULL, 0, 0, %d},\n",
+                        ", %d, offsetof(struct %S, has_%S), NULL, NULL, 0, 0, %d, 0},\n",
                         field->is_nullable, st->name, field->name,
                         field_index);
                 } else {
                     sstr_printf_append(
                         param->source,
-                        ", 0, -1, NULL, NULL, 0, 0, %d},\n", field_index);
+                        ", 0, -1, NULL, NULL, 0, 0, %d, 0},\n", field_index);
                 }
                 gen_hash_arr(st->name, JSON_KEY(field), param);
             }
@@ -2155,11 +3694,11 @@ static void gen_fields_list_fn(void* key, void* value, void* ptr) {
                 sstr_printf_append(
                     param->source,
                     ", %d, offsetof(struct %S, has_%S), NULL, NULL, 0, 0, "
-                    "%d},\n",
+                    "%d, 0},\n",
                     field->is_nullable, st->name, field->name, field_index);
             } else {
                 sstr_printf_append(param->source,
-                                   ", 0, -1, NULL, NULL, 0, 0, %d},\n",
+                                   ", 0, -1, NULL, NULL, 0, 0, %d, 0},\n",
                                    field_index);
             }
             gen_hash_arr(st->name, JSON_KEY(field), param);
@@ -2191,12 +3730,12 @@ static void gen_fields_list_fn(void* key, void* value, void* ptr) {
                 sstr_printf_append(param->source,
                     ", \"%S\", %S_variant_structs"
                     ", (int)offsetof(struct %S, tag)"
-                    ", (int)offsetof(struct %S, value), %d},\n",
+                    ", (int)offsetof(struct %S, value), %d, 0},\n",
                     oc->tag_field, field->type_name,
                     field->type_name, field->type_name, field_index);
             } else {
                 sstr_printf_append(param->source,
-                                   ", NULL, NULL, 0, 0, %d},\n", field_index);
+                                   ", NULL, NULL, 0, 0, %d, 0},\n", field_index);
             }
             gen_hash_arr(st->name, JSON_KEY(field), param);
         } else if (field->type == FIELD_TYPE_ENUM) {
@@ -2212,40 +3751,52 @@ static void gen_fields_list_fn(void* key, void* value, void* ptr) {
                 sstr_printf_append(
                     param->source,
                     ", %d, offsetof(struct %S, has_%S), NULL, NULL, 0, 0, "
-                    "%d},\n",
+                    "%d, 0},\n",
                     field->is_nullable, st->name, field->name, field_index);
             } else {
                 sstr_printf_append(param->source,
-                                   ", 0, -1, NULL, NULL, 0, 0, %d},\n",
+                                   ", 0, -1, NULL, NULL, 0, 0, %d, 0},\n",
                                    field_index);
             }
             gen_hash_arr(st->name, JSON_KEY(field), param);
         } else {
+            // a str<N> field's type_size is N + 1, its length byte follows
+            sstr_t size = sstr_new();
+            if (field->type == FIELD_TYPE_FIXSTR) {
+                sstr_printf_append(size, "%d", field->str_size + 1);
+            } else {
+                sstr_printf_append(size, "sizeof(%s)",
+                                   field->is_inline_str
+                                       ? "struct sstr_s"
+                                       : sstr_cstr(field->type_name));
+            }
             sstr_printf_append(
                 param->source,
-                "    {offsetof(struct %S, %S), sizeof(%S), %d, \"%S\", \"%S\", "
+                "    {offsetof(struct %S, %S), %S, %d, \"%S\", \"%S\", "
                 "\"%S\", %d, NULL, 0, %d, 0, 0, 0",
-                st->name, field->name, field->type_name, field->type,
+                st->name, field->name, size, field->type,
                 field->type_name, JSON_KEY(field), st->name, field->is_array,
                 field->array_size);
             if (field->is_optional || field->is_nullable) {
                 sstr_printf_append(
                     param->source,
                     ", %d, offsetof(struct %S, has_%S), NULL, NULL, 0, 0, "
-                    "%d},\n",
-                    field->is_nullable, st->name, field->name, field_index);
+                    "%d, %d},\n",
+                    field->is_nullable, st->name, field->name, field_index,
+                    field->is_inline_str);
             } else {
                 sstr_printf_append(param->source,
-                                   ", 0, -1, NULL, NULL, 0, 0, %d},\n",
-                                   field_index);
+                                   ", 0, -1, NULL, NULL, 0, 0, %d, %d},\n",
+                                   field_index, field->is_inline_str);
             }
+            sstr_free(size);
             gen_hash_arr(st->name, JSON_KEY(field), param);
         }
         if (field->type != FIELD_TYPE_MAP && field->is_array && field->array_size == 0) {
             // dynamic array: generate _len field entry
             sstr_printf_append(param->source, "    {offsetof(struct %S, %S_len), sizeof(int), "
                                "%d, \"int\", \"%S_len\", "
-                               "\"%S\", %d, NULL, 0, 0, 0, 0, 0, 0, -1, NULL, NULL, 0, 0, -1},\n",
+                               "\"%S\", %d, NULL, 0, 0, 0, 0, 0, 0, -1, NULL, NULL, 0, 0, -1, 0},\n",
                                st->name, field->name, FIELD_TYPE_INT,
                                JSON_KEY(field), st->name, 0);
             sstr_t tmp = sstr_dup(JSON_KEY(field));
@@ -2365,6 +3916,7 @@ static void gen_code_offset_map(struct hash_map* struct_map,
                      "    int oneof_tag_offset;\n"
                      "    int oneof_value_offset;\n"
                      "    int field_index;\n"
+                     "    int is_inline_str;\n"
                      "};\n\n");
     sstr_printf_append(
         source,
@@ -2380,7 +3932,7 @@ static void gen_code_offset_map(struct hash_map* struct_map,
     param.hash_arr = (int*)malloc(sizeof(int) * param.hash_size);
     memset(param.hash_arr, -1, sizeof(int) * param.hash_size);
     hash_map_for_each(struct_map, gen_fields_list_fn, &param);
-    sstr_append_cstr(source, "    {0, 0, 0, NULL, NULL, NULL, 0, NULL, 0, 0, 0, 0, 0, 0, -1, NULL, NULL, 0, 0, -1}};\n");
+    sstr_append_cstr(source, "    {0, 0, 0, NULL, NULL, NULL, 0, NULL, 0, 0, 0, 0, 0, 0, -1, NULL, NULL, 0, 0, -1, 0}};\n");
 
     sstr_printf_append(
         source, "int json_entry_hash_size = %d;\nint json_entry_hash[%d] = {",
@@ -2399,6 +3951,7 @@ static void dummy_free(void* ptr) { (void)ptr; }
 
 struct do_each_struct_gen_code_param {
     struct hash_map* dependency_map;
+    struct hash_map* struct_map;
     sstr_t source;
     sstr_t header;
 };
@@ -2421,10 +3974,13 @@ static void do_each_struct_gen_code(void* key, void* value, void* ptr) {
 
     // for each field, check if it is a struct type, and already
     // inserted into dependency map, if not, we cannot generate code
-    // for this struct, just return.
+    // for this struct, just return. A dynamic array of the struct itself
+    // is only a pointer, so it does not wait on anything.
     struct struct_field* iter = v->fields;
     while (iter) {
-        if (iter->type == FIELD_TYPE_STRUCT) {
+        if (iter->type == FIELD_TYPE_STRUCT &&
+            !(iter->is_array && iter->array_size == 0 &&
+              sstr_compare(iter->type_name, k) == 0)) {
             int dep_status = hash_map_find(dep_map, iter->type_name, &dv);
             if (dep_status != HASH_MAP_OK) {
                 return;
@@ -2445,7 +4001,14 @@ static void do_each_struct_gen_code(void* key, void* value, void* ptr) {
         iter = iter->next;
     }
     // all dependency is resolved
-    gen_code_struct(v, param->source, param->header);
+    gen_code_struct(v, param->struct_map, param->source, param->header);
+    // json_extract_XXX_<path>()
+    sstr_t name = sstr_dup(v->name);
+    sstr_t path = sstr_new();
+    gen_code_struct_extract(v, param->struct_map, v->name, name, path,
+                            param->source, param->header);
+    sstr_free(path);
+    sstr_free(name);
 
     // now the struct is generated, we can insert it into dependency map
     // to avoid generating it again.
@@ -2458,6 +4021,7 @@ int gencode_head_guard_begin(sstr_t head) {
     sstr_append_cstr(head, "#include \"sstr.h\"\n");
     sstr_append_cstr(head, "#include <stdbool.h>\n");
     sstr_append_cstr(head, "#include <stdint.h>\n");
+    sstr_append_cstr(head, "#ifndef _WIN32\n#include <sys/uio.h>\n#endif\n");
     sstr_append_cstr(head, "#ifdef __cplusplus\n");
     sstr_append_cstr(head, "extern \"C\" {\n");
     sstr_append_cstr(head, "#endif\n\n");
@@ -2515,7 +4079,164 @@ int gencode_head_guard_begin(sstr_t head) {
         "    const struct json_nested_mask* sub_masks;\n"
         "    int sub_mask_count;\n"
         "};\n"
-        "#endif\n\n");
+        "#endif\n\n"
+        "struct json_cache;\n\n");
+    sstr_append_cstr(
+        head,
+        "#ifdef _WIN32\n"
+        "struct json_iovec {\n"
+        "    void* iov_base;\n"
+        "    size_t iov_len;\n"
+        "};\n"
+        "#define JSON_IOVEC struct json_iovec\n"
+        "#else\n"
+        "#define JSON_IOVEC struct iovec\n"
+        "#endif\n\n"
+        "struct json_iov_seg_;\n\n"
+        "/**\n"
+        " * @brief Scatter-gather output of the json_marshal_iov_* functions.\n"
+        " *\n"
+        " * Punctuation, numbers and escaped text are written to buf; strings\n"
+        " * of at least JSON_IOV_MIN_REF bytes that need no escaping are\n"
+        " * referenced where they are. Initialize with json_iov_init(), free\n"
+        " * with json_iov_clear().\n"
+        " */\n"
+        "struct json_iov {\n"
+        "    sstr_t buf;\n"
+        "    struct json_iov_seg_* segs;\n"
+        "    int seg_count;\n"
+        "    int seg_cap;\n"
+        "    JSON_IOVEC* vec;\n"
+        "    int vec_cap;\n"
+        "    size_t mark;  /* start of the buf bytes not yet in segs */\n"
+        "};\n\n"
+        "int json_iov_init(struct json_iov* io);\n"
+        "/** @brief Drop the output but keep the memory for the next use. */\n"
+        "void json_iov_reset(struct json_iov* io);\n"
+        "void json_iov_clear(struct json_iov* io);\n"
+        "/**\n"
+        " * @brief The output so far as an iovec array of *count entries, for\n"
+        " * writev() or sendmsg(). Valid until the next call on @p io. *count\n"
+        " * may exceed IOV_MAX, in which case it has to be written in slices.\n"
+        " * @return NULL with *count set to 0 on allocation failure.\n"
+        " */\n"
+        "JSON_IOVEC* json_iov_vec(struct json_iov* io, int* count);\n\n");
+    sstr_append_cstr(
+        head,
+        "/**\n"
+        " * @brief Receives streamed output; return 0 to go on, anything else\n"
+        " * to fail the stream.\n"
+        " */\n"
+        "typedef int (*json_sink_write_fn)(void* ctx, const char* data, "
+        "size_t len);\n\n"
+        "/**\n"
+        " * @brief Buffered output of the streaming writers. Output collects in\n"
+        " * buf and is passed to write once it reaches flush_size bytes, so\n"
+        " * memory use does not grow with the number of records written.\n"
+        " */\n"
+        "struct json_sink {\n"
+        "    json_sink_write_fn write;\n"
+        "    void* ctx;\n"
+        "    sstr_t buf;\n"
+        "    size_t flush_size;\n"
+        "    int err;  /* -1 once a write or marshal failed */\n"
+        "};\n\n"
+        "/**\n"
+        " * @brief Set up @p sink; flush_size 0 uses JSON_SINK_FLUSH_SIZE.\n"
+        " * @return 0 on success, -1 on allocation failure.\n"
+        " */\n"
+        "int json_sink_init(struct json_sink* sink, json_sink_write_fn write,\n"
+        "                   void* ctx, size_t flush_size);\n"
+        "/** @brief Write out everything buffered. @return sink->err. */\n"
+        "int json_sink_flush(struct json_sink* sink);\n"
+        "/** @brief Free the buffer; pending output is dropped, not flushed. */\n"
+        "void json_sink_clear(struct json_sink* sink);\n"
+        "/** @brief A json_sink_write_fn for a FILE* passed as ctx. */\n"
+        "int json_sink_write_file(void* ctx, const char* data, size_t len);\n\n"
+        "/** @brief State of a JSON array streamed element by element. */\n"
+        "struct json_array_writer {\n"
+        "    struct json_sink* sink;\n"
+        "    int count;\n"
+        "};\n\n");
+    sstr_append_cstr(
+        head,
+        "/* Also declared by schema/schema_runtime.h, which shares them. */\n"
+        "#ifndef JGENC_JSON_DECODE_TYPES_\n"
+        "#define JGENC_JSON_DECODE_TYPES_\n\n"
+        "/**\n"
+        " * @brief Decode error reported by the *_ex unmarshal functions.\n"
+        " *\n"
+        " * Filled without allocating or formatting; call json_error_format()\n"
+        " * to render a message when one is needed.\n"
+        " */\n"
+        "struct json_error {\n"
+        "    int code;            /* json_gen_error_t, 0 on success */\n"
+        "    long offset;         /* input byte offset of the failure */\n"
+        "    int expected_token;  /* '{' '}' '[' ']' ':' ',' or JSON_EXPECT_* */\n"
+        "};\n\n"
+        "#define JSON_EXPECT_NONE 0\n"
+        "#define JSON_EXPECT_STRING 1\n"
+        "#define JSON_EXPECT_NUMBER 2\n"
+        "#define JSON_EXPECT_VALUE 3\n\n"
+        "/**\n"
+        " * @brief Resource caps for decoding untrusted input.\n"
+        " *\n"
+        " * A zero field means unlimited. A violation fails the decode with\n"
+        " * JSON_GEN_ERROR_BOUNDS before the offending value is allocated.\n"
+        " */\n"
+        "struct json_limits {\n"
+        "    size_t max_input_bytes;  /* length of the whole document */\n"
+        "    size_t max_string_len;   /* bytes of one decoded string or key */\n"
+        "    size_t max_array_len;    /* elements of one array */\n"
+        "    size_t max_map_entries;  /* entries of one map object */\n"
+        "    size_t max_alloc_bytes;  /* bytes allocated by one decode */\n"
+        "};\n\n"
+        "#endif /* JGENC_JSON_DECODE_TYPES_ */\n\n"
+        "/**\n"
+        " * @brief Append a \"line L col C: error: ...\" message for @p err to\n"
+        " * @p out. @p in is the decoded input, used for the position and a\n"
+        " * short excerpt; it may be NULL.\n"
+        " */\n"
+        "int json_error_format(const struct json_error* err, sstr_t in, "
+        "sstr_t out);\n\n"
+        "/**\n"
+        " * @brief Set the limits used by unmarshal calls that are not given\n"
+        " * their own. NULL removes them.\n"
+        " *\n"
+        " * The default is a plain global that every decode reads without a\n"
+        " * lock. Call this before any thread starts decoding and never while\n"
+        " * one may be running. To use different limits per thread or per\n"
+        " * request, pass a struct json_limits to the *_limited functions.\n"
+        " */\n"
+        "void json_gen_c_set_limits(const struct json_limits* limits);\n\n"
+        "/* json_extract() value types (same ids as the schema field types) */\n"
+        "#define JSON_EXTRACT_INT 0     /* int* */\n"
+        "#define JSON_EXTRACT_LONG 1    /* long* */\n"
+        "#define JSON_EXTRACT_FLOAT 2   /* float* */\n"
+        "#define JSON_EXTRACT_DOUBLE 3  /* double* */\n"
+        "#define JSON_EXTRACT_SSTR 4    /* sstr_t, contents replaced */\n"
+        "#define JSON_EXTRACT_BOOL 7    /* int* */\n"
+        "#define JSON_EXTRACT_INT8 9    /* int8_t* ... */\n"
+        "#define JSON_EXTRACT_INT16 10\n"
+        "#define JSON_EXTRACT_INT32 11\n"
+        "#define JSON_EXTRACT_INT64 12\n"
+        "#define JSON_EXTRACT_UINT8 13\n"
+        "#define JSON_EXTRACT_UINT16 14\n"
+        "#define JSON_EXTRACT_UINT32 15\n"
+        "#define JSON_EXTRACT_UINT64 16  /* ... uint64_t* */\n\n"
+        "/**\n"
+        " * @brief Decode only the value at JSON Pointer @p path (RFC 6901,\n"
+        " * e.g. \"/items/3/price\") of the @p len bytes at @p in. Everything\n"
+        " * before it is skipped without being decoded, and the scan stops at\n"
+        " * the value. Nothing is allocated except for a JSON_EXTRACT_SSTR\n"
+        " * result.\n"
+        " * @return 0 on success; JSON_GEN_ERROR_NOT_FOUND if the path does\n"
+        " * not exist, JSON_GEN_ERROR_PARSE for malformed input or a value of\n"
+        " * another type, JSON_GEN_ERROR_BOUNDS if it does not fit @p type.\n"
+        " */\n"
+        "int json_extract(const char* in, size_t len, const char* path, "
+        "int type,\n"
+        "                 void* out);\n\n");
     sstr_append_cstr(
         head,
         "/**\n"
@@ -2599,32 +4320,20 @@ int gencode_head_guard_begin(sstr_t head) {
         "indent, int curindent, sstr_t out);\n"
         "int json_marshal_array_indent_uint64_t(uint64_t* obj, int len, int "
         "indent, int curindent, sstr_t out);\n\n"
-        "#define json_marshal_array_int(obj, len, out) "
-        "json_marshal_array_indent_int(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_long(obj, len, out) "
-        "json_marshal_array_indent_long(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_float(obj, len, out) "
-        "json_marshal_array_indent_float(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_double(obj, len, out) "
-        "json_marshal_array_indent_double(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_sstr_t(obj, len, out) "
-        "json_marshal_array_indent_sstr_t(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_int8_t(obj, len, out) "
-        "json_marshal_array_indent_int8_t(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_int16_t(obj, len, out) "
-        "json_marshal_array_indent_int16_t(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_int32_t(obj, len, out) "
-        "json_marshal_array_indent_int32_t(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_int64_t(obj, len, out) "
-        "json_marshal_array_indent_int64_t(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_uint8_t(obj, len, out) "
-        "json_marshal_array_indent_uint8_t(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_uint16_t(obj, len, out) "
-        "json_marshal_array_indent_uint16_t(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_uint32_t(obj, len, out) "
-        "json_marshal_array_indent_uint32_t(obj, len, 0, 0, out)\n"
-        "#define json_marshal_array_uint64_t(obj, len, out) "
-        "json_marshal_array_indent_uint64_t(obj, len, 0, 0, out)\n\n"
+        "/* compact forms of the above */\n"
+        "int json_marshal_array_int(int* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_long(long* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_float(float* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_double(double* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_sstr_t(sstr_t* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_int8_t(int8_t* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_int16_t(int16_t* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_int32_t(int32_t* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_int64_t(int64_t* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_uint8_t(uint8_t* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_uint16_t(uint16_t* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_uint32_t(uint32_t* obj, int len, sstr_t out);\n"
+        "int json_marshal_array_uint64_t(uint64_t* obj, int len, sstr_t out);\n\n"
 
         "/**\n"
         " * @brief Convert (unmarshal) json string to array of int.\n"
@@ -2719,14 +4428,19 @@ int gencode_source_begin(sstr_t source) {
         "static void* (*jgenc_realloc_fn_)(void*, size_t)                = NULL;\n"
         "static void  (*jgenc_free_fn_)(void*)                           = NULL;\n"
         "\n"
+        "// A thread allocator (jgenc_set_thread_allocator()) wins over the\n"
+        "// json_gen_c_set_alloc() functions.\n"
         "static inline void* jgenc_malloc_dispatch_(size_t sz) {\n"
-        "    return jgenc_malloc_fn_ ? jgenc_malloc_fn_(sz) : malloc(sz);\n"
+        "    return jgenc_malloc_fn_ && !jgenc_thread_allocator()\n"
+        "               ? jgenc_malloc_fn_(sz) : jgenc_malloc(sz);\n"
         "}\n"
         "static inline void* jgenc_realloc_dispatch_(void* p, size_t sz) {\n"
-        "    return jgenc_realloc_fn_ ? jgenc_realloc_fn_(p, sz) : realloc(p, sz);\n"
+        "    return jgenc_realloc_fn_ && !jgenc_thread_allocator()\n"
+        "               ? jgenc_realloc_fn_(p, sz) : jgenc_realloc(p, sz);\n"
         "}\n"
         "static inline void jgenc_free_dispatch_(void* p) {\n"
-        "    if (jgenc_free_fn_) jgenc_free_fn_(p); else free(p);\n"
+        "    if (jgenc_free_fn_ && !jgenc_thread_allocator()) jgenc_free_fn_(p);\n"
+        "    else jgenc_free(p);\n"
         "}\n"
         "\n"
         "#define JGENC_MALLOC(sz)      jgenc_malloc_dispatch_(sz)\n"
@@ -2800,6 +4514,13 @@ static void do_each_oneof_gen_code(void* key, void* value, void* ptr) {
     hash_map_insert(dep_map, sstr_dup(k), NULL);
 }
 
+static void find_cached_struct_fn(void* key, void* value, void* ptr) {
+    (void)key;
+    if (((struct struct_container*)value)->is_cached) {
+        *(int*)ptr = 1;
+    }
+}
+
 int gencode_source(struct hash_map* struct_map, struct hash_map* enum_map,
                    struct hash_map* oneof_map, sstr_t source, sstr_t header) {
     // to ensure the order struct definition on header file, we use a hash map
@@ -2818,6 +4539,7 @@ int gencode_source(struct hash_map* struct_map, struct hash_map* enum_map,
     int i;
     struct do_each_struct_gen_code_param param;
     param.dependency_map = dependency_map;
+    param.struct_map = struct_map;
     param.source = source;
     param.header = header;
 
@@ -2830,6 +4552,13 @@ int gencode_source(struct hash_map* struct_map, struct hash_map* enum_map,
     // includes, and all common functions, scalar type parsing codes.
     gencode_source_begin(source);
 
+    // json_parse.c drops the fragments of @cached structs it decodes into.
+    int any_cached = 0;
+    hash_map_for_each(struct_map, find_cached_struct_fn, &any_cached);
+    if (any_cached) {
+        sstr_append_cstr(source, "#define JSON_HAS_CACHED_STRUCTS 1\n\n");
+    }
+
     // generate enum string arrays (must be before offset map which references them)
     gen_enum_strings(enum_map, source);
 
@@ -133,6 +133,32 @@ static void emit_bool_accessors(sstr_t out, struct struct_field* f,
 static void emit_string_accessors(sstr_t out, struct struct_field* f) {
     const char* fname = sstr_cstr(f->name);
 
+    if (f->is_inline_str) {
+        /* @inline_str: the sstr lives inside data_, never NULL */
+        sstr_printf_append(out,
+                           "    std::string %s() const {\n"
+                           "        sstr_t s = const_cast<struct ::sstr_s*>("
+                           "data_.%s);\n"
+                           "        return std::string(sstr_cstr(s), "
+                           "sstr_length(s));\n"
+                           "    }\n",
+                           fname, fname);
+        sstr_printf_append(out,
+                           "    void set_%s(const std::string& v) {\n"
+                           "        sstr_clear(data_.%s);\n"
+                           "        sstr_append_of(data_.%s, v.data(), "
+                           "v.size());\n"
+                           "    }\n",
+                           fname, fname, fname);
+        sstr_printf_append(out,
+                           "    void set_%s(const char* v) {\n"
+                           "        sstr_clear(data_.%s);\n"
+                           "        sstr_append_cstr(data_.%s, v);\n"
+                           "    }\n",
+                           fname, fname, fname);
+        return;
+    }
+
     /* getter returns std::string; handles NULL sstr_t from _init */
     sstr_append_cstr(out, "    std::string ");
     sstr_append_cstr(out, fname);
@@ -179,6 +205,29 @@ static void emit_string_accessors(sstr_t out, struct struct_field* f) {
     sstr_append_cstr(out, ", v);\n    }\n");
 }
 
+static void emit_fixstr_accessors(sstr_t out, struct struct_field* f) {
+    const char* fname = sstr_cstr(f->name);
+
+    /* str<N>: bytes and length live in data_; too long a value throws */
+    sstr_printf_append(out,
+                       "    std::string %s() const {\n"
+                       "        return std::string(data_.%s, data_.%s_len);\n"
+                       "    }\n",
+                       fname, fname, fname);
+    sstr_printf_append(out,
+                       "    void set_%s(const std::string& v) {\n"
+                       "        if (v.size() > %d) {\n"
+                       "            throw std::length_error(\"%s: longer than "
+                       "str<%d>\");\n"
+                       "        }\n"
+                       "        std::memcpy(data_.%s, v.data(), v.size());\n"
+                       "        data_.%s[v.size()] = '\\0';\n"
+                       "        data_.%s_len = static_cast<uint8_t>(v.size());\n"
+                       "    }\n",
+                       fname, f->str_size, fname, f->str_size, fname, fname,
+                       fname);
+}
+
 static void emit_enum_accessors(sstr_t out, struct struct_field* f) {
     const char* fname = sstr_cstr(f->name);
     const char* tname = sstr_cstr(f->type_name);
@@ -410,6 +459,8 @@ static void emit_field_accessors(sstr_t out, struct struct_field* f,
         emit_dynamic_array_accessors(out, f);
     } else if (f->type == FIELD_TYPE_SSTR) {
         emit_string_accessors(out, f);
+    } else if (f->type == FIELD_TYPE_FIXSTR) {
+        emit_fixstr_accessors(out, f);
     } else if (f->type == FIELD_TYPE_BOOL) {
         emit_bool_accessors(out, f, struct_name);
     } else if (f->type == FIELD_TYPE_ENUM) {
@@ -699,7 +750,10 @@ static void do_each_cpp_struct(void* key, void* value, void* ptr) {
     /* Check struct-typed field dependencies */
     struct struct_field* f = sc->fields;
     while (f) {
-        if (f->type == FIELD_TYPE_STRUCT) {
+        /* A dynamic array of the struct itself is only a pointer */
+        if (f->type == FIELD_TYPE_STRUCT &&
+            !(f->is_array && f->array_size == 0 &&
+              sstr_compare(f->type_name, k) == 0)) {
             if (hash_map_find(dep_map, f->type_name, &dv) != HASH_MAP_OK)
                 return;
         }
@@ -26,6 +26,7 @@ static const char* go_type_for(int field_type) {
         case FIELD_TYPE_DOUBLE: return "float64";
         case FIELD_TYPE_BOOL:   return "bool";
         case FIELD_TYPE_SSTR:   return "string";
+        case FIELD_TYPE_FIXSTR: return "string";
         case FIELD_TYPE_INT8:   return "int8";
         case FIELD_TYPE_INT16:  return "int16";
         case FIELD_TYPE_INT32:  return "int32";
@@ -229,7 +230,7 @@ static void emit_default_func(struct struct_container* sc, struct go_emit_ctx* c
             const char* dv = sstr_cstr(f->default_value);
             int is_opt = f->is_optional || f->is_nullable;
 
-            if (f->type == FIELD_TYPE_SSTR) {
+            if (f->type == FIELD_TYPE_SSTR || f->type == FIELD_TYPE_FIXSTR) {
                 if (is_opt) {
                     sstr_append_cstr(out, "ptrString(\"");
                 } else {
@@ -22,6 +22,10 @@
 /* The effective wire key for a field: @json alias if set, else C name. */
 #define WIRE_KEY(f) sstr_cstr((f)->json_name ? (f)->json_name : (f)->name)
 
+/* Structs with at least this many fields dispatch unpacked keys with a
+ * switch on the key length instead of an if/else chain. */
+#define UNPACK_KEY_SWITCH_MIN_FIELDS 5
+
 /* ── helpers ─────────────────────────────────────────────────────────── */
 
 static void mp_map_c_value_type(struct struct_field *field, sstr_t out) {
@@ -123,6 +127,13 @@ static void mp_gen_struct_header(struct struct_container *st, sstr_t header) {
             sstr_printf_append(header, "int %s%s", ptr_suffix, sstr_cstr(field->name));
         } else if (field->type == FIELD_TYPE_BOOL) {
             sstr_printf_append(header, "int %s%s", ptr_suffix, sstr_cstr(field->name));
+        } else if (field->is_inline_str) {
+            sstr_printf_append(header, "struct sstr_s %s[1]",
+                               sstr_cstr(field->name));
+        } else if (field->type == FIELD_TYPE_FIXSTR) {
+            sstr_printf_append(header, "char %s[%d];\n    uint8_t %s_len",
+                               sstr_cstr(field->name), field->str_size + 1,
+                               sstr_cstr(field->name));
         } else {
             sstr_printf_append(header, "%s %s%s",
                                sstr_cstr(field->type_name),
@@ -161,6 +172,33 @@ static void mp_gen_struct_header(struct struct_container *st, sstr_t header) {
         sstr_cstr(st->name), sstr_cstr(st->name),
         sstr_cstr(st->name), sstr_cstr(st->name),
         sstr_cstr(st->name), sstr_cstr(st->name));
+    sstr_printf_append(
+        header,
+        "/* Same as %s_init(), %s_clear() and msgpack_unpack_%s(), with\n"
+        " * alloc installed as the thread allocator for the call (NULL: the\n"
+        " * calling thread's allocator). Objects do not record their\n"
+        " * allocator: free one with %s_clear_ex() and the alloc that built\n"
+        " * it. */\n"
+        "int %s_init_ex(struct %s *obj, const struct jgenc_allocator *alloc);\n"
+        "int %s_clear_ex(struct %s *obj, const struct jgenc_allocator *alloc);\n"
+        "int msgpack_unpack_%s_ex(const unsigned char *data, size_t len, struct %s *obj,\n"
+        "    const struct jgenc_allocator *alloc);\n\n",
+        sstr_cstr(st->name), sstr_cstr(st->name), sstr_cstr(st->name),
+        sstr_cstr(st->name),
+        sstr_cstr(st->name), sstr_cstr(st->name),
+        sstr_cstr(st->name), sstr_cstr(st->name),
+        sstr_cstr(st->name), sstr_cstr(st->name));
+    sstr_printf_append(
+        header,
+        "/* Same as msgpack_unpack_%s(), but sstr_t fields, array elements and\n"
+        " * map entries (not @inline_str) are sstr_ref() strings into data\n"
+        " * instead of copies. data must outlive obj, and the strings are not\n"
+        " * NUL-terminated: use sstr_length(). %s_clear() frees them as\n"
+        " * usual. */\n"
+        "int msgpack_unpack_%s_borrow(const unsigned char *data, size_t len,\n"
+        "    struct %s *obj);\n\n",
+        sstr_cstr(st->name), sstr_cstr(st->name),
+        sstr_cstr(st->name), sstr_cstr(st->name));
 
     /* field index enum + mask word count */
     int field_count = mp_count_struct_fields(st);
@@ -319,7 +357,7 @@ static void mp_gen_struct_init(struct struct_container *st, sstr_t source) {
 
     struct struct_field *f = st->fields;
     while (f) {
-        if (f->type == FIELD_TYPE_SSTR && !f->is_array) {
+        if (f->type == FIELD_TYPE_SSTR && !f->is_array && !f->is_inline_str) {
             sstr_printf_append(source, "    obj->%s = sstr_new();\n",
                                sstr_cstr(f->name));
         }
@@ -327,6 +365,13 @@ static void mp_gen_struct_init(struct struct_container *st, sstr_t source) {
             if (f->type == FIELD_TYPE_SSTR) {
                 sstr_printf_append(source, "    sstr_append_cstr(obj->%s, \"%s\");\n",
                                    sstr_cstr(f->name), sstr_cstr(f->default_value));
+            } else if (f->type == FIELD_TYPE_FIXSTR) {
+                sstr_printf_append(source,
+                    "    memcpy(obj->%s, \"%s\", sizeof(\"%s\"));\n"
+                    "    obj->%s_len = (uint8_t)(sizeof(\"%s\") - 1);\n",
+                    sstr_cstr(f->name), sstr_cstr(f->default_value),
+                    sstr_cstr(f->default_value), sstr_cstr(f->name),
+                    sstr_cstr(f->default_value));
             } else if (f->type == FIELD_TYPE_ENUM) {
                 sstr_printf_append(source, "    obj->%s = %s_%s;\n",
                                    sstr_cstr(f->name),
@@ -400,7 +445,12 @@ static void mp_gen_struct_clear(struct struct_container *st, sstr_t source) {
         char base[256];
         snprintf(base, sizeof(base), "obj->%s", sstr_cstr(f->name));
 
-        if (f->type == FIELD_TYPE_SSTR && !f->is_array) {
+        if (f->is_inline_str) {
+            sstr_printf_append(source, "    sstr_reset(%s);\n", base);
+        } else if (f->type == FIELD_TYPE_FIXSTR) {
+            sstr_printf_append(source, "    %s[0] = '\\0';\n    %s_len = 0;\n",
+                               base, base);
+        } else if (f->type == FIELD_TYPE_SSTR && !f->is_array) {
             sstr_printf_append(source, "    sstr_free(%s);\n", base);
         } else if (f->type == FIELD_TYPE_STRUCT && !f->is_array) {
             sstr_printf_append(source, "    %s_clear(&%s);\n",
@@ -530,6 +580,10 @@ static void mp_gen_pack_scalar(struct struct_field *f, const char *accessor,
     case FIELD_TYPE_SSTR:
         sstr_printf_append(source, "    mp_pack_sstr(out, %s);\n", accessor);
         break;
+    case FIELD_TYPE_FIXSTR:
+        sstr_printf_append(source, "    mp_pack_str(out, %s, %s_len);\n",
+                           accessor, accessor);
+        break;
     case FIELD_TYPE_ENUM:
         sstr_printf_append(source,
             "    if (%s >= 0 && %s < %s_enum_str_count) {\n"
@@ -599,11 +653,60 @@ static void mp_gen_pack_map_value(struct struct_field *field,
     }
 }
 
+/* Size of the msgpack str header for a string of \a len bytes. */
+static int mp_str_header_size(int len) {
+    return len <= 31 ? 1 : (len <= 0xff ? 2 : 3);
+}
+
+/* Encoded size of one element of field \a f when every value of its type
+ * takes the same number of bytes, else 0. */
+static int mp_fixed_elem_size(struct struct_field *f) {
+    switch (f->type) {
+    case FIELD_TYPE_FLOAT:
+        return 5;
+    case FIELD_TYPE_DOUBLE:
+        return 9;
+    case FIELD_TYPE_BOOL:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Lower bound of the bytes msgpack_pack_<S>() writes for \a st, known when
+ * the code is generated: the map header, every key that is always
+ * present, and at least one byte per value (all of it for fixed-width
+ * scalars and fixed-size arrays of them). */
+static int mp_struct_min_size(struct struct_container *st) {
+    int n = 5;
+    for (struct struct_field *f = st->fields; f; f = f->next) {
+        const char *wire_key = WIRE_KEY(f);
+        int key_len = (int)strlen(wire_key);
+        int elem = mp_fixed_elem_size(f);
+        if (f->is_optional) {
+            n += st->is_compact;  // nil placeholder
+            continue;
+        }
+        if (!st->is_compact) {
+            n += mp_str_header_size(key_len) + key_len;
+        }
+        if (f->is_nullable || f->type == FIELD_TYPE_MAP) {
+            n += 1;
+        } else if (f->is_array) {
+            n += 1 + (f->array_size > 0 ? f->array_size * elem : 0);
+        } else {
+            n += elem > 0 ? elem : 1;
+        }
+    }
+    return n;
+}
+
 static void mp_gen_pack_struct(struct struct_container *st, sstr_t source) {
     /* Count fields to pack (skip optional fields dynamically). */
     sstr_printf_append(source,
-        "int msgpack_pack_%s(struct %s *obj, sstr_t out) {\n",
-        sstr_cstr(st->name), sstr_cstr(st->name));
+        "int msgpack_pack_%s(struct %s *obj, sstr_t out) {\n"
+        "    (void)sstr_reserve_fast(out, %d);\n",
+        sstr_cstr(st->name), sstr_cstr(st->name), mp_struct_min_size(st));
 
     /* We need to count the actual number of fields at runtime for optional. */
     int has_optional = 0;
@@ -611,7 +714,11 @@ static void mp_gen_pack_struct(struct struct_container *st, sstr_t source) {
     int total_fields = 0;
     while (f) { total_fields++; if (f->is_optional) has_optional = 1; f = f->next; }
 
-    if (has_optional) {
+    if (st->is_compact) {
+        /* @compact: every field has a slot, absent ones hold nil */
+        sstr_printf_append(source,
+            "    mp_pack_array_header(out, %d);\n", total_fields);
+    } else if (has_optional) {
         sstr_printf_append(source, "    int _nfields = %d;\n", total_fields);
         f = st->fields;
         while (f) {
@@ -639,8 +746,10 @@ static void mp_gen_pack_struct(struct struct_container *st, sstr_t source) {
         }
 
         /* Pack key */
-        sstr_printf_append(source,
-            "    mp_pack_str(out, \"%s\", %d);\n", wire_key, key_len);
+        if (!st->is_compact) {
+            sstr_printf_append(source,
+                "    mp_pack_str(out, \"%s\", %d);\n", wire_key, key_len);
+        }
 
         /* Pack value */
         if (f->is_nullable) {
@@ -673,6 +782,11 @@ static void mp_gen_pack_struct(struct struct_container *st, sstr_t source) {
                     "    for (int _ai = 0; _ai < %d; _ai++) {\n",
                     f->array_size, f->array_size);
             } else {
+                if (mp_fixed_elem_size(f) > 0) {
+                    sstr_printf_append(source,
+                        "    (void)sstr_reserve_fast(out, 5 + (size_t)obj->%s_len * %d);\n",
+                        sstr_cstr(f->name), mp_fixed_elem_size(f));
+                }
                 sstr_printf_append(source,
                     "    mp_pack_array_header(out, (uint32_t)obj->%s_len);\n"
                     "    for (int _ai = 0; _ai < obj->%s_len; _ai++) {\n",
@@ -694,7 +808,12 @@ static void mp_gen_pack_struct(struct struct_container *st, sstr_t source) {
         if (f->is_nullable) {
             sstr_append_cstr(source, "    }\n");
         }
-        if (f->is_optional) {
+        if (f->is_optional && st->is_compact) {
+            sstr_append_cstr(source,
+                "    } else {\n"
+                "        mp_pack_nil(out);\n"
+                "    }\n");
+        } else if (f->is_optional) {
             sstr_append_cstr(source, "    }\n");
         }
         f = f->next;
@@ -755,12 +874,30 @@ static void mp_gen_unpack_scalar(struct struct_field *f, const char *accessor,
             "      %s = _v; }\n", accessor);
         break;
     case FIELD_TYPE_SSTR:
+        if (f->is_inline_str) {
+            /* stored in the struct: always a copy, never borrowed */
+            sstr_printf_append(source,
+                "    { const char *_s; uint32_t _sl;\n"
+                "      if (mp_unpack_str(&_r, &_s, &_sl) < 0) return -1;\n"
+                "      sstr_clear_fast(%s);\n"
+                "      sstr_append_of_fast(%s, _s, _sl); }\n",
+                accessor, accessor);
+        } else {
+            sstr_printf_append(source,
+                "    { const char *_s; uint32_t _sl;\n"
+                "      if (mp_unpack_str(&_r, &_s, &_sl) < 0) return -1;\n"
+                "      mp_store_sstr(%s, _s, _sl); }\n",
+                accessor);
+        }
+        break;
+    case FIELD_TYPE_FIXSTR:
         sstr_printf_append(source,
             "    { const char *_s; uint32_t _sl;\n"
-            "      if (mp_unpack_str(&_r, &_s, &_sl) < 0) return -1;\n"
-            "      sstr_clear(%s);\n"
-            "      sstr_append_of(%s, _s, _sl); }\n",
-            accessor, accessor);
+            "      if (mp_unpack_str(&_r, &_s, &_sl) < 0 || _sl > %d) return -1;\n"
+            "      memcpy(%s, _s, _sl);\n"
+            "      %s[_sl] = '\\0';\n"
+            "      %s_len = (uint8_t)_sl; }\n",
+            f->str_size, accessor, accessor, accessor);
         break;
     case FIELD_TYPE_ENUM:
         sstr_printf_append(source,
@@ -834,130 +971,81 @@ static void mp_gen_unpack_map_value(struct struct_field *field,
     }
 }
 
-static void mp_gen_unpack_struct(struct struct_container *st, sstr_t source) {
-    sstr_printf_append(source,
-        "int msgpack_unpack_%s(const unsigned char *data, size_t len, struct %s *obj) {\n"
-        "    struct mp_reader _r;\n"
-        "    mp_reader_init(&_r, data, len);\n"
-        "    uint32_t _nfields;\n"
-        "    if (mp_unpack_map_header(&_r, &_nfields) < 0) return -1;\n"
-        "    for (uint32_t _fi = 0; _fi < _nfields; _fi++) {\n"
-        "        const char *_key; uint32_t _klen;\n"
-        "        if (mp_unpack_str(&_r, &_key, &_klen) < 0) return -1;\n",
-        sstr_cstr(st->name), sstr_cstr(st->name));
+/* Decode the value of one field; the key has been matched. In @compact
+ * structs an optional field's slot holds nil when the field is absent. */
+static void mp_gen_unpack_field(struct struct_field *f, int compact,
+                                sstr_t source) {
+    int nil_means_absent = f->is_nullable || (compact && f->is_optional);
 
-    /* Field dispatch by key name. */
-    struct struct_field *f = st->fields;
-    int first = 1;
-    while (f) {
-        const char *wire_key = WIRE_KEY(f);
+    /* Handle nullable */
+    if (nil_means_absent) {
         sstr_printf_append(source,
-            "        %sif (_klen == %d && memcmp(_key, \"%s\", %d) == 0) {\n",
-            first ? "" : "} else ", (int)strlen(wire_key), wire_key,
-            (int)strlen(wire_key));
-        first = 0;
-
-        /* Handle nullable */
-        if (f->is_nullable) {
-            sstr_printf_append(source,
-                "            if (mp_peek(&_r) == MP_NIL) {\n"
-                "                mp_unpack_nil(&_r);\n"
-                "                obj->has_%s = 0;\n"
-                "            } else {\n"
-                "                obj->has_%s = 1;\n",
-                sstr_cstr(f->name), sstr_cstr(f->name));
-        }
+            "            if (mp_peek(&_r) == MP_NIL) {\n"
+            "                mp_unpack_nil(&_r);\n"
+            "                obj->has_%s = 0;\n"
+            "            } else {\n"
+            "                obj->has_%s = 1;\n",
+            sstr_cstr(f->name), sstr_cstr(f->name));
+    }
 
-        if (f->is_optional && !f->is_nullable) {
-            sstr_printf_append(source, "            obj->has_%s = 1;\n",
-                               sstr_cstr(f->name));
-        }
+    if (f->is_optional && !nil_means_absent) {
+        sstr_printf_append(source, "            obj->has_%s = 1;\n",
+                           sstr_cstr(f->name));
+    }
 
-        char accessor[256];
-        snprintf(accessor, sizeof(accessor), "obj->%s", sstr_cstr(f->name));
+    char accessor[256];
+    snprintf(accessor, sizeof(accessor), "obj->%s", sstr_cstr(f->name));
 
-        if (f->type == FIELD_TYPE_MAP && !f->is_array) {
-            /* map field */
+    if (f->type == FIELD_TYPE_MAP && !f->is_array) {
+        /* map field */
+        sstr_printf_append(source,
+            "            { uint32_t _mc;\n"
+            "              if (mp_unpack_map_header(&_r, &_mc) < 0) return -1;\n"
+            "              %s.entries = (struct map_entry_%s *)JGENC_MALLOC(sizeof(struct map_entry_%s) * (_mc > 0 ? _mc : 1));\n"
+            "              %s.len = (int)_mc;\n"
+            "              for (uint32_t _mi = 0; _mi < _mc; _mi++) {\n"
+            "                  const char *_mk; uint32_t _mkl;\n"
+            "                  if (mp_unpack_str(&_r, &_mk, &_mkl) < 0) return -1;\n"
+            "                  %s.entries[_mi].key = mp_new_sstr(_mk, _mkl);\n",
+            accessor, mp_map_suffix(f), mp_map_suffix(f),
+            accessor, accessor);
+        if (f->map_value_type == FIELD_TYPE_SSTR) {
             sstr_printf_append(source,
-                "            { uint32_t _mc;\n"
-                "              if (mp_unpack_map_header(&_r, &_mc) < 0) return -1;\n"
-                "              %s.entries = (struct map_entry_%s *)JGENC_MALLOC(sizeof(struct map_entry_%s) * (_mc > 0 ? _mc : 1));\n"
-                "              %s.len = (int)_mc;\n"
-                "              for (uint32_t _mi = 0; _mi < _mc; _mi++) {\n"
-                "                  const char *_mk; uint32_t _mkl;\n"
-                "                  if (mp_unpack_str(&_r, &_mk, &_mkl) < 0) return -1;\n"
-                "                  %s.entries[_mi].key = sstr_of(_mk, _mkl);\n",
-                accessor, mp_map_suffix(f), mp_map_suffix(f),
-                accessor, accessor);
-            if (f->map_value_type == FIELD_TYPE_SSTR) {
-                sstr_printf_append(source,
-                    "                  %s.entries[_mi].value = sstr_new();\n", accessor);
-            }
-            char val_acc[300];
-            snprintf(val_acc, sizeof(val_acc), "%s.entries[_mi].value", accessor);
-            mp_gen_unpack_map_value(f, val_acc, source);
-            sstr_append_cstr(source, "              }\n            }\n");
-        } else if (f->is_array) {
-            if (f->array_size > 0) {
-                /* fixed array */
+                "                  %s.entries[_mi].value = sstr_new();\n", accessor);
+        }
+        char val_acc[300];
+        snprintf(val_acc, sizeof(val_acc), "%s.entries[_mi].value", accessor);
+        mp_gen_unpack_map_value(f, val_acc, source);
+        sstr_append_cstr(source, "              }\n            }\n");
+    } else if (f->is_array) {
+        if (f->array_size > 0) {
+            /* fixed array */
+            sstr_printf_append(source,
+                "            { uint32_t _ac;\n"
+                "              if (mp_unpack_array_header(&_r, &_ac) < 0) return -1;\n"
+                "              for (uint32_t _ai = 0; _ai < _ac && _ai < %d; _ai++) {\n",
+                f->array_size);
+        } else {
+            /* dynamic array */
+            const char *c_type;
+            if (f->type == FIELD_TYPE_STRUCT) {
+                /* need "struct TypeName" */
+                sstr_t ct = sstr_new();
+                sstr_printf_append(ct, "struct %s", sstr_cstr(f->type_name));
                 sstr_printf_append(source,
                     "            { uint32_t _ac;\n"
                     "              if (mp_unpack_array_header(&_r, &_ac) < 0) return -1;\n"
-                    "              for (uint32_t _ai = 0; _ai < _ac && _ai < %d; _ai++) {\n",
-                    f->array_size);
-            } else {
-                /* dynamic array */
-                const char *c_type;
-                if (f->type == FIELD_TYPE_STRUCT) {
-                    /* need "struct TypeName" */
-                    sstr_t ct = sstr_new();
-                    sstr_printf_append(ct, "struct %s", sstr_cstr(f->type_name));
-                    sstr_printf_append(source,
-                        "            { uint32_t _ac;\n"
-                        "              if (mp_unpack_array_header(&_r, &_ac) < 0) return -1;\n"
-                        "              %s = (%s *)JGENC_MALLOC(sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
-                        "              memset(%s, 0, sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
-                        "              obj->%s_len = (int)_ac;\n"
-                        "              for (uint32_t _ai = 0; _ai < _ac; _ai++) {\n",
-                        accessor, sstr_cstr(ct), sstr_cstr(ct),
-                        accessor, sstr_cstr(ct), sstr_cstr(f->name));
-                    sstr_free(ct);
-                    goto emit_elem;
-                } else if (f->type == FIELD_TYPE_ONEOF) {
-                    sstr_t ct = sstr_new();
-                    sstr_printf_append(ct, "struct %s", sstr_cstr(f->type_name));
-                    sstr_printf_append(source,
-                        "            { uint32_t _ac;\n"
-                        "              if (mp_unpack_array_header(&_r, &_ac) < 0) return -1;\n"
-                        "              %s = (%s *)JGENC_MALLOC(sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
-                        "              memset(%s, 0, sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
-                        "              obj->%s_len = (int)_ac;\n"
-                        "              for (uint32_t _ai = 0; _ai < _ac; _ai++) {\n",
-                        accessor, sstr_cstr(ct), sstr_cstr(ct),
-                        accessor, sstr_cstr(ct), sstr_cstr(f->name));
-                    sstr_free(ct);
-                    goto emit_elem;
-                } else if (f->type == FIELD_TYPE_MAP) {
-                    sstr_t ct = sstr_new();
-                    sstr_printf_append(ct, "struct map_container_%s", mp_map_suffix(f));
-                    sstr_printf_append(source,
-                        "            { uint32_t _ac;\n"
-                        "              if (mp_unpack_array_header(&_r, &_ac) < 0) return -1;\n"
-                        "              %s = (%s *)JGENC_MALLOC(sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
-                        "              memset(%s, 0, sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
-                        "              obj->%s_len = (int)_ac;\n"
-                        "              for (uint32_t _ai = 0; _ai < _ac; _ai++) {\n",
-                        accessor, sstr_cstr(ct), sstr_cstr(ct),
-                        accessor, sstr_cstr(ct), sstr_cstr(f->name));
-                    sstr_free(ct);
-                    goto emit_elem;
-                } else if (f->type == FIELD_TYPE_ENUM || f->type == FIELD_TYPE_BOOL) {
-                    c_type = "int";
-                } else if (f->type == FIELD_TYPE_SSTR) {
-                    c_type = "sstr_t";
-                } else {
-                    c_type = sstr_cstr(f->type_name);
-                }
+                    "              %s = (%s *)JGENC_MALLOC(sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
+                    "              memset(%s, 0, sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
+                    "              obj->%s_len = (int)_ac;\n"
+                    "              for (uint32_t _ai = 0; _ai < _ac; _ai++) {\n",
+                    accessor, sstr_cstr(ct), sstr_cstr(ct),
+                    accessor, sstr_cstr(ct), sstr_cstr(f->name));
+                sstr_free(ct);
+                goto emit_elem;
+            } else if (f->type == FIELD_TYPE_ONEOF) {
+                sstr_t ct = sstr_new();
+                sstr_printf_append(ct, "struct %s", sstr_cstr(f->type_name));
                 sstr_printf_append(source,
                     "            { uint32_t _ac;\n"
                     "              if (mp_unpack_array_header(&_r, &_ac) < 0) return -1;\n"
@@ -965,52 +1053,169 @@ static void mp_gen_unpack_struct(struct struct_container *st, sstr_t source) {
                     "              memset(%s, 0, sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
                     "              obj->%s_len = (int)_ac;\n"
                     "              for (uint32_t _ai = 0; _ai < _ac; _ai++) {\n",
-                    accessor, c_type, c_type,
-                    accessor, c_type, sstr_cstr(f->name));
-            }
-emit_elem:;
-            char elem_acc[300];
-            snprintf(elem_acc, sizeof(elem_acc), "%s[_ai]", accessor);
-            if (f->type == FIELD_TYPE_SSTR) {
-                sstr_printf_append(source,
-                    "                  %s = sstr_new();\n", elem_acc);
-            }
-            struct struct_field elem_f = *f;
-            elem_f.is_array = 0;
-            mp_gen_unpack_scalar(&elem_f, elem_acc, source);
-            if (f->array_size > 0) {
-                /* skip remaining if more than fixed size */
+                    accessor, sstr_cstr(ct), sstr_cstr(ct),
+                    accessor, sstr_cstr(ct), sstr_cstr(f->name));
+                sstr_free(ct);
+                goto emit_elem;
+            } else if (f->type == FIELD_TYPE_MAP) {
+                sstr_t ct = sstr_new();
+                sstr_printf_append(ct, "struct map_container_%s", mp_map_suffix(f));
                 sstr_printf_append(source,
-                    "              }\n"
-                    "              for (uint32_t _ai = %d; _ai < _ac; _ai++) mp_unpack_skip(&_r);\n"
-                    "            }\n",
-                    f->array_size);
+                    "            { uint32_t _ac;\n"
+                    "              if (mp_unpack_array_header(&_r, &_ac) < 0) return -1;\n"
+                    "              %s = (%s *)JGENC_MALLOC(sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
+                    "              memset(%s, 0, sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
+                    "              obj->%s_len = (int)_ac;\n"
+                    "              for (uint32_t _ai = 0; _ai < _ac; _ai++) {\n",
+                    accessor, sstr_cstr(ct), sstr_cstr(ct),
+                    accessor, sstr_cstr(ct), sstr_cstr(f->name));
+                sstr_free(ct);
+                goto emit_elem;
+            } else if (f->type == FIELD_TYPE_ENUM || f->type == FIELD_TYPE_BOOL) {
+                c_type = "int";
+            } else if (f->type == FIELD_TYPE_SSTR) {
+                c_type = "sstr_t";
             } else {
-                sstr_append_cstr(source, "              }\n            }\n");
+                c_type = sstr_cstr(f->type_name);
             }
+            sstr_printf_append(source,
+                "            { uint32_t _ac;\n"
+                "              if (mp_unpack_array_header(&_r, &_ac) < 0) return -1;\n"
+                "              %s = (%s *)JGENC_MALLOC(sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
+                "              memset(%s, 0, sizeof(%s) * (_ac > 0 ? _ac : 1));\n"
+                "              obj->%s_len = (int)_ac;\n"
+                "              for (uint32_t _ai = 0; _ai < _ac; _ai++) {\n",
+                accessor, c_type, c_type,
+                accessor, c_type, sstr_cstr(f->name));
+        }
+emit_elem:;
+        char elem_acc[300];
+        snprintf(elem_acc, sizeof(elem_acc), "%s[_ai]", accessor);
+        if (f->type == FIELD_TYPE_SSTR) {
+            sstr_printf_append(source,
+                "                  %s = sstr_new();\n", elem_acc);
+        }
+        struct struct_field elem_f = *f;
+        elem_f.is_array = 0;
+        mp_gen_unpack_scalar(&elem_f, elem_acc, source);
+        if (f->array_size > 0) {
+            /* skip remaining if more than fixed size */
+            sstr_printf_append(source,
+                "              }\n"
+                "              for (uint32_t _ai = %d; _ai < _ac; _ai++) mp_unpack_skip(&_r);\n"
+                "            }\n",
+                f->array_size);
         } else {
-            if (f->type == FIELD_TYPE_SSTR) {
-                /* sstr_t fields may need init if not yet allocated */
-                sstr_printf_append(source,
-                    "            if (%s == NULL) %s = sstr_new();\n",
-                    accessor, accessor);
-            }
-            sstr_printf_append(source, "    ");
-            mp_gen_unpack_scalar(f, accessor, source);
+            sstr_append_cstr(source, "              }\n            }\n");
         }
-
-        if (f->is_nullable) {
-            sstr_append_cstr(source, "            }\n");  /* close else */
+    } else {
+        if (f->type == FIELD_TYPE_SSTR && !f->is_inline_str) {
+            /* sstr_t fields may need init if not yet allocated */
+            sstr_printf_append(source,
+                "            if (%s == NULL) %s = sstr_new();\n",
+                accessor, accessor);
         }
+        sstr_printf_append(source, "    ");
+        mp_gen_unpack_scalar(f, accessor, source);
+    }
 
-        f = f->next;
+    if (nil_means_absent) {
+        sstr_append_cstr(source, "            }\n");  /* close else */
     }
+}
+
+static void mp_gen_unpack_struct(struct struct_container *st, sstr_t source) {
+    sstr_printf_append(source,
+        "int msgpack_unpack_%s(const unsigned char *data, size_t len, struct %s *obj) {\n"
+        "    struct mp_reader _r;\n"
+        "    mp_reader_init(&_r, data, len);\n"
+        "    uint32_t _nfields;\n",
+        sstr_cstr(st->name), sstr_cstr(st->name));
 
-    if (!first) {
+    if (st->is_compact) {
+        /* @compact: fields by position. Trailing elements added by a newer
+         * schema are skipped; a keyed map (the non-compact encoding) is
+         * still accepted below. */
+        struct struct_field *pf;
+        int pi = 0;
         sstr_append_cstr(source,
-            "        } else {\n"
-            "            mp_unpack_skip(&_r);\n"
-            "        }\n");
+            "    int _b0 = mp_peek(&_r);\n"
+            "    if ((_b0 & 0xf0) == MP_FIXARRAY || _b0 == MP_ARRAY16 ||\n"
+            "        _b0 == MP_ARRAY32) {\n"
+            "      if (mp_unpack_array_header(&_r, &_nfields) < 0) return -1;\n"
+            "      for (uint32_t _fi = 0; _fi < _nfields; _fi++) {\n"
+            "        switch (_fi) {\n");
+        for (pf = st->fields; pf; pf = pf->next, pi++) {
+            sstr_printf_append(source, "        case %d: {\n", pi);
+            mp_gen_unpack_field(pf, 1, source);
+            sstr_append_cstr(source,
+                "            continue;\n"
+                "        }\n");
+        }
+        sstr_append_cstr(source,
+            "        }\n"
+            "        if (mp_unpack_skip(&_r) < 0) return -1;\n"
+            "      }\n"
+            "      return 0;\n"
+            "    }\n");
+    }
+
+    sstr_append_cstr(source,
+        "    if (mp_unpack_map_header(&_r, &_nfields) < 0) return -1;\n"
+        "    for (uint32_t _fi = 0; _fi < _nfields; _fi++) {\n"
+        "        const char *_key; uint32_t _klen;\n"
+        "        if (mp_unpack_str(&_r, &_key, &_klen) < 0) return -1;\n");
+
+    /* Field dispatch by key name. Small structs test each key in turn;
+     * wider ones switch on the key length first, and the fixed-length
+     * memcmp() calls compile to a few word compares. */
+    struct struct_field *f;
+    int nfields = 0;
+    for (f = st->fields; f; f = f->next) nfields++;
+
+    if (nfields < UNPACK_KEY_SWITCH_MIN_FIELDS) {
+        int first = 1;
+        for (f = st->fields; f; f = f->next) {
+            const char *wire_key = WIRE_KEY(f);
+            sstr_printf_append(source,
+                "        %sif (_klen == %d && memcmp(_key, \"%s\", %d) == 0) {\n",
+                first ? "" : "} else ", (int)strlen(wire_key), wire_key,
+                (int)strlen(wire_key));
+            first = 0;
+            mp_gen_unpack_field(f, st->is_compact, source);
+        }
+        if (!first) {
+            sstr_append_cstr(source,
+                "        } else {\n"
+                "            mp_unpack_skip(&_r);\n"
+                "        }\n");
+        }
+    } else {
+        sstr_append_cstr(source, "        switch (_klen) {\n");
+        for (f = st->fields; f; f = f->next) {
+            int klen = (int)strlen(WIRE_KEY(f));
+            struct struct_field *g;
+            for (g = st->fields; g != f; g = g->next) {
+                if ((int)strlen(WIRE_KEY(g)) == klen) break;
+            }
+            if (g != f) continue;  // this length already has its case
+            sstr_printf_append(source, "        case %d:\n", klen);
+            for (g = f; g; g = g->next) {
+                const char *wire_key = WIRE_KEY(g);
+                if ((int)strlen(wire_key) != klen) continue;
+                sstr_printf_append(source,
+                    "        if (memcmp(_key, \"%s\", %d) == 0) {\n",
+                    wire_key, klen);
+                mp_gen_unpack_field(g, st->is_compact, source);
+                sstr_append_cstr(source,
+                    "            continue;\n"
+                    "        }\n");
+            }
+            sstr_append_cstr(source, "        break;\n");
+        }
+        sstr_append_cstr(source,
+            "        }\n"
+            "        mp_unpack_skip(&_r);\n");
     }
 
     sstr_append_cstr(source,
@@ -1108,7 +1313,7 @@ static void mp_gen_oneof_pack(struct oneof_container *oc, sstr_t source) {
         "    }\n"
         "    /* append variant fields (raw bytes after map header) */\n"
         "    if (sstr_length(_tmp) > 0 && _cr.pos < sstr_length(_tmp)) {\n"
-        "        sstr_append_of(out, sstr_cstr(_tmp) + _cr.pos, sstr_length(_tmp) - _cr.pos);\n"
+        "        sstr_append_of_fast(out, sstr_cstr(_tmp) + _cr.pos, sstr_length(_tmp) - _cr.pos);\n"
         "    }\n"
         "    sstr_free(_tmp);\n"
         "    return 0;\n}\n\n",
@@ -1216,6 +1421,47 @@ static void mp_gen_oneof_unpack_array(struct oneof_container *oc, sstr_t source)
 
 /* ── per-struct / per-oneof codegen ─────────────────────────────────── */
 
+/* ── allocator wrappers ─────────────────────────────────────────────── */
+
+/* Wrapper that runs call with alloc installed as the thread allocator. */
+static void mp_gen_alloc_wrapper(sstr_t source, sstr_t signature, sstr_t call) {
+    sstr_printf_append(source,
+        "%s {\n"
+        "    const struct jgenc_allocator *_prev =\n"
+        "        alloc ? jgenc_set_thread_allocator(alloc) : jgenc_thread_allocator();\n"
+        "    int _r = %s;\n"
+        "    jgenc_set_thread_allocator(_prev);\n"
+        "    return _r;\n"
+        "}\n\n",
+        sstr_cstr(signature), sstr_cstr(call));
+    sstr_free(signature);
+    sstr_free(call);
+}
+
+static void mp_gen_alloc_wrappers(struct struct_container *st, sstr_t source) {
+    const char *n = sstr_cstr(st->name);
+    mp_gen_alloc_wrapper(source,
+        sstr_printf("int %s_init_ex(struct %s *obj, const struct jgenc_allocator *alloc)", n, n),
+        sstr_printf("%s_init(obj)", n));
+    mp_gen_alloc_wrapper(source,
+        sstr_printf("int %s_clear_ex(struct %s *obj, const struct jgenc_allocator *alloc)", n, n),
+        sstr_printf("%s_clear(obj)", n));
+    mp_gen_alloc_wrapper(source,
+        sstr_printf("int msgpack_unpack_%s_ex(const unsigned char *data, size_t len, "
+                    "struct %s *obj, const struct jgenc_allocator *alloc)", n, n),
+        sstr_printf("msgpack_unpack_%s(data, len, obj)", n));
+    sstr_printf_append(source,
+        "int msgpack_unpack_%s_borrow(const unsigned char *data, size_t len,\n"
+        "    struct %s *obj) {\n"
+        "    int _prev = mp_borrow_strs;\n"
+        "    mp_borrow_strs = 1;\n"
+        "    int _r = msgpack_unpack_%s(data, len, obj);\n"
+        "    mp_borrow_strs = _prev;\n"
+        "    return _r;\n"
+        "}\n\n",
+        n, n, n);
+}
+
 static void mp_gen_code_struct(struct struct_container *st, sstr_t source,
                                sstr_t header) {
     mp_gen_struct_header(st, header);
@@ -1225,6 +1471,7 @@ static void mp_gen_code_struct(struct struct_container *st, sstr_t source,
     mp_gen_unpack_struct(st, source);
     mp_gen_pack_array(st, source);
     mp_gen_unpack_array(st, source);
+    mp_gen_alloc_wrappers(st, source);
 }
 
 static void mp_gen_code_oneof(struct oneof_container *oc, sstr_t source,
@@ -1330,6 +1577,26 @@ static void mp_head_begin(sstr_t head) {
         "                          void  (*free_fn)(void*));\n"
         "#endif\n\n");
 
+    /* Stream framing API */
+    sstr_append_cstr(head,
+        "/* Framing a byte stream of back-to-back messages: msgpack_frame_next()\n"
+        " * finds where the message at the start of data ends, without decoding\n"
+        " * it. Start from a zeroed struct msgpack_frame. Returns 1 and sets\n"
+        " * *msg_len once the message is complete, and resets the frame for the\n"
+        " * next one. Returns 0 when more bytes are needed: the frame keeps its\n"
+        " * progress, so call again with the same message start and more bytes;\n"
+        " * the message is at least pos + pending bytes long. Returns -1 if the\n"
+        " * data is not MessagePack. */\n"
+        "struct msgpack_frame {\n"
+        "    size_t pos;        /* bytes of the message scanned so far */\n"
+        "    uint64_t pending;  /* values still to scan */\n"
+        "};\n"
+        "int msgpack_frame_next(struct msgpack_frame *fr, const unsigned char *data,\n"
+        "    size_t len, size_t *msg_len);\n"
+        "/* msgpack_frame_next() from a zeroed frame, for a one-off check. */\n"
+        "int msgpack_message_length(const unsigned char *data, size_t len,\n"
+        "    size_t *msg_len);\n\n");
+
     /* Field mask macros (same as JSON) */
     sstr_append_cstr(head,
         "#define JSON_GEN_C_FIELD_MASK_WORD_COUNT(field_count) \\\n"
@@ -1376,13 +1643,16 @@ static void mp_source_begin(sstr_t source) {
         "static void* (*jgenc_realloc_fn_)(void*, size_t) = NULL;\n"
         "static void  (*jgenc_free_fn_)(void*) = NULL;\n\n"
         "static inline void* jgenc_malloc_dispatch_(size_t s) {\n"
-        "    return jgenc_malloc_fn_ ? jgenc_malloc_fn_(s) : malloc(s);\n"
+        "    return jgenc_malloc_fn_ && !jgenc_thread_allocator()\n"
+        "               ? jgenc_malloc_fn_(s) : jgenc_malloc(s);\n"
         "}\n"
         "static inline void* jgenc_realloc_dispatch_(void *p, size_t s) {\n"
-        "    return jgenc_realloc_fn_ ? jgenc_realloc_fn_(p, s) : realloc(p, s);\n"
+        "    return jgenc_realloc_fn_ && !jgenc_thread_allocator()\n"
+        "               ? jgenc_realloc_fn_(p, s) : jgenc_realloc(p, s);\n"
         "}\n"
         "static inline void jgenc_free_dispatch_(void *p) {\n"
-        "    jgenc_free_fn_ ? jgenc_free_fn_(p) : free(p);\n"
+        "    if (jgenc_free_fn_ && !jgenc_thread_allocator()) jgenc_free_fn_(p);\n"
+        "    else jgenc_free(p);\n"
         "}\n\n"
         "#define JGENC_MALLOC(s)    jgenc_malloc_dispatch_(s)\n"
         "#define JGENC_REALLOC(p,s) jgenc_realloc_dispatch_((p),(s))\n"
@@ -1406,6 +1676,25 @@ static void mp_source_begin(sstr_t source) {
     sstr_append_of(source, (const char *)msgpack_codec_c,
                    (size_t)msgpack_codec_c_len);
     sstr_append_cstr(source, "\n");
+
+    sstr_append_cstr(source,
+        "int msgpack_frame_next(struct msgpack_frame *fr, const unsigned char *data,\n"
+        "    size_t len, size_t *msg_len) {\n"
+        "    int rc;\n"
+        "    if (fr->pos == 0 && fr->pending == 0) fr->pending = 1;\n"
+        "    rc = mp_frame_scan(data, len, &fr->pos, &fr->pending);\n"
+        "    if (rc == 1) {\n"
+        "        *msg_len = fr->pos;\n"
+        "        fr->pos = 0;\n"
+        "        fr->pending = 0;\n"
+        "    }\n"
+        "    return rc;\n"
+        "}\n\n"
+        "int msgpack_message_length(const unsigned char *data, size_t len,\n"
+        "    size_t *msg_len) {\n"
+        "    struct msgpack_frame fr = {0, 0};\n"
+        "    return msgpack_frame_next(&fr, data, len, msg_len);\n"
+        "}\n\n");
 }
 
 /* ── public entry point ─────────────────────────────────────────────── */
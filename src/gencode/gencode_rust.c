@@ -26,6 +26,7 @@ static const char* rust_type_for(int field_type) {
         case FIELD_TYPE_DOUBLE: return "f64";
         case FIELD_TYPE_BOOL:   return "bool";
         case FIELD_TYPE_SSTR:   return "String";
+        case FIELD_TYPE_FIXSTR: return "String";
         case FIELD_TYPE_INT8:   return "i8";
         case FIELD_TYPE_INT16:  return "i16";
         case FIELD_TYPE_INT32:  return "i32";
@@ -132,7 +133,7 @@ static void emit_default_expr(sstr_t out, struct struct_field* f) {
     const char* dv = sstr_cstr(f->default_value);
     if (f->type == FIELD_TYPE_BOOL) {
         sstr_append_cstr(out, dv);
-    } else if (f->type == FIELD_TYPE_SSTR) {
+    } else if (f->type == FIELD_TYPE_SSTR || f->type == FIELD_TYPE_FIXSTR) {
         sstr_append_cstr(out, "String::from(\"");
         sstr_append_cstr(out, dv);
         sstr_append_cstr(out, "\")");
@@ -297,7 +298,8 @@ static void emit_struct(struct struct_container* sc, struct rust_gen_ctx* ctx) {
                 }
             } else if (f->has_default) {
                 emit_default_expr(out, f);
-            } else if (f->type == FIELD_TYPE_SSTR && !f->is_array) {
+            } else if ((f->type == FIELD_TYPE_SSTR ||
+                        f->type == FIELD_TYPE_FIXSTR) && !f->is_array) {
                 sstr_append_cstr(out, "String::new()");
             } else if (f->type == FIELD_TYPE_BOOL && !f->is_array) {
                 sstr_append_cstr(out, "false");
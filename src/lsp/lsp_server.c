@@ -159,7 +159,7 @@ static void validate_document(FILE *out, struct lsp_state *state)
 
 static const char *keyword_completions[] = {
     "struct", "enum", "oneof", "optional", "nullable",
-    "map", "#include", NULL
+    "map", "str", "#include", NULL
 };
 
 static const char *type_completions[] = {
@@ -169,7 +169,7 @@ static const char *type_completions[] = {
 };
 
 static const char *annotation_completions[] = {
-    "@json", "@tag", "@deprecated", NULL
+    "@json", "@tag", "@deprecated", "@cached", "@compact", "@inline_str", NULL
 };
 
 static sstr_t build_completion_response(long id)
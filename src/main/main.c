@@ -27,7 +27,7 @@ enum output_format {
  */
 static void usage(FILE *stream) {
     fprintf(stream,
-        "Usage: json-gen-c -out <output_dir> -in <input_file> [--format json|msgpack|cbor] [--cpp-wrapper] [--rust] [--go]\n"
+        "Usage: json-gen-c -out <output_dir> -in <input_file> [--format json|msgpack|cbor] [--msgpack-struct map|array] [--cpp-wrapper] [--rust] [--go]\n"
         "       json-gen-c --check-compat <old_schema> <new_schema>\n"
         "       json-gen-c --lsp\n"
         "Generate serialization C code from struct definition.\n\n"
@@ -35,6 +35,10 @@ static void usage(FILE *stream) {
         "    -in <input_file>     Specify the input struct definition file.\n"
         "    -out <output_dir>    Specify the output codes location, default to current directory\n"
         "    --format <format>    Output format: json (default), msgpack, or cbor\n"
+        "    --msgpack-struct <layout>\n"
+        "                         Struct layout for msgpack and cbor: map (default,\n"
+        "                         keyed) or array (positional, as if every struct\n"
+        "                         were marked @compact)\n"
         "    --cpp-wrapper        Also generate a C++ wrapper header (.gen.hpp)\n"
         "    --rust               Also generate a Rust module (.gen.rs) with serde derives\n"
         "    --go                 Also generate a Go source file (.gen.go)\n"
@@ -55,6 +59,7 @@ struct options {
     char *compat_old;      /**< Old schema for --check-compat */
     char *compat_new;      /**< New schema for --check-compat */
     enum output_format format; /**< Output serialization format */
+    int compact_structs;   /**< --msgpack-struct=array: all structs @compact */
     int cpp_wrapper;       /**< Generate C++ wrapper header (.gen.hpp) */
     int rust_gen;          /**< Generate Rust module (.gen.rs) */
     int go_gen;            /**< Generate Go source file (.gen.go) */
@@ -95,6 +100,7 @@ static json_gen_error_t options_parse(int argc, char **argv, struct options *opt
         {"in", required_argument, 0, 'i'},
         {"out", required_argument, 0, 'o'},
         {"format", required_argument, 0, 'f'},
+        {"msgpack-struct", required_argument, 0, 'm'},
         {"cpp-wrapper", no_argument, 0, 'c'},
         {"rust", no_argument, 0, 'r'},
         {"go", no_argument, 0, 'g'},
@@ -129,6 +135,16 @@ static json_gen_error_t options_parse(int argc, char **argv, struct options *opt
                     return JSON_GEN_ERROR_INVALID_PARAM;
                 }
                 break;
+            case 'm':
+                if (strcmp(optarg, "map") == 0) {
+                    options->compact_structs = 0;
+                } else if (strcmp(optarg, "array") == 0) {
+                    options->compact_structs = 1;
+                } else {
+                    fprintf(stderr, "Error: unknown msgpack struct layout '%s' (expected map or array)\n", optarg);
+                    return JSON_GEN_ERROR_INVALID_PARAM;
+                }
+                break;
             case 'c':
                 options->cpp_wrapper = 1;
                 break;
@@ -202,6 +218,13 @@ static int parse_schema_file(const char *path, struct struct_parser *parser) {
     return struct_parser_validate(parser);
 }
 
+/* hash_map_for_each() callback for --msgpack-struct=array. */
+static void mark_compact_fn(void *key, void *value, void *ptr) {
+    (void)key;
+    (void)ptr;
+    ((struct struct_container *)value)->is_compact = 1;
+}
+
 /**
  * @brief Run the --check-compat workflow.
  * @return 0 if schemas are compatible, 1 if breaking changes, 2+ on error.
@@ -237,7 +260,7 @@ static int run_compat_check(const char *old_path, const char *new_path) {
 
 int main(int argc, char **argv) {
     // Initialize options structure
-    struct options options = {NULL, NULL, NULL, NULL, FORMAT_JSON, 0, 0, 0, 0};
+    struct options options = {NULL, NULL, NULL, NULL, FORMAT_JSON, 0, 0, 0, 0, 0};
     
     // Parse command line options
     json_gen_error_t result = options_parse(argc, argv, &options);
@@ -302,6 +325,10 @@ int main(int argc, char **argv) {
         cleanup_and_exit(content, parser, NULL, NULL, JSON_GEN_ERROR_PARSE);
     }
 
+    if (options.compact_structs) {
+        hash_map_for_each(parser->struct_map, mark_compact_fn, NULL);
+    }
+
     // Generate output code based on selected format
     sstr_t source = sstr_new();
     sstr_t head = sstr_new();
@@ -0,0 +1,2013 @@
+/**
+ * @file schema/schema_runtime.c
+ * @brief Schema interpreter implementation.
+ *
+ * Compilation turns each struct_container into a jgenc_schema_type: a flat
+ * array of schema_field entries carrying everything the generated code
+ * bakes in as constants (offsets, element sizes, `_len`/`has_` offsets,
+ * escaped JSON keys, defaults) plus an open-addressed key table. The
+ * codecs below are straight loops over that array. Keys are first matched
+ * against the field that follows the previous one, so input produced in
+ * schema order never touches the hash table.
+ */
+
+#include "schema/schema_runtime.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "struct/struct_parse.h"
+#include "utils/compat.h"
+#include "utils/error_codes.h"
+#include "utils/hash.h"
+#include "utils/hash_map.h"
+
+/* The generated runtime codecs, compiled into this file. */
+#include "gencode/codes/msgpack_codec.h"
+#include "gencode/codes/msgpack_codec.c"
+#include "gencode/codes/cbor_codec.h"
+#include "gencode/codes/cbor_codec.c"
+
+/* Nesting limit for decoding, matching the generated JSON parser. */
+#define SCHEMA_MAX_DEPTH 256
+
+/* schema_field.kind */
+#define SF_SCALAR 0
+#define SF_FIXED 1
+#define SF_DYNAMIC 2
+
+struct schema_enum {
+    char *name;
+    char **names;       /* indexed by value; NULL for gaps */
+    uint32_t *lens;
+    int count;
+};
+
+struct schema_field {
+    char *name;                 /* C field name */
+    char *key;                  /* wire key (@json alias or name) */
+    uint32_t key_len;
+    char *json_key;             /* ,"key": escaped, for the JSON encoder */
+    uint32_t json_key_len;
+    int type;                   /* FIELD_TYPE_* */
+    int kind;                   /* SF_* */
+    int optional;
+    int nullable;
+    size_t offset;
+    size_t elem_size;
+    int count;                  /* fixed array length, or N of str<N> */
+    long len_offset;            /* dynamic array `_len` / str<N> `_len` */
+    long has_offset;            /* `has_` flag, -1 if none */
+    struct jgenc_schema_type *sub;
+    struct schema_enum *en;
+    int has_default;
+    int64_t def_i;
+    uint64_t def_u;
+    double def_d;
+    char *def_s;
+    size_t def_s_len;
+};
+
+struct jgenc_schema_type {
+    char *name;
+    size_t size;
+    size_t align;
+    struct schema_field *fields;
+    int field_count;
+    uint16_t *slots;            /* key hash -> field index + 1 */
+    uint32_t slot_mask;
+    int layout_state;           /* 0 pending, 1 in progress, 2 done */
+    int compact;                /* @compact: msgpack/CBOR array by position */
+    struct struct_container *src;
+};
+
+struct jgenc_schema {
+    struct jgenc_schema_type *types;
+    int type_count;
+    struct schema_enum *enums;
+    int enum_count;
+};
+
+/* ======================================================================
+ * Compilation
+ * ====================================================================== */
+
+static char *schema_strndup(const char *s, size_t n) {
+    char *r = malloc(n + 1);
+    if (r == NULL) return NULL;
+    memcpy(r, s, n);
+    r[n] = '\0';
+    return r;
+}
+
+static uint32_t schema_key_hash(const char *s, size_t n) {
+    uint32_t h = 2166136261u;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    }
+    return h;
+}
+
+static size_t align_up(size_t off, size_t a) {
+    return (off + a - 1) & ~(a - 1);
+}
+
+/* C storage of one element of a scalar field type, as the generated header
+ * declares it: bool and enum fields are int. */
+static int scalar_layout(int type, size_t *size, size_t *align) {
+    switch (type) {
+    case FIELD_TYPE_INT:
+    case FIELD_TYPE_BOOL:
+    case FIELD_TYPE_ENUM:
+        *size = sizeof(int); *align = _Alignof(int); return 0;
+    case FIELD_TYPE_LONG:
+        *size = sizeof(long); *align = _Alignof(long); return 0;
+    case FIELD_TYPE_FLOAT:
+        *size = sizeof(float); *align = _Alignof(float); return 0;
+    case FIELD_TYPE_DOUBLE:
+        *size = sizeof(double); *align = _Alignof(double); return 0;
+    case FIELD_TYPE_SSTR:
+        *size = sizeof(sstr_t); *align = _Alignof(sstr_t); return 0;
+    case FIELD_TYPE_INT8:
+    case FIELD_TYPE_UINT8:
+        *size = 1; *align = 1; return 0;
+    case FIELD_TYPE_INT16:
+    case FIELD_TYPE_UINT16:
+        *size = 2; *align = _Alignof(int16_t); return 0;
+    case FIELD_TYPE_INT32:
+    case FIELD_TYPE_UINT32:
+        *size = 4; *align = _Alignof(int32_t); return 0;
+    case FIELD_TYPE_INT64:
+    case FIELD_TYPE_UINT64:
+        *size = 8; *align = _Alignof(int64_t); return 0;
+    default:
+        return -1;
+    }
+}
+
+struct schema_builder {
+    struct jgenc_schema *schema;
+    int index;
+    int failed;
+};
+
+static struct jgenc_schema_type *schema_type_by_name(
+    const struct jgenc_schema *schema, const char *name) {
+    int i;
+    for (i = 0; i < schema->type_count; i++) {
+        if (strcmp(schema->types[i].name, name) == 0) {
+            return &schema->types[i];
+        }
+    }
+    return NULL;
+}
+
+static struct schema_enum *schema_enum_by_name(struct jgenc_schema *schema,
+                                               const char *name) {
+    int i;
+    for (i = 0; i < schema->enum_count; i++) {
+        if (strcmp(schema->enums[i].name, name) == 0) {
+            return &schema->enums[i];
+        }
+    }
+    return NULL;
+}
+
+static void collect_struct_cb(void *key, void *value, void *ud) {
+    struct schema_builder *b = ud;
+    struct struct_container *sc = value;
+    struct jgenc_schema_type *t = &b->schema->types[b->index++];
+    (void)key;
+    t->name = schema_strndup(sstr_cstr(sc->name), sstr_length(sc->name));
+    t->src = sc;
+    if (t->name == NULL) b->failed = 1;
+}
+
+static void collect_enum_cb(void *key, void *value, void *ud) {
+    struct schema_builder *b = ud;
+    struct enum_container *ec = value;
+    struct schema_enum *e = &b->schema->enums[b->index++];
+    struct enum_value *v;
+    int max = -1;
+    (void)key;
+    e->name = schema_strndup(sstr_cstr(ec->name), sstr_length(ec->name));
+    for (v = ec->values; v != NULL; v = v->next) {
+        if (v->index > max) max = v->index;
+    }
+    e->count = max + 1;
+    e->names = calloc((size_t)(e->count > 0 ? e->count : 1), sizeof(char *));
+    e->lens = calloc((size_t)(e->count > 0 ? e->count : 1), sizeof(uint32_t));
+    if (e->name == NULL || e->names == NULL || e->lens == NULL) {
+        b->failed = 1;
+        return;
+    }
+    for (v = ec->values; v != NULL; v = v->next) {
+        if (v->index < 0) continue;
+        e->names[v->index] =
+            schema_strndup(sstr_cstr(v->name), sstr_length(v->name));
+        e->lens[v->index] = (uint32_t)sstr_length(v->name);
+        if (e->names[v->index] == NULL) b->failed = 1;
+    }
+}
+
+static void count_cb(void *key, void *value, void *ud) {
+    (void)key;
+    (void)value;
+    (*(int *)ud)++;
+}
+
+static int enum_lookup(const struct schema_enum *e, const char *s,
+                       size_t n) {
+    int i;
+    for (i = 0; i < e->count; i++) {
+        if (e->names[i] != NULL && e->lens[i] == n &&
+            memcmp(e->names[i], s, n) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int compile_default(struct schema_field *f, struct struct_field *sf) {
+    const char *lit = sstr_cstr(sf->default_value);
+    size_t n = sstr_length(sf->default_value);
+    f->has_default = 1;
+    switch (f->type) {
+    case FIELD_TYPE_BOOL:
+        f->def_i = strcmp(lit, "true") == 0 ? 1
+                   : strcmp(lit, "false") == 0 ? 0
+                   : strtoll(lit, NULL, 0);
+        return 0;
+    case FIELD_TYPE_UINT64:
+        f->def_u = strtoull(lit, NULL, 0);
+        return 0;
+    case FIELD_TYPE_FLOAT:
+    case FIELD_TYPE_DOUBLE:
+        f->def_d = strtod(lit, NULL);
+        return 0;
+    case FIELD_TYPE_SSTR:
+    case FIELD_TYPE_FIXSTR:
+        if (f->type == FIELD_TYPE_FIXSTR && n > (size_t)f->count) return -1;
+        f->def_s = schema_strndup(lit, n);
+        f->def_s_len = n;
+        return f->def_s == NULL ? -1 : 0;
+    case FIELD_TYPE_ENUM:
+        f->def_i = enum_lookup(f->en, lit, n);
+        return f->def_i < 0 ? -1 : 0;
+    case FIELD_TYPE_STRUCT:
+        f->has_default = 0;
+        return 0;
+    default:
+        f->def_i = strtoll(lit, NULL, 0);
+        return 0;
+    }
+}
+
+static int compile_key(struct schema_field *f, sstr_t key) {
+    sstr_t j = sstr_new();
+    f->key = schema_strndup(sstr_cstr(key), sstr_length(key));
+    f->key_len = (uint32_t)sstr_length(key);
+    sstr_append_cstr(j, ",\"");
+    sstr_json_escape_string_append(j, key);
+    sstr_append_cstr(j, "\":");
+    f->json_key = schema_strndup(sstr_cstr(j), sstr_length(j));
+    f->json_key_len = (uint32_t)sstr_length(j);
+    sstr_free(j);
+    return f->key == NULL || f->json_key == NULL ? -1 : 0;
+}
+
+static int compile_type(struct jgenc_schema *schema,
+                        struct jgenc_schema_type *t);
+
+static int compile_field(struct jgenc_schema *schema,
+                         struct jgenc_schema_type *t,
+                         struct schema_field *f, struct struct_field *sf,
+                         size_t *off, size_t *align) {
+    size_t size = 0, a = 1;
+
+    f->name = schema_strndup(sstr_cstr(sf->name), sstr_length(sf->name));
+    if (f->name == NULL ||
+        compile_key(f, sf->json_name ? sf->json_name : sf->name) != 0) {
+        return -1;
+    }
+    f->type = sf->type;
+    f->optional = sf->is_optional;
+    f->nullable = sf->is_nullable;
+    f->has_offset = -1;
+    f->len_offset = -1;
+
+    if (sf->type == FIELD_TYPE_MAP || sf->type == FIELD_TYPE_ONEOF ||
+        sf->is_inline_str ||
+        (sf->type == FIELD_TYPE_FIXSTR && sf->is_array)) {
+        fprintf(stderr, "%s.%s: field type not supported by the schema "
+                "interpreter\n", t->name, f->name);
+        return -1;
+    }
+
+    if (sf->type == FIELD_TYPE_STRUCT) {
+        f->sub = schema_type_by_name(schema, sstr_cstr(sf->type_name));
+        if (f->sub == NULL) return -1;
+        if (!sf->is_array || sf->array_size > 0) {
+            // by value: the nested layout must be known first
+            if (compile_type(schema, f->sub) != 0) return -1;
+        }
+        f->elem_size = f->sub->size;
+        a = f->sub->align;
+    } else if (sf->type == FIELD_TYPE_FIXSTR) {
+        f->count = sf->str_size;
+        f->elem_size = (size_t)sf->str_size + 1;
+    } else {
+        if (sf->type == FIELD_TYPE_ENUM) {
+            f->en = schema_enum_by_name(schema, sstr_cstr(sf->type_name));
+            if (f->en == NULL) return -1;
+        }
+        if (scalar_layout(sf->type, &f->elem_size, &a) != 0) return -1;
+    }
+
+    if (sf->is_array && sf->array_size == 0) {
+        f->kind = SF_DYNAMIC;
+        size = sizeof(void *);
+        a = _Alignof(void *);
+    } else if (sf->is_array) {
+        f->kind = SF_FIXED;
+        f->count = sf->array_size;
+        size = f->elem_size * (size_t)sf->array_size;
+    } else {
+        f->kind = SF_SCALAR;
+        size = f->elem_size;
+    }
+
+    // same declaration order as gen_code_struct_header()
+    *off = align_up(*off, a);
+    f->offset = *off;
+    *off += size;
+    if (a > *align) *align = a;
+    if (f->type == FIELD_TYPE_FIXSTR) {
+        f->len_offset = (long)*off;
+        *off += sizeof(uint8_t);
+    }
+    if (f->optional || f->nullable) {
+        *off = align_up(*off, _Alignof(bool));
+        f->has_offset = (long)*off;
+        *off += sizeof(bool);
+    }
+    if (f->kind == SF_DYNAMIC) {
+        *off = align_up(*off, _Alignof(int));
+        f->len_offset = (long)*off;
+        *off += sizeof(int);
+        if (_Alignof(int) > *align) *align = _Alignof(int);
+    }
+
+    if (sf->has_default && f->kind == SF_SCALAR &&
+        compile_default(f, sf) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int compile_type(struct jgenc_schema *schema,
+                        struct jgenc_schema_type *t) {
+    struct struct_field *sf;
+    size_t off = 0, align = 1;
+    uint32_t slots = 1;
+    int i, n = 0;
+
+    if (t->layout_state == 2) return 0;
+    if (t->layout_state == 1) return -1;  // struct contains itself by value
+    t->layout_state = 1;
+
+    if (t->src->is_cached) {
+        fprintf(stderr, "%s: @cached structs are not supported by the schema "
+                "interpreter\n", t->name);
+        return -1;
+    }
+    t->compact = t->src->is_compact;
+    for (sf = t->src->fields; sf != NULL; sf = sf->next) n++;
+    t->fields = calloc((size_t)(n > 0 ? n : 1), sizeof(struct schema_field));
+    if (t->fields == NULL) return -1;
+    t->field_count = n;
+
+    for (i = 0, sf = t->src->fields; sf != NULL; sf = sf->next, i++) {
+        if (compile_field(schema, t, &t->fields[i], sf, &off, &align) != 0) {
+            return -1;
+        }
+    }
+    t->align = align;
+    t->size = align_up(off > 0 ? off : 1, align);
+
+    while (slots < (uint32_t)n * 2) slots <<= 1;
+    t->slots = calloc(slots, sizeof(uint16_t));
+    if (t->slots == NULL) return -1;
+    t->slot_mask = slots - 1;
+    for (i = 0; i < n; i++) {
+        uint32_t h = schema_key_hash(t->fields[i].key, t->fields[i].key_len);
+        while (t->slots[h & t->slot_mask] != 0) h++;
+        t->slots[h & t->slot_mask] = (uint16_t)(i + 1);
+    }
+
+    t->layout_state = 2;
+    return 0;
+}
+
+struct jgenc_schema *jgenc_schema_compile(const char *text, size_t len) {
+    struct struct_parser *parser;
+    struct jgenc_schema *schema;
+    struct schema_builder b;
+    sstr_t content;
+    int i, r;
+
+    if (text == NULL) return NULL;
+    parser = struct_parser_new();
+    if (parser == NULL) return NULL;
+    parser->name = (char *)"<runtime schema>";
+    content = sstr_of(text, len);
+    r = struct_parser_parse(parser, content);
+    sstr_free(content);
+    if (r != 0 || struct_parser_validate_to(parser, stderr) != 0) {
+        struct_parser_free(parser);
+        return NULL;
+    }
+
+    schema = calloc(1, sizeof(struct jgenc_schema));
+    if (schema == NULL) {
+        struct_parser_free(parser);
+        return NULL;
+    }
+    hash_map_for_each(parser->struct_map, count_cb, &schema->type_count);
+    hash_map_for_each(parser->enum_map, count_cb, &schema->enum_count);
+    schema->types = calloc((size_t)schema->type_count + 1,
+                           sizeof(struct jgenc_schema_type));
+    schema->enums = calloc((size_t)schema->enum_count + 1,
+                           sizeof(struct schema_enum));
+
+    memset(&b, 0, sizeof(b));
+    b.schema = schema;
+    if (schema->types == NULL || schema->enums == NULL) {
+        b.failed = 1;
+    } else {
+        hash_map_for_each(parser->enum_map, collect_enum_cb, &b);
+        b.index = 0;
+        hash_map_for_each(parser->struct_map, collect_struct_cb, &b);
+    }
+    for (i = 0; !b.failed && i < schema->type_count; i++) {
+        if (compile_type(schema, &schema->types[i]) != 0) b.failed = 1;
+    }
+    // dynamic arrays may point at a struct laid out after their own
+    for (i = 0; !b.failed && i < schema->type_count; i++) {
+        struct jgenc_schema_type *t = &schema->types[i];
+        int j;
+        for (j = 0; j < t->field_count; j++) {
+            if (t->fields[j].sub != NULL) {
+                t->fields[j].elem_size = t->fields[j].sub->size;
+            }
+        }
+    }
+
+    // the field tables own copies of everything they need
+    for (i = 0; i < schema->type_count; i++) schema->types[i].src = NULL;
+    struct_parser_free(parser);
+    if (b.failed) {
+        jgenc_schema_free(schema);
+        return NULL;
+    }
+    return schema;
+}
+
+void jgenc_schema_free(struct jgenc_schema *schema) {
+    int i, j;
+    if (schema == NULL) return;
+    for (i = 0; schema->types != NULL && i < schema->type_count; i++) {
+        struct jgenc_schema_type *t = &schema->types[i];
+        for (j = 0; t->fields != NULL && j < t->field_count; j++) {
+            free(t->fields[j].name);
+            free(t->fields[j].key);
+            free(t->fields[j].json_key);
+            free(t->fields[j].def_s);
+        }
+        free(t->fields);
+        free(t->slots);
+        free(t->name);
+    }
+    for (i = 0; schema->enums != NULL && i < schema->enum_count; i++) {
+        struct schema_enum *e = &schema->enums[i];
+        for (j = 0; e->names != NULL && j < e->count; j++) free(e->names[j]);
+        free(e->names);
+        free(e->lens);
+        free(e->name);
+    }
+    free(schema->types);
+    free(schema->enums);
+    free(schema);
+}
+
+const struct jgenc_schema_type *jgenc_schema_find_type(
+    const struct jgenc_schema *schema, const char *name) {
+    if (schema == NULL || name == NULL) return NULL;
+    return schema_type_by_name(schema, name);
+}
+
+size_t jgenc_schema_type_size(const struct jgenc_schema_type *type) {
+    return type->size;
+}
+
+size_t jgenc_schema_type_align(const struct jgenc_schema_type *type) {
+    return type->align;
+}
+
+long jgenc_schema_field_offset(const struct jgenc_schema_type *type,
+                               const char *field) {
+    int i;
+    for (i = 0; i < type->field_count; i++) {
+        if (strcmp(type->fields[i].name, field) == 0) {
+            return (long)type->fields[i].offset;
+        }
+    }
+    return -1;
+}
+
+/* Find the field for a wire key, trying *next (the field after the last
+ * match) before the hash table. */
+static const struct schema_field *find_field(
+    const struct jgenc_schema_type *t, const char *key, size_t n,
+    int *next) {
+    const struct schema_field *f;
+    uint32_t h;
+    uint16_t id;
+    if (*next < t->field_count) {
+        f = &t->fields[*next];
+        if (f->key_len == n && memcmp(f->key, key, n) == 0) {
+            (*next)++;
+            return f;
+        }
+    }
+    h = schema_key_hash(key, n);
+    while ((id = t->slots[h & t->slot_mask]) != 0) {
+        f = &t->fields[id - 1];
+        if (f->key_len == n && memcmp(f->key, key, n) == 0) {
+            *next = id;
+            return f;
+        }
+        h++;
+    }
+    return NULL;
+}
+
+/* ======================================================================
+ * Object lifetime
+ * ====================================================================== */
+
+#define FIELD_PTR(obj, f) ((char *)(obj) + (f)->offset)
+#define HAS_FLAG(obj, f) (*(bool *)((char *)(obj) + (f)->has_offset))
+#define DYN_LEN(obj, f) (*(int *)((char *)(obj) + (f)->len_offset))
+#define DYN_PTR(obj, f) (*(char **)FIELD_PTR(obj, f))
+
+static void store_int(void *p, int type, int64_t v) {
+    switch (type) {
+    case FIELD_TYPE_INT8: *(int8_t *)p = (int8_t)v; break;
+    case FIELD_TYPE_INT16: *(int16_t *)p = (int16_t)v; break;
+    case FIELD_TYPE_INT32: *(int32_t *)p = (int32_t)v; break;
+    case FIELD_TYPE_INT64: *(int64_t *)p = v; break;
+    case FIELD_TYPE_UINT8: *(uint8_t *)p = (uint8_t)v; break;
+    case FIELD_TYPE_UINT16: *(uint16_t *)p = (uint16_t)v; break;
+    case FIELD_TYPE_UINT32: *(uint32_t *)p = (uint32_t)v; break;
+    case FIELD_TYPE_UINT64: *(uint64_t *)p = (uint64_t)v; break;
+    case FIELD_TYPE_LONG: *(long *)p = (long)v; break;
+    default: *(int *)p = (int)v; break;
+    }
+}
+
+static int64_t load_int(const void *p, int type) {
+    switch (type) {
+    case FIELD_TYPE_INT8: return *(const int8_t *)p;
+    case FIELD_TYPE_INT16: return *(const int16_t *)p;
+    case FIELD_TYPE_INT32: return *(const int32_t *)p;
+    case FIELD_TYPE_INT64: return *(const int64_t *)p;
+    case FIELD_TYPE_UINT8: return *(const uint8_t *)p;
+    case FIELD_TYPE_UINT16: return *(const uint16_t *)p;
+    case FIELD_TYPE_UINT32: return *(const uint32_t *)p;
+    case FIELD_TYPE_UINT64: return (int64_t)*(const uint64_t *)p;
+    case FIELD_TYPE_LONG: return *(const long *)p;
+    default: return *(const int *)p;
+    }
+}
+
+static int is_unsigned_type(int type) {
+    return type == FIELD_TYPE_UINT8 || type == FIELD_TYPE_UINT16 ||
+           type == FIELD_TYPE_UINT32 || type == FIELD_TYPE_UINT64;
+}
+
+static void schema_init_obj(const struct jgenc_schema_type *t, char *obj);
+static void schema_clear_obj(const struct jgenc_schema_type *t, char *obj);
+
+/* Release what one element owns, leaving it zeroed. */
+static void clear_elem(const struct schema_field *f, char *p) {
+    if (f->type == FIELD_TYPE_SSTR) {
+        sstr_free(*(sstr_t *)p);
+        *(sstr_t *)p = NULL;
+    } else if (f->type == FIELD_TYPE_STRUCT) {
+        schema_clear_obj(f->sub, p);
+    }
+}
+
+static void clear_dynamic(const struct schema_field *f, char *obj) {
+    char *arr = DYN_PTR(obj, f);
+    int i, n = DYN_LEN(obj, f);
+    if (f->type == FIELD_TYPE_SSTR || f->type == FIELD_TYPE_STRUCT) {
+        for (i = 0; arr != NULL && i < n; i++) {
+            clear_elem(f, arr + (size_t)i * f->elem_size);
+        }
+    }
+    jgenc_free(arr);
+    DYN_PTR(obj, f) = NULL;
+    DYN_LEN(obj, f) = 0;
+}
+
+static void schema_init_obj(const struct jgenc_schema_type *t, char *obj) {
+    int i, j;
+    memset(obj, 0, t->size);
+    for (i = 0; i < t->field_count; i++) {
+        const struct schema_field *f = &t->fields[i];
+        char *p = FIELD_PTR(obj, f);
+        if (f->type == FIELD_TYPE_STRUCT && f->kind != SF_DYNAMIC) {
+            int n = f->kind == SF_FIXED ? f->count : 1;
+            for (j = 0; j < n; j++) {
+                schema_init_obj(f->sub, p + (size_t)j * f->elem_size);
+            }
+            continue;
+        }
+        if (!f->has_default) continue;
+        switch (f->type) {
+        case FIELD_TYPE_FLOAT: *(float *)p = (float)f->def_d; break;
+        case FIELD_TYPE_DOUBLE: *(double *)p = f->def_d; break;
+        case FIELD_TYPE_UINT64: *(uint64_t *)p = f->def_u; break;
+        case FIELD_TYPE_SSTR:
+            *(sstr_t *)p = sstr_of(f->def_s, f->def_s_len);
+            break;
+        case FIELD_TYPE_FIXSTR:
+            memcpy(p, f->def_s, f->def_s_len + 1);
+            *(uint8_t *)(obj + f->len_offset) = (uint8_t)f->def_s_len;
+            break;
+        default: store_int(p, f->type, f->def_i); break;
+        }
+    }
+}
+
+static void schema_clear_obj(const struct jgenc_schema_type *t, char *obj) {
+    int i, j;
+    for (i = 0; i < t->field_count; i++) {
+        const struct schema_field *f = &t->fields[i];
+        if (f->kind == SF_DYNAMIC) {
+            clear_dynamic(f, obj);
+        } else if (f->type == FIELD_TYPE_SSTR ||
+                   f->type == FIELD_TYPE_STRUCT) {
+            int n = f->kind == SF_FIXED ? f->count : 1;
+            for (j = 0; j < n; j++) {
+                clear_elem(f, FIELD_PTR(obj, f) + (size_t)j * f->elem_size);
+            }
+        }
+    }
+    memset(obj, 0, t->size);
+}
+
+int jgenc_schema_init(const struct jgenc_schema_type *type, void *obj) {
+    if (type == NULL || obj == NULL) return JSON_GEN_ERROR_INVALID_PARAM;
+    schema_init_obj(type, obj);
+    return 0;
+}
+
+int jgenc_schema_clear(const struct jgenc_schema_type *type, void *obj) {
+    if (type == NULL || obj == NULL) return JSON_GEN_ERROR_INVALID_PARAM;
+    schema_clear_obj(type, obj);
+    return 0;
+}
+
+/* Replace a dynamic array with n fresh elements. Sizes come from the
+ * input, so callers bound n by the bytes left before calling. */
+static char *alloc_dynamic(const struct schema_field *f, char *obj,
+                           size_t n) {
+    size_t i;
+    char *arr;
+    clear_dynamic(f, obj);
+    arr = jgenc_malloc(f->elem_size * (n > 0 ? n : 1));
+    if (arr == NULL) return NULL;
+    memset(arr, 0, f->elem_size * (n > 0 ? n : 1));
+    if (f->type == FIELD_TYPE_STRUCT) {
+        for (i = 0; i < n; i++) {
+            schema_init_obj(f->sub, arr + i * f->elem_size);
+        }
+    }
+    DYN_PTR(obj, f) = arr;
+    DYN_LEN(obj, f) = (int)n;
+    return arr;
+}
+
+static sstr_t reuse_sstr(char *p) {
+    sstr_t s = *(sstr_t *)p;
+    if (s == NULL) {
+        s = sstr_new();
+        *(sstr_t *)p = s;
+    } else {
+        sstr_clear_fast(s);
+    }
+    return s;
+}
+
+/* ======================================================================
+ * JSON
+ * ====================================================================== */
+
+struct json_reader {
+    const char *p;
+    const char *begin;
+    const char *end;
+    int depth;
+    sstr_t scratch;
+    const struct json_limits *lim;  /* NULL when uncapped */
+    size_t alloc_bytes;
+    struct json_error *err;
+};
+
+/* Record the first failure in r->err, at r->p, and return code. */
+static int jr_fail(struct json_reader *r, int code, int expected) {
+    if (r->err != NULL && r->err->code == 0) {
+        r->err->code = code;
+        r->err->offset = (long)(r->p - r->begin);
+        r->err->expected_token = expected;
+    }
+    return code;
+}
+
+static int jr_over(struct json_reader *r, size_t cap, size_t n) {
+    return cap != 0 && n > cap
+               ? jr_fail(r, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE)
+               : 0;
+}
+
+/* Nonzero (after reporting) when count n is over the FIELD cap. */
+#define JR_LIMIT(r, FIELD, n) \
+    ((r)->lim != NULL ? jr_over((r), (r)->lim->FIELD, (size_t)(n)) : 0)
+
+/* Charge bytes to the decode's max_alloc_bytes budget. */
+static int jr_alloc(struct json_reader *r, size_t bytes) {
+    size_t cap = r->lim != NULL ? r->lim->max_alloc_bytes : 0;
+    if (cap == 0) return 0;
+    if (bytes > cap - r->alloc_bytes) {
+        return jr_fail(r, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE);
+    }
+    r->alloc_bytes += bytes;
+    return 0;
+}
+
+static int jr_ws(struct json_reader *r) {
+    while (r->p < r->end) {
+        char c = *r->p;
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') {
+            return (unsigned char)c;
+        }
+        r->p++;
+    }
+    return -1;
+}
+
+static int jr_literal(struct json_reader *r, const char *lit, size_t n) {
+    if ((size_t)(r->end - r->p) < n || memcmp(r->p, lit, n) != 0) {
+        return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_VALUE);
+    }
+    r->p += n;
+    return 0;
+}
+
+static int hex4(const char *p, unsigned *out) {
+    unsigned v = 0;
+    int i;
+    for (i = 0; i < 4; i++) {
+        char c = p[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= (unsigned)(c - '0');
+        else if (c >= 'a' && c <= 'f') v |= (unsigned)(c - 'a' + 10);
+        else if (c >= 'A' && c <= 'F') v |= (unsigned)(c - 'A' + 10);
+        else return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+static void append_utf8(sstr_t dst, unsigned cp) {
+    char b[4];
+    if (cp < 0x80) {
+        b[0] = (char)cp;
+        sstr_append_of(dst, b, 1);
+    } else if (cp < 0x800) {
+        b[0] = (char)(0xc0 | (cp >> 6));
+        b[1] = (char)(0x80 | (cp & 0x3f));
+        sstr_append_of(dst, b, 2);
+    } else if (cp < 0x10000) {
+        b[0] = (char)(0xe0 | (cp >> 12));
+        b[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        b[2] = (char)(0x80 | (cp & 0x3f));
+        sstr_append_of(dst, b, 3);
+    } else {
+        b[0] = (char)(0xf0 | (cp >> 18));
+        b[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+        b[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+        b[3] = (char)(0x80 | (cp & 0x3f));
+        sstr_append_of(dst, b, 4);
+    }
+}
+
+/* Read a string whose opening quote is at r->p. Unescaped strings come
+ * back as a span of the input; escaped ones are decoded into dst (which
+ * must then be non-NULL) and *s points at its bytes. A surrogate escape
+ * must be a high/low pair. */
+static int jr_string(struct json_reader *r, sstr_t dst, const char **s,
+                     size_t *n) {
+    const char *start = ++r->p;
+    const char *q = start;
+    while (q < r->end && *q != '"' && *q != '\\' &&
+           (unsigned char)*q >= 0x20) {
+        q++;
+    }
+    if (q < r->end && *q == '"') {
+        *s = start;
+        *n = (size_t)(q - start);
+        if (JR_LIMIT(r, max_string_len, *n) != 0) return JSON_GEN_ERROR_BOUNDS;
+        if (dst != NULL) sstr_append_of(dst, start, *n);
+        r->p = q + 1;
+        return 0;
+    }
+    if (dst == NULL) return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING);
+    sstr_append_of(dst, start, (size_t)(q - start));
+    while (q < r->end) {
+        unsigned char c = (unsigned char)*q;
+        r->p = q;
+        if (JR_LIMIT(r, max_string_len, sstr_length(dst)) != 0) {
+            return JSON_GEN_ERROR_BOUNDS;
+        }
+        if (c == '"') {
+            r->p = q + 1;
+            *s = sstr_cstr(dst);
+            *n = sstr_length(dst);
+            return 0;
+        }
+        if (c < 0x20) return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING);
+        if (c != '\\') {
+            const char *run = q;
+            while (q < r->end && *q != '"' && *q != '\\' &&
+                   (unsigned char)*q >= 0x20) {
+                q++;
+            }
+            sstr_append_of(dst, run, (size_t)(q - run));
+            continue;
+        }
+        if (++q >= r->end) break;
+        switch (*q) {
+        case '"': sstr_append_of(dst, "\"", 1); break;
+        case '\\': sstr_append_of(dst, "\\", 1); break;
+        case '/': sstr_append_of(dst, "/", 1); break;
+        case 'b': sstr_append_of(dst, "\b", 1); break;
+        case 'f': sstr_append_of(dst, "\f", 1); break;
+        case 'n': sstr_append_of(dst, "\n", 1); break;
+        case 'r': sstr_append_of(dst, "\r", 1); break;
+        case 't': sstr_append_of(dst, "\t", 1); break;
+        case 'u': {
+            unsigned cp, lo;
+            if (r->end - q < 5 || hex4(q + 1, &cp) != 0 ||
+                (cp >= 0xdc00 && cp < 0xe000)) {
+                return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE);
+            }
+            q += 4;
+            if (cp >= 0xd800 && cp < 0xdc00) {
+                if (r->end - q < 7 || q[1] != '\\' || q[2] != 'u' ||
+                    hex4(q + 3, &lo) != 0 || lo < 0xdc00 || lo >= 0xe000) {
+                    return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE);
+                }
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                q += 6;
+            }
+            append_utf8(dst, cp);
+            break;
+        }
+        default:
+            return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE);
+        }
+        q++;
+    }
+    r->p = q;
+    return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING);
+}
+
+/* Scan a number token as the generated tokenizer does: an optional '-',
+ * digits, '.' and digits, then an exponent, with at least one mantissa
+ * digit and one exponent digit. *is_int is set when it has no fraction or
+ * exponent. */
+static int jr_number_span(struct json_reader *r, const char **s, size_t *n,
+                          int *is_int) {
+    const char *q = r->p;
+    int digits = 0;
+    *is_int = 1;
+    if (q < r->end && *q == '-') q++;
+    while (q < r->end && *q >= '0' && *q <= '9') {
+        q++;
+        digits = 1;
+    }
+    if (q < r->end && *q == '.') {
+        *is_int = 0;
+        q++;
+        while (q < r->end && *q >= '0' && *q <= '9') {
+            q++;
+            digits = 1;
+        }
+    }
+    if (q < r->end && (*q == 'e' || *q == 'E')) {
+        *is_int = 0;
+        q++;
+        if (q < r->end && (*q == '+' || *q == '-')) q++;
+        if (q >= r->end || *q < '0' || *q > '9') digits = 0;
+        while (q < r->end && *q >= '0' && *q <= '9') q++;
+    }
+    if (!digits) return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NUMBER);
+    *s = r->p;
+    *n = (size_t)(q - r->p);
+    r->p = q;
+    return 0;
+}
+
+static int span_to_double(struct json_reader *r, const char *s, size_t n,
+                          double *out) {
+    char buf[64];
+    if (n < sizeof(buf)) {
+        memcpy(buf, s, n);
+        buf[n] = '\0';
+        *out = strtod(buf, NULL);
+    } else {
+        sstr_clear_fast(r->scratch);
+        sstr_append_of(r->scratch, s, n);
+        *out = strtod(sstr_cstr(r->scratch), NULL);
+    }
+    return 0;
+}
+
+/* Largest value of an integer FIELD_TYPE_*; the minimum of a signed one
+ * is -max - 1. */
+static uint64_t int_type_max(int type) {
+    switch (type) {
+    case FIELD_TYPE_INT8: return INT8_MAX;
+    case FIELD_TYPE_INT16: return INT16_MAX;
+    case FIELD_TYPE_INT64: return INT64_MAX;
+    case FIELD_TYPE_LONG: return LONG_MAX;
+    case FIELD_TYPE_UINT8: return UINT8_MAX;
+    case FIELD_TYPE_UINT16: return UINT16_MAX;
+    case FIELD_TYPE_UINT32: return UINT32_MAX;
+    case FIELD_TYPE_UINT64: return UINT64_MAX;
+    default: return INT_MAX;  /* int, int32_t, bool, enum */
+    }
+}
+
+/* Read an integer for a field of the given type. A fraction or exponent
+ * is a parse error and a value outside the type a bounds error, as in the
+ * generated decoder. */
+static int jr_int(struct json_reader *r, int type, int64_t *out,
+                  uint64_t *uout) {
+    const char *start = r->p;
+    const char *s;
+    size_t n, i;
+    int is_int, neg;
+    uint64_t v = 0, max = int_type_max(type);
+    if (jr_number_span(r, &s, &n, &is_int) != 0) return JSON_GEN_ERROR_PARSE;
+    r->p = start;
+    if (!is_int) return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NUMBER);
+    neg = s[0] == '-';
+    for (i = (size_t)neg; i < n; i++) {
+        uint64_t d = (uint64_t)(s[i] - '0');
+        if (v > (UINT64_MAX - d) / 10) {
+            return jr_fail(r, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE);
+        }
+        v = v * 10 + d;
+    }
+    if (is_unsigned_type(type) ? neg || v > max : v > max + (uint64_t)neg) {
+        return jr_fail(r, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE);
+    }
+    r->p = s + n;
+    *uout = v;
+    *out = neg ? -(int64_t)(v - 1) - 1 : (int64_t)v;
+    return 0;
+}
+
+static int jr_double(struct json_reader *r, double *out) {
+    const char *s;
+    size_t n;
+    int is_int;
+    if (jr_number_span(r, &s, &n, &is_int) != 0) return JSON_GEN_ERROR_PARSE;
+    if (is_int && n < 16) {
+        size_t i = s[0] == '-';
+        int64_t v = 0;
+        for (; i < n; i++) v = v * 10 + (s[i] - '0');
+        *out = (double)(s[0] == '-' ? -v : v);
+        return 0;
+    }
+    return span_to_double(r, s, n, out);
+}
+
+static int jr_skip(struct json_reader *r) {
+    int c = jr_ws(r);
+    const char *s;
+    size_t n;
+    int is_int, rc;
+    switch (c) {
+    case '"':
+        sstr_clear_fast(r->scratch);
+        return jr_string(r, r->scratch, &s, &n);
+    case '{':
+    case '[': {
+        int close = c == '{' ? '}' : ']';
+        if (++r->depth > SCHEMA_MAX_DEPTH) {
+            return jr_fail(r, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE);
+        }
+        r->p++;
+        if (jr_ws(r) == close) {
+            r->p++;
+            r->depth--;
+            return 0;
+        }
+        for (;;) {
+            if (close == '}') {
+                if (jr_ws(r) != '"') {
+                    return jr_fail(r, JSON_GEN_ERROR_PARSE,
+                                   JSON_EXPECT_STRING);
+                }
+                sstr_clear_fast(r->scratch);
+                if ((rc = jr_string(r, r->scratch, &s, &n)) != 0) return rc;
+                if (jr_ws(r) != ':') {
+                    return jr_fail(r, JSON_GEN_ERROR_PARSE, ':');
+                }
+                r->p++;
+            }
+            if ((rc = jr_skip(r)) != 0) return rc;
+            c = jr_ws(r);
+            if (c == close) break;
+            if (c != ',') return jr_fail(r, JSON_GEN_ERROR_PARSE, ',');
+            r->p++;
+        }
+        r->p++;
+        r->depth--;
+        return 0;
+    }
+    case 't': return jr_literal(r, "true", 4);
+    case 'f': return jr_literal(r, "false", 5);
+    case 'n': return jr_literal(r, "null", 4);
+    default:
+        return jr_number_span(r, &s, &n, &is_int);
+    }
+}
+
+static int json_object(struct json_reader *r,
+                       const struct jgenc_schema_type *t, char *obj);
+
+/* Decode one element of f's type at p. As in the generated decoder,
+ * integer and bool fields take true/false as 1/0, and only strings take
+ * null. */
+static int json_elem(struct json_reader *r, const struct schema_field *f,
+                     char *p) {
+    int c = jr_ws(r);
+    const char *s;
+    size_t n;
+    int rc;
+    switch (f->type) {
+    case FIELD_TYPE_SSTR:
+        if (c == 'n') return jr_literal(r, "null", 4);
+        if (c != '"') return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING);
+        if ((rc = jr_string(r, reuse_sstr(p), &s, &n)) != 0) return rc;
+        return jr_alloc(r, n + 1);
+    case FIELD_TYPE_FIXSTR:
+        if (c == 'n') {
+            p[0] = '\0';
+            *(uint8_t *)(p + f->count + 1) = 0;
+            return jr_literal(r, "null", 4);
+        }
+        if (c != '"') return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING);
+        sstr_clear_fast(r->scratch);
+        if ((rc = jr_string(r, r->scratch, &s, &n)) != 0) return rc;
+        if (n > (size_t)f->count) {
+            return jr_fail(r, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE);
+        }
+        memcpy(p, s, n);
+        p[n] = '\0';
+        *(uint8_t *)(p + f->count + 1) = (uint8_t)n;
+        return 0;
+    case FIELD_TYPE_STRUCT:
+        return json_object(r, f->sub, p);
+    case FIELD_TYPE_FLOAT: {
+        double d;
+        if ((rc = jr_double(r, &d)) != 0) return rc;
+        *(float *)p = (float)d;
+        return 0;
+    }
+    case FIELD_TYPE_DOUBLE:
+        return jr_double(r, (double *)p);
+    case FIELD_TYPE_ENUM:
+        if (c == '"') {
+            int v;
+            sstr_clear_fast(r->scratch);
+            if ((rc = jr_string(r, r->scratch, &s, &n)) != 0) return rc;
+            v = enum_lookup(f->en, s, n);
+            if (v < 0) return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_NONE);
+            *(int *)p = v;
+            return 0;
+        }
+        break;
+    default:
+        if (c == 't' || c == 'f') {
+            store_int(p, f->type, c == 't');
+            return c == 't' ? jr_literal(r, "true", 4)
+                            : jr_literal(r, "false", 5);
+        }
+        break;
+    }
+    {
+        int64_t v;
+        uint64_t u;
+        if ((rc = jr_int(r, f->type, &v, &u)) != 0) return rc;
+        if (f->type == FIELD_TYPE_UINT64) {
+            *(uint64_t *)p = u;
+        } else {
+            store_int(p, f->type, v);
+        }
+        return 0;
+    }
+}
+
+static int json_field(struct json_reader *r, const struct schema_field *f,
+                      char *obj) {
+    int c = jr_ws(r);
+    char *p = FIELD_PTR(obj, f);
+    int rc;
+    if (c == 'n' && f->nullable) {
+        if (f->has_offset >= 0) HAS_FLAG(obj, f) = 0;
+        return jr_literal(r, "null", 4);
+    }
+    if (f->has_offset >= 0) HAS_FLAG(obj, f) = 1;
+    if (f->kind == SF_SCALAR) return json_elem(r, f, p);
+
+    // like the generated decoder, a dynamic enum array may be null
+    if (c == 'n' && f->kind == SF_DYNAMIC && f->type == FIELD_TYPE_ENUM) {
+        return jr_literal(r, "null", 4);
+    }
+    if (c != '[') return jr_fail(r, JSON_GEN_ERROR_PARSE, '[');
+    r->p++;
+    if (f->kind == SF_FIXED) {
+        int i = 0;
+        for (;;) {
+            if (jr_ws(r) == ']') break;
+            if (i >= f->count) {
+                return jr_fail(r, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE);
+            }
+            rc = json_elem(r, f, p + (size_t)i * f->elem_size);
+            if (rc != 0) return rc;
+            i++;
+            c = jr_ws(r);
+            if (c == ']') break;
+            if (c != ',') return jr_fail(r, JSON_GEN_ERROR_PARSE, ',');
+            r->p++;
+        }
+        r->p++;
+        return 0;
+    } else {
+        // grow geometrically, then hand the array to the object
+        size_t cap = 0, len = 0;
+        char *arr = NULL;
+        rc = 0;
+        clear_dynamic(f, obj);
+        for (;;) {
+            if (jr_ws(r) == ']') {
+                r->p++;
+                break;
+            }
+            if (JR_LIMIT(r, max_array_len, len + 1) != 0) {
+                rc = JSON_GEN_ERROR_BOUNDS;
+                break;
+            }
+            if (len == cap) {
+                size_t ncap = cap ? cap * 2 : 8;
+                char *narr;
+                if ((rc = jr_alloc(r, (ncap - cap) * f->elem_size)) != 0) {
+                    break;
+                }
+                narr = jgenc_realloc(arr, ncap * f->elem_size);
+                if (narr == NULL) {
+                    rc = jr_fail(r, JSON_GEN_ERROR_MEMORY, JSON_EXPECT_NONE);
+                    break;
+                }
+                memset(narr + cap * f->elem_size, 0,
+                       (ncap - cap) * f->elem_size);
+                arr = narr;
+                cap = ncap;
+            }
+            if (f->type == FIELD_TYPE_STRUCT) {
+                schema_init_obj(f->sub, arr + len * f->elem_size);
+            }
+            rc = json_elem(r, f, arr + len * f->elem_size);
+            len++;
+            if (rc != 0) break;
+            c = jr_ws(r);
+            if (c == ']') {
+                r->p++;
+                break;
+            }
+            if (c != ',') {
+                rc = jr_fail(r, JSON_GEN_ERROR_PARSE, ',');
+                break;
+            }
+            r->p++;
+        }
+        DYN_PTR(obj, f) = arr;
+        DYN_LEN(obj, f) = (int)len;
+        if (rc == 0 && arr == NULL && alloc_dynamic(f, obj, 0) == NULL) {
+            rc = jr_fail(r, JSON_GEN_ERROR_MEMORY, JSON_EXPECT_NONE);
+        }
+        return rc;
+    }
+}
+
+static int json_object(struct json_reader *r,
+                       const struct jgenc_schema_type *t, char *obj) {
+    int next = 0, c;
+    if (jr_ws(r) != '{') return jr_fail(r, JSON_GEN_ERROR_PARSE, '{');
+    if (++r->depth > SCHEMA_MAX_DEPTH) {
+        return jr_fail(r, JSON_GEN_ERROR_BOUNDS, JSON_EXPECT_NONE);
+    }
+    r->p++;
+    if (jr_ws(r) == '}') {
+        r->p++;
+        r->depth--;
+        return 0;
+    }
+    for (;;) {
+        const struct schema_field *f;
+        const char *key;
+        size_t klen;
+        int rc;
+        if (jr_ws(r) != '"') {
+            return jr_fail(r, JSON_GEN_ERROR_PARSE, JSON_EXPECT_STRING);
+        }
+        sstr_clear_fast(r->scratch);
+        if ((rc = jr_string(r, r->scratch, &key, &klen)) != 0) return rc;
+        if (jr_ws(r) != ':') return jr_fail(r, JSON_GEN_ERROR_PARSE, ':');
+        r->p++;
+        f = find_field(t, key, klen, &next);
+        rc = f != NULL ? json_field(r, f, obj) : jr_skip(r);
+        if (rc != 0) return rc;
+        c = jr_ws(r);
+        if (c == '}') break;
+        if (c != ',') return jr_fail(r, JSON_GEN_ERROR_PARSE, ',');
+        r->p++;
+    }
+    r->p++;
+    r->depth--;
+    return 0;
+}
+
+int jgenc_schema_json_unmarshal_limited(const struct jgenc_schema_type *type,
+                                        const char *in, size_t len,
+                                        void *obj,
+                                        const struct json_limits *limits,
+                                        struct json_error *err) {
+    struct json_reader r;
+    int rc;
+    if (err != NULL) {
+        err->code = 0;
+        err->offset = 0;
+        err->expected_token = JSON_EXPECT_NONE;
+    }
+    if (type == NULL || in == NULL || obj == NULL) {
+        return JSON_GEN_ERROR_INVALID_PARAM;
+    }
+    r.p = in;
+    r.begin = in;
+    r.end = in + len;
+    r.depth = 0;
+    r.lim = limits;
+    r.alloc_bytes = 0;
+    r.err = err;
+    if (JR_LIMIT(&r, max_input_bytes, len) != 0) return JSON_GEN_ERROR_BOUNDS;
+    r.scratch = sstr_new();
+    rc = json_object(&r, type, obj);
+    sstr_free(r.scratch);
+    return rc;
+}
+
+int jgenc_schema_json_unmarshal(const struct jgenc_schema_type *type,
+                                const char *in, size_t len, void *obj) {
+    return jgenc_schema_json_unmarshal_limited(type, in, len, obj, NULL,
+                                               NULL);
+}
+
+static void json_put_elem(const struct schema_field *f, const char *p,
+                          sstr_t out);
+
+static void json_put_object(const struct jgenc_schema_type *t,
+                            const char *obj, sstr_t out) {
+    int i, first = 1;
+    sstr_append_of_fast(out, "{", 1);
+    for (i = 0; i < t->field_count; i++) {
+        const struct schema_field *f = &t->fields[i];
+        const char *p = FIELD_PTR(obj, f);
+        if (f->optional && !f->nullable && !HAS_FLAG(obj, f)) continue;
+        sstr_append_of_fast(out, f->json_key + first, f->json_key_len - first);
+        first = 0;
+        if (f->nullable && !HAS_FLAG(obj, f)) {
+            sstr_append_of_fast(out, "null", 4);
+        } else if (f->kind == SF_SCALAR) {
+            json_put_elem(f, p, out);
+        } else {
+            int j, n = f->kind == SF_FIXED ? f->count : DYN_LEN(obj, f);
+            const char *arr = f->kind == SF_FIXED ? p : DYN_PTR(obj, f);
+            sstr_append_of_fast(out, "[", 1);
+            for (j = 0; j < n; j++) {
+                if (j > 0) sstr_append_of_fast(out, ",", 1);
+                json_put_elem(f, arr + (size_t)j * f->elem_size, out);
+            }
+            sstr_append_of_fast(out, "]", 1);
+        }
+    }
+    sstr_append_of_fast(out, "}", 1);
+}
+
+static void json_put_elem(const struct schema_field *f, const char *p,
+                          sstr_t out) {
+    switch (f->type) {
+    case FIELD_TYPE_SSTR:
+        sstr_append_of_fast(out, "\"", 1);
+        sstr_json_escape_string_append(out, *(sstr_t const *)p);
+        sstr_append_of_fast(out, "\"", 1);
+        break;
+    case FIELD_TYPE_FIXSTR:
+        sstr_append_of_fast(out, "\"", 1);
+        sstr_json_escape_append_of(out, p,
+                                   *(const uint8_t *)(p + f->count + 1));
+        sstr_append_of_fast(out, "\"", 1);
+        break;
+    case FIELD_TYPE_STRUCT:
+        json_put_object(f->sub, p, out);
+        break;
+    case FIELD_TYPE_BOOL:
+        if (*(const int *)p) {
+            sstr_append_of_fast(out, "true", 4);
+        } else {
+            sstr_append_of_fast(out, "false", 5);
+        }
+        break;
+    case FIELD_TYPE_FLOAT:
+        sstr_append_float_str(out, *(const float *)p, -1);
+        break;
+    case FIELD_TYPE_DOUBLE:
+        sstr_append_double_str(out, *(const double *)p, -1);
+        break;
+    case FIELD_TYPE_ENUM: {
+        int v = *(const int *)p;
+        if (v >= 0 && v < f->en->count && f->en->names[v] != NULL) {
+            sstr_append_of_fast(out, "\"", 1);
+            sstr_append_of(out, f->en->names[v], f->en->lens[v]);
+            sstr_append_of_fast(out, "\"", 1);
+        } else {
+            sstr_append_int_str(out, v);
+        }
+        break;
+    }
+    case FIELD_TYPE_UINT32:
+        sstr_append_uint32_str(out, *(const uint32_t *)p);
+        break;
+    case FIELD_TYPE_UINT64:
+        sstr_append_uint64_str(out, *(const uint64_t *)p);
+        break;
+    case FIELD_TYPE_LONG:
+    case FIELD_TYPE_INT64:
+        sstr_append_long_str(out, (long)load_int(p, f->type));
+        break;
+    default:
+        sstr_append_int_str(out, (int)load_int(p, f->type));
+        break;
+    }
+}
+
+int jgenc_schema_json_marshal(const struct jgenc_schema_type *type,
+                              const void *obj, sstr_t out) {
+    if (type == NULL || obj == NULL || out == NULL) {
+        return JSON_GEN_ERROR_INVALID_PARAM;
+    }
+    json_put_object(type, obj, out);
+    return 0;
+}
+
+/* ======================================================================
+ * MessagePack
+ * ====================================================================== */
+
+/* Number of keys written for obj: absent optional fields are skipped. */
+static uint32_t present_fields(const struct jgenc_schema_type *t,
+                               const char *obj) {
+    uint32_t n = (uint32_t)t->field_count;
+    int i;
+    for (i = 0; i < t->field_count; i++) {
+        const struct schema_field *f = &t->fields[i];
+        if (f->optional && !f->nullable && !HAS_FLAG(obj, f)) n--;
+    }
+    return n;
+}
+
+static void mp_put_object(const struct jgenc_schema_type *t, const char *obj,
+                          sstr_t out);
+
+static void mp_put_elem(const struct schema_field *f, const char *p,
+                        sstr_t out) {
+    switch (f->type) {
+    case FIELD_TYPE_SSTR: {
+        sstr_t s = *(sstr_t const *)p;
+        if (s == NULL) {
+            mp_pack_str(out, "", 0);
+        } else {
+            mp_pack_sstr(out, s);
+        }
+        break;
+    }
+    case FIELD_TYPE_FIXSTR:
+        mp_pack_str(out, p, *(const uint8_t *)(p + f->count + 1));
+        break;
+    case FIELD_TYPE_STRUCT:
+        mp_put_object(f->sub, p, out);
+        break;
+    case FIELD_TYPE_BOOL:
+        mp_pack_bool(out, *(const int *)p);
+        break;
+    case FIELD_TYPE_FLOAT:
+        mp_pack_float(out, *(const float *)p);
+        break;
+    case FIELD_TYPE_DOUBLE:
+        mp_pack_double(out, *(const double *)p);
+        break;
+    case FIELD_TYPE_ENUM: {
+        int v = *(const int *)p;
+        if (v >= 0 && v < f->en->count && f->en->names[v] != NULL) {
+            mp_pack_str(out, f->en->names[v], f->en->lens[v]);
+        } else {
+            mp_pack_int(out, v);
+        }
+        break;
+    }
+    default:
+        if (is_unsigned_type(f->type)) {
+            mp_pack_uint(out, (uint64_t)load_int(p, f->type));
+        } else {
+            mp_pack_int(out, load_int(p, f->type));
+        }
+        break;
+    }
+}
+
+static void mp_put_object(const struct jgenc_schema_type *t, const char *obj,
+                          sstr_t out) {
+    int i, j;
+    if (t->compact) {
+        mp_pack_array_header(out, (uint32_t)t->field_count);
+    } else {
+        mp_pack_map_header(out, present_fields(t, obj));
+    }
+    for (i = 0; i < t->field_count; i++) {
+        const struct schema_field *f = &t->fields[i];
+        const char *p = FIELD_PTR(obj, f);
+        if (t->compact) {
+            if (f->optional && !HAS_FLAG(obj, f)) {
+                mp_pack_nil(out);
+                continue;
+            }
+        } else {
+            if (f->optional && !f->nullable && !HAS_FLAG(obj, f)) continue;
+            mp_pack_str(out, f->key, f->key_len);
+        }
+        if (f->nullable && !HAS_FLAG(obj, f)) {
+            mp_pack_nil(out);
+        } else if (f->kind == SF_SCALAR) {
+            mp_put_elem(f, p, out);
+        } else {
+            int n = f->kind == SF_FIXED ? f->count : DYN_LEN(obj, f);
+            const char *arr = f->kind == SF_FIXED ? p : DYN_PTR(obj, f);
+            mp_pack_array_header(out, (uint32_t)n);
+            for (j = 0; j < n; j++) {
+                mp_put_elem(f, arr + (size_t)j * f->elem_size, out);
+            }
+        }
+    }
+}
+
+int jgenc_schema_msgpack_pack(const struct jgenc_schema_type *type,
+                              const void *obj, sstr_t out) {
+    if (type == NULL || obj == NULL || out == NULL) {
+        return JSON_GEN_ERROR_INVALID_PARAM;
+    }
+    mp_put_object(type, obj, out);
+    return 0;
+}
+
+static int mp_get_object(struct mp_reader *r,
+                         const struct jgenc_schema_type *t, char *obj,
+                         int depth);
+
+static int mp_get_elem(struct mp_reader *r, const struct schema_field *f,
+                       char *p, int depth) {
+    const char *s;
+    uint32_t n;
+    int b = mp_peek(r);
+    if (b < 0) return JSON_GEN_ERROR_PARSE;
+    switch (f->type) {
+    case FIELD_TYPE_SSTR: {
+        sstr_t dst;
+        if (mp_unpack_str(r, &s, &n) < 0) return JSON_GEN_ERROR_PARSE;
+        dst = reuse_sstr(p);
+        sstr_append_of_fast(dst, s, n);
+        return 0;
+    }
+    case FIELD_TYPE_FIXSTR:
+        if (mp_unpack_str(r, &s, &n) < 0 || n > (uint32_t)f->count) {
+            return JSON_GEN_ERROR_PARSE;
+        }
+        memcpy(p, s, n);
+        p[n] = '\0';
+        *(uint8_t *)(p + f->count + 1) = (uint8_t)n;
+        return 0;
+    case FIELD_TYPE_STRUCT:
+        return mp_get_object(r, f->sub, p, depth + 1);
+    case FIELD_TYPE_BOOL:
+        return mp_unpack_bool(r, (int *)p) < 0 ? JSON_GEN_ERROR_PARSE : 0;
+    case FIELD_TYPE_FLOAT: {
+        double d;
+        if (mp_unpack_number_as_double(r, &d) < 0) return JSON_GEN_ERROR_PARSE;
+        *(float *)p = (float)d;
+        return 0;
+    }
+    case FIELD_TYPE_DOUBLE:
+        return mp_unpack_number_as_double(r, (double *)p) < 0
+                   ? JSON_GEN_ERROR_PARSE : 0;
+    case FIELD_TYPE_ENUM:
+        if ((b >= MP_FIXSTR && b <= MP_FIXSTR + MP_FIXSTR_MASK) ||
+            b == MP_STR8 || b == MP_STR16 || b == MP_STR32) {
+            int v;
+            if (mp_unpack_str(r, &s, &n) < 0) return JSON_GEN_ERROR_PARSE;
+            v = enum_lookup(f->en, s, n);
+            if (v < 0) return JSON_GEN_ERROR_PARSE;
+            *(int *)p = v;
+            return 0;
+        }
+        /* fall through */
+    default:
+        if (f->type == FIELD_TYPE_UINT64) {
+            return mp_unpack_number_as_uint64(r, (uint64_t *)p) < 0
+                       ? JSON_GEN_ERROR_PARSE : 0;
+        } else {
+            int64_t v;
+            if (mp_unpack_number_as_int64(r, &v) < 0) {
+                return JSON_GEN_ERROR_PARSE;
+            }
+            store_int(p, f->type, v);
+            return 0;
+        }
+    }
+}
+
+static int mp_get_field(struct mp_reader *r, const struct schema_field *f,
+                        char *obj, int depth) {
+    char *p = FIELD_PTR(obj, f);
+    uint32_t n, i;
+    int b = mp_peek(r);
+    if (b < 0) return JSON_GEN_ERROR_PARSE;
+    if (b == MP_NIL) {
+        // nullable, or an absent optional in a @compact struct
+        if (f->has_offset >= 0) HAS_FLAG(obj, f) = 0;
+        return mp_unpack_nil(r) < 0 ? JSON_GEN_ERROR_PARSE : 0;
+    }
+    if (f->has_offset >= 0) HAS_FLAG(obj, f) = 1;
+    if (f->kind == SF_SCALAR) return mp_get_elem(r, f, p, depth);
+
+    if (mp_unpack_array_header(r, &n) < 0) return JSON_GEN_ERROR_PARSE;
+    if (f->kind == SF_DYNAMIC) {
+        // every element takes at least one byte
+        if (n > r->len - r->pos) return JSON_GEN_ERROR_PARSE;
+        p = alloc_dynamic(f, obj, n);
+        if (p == NULL) return JSON_GEN_ERROR_MEMORY;
+    }
+    for (i = 0; i < n; i++) {
+        int rc;
+        if (f->kind == SF_FIXED && i >= (uint32_t)f->count) {
+            rc = mp_unpack_skip(r) < 0 ? JSON_GEN_ERROR_PARSE : 0;
+        } else {
+            rc = mp_get_elem(r, f, p + (size_t)i * f->elem_size, depth);
+        }
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+static int mp_get_object(struct mp_reader *r,
+                         const struct jgenc_schema_type *t, char *obj,
+                         int depth) {
+    uint32_t n, i;
+    int next = 0, b;
+    if (depth > SCHEMA_MAX_DEPTH) return JSON_GEN_ERROR_BOUNDS;
+    // @compact: by position, extra trailing elements skipped; a keyed map
+    // is accepted as well, as in the generated code
+    b = mp_peek(r);
+    if ((b & 0xf0) == MP_FIXARRAY || b == MP_ARRAY16 || b == MP_ARRAY32) {
+        if (!t->compact) return JSON_GEN_ERROR_PARSE;
+        if (mp_unpack_array_header(r, &n) < 0) return JSON_GEN_ERROR_PARSE;
+        for (i = 0; i < n; i++) {
+            int rc;
+            if (i < (uint32_t)t->field_count) {
+                rc = mp_get_field(r, &t->fields[i], obj, depth);
+            } else {
+                rc = mp_unpack_skip(r) < 0 ? JSON_GEN_ERROR_PARSE : 0;
+            }
+            if (rc != 0) return rc;
+        }
+        return 0;
+    }
+    if (mp_unpack_map_header(r, &n) < 0) return JSON_GEN_ERROR_PARSE;
+    for (i = 0; i < n; i++) {
+        const struct schema_field *f;
+        const char *key;
+        uint32_t klen;
+        int rc;
+        if (mp_unpack_str(r, &key, &klen) < 0) return JSON_GEN_ERROR_PARSE;
+        f = find_field(t, key, klen, &next);
+        if (f != NULL) {
+            rc = mp_get_field(r, f, obj, depth);
+        } else {
+            rc = mp_unpack_skip(r) < 0 ? JSON_GEN_ERROR_PARSE : 0;
+        }
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+int jgenc_schema_msgpack_unpack(const struct jgenc_schema_type *type,
+                                const unsigned char *data, size_t len,
+                                void *obj) {
+    struct mp_reader r;
+    if (type == NULL || obj == NULL || mp_reader_init(&r, data, len) < 0) {
+        return JSON_GEN_ERROR_INVALID_PARAM;
+    }
+    return mp_get_object(&r, type, obj, 0);
+}
+
+/* ======================================================================
+ * CBOR
+ * ====================================================================== */
+
+static void cb_put_object(const struct jgenc_schema_type *t, const char *obj,
+                          sstr_t out);
+
+static void cb_put_elem(const struct schema_field *f, const char *p,
+                        sstr_t out) {
+    switch (f->type) {
+    case FIELD_TYPE_SSTR: {
+        sstr_t s = *(sstr_t const *)p;
+        if (s == NULL) {
+            cb_pack_str(out, "", 0);
+        } else {
+            cb_pack_sstr(out, s);
+        }
+        break;
+    }
+    case FIELD_TYPE_FIXSTR:
+        cb_pack_str(out, p, *(const uint8_t *)(p + f->count + 1));
+        break;
+    case FIELD_TYPE_STRUCT:
+        cb_put_object(f->sub, p, out);
+        break;
+    case FIELD_TYPE_BOOL:
+        cb_pack_bool(out, *(const int *)p);
+        break;
+    case FIELD_TYPE_FLOAT:
+        cb_pack_float(out, *(const float *)p);
+        break;
+    case FIELD_TYPE_DOUBLE:
+        cb_pack_double(out, *(const double *)p);
+        break;
+    case FIELD_TYPE_ENUM: {
+        int v = *(const int *)p;
+        if (v >= 0 && v < f->en->count && f->en->names[v] != NULL) {
+            cb_pack_str(out, f->en->names[v], f->en->lens[v]);
+        } else {
+            cb_pack_int(out, v);
+        }
+        break;
+    }
+    default:
+        if (is_unsigned_type(f->type)) {
+            cb_pack_uint(out, (uint64_t)load_int(p, f->type));
+        } else {
+            cb_pack_int(out, load_int(p, f->type));
+        }
+        break;
+    }
+}
+
+static void cb_put_object(const struct jgenc_schema_type *t, const char *obj,
+                          sstr_t out) {
+    int i, j;
+    if (t->compact) {
+        cb_pack_array_header(out, (uint32_t)t->field_count);
+    } else {
+        cb_pack_map_header(out, present_fields(t, obj));
+    }
+    for (i = 0; i < t->field_count; i++) {
+        const struct schema_field *f = &t->fields[i];
+        const char *p = FIELD_PTR(obj, f);
+        if (t->compact) {
+            if (f->optional && !HAS_FLAG(obj, f)) {
+                cb_pack_nil(out);
+                continue;
+            }
+        } else {
+            if (f->optional && !f->nullable && !HAS_FLAG(obj, f)) continue;
+            cb_pack_str(out, f->key, f->key_len);
+        }
+        if (f->nullable && !HAS_FLAG(obj, f)) {
+            cb_pack_nil(out);
+        } else if (f->kind == SF_SCALAR) {
+            cb_put_elem(f, p, out);
+        } else {
+            int n = f->kind == SF_FIXED ? f->count : DYN_LEN(obj, f);
+            const char *arr = f->kind == SF_FIXED ? p : DYN_PTR(obj, f);
+            cb_pack_array_header(out, (uint32_t)n);
+            for (j = 0; j < n; j++) {
+                cb_put_elem(f, arr + (size_t)j * f->elem_size, out);
+            }
+        }
+    }
+}
+
+int jgenc_schema_cbor_pack(const struct jgenc_schema_type *type,
+                           const void *obj, sstr_t out) {
+    if (type == NULL || obj == NULL || out == NULL) {
+        return JSON_GEN_ERROR_INVALID_PARAM;
+    }
+    cb_put_object(type, obj, out);
+    return 0;
+}
+
+static int cb_get_object(struct cb_reader *r,
+                         const struct jgenc_schema_type *t, char *obj,
+                         int depth);
+
+static int cb_get_elem(struct cb_reader *r, const struct schema_field *f,
+                       char *p, int depth) {
+    const char *s;
+    uint32_t n;
+    int b = cb_peek(r);
+    if (b < 0) return JSON_GEN_ERROR_PARSE;
+    switch (f->type) {
+    case FIELD_TYPE_SSTR: {
+        sstr_t dst;
+        if (cb_unpack_str(r, &s, &n) < 0) return JSON_GEN_ERROR_PARSE;
+        dst = reuse_sstr(p);
+        sstr_append_of_fast(dst, s, n);
+        return 0;
+    }
+    case FIELD_TYPE_FIXSTR:
+        if (cb_unpack_str(r, &s, &n) < 0 || n > (uint32_t)f->count) {
+            return JSON_GEN_ERROR_PARSE;
+        }
+        memcpy(p, s, n);
+        p[n] = '\0';
+        *(uint8_t *)(p + f->count + 1) = (uint8_t)n;
+        return 0;
+    case FIELD_TYPE_STRUCT:
+        return cb_get_object(r, f->sub, p, depth + 1);
+    case FIELD_TYPE_BOOL:
+        return cb_unpack_bool(r, (int *)p) < 0 ? JSON_GEN_ERROR_PARSE : 0;
+    case FIELD_TYPE_FLOAT: {
+        double d;
+        if (cb_unpack_number_as_double(r, &d) < 0) return JSON_GEN_ERROR_PARSE;
+        *(float *)p = (float)d;
+        return 0;
+    }
+    case FIELD_TYPE_DOUBLE:
+        return cb_unpack_number_as_double(r, (double *)p) < 0
+                   ? JSON_GEN_ERROR_PARSE : 0;
+    case FIELD_TYPE_ENUM:
+        if (((b >> 5) & 0x07) == CB_MAJOR_TSTR) {
+            int v;
+            if (cb_unpack_str(r, &s, &n) < 0) return JSON_GEN_ERROR_PARSE;
+            v = enum_lookup(f->en, s, n);
+            if (v < 0) return JSON_GEN_ERROR_PARSE;
+            *(int *)p = v;
+            return 0;
+        }
+        /* fall through */
+    default:
+        if (f->type == FIELD_TYPE_UINT64) {
+            return cb_unpack_number_as_uint64(r, (uint64_t *)p) < 0
+                       ? JSON_GEN_ERROR_PARSE : 0;
+        } else {
+            int64_t v;
+            if (cb_unpack_number_as_int64(r, &v) < 0) {
+                return JSON_GEN_ERROR_PARSE;
+            }
+            store_int(p, f->type, v);
+            return 0;
+        }
+    }
+}
+
+static int cb_get_field(struct cb_reader *r, const struct schema_field *f,
+                        char *obj, int depth) {
+    char *p = FIELD_PTR(obj, f);
+    uint32_t n, i;
+    int b = cb_peek(r);
+    if (b < 0) return JSON_GEN_ERROR_PARSE;
+    if (b == CB_NULL) {
+        // nullable, or an absent optional in a @compact struct
+        if (f->has_offset >= 0) HAS_FLAG(obj, f) = 0;
+        return cb_unpack_nil(r) < 0 ? JSON_GEN_ERROR_PARSE : 0;
+    }
+    if (f->has_offset >= 0) HAS_FLAG(obj, f) = 1;
+    if (f->kind == SF_SCALAR) return cb_get_elem(r, f, p, depth);
+
+    if (cb_unpack_array_header(r, &n) < 0) return JSON_GEN_ERROR_PARSE;
+    if (f->kind == SF_DYNAMIC) {
+        // every element takes at least one byte
+        if (n > r->len - r->pos) return JSON_GEN_ERROR_PARSE;
+        p = alloc_dynamic(f, obj, n);
+        if (p == NULL) return JSON_GEN_ERROR_MEMORY;
+    }
+    for (i = 0; i < n; i++) {
+        int rc;
+        if (f->kind == SF_FIXED && i >= (uint32_t)f->count) {
+            rc = cb_unpack_skip(r) < 0 ? JSON_GEN_ERROR_PARSE : 0;
+        } else {
+            rc = cb_get_elem(r, f, p + (size_t)i * f->elem_size, depth);
+        }
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+static int cb_get_object(struct cb_reader *r,
+                         const struct jgenc_schema_type *t, char *obj,
+                         int depth) {
+    uint32_t n, i;
+    int next = 0, b;
+    if (depth > SCHEMA_MAX_DEPTH) return JSON_GEN_ERROR_BOUNDS;
+    // @compact: by position, extra trailing elements skipped; a keyed map
+    // is accepted as well, as in the generated code
+    b = cb_peek(r);
+    if (b >= 0 && (b >> 5) == CB_MAJOR_ARRAY) {
+        if (!t->compact) return JSON_GEN_ERROR_PARSE;
+        if (cb_unpack_array_header(r, &n) < 0) return JSON_GEN_ERROR_PARSE;
+        for (i = 0; i < n; i++) {
+            int rc;
+            if (i < (uint32_t)t->field_count) {
+                rc = cb_get_field(r, &t->fields[i], obj, depth);
+            } else {
+                rc = cb_unpack_skip(r) < 0 ? JSON_GEN_ERROR_PARSE : 0;
+            }
+            if (rc != 0) return rc;
+        }
+        return 0;
+    }
+    if (cb_unpack_map_header(r, &n) < 0) return JSON_GEN_ERROR_PARSE;
+    for (i = 0; i < n; i++) {
+        const struct schema_field *f;
+        const char *key;
+        uint32_t klen;
+        int rc;
+        if (cb_unpack_str(r, &key, &klen) < 0) return JSON_GEN_ERROR_PARSE;
+        f = find_field(t, key, klen, &next);
+        if (f != NULL) {
+            rc = cb_get_field(r, f, obj, depth);
+        } else {
+            rc = cb_unpack_skip(r) < 0 ? JSON_GEN_ERROR_PARSE : 0;
+        }
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+int jgenc_schema_cbor_unpack(const struct jgenc_schema_type *type,
+                             const unsigned char *data, size_t len,
+                             void *obj) {
+    struct cb_reader r;
+    if (type == NULL || obj == NULL || cb_reader_init(&r, data, len) < 0) {
+        return JSON_GEN_ERROR_INVALID_PARAM;
+    }
+    return cb_get_object(&r, type, obj, 0);
+}
+
+/* ======================================================================
+ * Cache
+ * ====================================================================== */
+
+#define SCHEMA_CACHE_BUCKETS 64
+
+struct schema_cache_entry {
+    uint32_t hash;
+    size_t len;
+    char *text;
+    struct jgenc_schema *schema;
+    struct schema_cache_entry *next;
+};
+
+/* Schemas keyed by a hash of their text; a hit compares the text but
+ * allocates nothing. */
+struct jgenc_schema_cache {
+    struct schema_cache_entry *buckets[SCHEMA_CACHE_BUCKETS];
+    compat_mutex_t mutex;
+};
+
+static struct jgenc_schema *cache_find(struct jgenc_schema_cache *cache,
+                                       uint32_t h, const char *text,
+                                       size_t len) {
+    struct schema_cache_entry *e;
+    for (e = cache->buckets[h % SCHEMA_CACHE_BUCKETS]; e != NULL;
+         e = e->next) {
+        if (e->hash == h && e->len == len && memcmp(e->text, text, len) == 0) {
+            return e->schema;
+        }
+    }
+    return NULL;
+}
+
+struct jgenc_schema_cache *jgenc_schema_cache_new(void) {
+    struct jgenc_schema_cache *cache = calloc(1, sizeof(*cache));
+    if (cache == NULL) return NULL;
+    if (compat_mutex_init(&cache->mutex) != 0) {
+        free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+void jgenc_schema_cache_free(struct jgenc_schema_cache *cache) {
+    int i;
+    if (cache == NULL) return;
+    for (i = 0; i < SCHEMA_CACHE_BUCKETS; i++) {
+        struct schema_cache_entry *e = cache->buckets[i];
+        while (e != NULL) {
+            struct schema_cache_entry *next = e->next;
+            jgenc_schema_free(e->schema);
+            free(e->text);
+            free(e);
+            e = next;
+        }
+    }
+    compat_mutex_destroy(&cache->mutex);
+    free(cache);
+}
+
+const struct jgenc_schema *jgenc_schema_cache_compile(
+    struct jgenc_schema_cache *cache, const char *text, size_t len) {
+    struct jgenc_schema *schema, *found;
+    struct schema_cache_entry *e;
+    uint32_t h;
+
+    if (cache == NULL || text == NULL) return NULL;
+    h = hash_murmur(text, len, 0xbc9f1d34);
+
+    compat_mutex_lock(&cache->mutex);
+    found = cache_find(cache, h, text, len);
+    compat_mutex_unlock(&cache->mutex);
+    if (found != NULL) return found;
+
+    // compile unlocked so one slow schema does not stall other tenants
+    schema = jgenc_schema_compile(text, len);
+    if (schema == NULL) return NULL;
+    e = malloc(sizeof(*e));
+    if (e != NULL) e->text = schema_strndup(text, len);
+    if (e == NULL || e->text == NULL) {
+        free(e);
+        jgenc_schema_free(schema);
+        return NULL;
+    }
+    e->hash = h;
+    e->len = len;
+    e->schema = schema;
+
+    compat_mutex_lock(&cache->mutex);
+    found = cache_find(cache, h, text, len);
+    if (found == NULL) {
+        e->next = cache->buckets[h % SCHEMA_CACHE_BUCKETS];
+        cache->buckets[h % SCHEMA_CACHE_BUCKETS] = e;
+    }
+    compat_mutex_unlock(&cache->mutex);
+    if (found != NULL) {
+        // another thread compiled the same text first
+        jgenc_schema_free(schema);
+        free(e->text);
+        free(e);
+        return found;
+    }
+    return schema;
+}
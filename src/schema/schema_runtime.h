@@ -0,0 +1,193 @@
+/**
+ * @file schema/schema_runtime.h
+ * @brief Schema interpreter — JSON, MessagePack and CBOR conversion for
+ *        schemas loaded at runtime, without running the generator.
+ *
+ * A `.json-gen-c` schema is parsed with struct_parser_parse() and compiled
+ * into per-struct field tables: the C layout the generator would emit
+ * (offsets, sizes, `_len` and `has_` companions) plus a key lookup table.
+ * The conversion functions walk those tables over caller-provided memory,
+ * so an object decoded here has the same layout as the generated struct,
+ * and the wire formats match the generated code byte for byte.
+ *
+ * Supported field types: all integer types, float, double, bool, enums,
+ * sstr_t, str<N>, nested structs, fixed and dynamic arrays of those, and
+ * the optional / nullable / default modifiers, and @compact structs.
+ * Maps, oneofs, @inline_str and @cached structs are rejected at compile
+ * time.
+ *
+ * The JSON decoder rejects every document the generated decoder rejects,
+ * and decodes the others to the same object. It is stricter in a few places: comments, raw
+ * control characters and malformed \u escapes in strings, a missing or
+ * extra comma between members, and malformed unknown values.
+ */
+
+#ifndef SCHEMA_RUNTIME_H_
+#define SCHEMA_RUNTIME_H_
+
+#include <stddef.h>
+
+#include "utils/sstr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Same as in the generated header, which guards them the same way. */
+#ifndef JGENC_JSON_DECODE_TYPES_
+#define JGENC_JSON_DECODE_TYPES_
+
+/** Decode error; see the generated header. */
+struct json_error {
+    int code;            /* json_gen_error_t, 0 on success */
+    long offset;         /* input byte offset of the failure */
+    int expected_token;  /* '{' '}' '[' ']' ':' ',' or JSON_EXPECT_* */
+};
+
+#define JSON_EXPECT_NONE 0
+#define JSON_EXPECT_STRING 1
+#define JSON_EXPECT_NUMBER 2
+#define JSON_EXPECT_VALUE 3
+
+/** Resource caps for decoding untrusted input; 0 means unlimited. */
+struct json_limits {
+    size_t max_input_bytes;  /* length of the whole document */
+    size_t max_string_len;   /* bytes of one decoded string or key */
+    size_t max_array_len;    /* elements of one array */
+    size_t max_map_entries;  /* entries of one map object */
+    size_t max_alloc_bytes;  /* bytes allocated by one decode */
+};
+
+#endif /* JGENC_JSON_DECODE_TYPES_ */
+
+/** A compiled schema; immutable and safe to share between threads. */
+struct jgenc_schema;
+
+/** One struct of a compiled schema. */
+struct jgenc_schema_type;
+
+/** Content-addressed cache of compiled schemas. */
+struct jgenc_schema_cache;
+
+/**
+ * @brief Parse and compile a schema.
+ *
+ * Parse errors are printed to stderr by the schema parser.
+ *
+ * @param text Schema source, as accepted by json-gen-c -in.
+ * @param len  Length of text.
+ * @return the compiled schema, or NULL if the schema does not parse or
+ *         uses an unsupported field type.
+ */
+struct jgenc_schema *jgenc_schema_compile(const char *text, size_t len);
+
+/**
+ * @brief Free a schema returned by jgenc_schema_compile().
+ */
+void jgenc_schema_free(struct jgenc_schema *schema);
+
+/**
+ * @brief Look up a struct by name.
+ * @return the struct, or NULL if the schema has no struct of that name.
+ */
+const struct jgenc_schema_type *jgenc_schema_find_type(
+    const struct jgenc_schema *schema, const char *name);
+
+/** @brief sizeof() of the generated struct. */
+size_t jgenc_schema_type_size(const struct jgenc_schema_type *type);
+
+/** @brief _Alignof() of the generated struct. */
+size_t jgenc_schema_type_align(const struct jgenc_schema_type *type);
+
+/**
+ * @brief offsetof() of a field of the generated struct.
+ * @return the offset, or -1 if the struct has no such field.
+ */
+long jgenc_schema_field_offset(const struct jgenc_schema_type *type,
+                               const char *field);
+
+/**
+ * @brief Same as <struct>_init(): zero obj and apply field defaults.
+ */
+int jgenc_schema_init(const struct jgenc_schema_type *type, void *obj);
+
+/**
+ * @brief Same as <struct>_clear(): free everything obj owns, then zero it.
+ */
+int jgenc_schema_clear(const struct jgenc_schema_type *type, void *obj);
+
+/**
+ * @brief Same as json_unmarshal_<struct>() on an initialized obj.
+ * @return 0 on success, negative JSON_GEN_ERROR_* on malformed input.
+ */
+int jgenc_schema_json_unmarshal(const struct jgenc_schema_type *type,
+                                const char *in, size_t len, void *obj);
+
+/**
+ * @brief Same as json_unmarshal_<struct>_limited(): decode under
+ *        limits and describe a failure in err.
+ *
+ * The process default of the generated json_gen_c_set_limits() does not
+ * apply here; a NULL limits means no caps. err may be NULL.
+ *
+ * @return 0 on success, negative JSON_GEN_ERROR_* on malformed input or a
+ *         cap exceeded (JSON_GEN_ERROR_BOUNDS).
+ */
+int jgenc_schema_json_unmarshal_limited(const struct jgenc_schema_type *type,
+                                        const char *in, size_t len,
+                                        void *obj,
+                                        const struct json_limits *limits,
+                                        struct json_error *err);
+
+/**
+ * @brief Same as json_marshal_<struct>(): append compact JSON to out.
+ */
+int jgenc_schema_json_marshal(const struct jgenc_schema_type *type,
+                              const void *obj, sstr_t out);
+
+/** @brief Same as msgpack_pack_<struct>(). */
+int jgenc_schema_msgpack_pack(const struct jgenc_schema_type *type,
+                              const void *obj, sstr_t out);
+
+/** @brief Same as msgpack_unpack_<struct>() on an initialized obj. */
+int jgenc_schema_msgpack_unpack(const struct jgenc_schema_type *type,
+                                const unsigned char *data, size_t len,
+                                void *obj);
+
+/** @brief Same as cbor_pack_<struct>(). */
+int jgenc_schema_cbor_pack(const struct jgenc_schema_type *type,
+                           const void *obj, sstr_t out);
+
+/** @brief Same as cbor_unpack_<struct>() on an initialized obj. */
+int jgenc_schema_cbor_unpack(const struct jgenc_schema_type *type,
+                             const unsigned char *data, size_t len,
+                             void *obj);
+
+/**
+ * @brief Create an empty schema cache.
+ * @return the cache, or NULL if out of memory.
+ */
+struct jgenc_schema_cache *jgenc_schema_cache_new(void);
+
+/**
+ * @brief Free a cache and every schema it compiled.
+ */
+void jgenc_schema_cache_free(struct jgenc_schema_cache *cache);
+
+/**
+ * @brief Compile a schema, or return the one compiled earlier from the
+ *        same text.
+ *
+ * Thread-safe. The schema is owned by the cache and stays valid until
+ * jgenc_schema_cache_free().
+ *
+ * @return the compiled schema, or NULL as for jgenc_schema_compile().
+ */
+const struct jgenc_schema *jgenc_schema_cache_compile(
+    struct jgenc_schema_cache *cache, const char *text, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SCHEMA_RUNTIME_H_ */
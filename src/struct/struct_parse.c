@@ -47,6 +47,8 @@ static struct struct_field* struct_field_new(sstr_t name, int type,
     field->default_value = NULL;
     field->has_default = 0;
     field->is_deprecated = 0;
+    field->is_inline_str = 0;
+    field->str_size = 0;
     field->line = 0;
     field->col = 0;
     return field;
@@ -88,6 +90,8 @@ static struct struct_container* struct_container_new() {
     container->name_line = 0;
     container->name_col = 0;
     container->filename = NULL;
+    container->is_cached = 0;
+    container->is_compact = 0;
     return container;
 }
 
@@ -495,6 +499,10 @@ static enum top_level_item_kind top_level_item_kind_from_token(
     if (token->type == TOKEN_SHARPE) {
         return TOP_LEVEL_ITEM_INCLUDE;
     }
+    if (token->type == TOKEN_AT) {
+        // struct annotation, e.g. '@cached struct ...'
+        return TOP_LEVEL_ITEM_STRUCT;
+    }
     if (token->type != TOKEN_IDENTIFY || token->txt == NULL) {
         return TOP_LEVEL_ITEM_INVALID;
     }
@@ -851,6 +859,53 @@ static int parse_map_field(struct struct_parser* parser, sstr_t content,
     return 0;
 }
 
+/**
+ * @brief Parse a str<N> field type: a string of at most N bytes stored in
+ * the struct. Expects the tokenizer to have just consumed "str".
+ * @return 0 on success, -1 on error.
+ */
+static int parse_fixstr_field(struct struct_parser* parser, sstr_t content,
+                              struct struct_token* token,
+                              struct struct_field* field, sstr_t type_name) {
+    token->txt = NULL;
+    // <N> is tokenized as TOKEN_STRING, like map<...>
+    next_token(parser, content, token);
+    if (token->type != TOKEN_STRING) {
+        PERROR(parser, "expected '<size>' after 'str'");
+        sstr_free(type_name);
+        return -1;
+    }
+    char* end = NULL;
+    long n = strtol(sstr_cstr(token->txt), &end, 10);
+    while (end && *end == ' ') end++;
+    if (end == sstr_cstr(token->txt) || *end != '\0' || n < 1 || n > 255) {
+        PERROR(parser, "str<N> size must be an integer from 1 to 255, got '%s'",
+               sstr_cstr(token->txt));
+        sstr_free(type_name);
+        return -1;
+    }
+    field->type = FIELD_TYPE_FIXSTR;
+    field->str_size = (int)n;
+    field->type_name = type_name;
+    sstr_free(token->txt);
+    token->txt = NULL;
+    return 0;
+}
+
+// length of a default string literal once its escapes are decoded
+static size_t default_str_length(sstr_t lit) {
+    const char* p = sstr_cstr(lit);
+    size_t len = sstr_length(lit);
+    size_t n = 0;
+    size_t i;
+    for (i = 0; i < len; i++, n++) {
+        if (p[i] == '\\' && i + 1 < len) {
+            i++;
+        }
+    }
+    return n;
+}
+
 static int struct_parse_field(struct struct_parser* parser, sstr_t content,
                               struct struct_token* token,
                               struct struct_field* field) {
@@ -868,7 +923,8 @@ static int struct_parse_field(struct struct_parser* parser, sstr_t content,
         return 0;
     }
 
-    // parse @json "alias" and @deprecated annotations (order-independent)
+    // parse @json "alias", @deprecated and @inline_str annotations
+    // (order-independent)
     while (tk == TOKEN_AT) {
         tk = next_token(parser, content, token);
         if (tk != TOKEN_IDENTIFY) {
@@ -891,6 +947,10 @@ static int struct_parse_field(struct struct_parser* parser, sstr_t content,
             field->is_deprecated = 1;
             sstr_free(token->txt);
             token->txt = NULL;
+        } else if (sstr_compare_c(token->txt, "inline_str") == 0) {
+            field->is_inline_str = 1;
+            sstr_free(token->txt);
+            token->txt = NULL;
         } else {
             PERROR(parser, "unknown annotation '@%s'",
                    sstr_cstr(token->txt));
@@ -953,6 +1013,15 @@ static int struct_parse_field(struct struct_parser* parser, sstr_t content,
         goto parse_field_name;
     }
 
+    // handle str<N> syntax
+    if (sstr_compare_c(type_name, TYPE_NAME_FIXSTR) == 0) {
+        type_id = FIELD_TYPE_FIXSTR;
+        if (parse_fixstr_field(parser, content, token, field, type_name) < 0) {
+            return -1;
+        }
+        goto parse_field_name;
+    }
+
     // get type id of typename.
     type_id = lookup_primitive_type(type_name);
     if (type_id < 0) {
@@ -1009,6 +1078,15 @@ parse_field_name:
 
         tk = next_token(parser, content, token);
     }
+    if (field->is_inline_str &&
+        (field->type != FIELD_TYPE_SSTR || field->is_array)) {
+        PERROR(parser, "'@inline_str' requires a non-array sstr_t field");
+        return -1;
+    }
+    if (field->type == FIELD_TYPE_FIXSTR && field->is_array) {
+        PERROR(parser, "str<N> fields cannot be arrays");
+        return -1;
+    }
     // parse default value: = <literal>;
     if (tk == TOKEN_EQUAL) {
         if (field->is_array) {
@@ -1030,6 +1108,13 @@ parse_field_name:
                    token_type_str(token));
             return -1;
         }
+        if (field->type == FIELD_TYPE_FIXSTR &&
+            (tk != TOKEN_STRING ||
+             default_str_length(token->txt) > (size_t)field->str_size)) {
+            PERROR(parser, "default value does not fit in str<%d>",
+                   field->str_size);
+            return -1;
+        }
         field->default_value = token->txt;
         token->txt = NULL;
         field->has_default = 1;
@@ -1443,6 +1528,35 @@ static int parse_struct_definition(struct struct_parser* parser, sstr_t content,
         return JSON_GEN_ERROR_MEMORY;
     }
 
+    // struct annotations before 'struct'
+    while (token->type == TOKEN_AT) {
+        int tk = next_token(parser, content, token);
+        if (tk != TOKEN_IDENTIFY) {
+            PERROR(parser, "expected annotation name after '@', found '%s'",
+                   token_type_str(token));
+            struct_container_free(sct);
+            return JSON_GEN_ERROR_PARSE;
+        }
+        if (sstr_compare_c(token->txt, "cached") == 0) {
+            sct->is_cached = 1;
+        } else if (sstr_compare_c(token->txt, "compact") == 0) {
+            sct->is_compact = 1;
+        } else {
+            PERROR(parser, "unknown struct annotation '@%s'",
+                   sstr_cstr(token->txt));
+            struct_container_free(sct);
+            return JSON_GEN_ERROR_PARSE;
+        }
+        next_token(parser, content, token);
+    }
+    if (token->type != TOKEN_IDENTIFY ||
+        sstr_compare_c(token->txt, "struct") != 0) {
+        PERROR(parser, "expected 'struct' after struct annotation, found '%s'",
+               token_type_str(token));
+        struct_container_free(sct);
+        return JSON_GEN_ERROR_PARSE;
+    }
+
     int r = parse_struct_body(parser, content, token, sct);
     if (r != 0) {
         struct_container_free(sct);
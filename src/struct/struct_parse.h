@@ -38,6 +38,7 @@ extern "C" {
 #define FIELD_TYPE_UINT32 15
 #define FIELD_TYPE_UINT64 16
 #define FIELD_TYPE_ONEOF 17
+#define FIELD_TYPE_FIXSTR 18
 
 #define TYPE_NAME_INT "int"
 #define TYPE_NAME_BOOL "bool"
@@ -53,6 +54,7 @@ extern "C" {
 #define TYPE_NAME_UINT16 "uint16_t"
 #define TYPE_NAME_UINT32 "uint32_t"
 #define TYPE_NAME_UINT64 "uint64_t"
+#define TYPE_NAME_FIXSTR "str"
 
 /**
  * @brief We use a hash map to store parsed structs, and use the struct name
@@ -146,6 +148,11 @@ struct struct_field {
     int has_default;
     // 1 if field is deprecated, 0 otherwise
     int is_deprecated;
+    // 1 if annotated with @inline_str: the struct sstr_s is stored in the
+    // struct itself instead of behind an sstr_t
+    int is_inline_str;
+    // for FIELD_TYPE_FIXSTR (str<N>): N, the most bytes the field holds
+    int str_size;
     // source position where the field was defined
     int line;
     int col;
@@ -167,6 +174,11 @@ struct struct_container {
     int name_col;
     // source filename (not owned)
     const char *filename;
+    // 1 if annotated with @cached: keep per-field json fragments
+    int is_cached;
+    // 1 if annotated with @compact: msgpack/cbor encode the struct as an
+    // array of field values in declaration order instead of a keyed map
+    int is_compact;
 };
 
 /**
@@ -4,6 +4,7 @@
  *
  * Provides unified APIs for:
  * - Mutex (pthread on POSIX, CRITICAL_SECTION on Windows)
+ * - Atomic pointer load/exchange for lock-free publication
  * - isatty / fileno
  * - strdup
  * - Path separator detection
@@ -37,6 +38,14 @@ static inline void compat_mutex_destroy(compat_mutex_t *m) {
     DeleteCriticalSection(m);
 }
 
+/* Interlocked calls are full barriers. */
+static inline void *compat_atomic_load_ptr(void *volatile *p) {
+    return InterlockedCompareExchangePointer(p, NULL, NULL);
+}
+static inline void *compat_atomic_exchange_ptr(void *volatile *p, void *v) {
+    return InterlockedExchangePointer(p, v);
+}
+
 #define compat_isatty(fd)   _isatty(fd)
 #define compat_fileno(f)    _fileno(f)
 #define compat_strdup(s)    _strdup(s)
@@ -62,6 +71,13 @@ static inline void compat_mutex_destroy(compat_mutex_t *m) {
     pthread_mutex_destroy(m);
 }
 
+static inline void *compat_atomic_load_ptr(void *volatile *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+static inline void *compat_atomic_exchange_ptr(void *volatile *p, void *v) {
+    return __atomic_exchange_n(p, v, __ATOMIC_ACQ_REL);
+}
+
 #define compat_isatty(fd)   isatty(fd)
 #define compat_fileno(f)    fileno(f)
 #define compat_strdup(s)    strdup(s)
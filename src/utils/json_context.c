@@ -34,6 +34,12 @@ void json_context_free(struct json_context* ctx) {
     
     // Note: We don't free field_offset_items and entry_hash here
     // as they are typically static/global data owned by the generated code
+    free(ctx->table);
+    while (ctx->retired != NULL) {
+        struct json_context_table* next = ctx->retired->retired_next;
+        free(ctx->retired);
+        ctx->retired = next;
+    }
     
     free(ctx);
 }
@@ -47,18 +53,49 @@ int json_context_init(struct json_context* ctx,
         return JSON_GEN_ERROR_INVALID_PARAM;
     }
     
+    struct json_context_table* table = malloc(sizeof(struct json_context_table));
+    if (table == NULL) {
+        return JSON_GEN_ERROR_MEMORY;
+    }
+    table->field_offset_items = field_items;
+    table->item_count = item_count;
+    table->entry_hash = hash_table;
+    table->entry_hash_size = hash_size;
+    table->retired_next = NULL;
+    
+    // Readers never lock; the mutex only orders concurrent writers and
+    // guards the retired list.
     compat_mutex_lock(&ctx->mutex);
     
-    ctx->field_offset_items = field_items;
-    ctx->item_count = item_count;
-    ctx->entry_hash = hash_table;
-    ctx->entry_hash_size = hash_size;
+    struct json_context_table* old = compat_atomic_exchange_ptr(
+        (void* volatile*)&ctx->table, table);
+    if (old != NULL) {
+        old->retired_next = ctx->retired;
+        ctx->retired = old;
+    }
     
     compat_mutex_unlock(&ctx->mutex);
     
     return JSON_GEN_SUCCESS;
 }
 
+void json_context_reclaim(struct json_context* ctx) {
+    if (ctx == NULL) {
+        return;
+    }
+    
+    compat_mutex_lock(&ctx->mutex);
+    struct json_context_table* retired = ctx->retired;
+    ctx->retired = NULL;
+    compat_mutex_unlock(&ctx->mutex);
+    
+    while (retired != NULL) {
+        struct json_context_table* next = retired->retired_next;
+        free(retired);
+        retired = next;
+    }
+}
+
 /**
  * @brief Hash function for two strings
  */
@@ -95,42 +132,33 @@ struct json_field_offset_item* json_context_find_field(
         return NULL;
     }
     
-    compat_mutex_lock(&ctx->mutex);
-    
-    if (ctx->entry_hash_size == 0 || ctx->entry_hash == NULL || 
-        ctx->field_offset_items == NULL) {
-        compat_mutex_unlock(&ctx->mutex);
+    const struct json_context_table* table =
+        compat_atomic_load_ptr((void* volatile*)&ctx->table);
+    if (table == NULL || table->entry_hash_size <= 0) {
         return NULL;
     }
     
-    unsigned int h = hash_2s_c(struct_name, field_name) % ctx->entry_hash_size;
-    int id = ctx->entry_hash[h];
+    unsigned int h = hash_2s_c(struct_name, field_name) % table->entry_hash_size;
     
-    if (id < 0) {
-        compat_mutex_unlock(&ctx->mutex);
-        return NULL;
-    }
-
-    do {
-        struct json_field_offset_item* item = &ctx->field_offset_items[id];
+    // Linear probing; -1 means empty slot. Bounded so that a completely
+    // full table cannot loop forever.
+    for (int probes = 0; probes < table->entry_hash_size; probes++) {
+        int id = table->entry_hash[h];
+        if (id < 0) {
+            break;
+        }
+        
+        struct json_field_offset_item* item = &table->field_offset_items[id];
         if (strcmp(struct_name, item->struct_name) == 0 &&
             strcmp(field_name, item->field_name) == 0) {
-            compat_mutex_unlock(&ctx->mutex);
             return item;
         }
         
         h++;
-        if ((int)h >= ctx->entry_hash_size) {
+        if ((int)h >= table->entry_hash_size) {
             h = 0;
         }
-        id = ctx->entry_hash[h];
-        
-        // -1 means empty slot
-        if (id < 0) {
-            break;
-        }
-    } while (1);
+    }
 
-    compat_mutex_unlock(&ctx->mutex);
     return NULL;
 }
@@ -23,15 +23,32 @@ struct json_field_offset_item {
 };
 
 /**
- * @brief Thread-safe JSON parsing context
- * This structure replaces global variables to ensure thread safety
+ * @brief Immutable field lookup table published by a json_context
+ * Once published a table is never modified, so readers need no lock.
  */
-struct json_context {
+struct json_context_table {
     struct json_field_offset_item *field_offset_items;  /**< Field offset items array */
     int *entry_hash;                                    /**< Hash table for field lookups */
     int entry_hash_size;                               /**< Size of hash table */
     int item_count;                                    /**< Number of field offset items */
-    compat_mutex_t mutex;                              /**< Mutex for thread safety */
+    struct json_context_table *retired_next;           /**< Next replaced table, freed by reclaim */
+};
+
+/**
+ * @brief Thread-safe JSON parsing context
+ * This structure replaces global variables to ensure thread safety.
+ * Lookups read the current table with an acquire load and take no lock;
+ * json_context_init() publishes a new table with an atomic swap. A replaced
+ * table stays valid until json_context_reclaim() or json_context_free(), so
+ * a reader that loaded it just before the swap can finish its lookup. Each
+ * republish retires one small table header (the item and hash arrays are
+ * the caller's), so a context that is republished periodically should call
+ * json_context_reclaim() at a point where no lookup is in flight.
+ */
+struct json_context {
+    struct json_context_table *volatile table;  /**< Current table, NULL until initialized */
+    struct json_context_table *retired;         /**< Replaced tables, guarded by mutex */
+    compat_mutex_t mutex;                       /**< Serializes writers */
 };
 
 /**
@@ -48,6 +65,8 @@ extern void json_context_free(struct json_context* ctx);
 
 /**
  * @brief Initialize context with field offset data
+ * @details Publishes a new immutable table; may be called again to replace
+ * it while other threads are calling json_context_find_field().
  * @param ctx Context to initialize
  * @param field_items Array of field offset items
  * @param item_count Number of items in array
@@ -61,8 +80,19 @@ extern int json_context_init(struct json_context* ctx,
                      int* hash_table,
                      int hash_size);
 
+/**
+ * @brief Free the tables replaced by earlier json_context_init() calls
+ * @details The caller must know that no thread is still inside a
+ * json_context_find_field() call that started before the latest
+ * json_context_init(), e.g. after the readers have passed a barrier or
+ * finished their current request. The current table is kept.
+ * @param ctx JSON context
+ */
+extern void json_context_reclaim(struct json_context* ctx);
+
 /**
  * @brief Find field offset item in thread-safe manner
+ * @details Lock-free: reads the table published by json_context_init().
  * @param ctx JSON context
  * @param struct_name Structure name
  * @param field_name Field name
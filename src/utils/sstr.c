@@ -17,15 +17,232 @@
 #include <string.h>
 #include <time.h>
 
-/* Allocator indirection — users may override before including generated code */
+#if defined(_MSC_VER)
+#define SSTR_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && \
+    !defined(__STDC_NO_THREADS__)
+#define SSTR_THREAD_LOCAL _Thread_local
+#else
+#define SSTR_THREAD_LOCAL __thread
+#endif
+
+static SSTR_THREAD_LOCAL const struct jgenc_allocator* jgenc_thread_alloc_ =
+    NULL;
+
+const struct jgenc_allocator* jgenc_set_thread_allocator(
+    const struct jgenc_allocator* alloc) {
+    const struct jgenc_allocator* prev = jgenc_thread_alloc_;
+    jgenc_thread_alloc_ = alloc;
+    return prev;
+}
+
+const struct jgenc_allocator* jgenc_thread_allocator(void) {
+    return jgenc_thread_alloc_;
+}
+
+void* jgenc_malloc(size_t size) {
+    const struct jgenc_allocator* a = jgenc_thread_alloc_;
+    return a ? a->malloc_fn(a->ud, size) : malloc(size);
+}
+
+void* jgenc_realloc(void* ptr, size_t size) {
+    const struct jgenc_allocator* a = jgenc_thread_alloc_;
+    return a ? a->realloc_fn(a->ud, ptr, size) : realloc(ptr, size);
+}
+
+void jgenc_free(void* ptr) {
+    const struct jgenc_allocator* a = jgenc_thread_alloc_;
+    if (a) {
+        a->free_fn(a->ud, ptr);
+    } else {
+        free(ptr);
+    }
+}
+
+/*
+ * Size-class pool. Every block starts with a JGENC_POOL_HEADER-byte header
+ * holding its class, so the payload keeps malloc()'s 16-byte alignment and
+ * free needs no lookup. A class with an empty free list is refilled with
+ * JGENC_POOL_BATCH blocks at once, carved from a JGENC_POOL_SLAB-byte slab;
+ * slabs are only released by jgenc_pool_destroy(). Blocks above the largest
+ * class go straight to malloc().
+ */
+#define JGENC_POOL_HEADER 16
+#define JGENC_POOL_LARGE JGENC_POOL_CLASS_COUNT
+
+#ifndef JGENC_POOL_SLAB
+#define JGENC_POOL_SLAB (64 * 1024)
+#endif
+#ifndef JGENC_POOL_BATCH
+#define JGENC_POOL_BATCH 32
+#endif
+
+/* Payload sizes; 48 fits a struct sstr_s on LP64. */
+static const size_t jgenc_pool_class_size_[JGENC_POOL_CLASS_COUNT] = {
+    16, 32, 48, 64, 96, 128, 192, 256, 384, 512,
+};
+
+struct jgenc_pool_slab_ {
+    struct jgenc_pool_slab_* next;
+    size_t pad_;  // keeps the carved blocks 16-byte aligned
+};
+
+struct jgenc_pool {
+    void* free_list[JGENC_POOL_CLASS_COUNT];
+    struct jgenc_pool_slab_* slabs;
+    char* bump;
+    char* bump_end;
+    struct jgenc_allocator alloc;
+};
+
+static int jgenc_pool_class_(size_t size) {
+    int c = 0;
+    if (size > jgenc_pool_class_size_[JGENC_POOL_CLASS_COUNT - 1]) {
+        return JGENC_POOL_LARGE;
+    }
+    while (jgenc_pool_class_size_[c] < size) {
+        c++;
+    }
+    return c;
+}
+
+static size_t* jgenc_pool_header_(void* ptr) {
+    return (size_t*)((char*)ptr - JGENC_POOL_HEADER);
+}
+
+/* Refill the free list of class c with up to JGENC_POOL_BATCH blocks. */
+static int jgenc_pool_refill_(struct jgenc_pool* pool, int c) {
+    size_t block = JGENC_POOL_HEADER + jgenc_pool_class_size_[c];
+    int n;
+    if ((size_t)(pool->bump_end - pool->bump) < block) {
+        struct jgenc_pool_slab_* slab =
+            (struct jgenc_pool_slab_*)malloc(JGENC_POOL_SLAB);
+        if (slab == NULL) {
+            return -1;
+        }
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        pool->bump = (char*)(slab + 1);
+        pool->bump_end = (char*)slab + JGENC_POOL_SLAB;
+    }
+    for (n = 0; n < JGENC_POOL_BATCH &&
+                (size_t)(pool->bump_end - pool->bump) >= block;
+         n++) {
+        void* p = pool->bump + JGENC_POOL_HEADER;
+        *jgenc_pool_header_(p) = (size_t)c;
+        *(void**)p = pool->free_list[c];
+        pool->free_list[c] = p;
+        pool->bump += block;
+    }
+    return 0;
+}
+
+static void* jgenc_pool_malloc_(void* ud, size_t size) {
+    struct jgenc_pool* pool = (struct jgenc_pool*)ud;
+    int c = jgenc_pool_class_(size);
+    void* p;
+
+    if (c == JGENC_POOL_LARGE) {
+        char* raw = (char*)malloc(JGENC_POOL_HEADER + size);
+        if (raw == NULL) {
+            return NULL;
+        }
+        *(size_t*)raw = JGENC_POOL_LARGE;
+        return raw + JGENC_POOL_HEADER;
+    }
+    if (pool->free_list[c] == NULL && jgenc_pool_refill_(pool, c) != 0) {
+        return NULL;
+    }
+    p = pool->free_list[c];
+    pool->free_list[c] = *(void**)p;
+    return p;
+}
+
+static void jgenc_pool_free_(void* ud, void* ptr) {
+    struct jgenc_pool* pool = (struct jgenc_pool*)ud;
+    size_t c;
+    if (ptr == NULL) {
+        return;
+    }
+    c = *jgenc_pool_header_(ptr);
+    if (c == JGENC_POOL_LARGE) {
+        free(jgenc_pool_header_(ptr));
+        return;
+    }
+    *(void**)ptr = pool->free_list[c];
+    pool->free_list[c] = ptr;
+}
+
+static void* jgenc_pool_realloc_(void* ud, void* ptr, size_t size) {
+    size_t c, old_size;
+    void* p;
+    if (ptr == NULL) {
+        return jgenc_pool_malloc_(ud, size);
+    }
+    c = *jgenc_pool_header_(ptr);
+    if (c == JGENC_POOL_LARGE) {
+        if (jgenc_pool_class_(size) == JGENC_POOL_LARGE) {
+            char* raw = (char*)realloc(jgenc_pool_header_(ptr),
+                                       JGENC_POOL_HEADER + size);
+            return raw == NULL ? NULL : raw + JGENC_POOL_HEADER;
+        }
+        old_size = size;  // shrinking into a class: copy what fits
+    } else {
+        old_size = jgenc_pool_class_size_[c];
+        if (size <= old_size) {
+            return ptr;
+        }
+    }
+    p = jgenc_pool_malloc_(ud, size);
+    if (p == NULL) {
+        return NULL;
+    }
+    memcpy(p, ptr, old_size < size ? old_size : size);
+    jgenc_pool_free_(ud, ptr);
+    return p;
+}
+
+struct jgenc_pool* jgenc_pool_new(void) {
+    struct jgenc_pool* pool =
+        (struct jgenc_pool*)calloc(1, sizeof(struct jgenc_pool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->alloc.ud = pool;
+    pool->alloc.malloc_fn = jgenc_pool_malloc_;
+    pool->alloc.realloc_fn = jgenc_pool_realloc_;
+    pool->alloc.free_fn = jgenc_pool_free_;
+    return pool;
+}
+
+void jgenc_pool_destroy(struct jgenc_pool* pool) {
+    struct jgenc_pool_slab_* slab;
+    if (pool == NULL) {
+        return;
+    }
+    slab = pool->slabs;
+    while (slab != NULL) {
+        struct jgenc_pool_slab_* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    free(pool);
+}
+
+const struct jgenc_allocator* jgenc_pool_allocator(struct jgenc_pool* pool) {
+    return &pool->alloc;
+}
+
+/* Allocator indirection — users may override before including generated
+ * code; by default sstr_t buffers follow the thread's jgenc_allocator. */
 #ifndef JGENC_MALLOC
-#define JGENC_MALLOC(sz) malloc(sz)
+#define JGENC_MALLOC(sz) jgenc_malloc(sz)
 #endif
 #ifndef JGENC_REALLOC
-#define JGENC_REALLOC(p, sz) realloc((p), (sz))
+#define JGENC_REALLOC(p, sz) jgenc_realloc((p), (sz))
 #endif
 #ifndef JGENC_FREE
-#define JGENC_FREE(p) free(p)
+#define JGENC_FREE(p) jgenc_free(p)
 #endif
 
 #define STR struct sstr_s
@@ -97,6 +314,16 @@ sstr_t sstr_ref(const void* data, size_t length) {
     return s;
 }
 
+void sstr_set_ref(sstr_t s, const void* data, size_t length) {
+    STR* ss = SSTR(s);
+    if (ss->type == SSTR_TYPE_LONG) {
+        JGENC_FREE(ss->un.long_str.data);
+    }
+    ss->un.ref_str.data = (char*)data;
+    ss->length = length;
+    ss->type = SSTR_TYPE_REF;
+}
+
 sstr_t sstr(const char* cstr) { return sstr_of(cstr, strlen(cstr)); }
 
 char* sstr_cstr(sstr_t s) { return STR_PTR(s); }
@@ -140,86 +367,92 @@ int sstr_compare_c(sstr_t a, const char* b) {
     return alen > blen ? 1 : -1;
 }
 
-void sstr_append_zero(sstr_t s, size_t length) {
-    STR* ss = (STR*)s;
-
-    assert(ss->type != SSTR_TYPE_REF);
+/* Capacity to grow a long string of capacity \a cap to so that it holds
+ * at least \a need bytes: the larger of \a need, \a cap grown by
+ * SSTR_GROWTH_NUM / SSTR_GROWTH_DEN, and \a cap + CAP_ADD_DELTA. Growing
+ * geometrically keeps the total copy cost of a long run of appends linear. */
+static size_t sstr_next_capacity(size_t cap, size_t need) {
+    size_t next =
+        cap + cap / SSTR_GROWTH_DEN * (SSTR_GROWTH_NUM - SSTR_GROWTH_DEN);
+    if (next < cap + CAP_ADD_DELTA) {
+        next = cap + CAP_ADD_DELTA;
+    }
+    return next < need ? need : next;
+}
 
+/* Make \a ss a long string with room for exactly \a cap bytes plus the
+ * terminator. \a cap must not be less than the current length. Returns -1,
+ * leaving \a ss as it was, if the allocation fails. */
+static int sstr_set_capacity(STR* ss, size_t cap) {
     if (ss->type == SSTR_TYPE_SHORT) {
-        if (ss->length + length <= SHORT_STR_CAPACITY) {
-            memset(ss->un.short_str + ss->length, 0, length + 1);
-            ss->length += length;
-            return;
-        } else {
-            char* ldata =
-                (char*)JGENC_MALLOC(length + ss->length + CAP_ADD_DELTA + 1);
-            memcpy(ldata, ss->un.short_str, ss->length);
-            memset(ldata + ss->length, 0, length + 1);
-            ss->un.long_str.data = ldata;
-            ss->un.long_str.capacity = length + ss->length + CAP_ADD_DELTA;
-            ss->length += length;
-            ss->type = SSTR_TYPE_LONG;
-            return;
+        char* ldata = (char*)JGENC_MALLOC(cap + 1);
+        if (ldata == NULL) {
+            return -1;
         }
+        memcpy(ldata, ss->un.short_str, ss->length + 1);
+        ss->un.long_str.data = ldata;
+        ss->type = SSTR_TYPE_LONG;
     } else {
-        if (ss->un.long_str.capacity - ss->length > length) {
-            memset(ss->un.long_str.data + ss->length, 0, length + 1);
-            ss->length += length;
-            return;
-        } else {
-            ss->un.long_str.data = (char*)JGENC_REALLOC(
-                STR_PTR(s), length + ss->length + CAP_ADD_DELTA + 1);
-            ss->un.long_str.capacity = length + ss->length + CAP_ADD_DELTA + 1;
-            memset(ss->un.long_str.data + ss->length, 0, length + 1);
-            ss->length += length;
-            return;
+        char* ldata = (char*)JGENC_REALLOC(ss->un.long_str.data, cap + 1);
+        if (ldata == NULL) {
+            return -1;
         }
+        ss->un.long_str.data = ldata;
+        ss->un.long_str.data[ss->length] = '\0';
     }
+    ss->un.long_str.capacity = cap;
+    return 0;
 }
 
-void sstr_append_of(sstr_t s, const void* data, size_t length) {
-    STR* ss = (STR*)s;
-    size_t oldlen = ss->length;
-    size_t newlen = oldlen + length;
+/* Room for \a extra more bytes at the end of \a ss, growing geometrically.
+ * NULL if it cannot grow. */
+static char* sstr_make_room(STR* ss, size_t extra) {
+    size_t need = ss->length + extra;
 
     assert(ss->type != SSTR_TYPE_REF);
 
     if (ss->type == SSTR_TYPE_SHORT) {
-        if (newlen <= SHORT_STR_CAPACITY) {
-            memcpy(ss->un.short_str + oldlen, data, length);
-            ss->length = newlen;
-            ss->un.short_str[newlen] = '\0';
-            return;
+        if (need > SHORT_STR_CAPACITY &&
+            sstr_set_capacity(
+                ss, sstr_next_capacity(SHORT_STR_CAPACITY, need)) != 0) {
+            return NULL;
         }
-        /* Promote SHORT → LONG */
-        char* ldata =
-            (char*)JGENC_MALLOC(newlen + CAP_ADD_DELTA + 1);
-        memcpy(ldata, ss->un.short_str, oldlen);
-        memcpy(ldata + oldlen, data, length);
-        ldata[newlen] = '\0';
-        ss->un.long_str.data = ldata;
-        ss->un.long_str.capacity = newlen + CAP_ADD_DELTA;
-        ss->length = newlen;
-        ss->type = SSTR_TYPE_LONG;
-        return;
+    } else if ((ss->un.long_str.capacity < need ||
+                ss->un.long_str.data == NULL) &&
+               sstr_set_capacity(ss, sstr_next_capacity(
+                                         ss->un.long_str.capacity, need)) !=
+                   0) {
+        return NULL;
     }
-    /* LONG type */
-    if (ss->un.long_str.capacity - oldlen > length) {
-        memcpy(ss->un.long_str.data + oldlen, data, length);
-        ss->length = newlen;
-        ss->un.long_str.data[newlen] = '\0';
+    return STR_PTR(ss) + ss->length;
+}
+
+void sstr_append_zero(sstr_t s, size_t length) {
+    STR* ss = SSTR(s);
+    char* p = sstr_make_room(ss, length);
+    if (p == NULL) {
         return;
     }
-    ss->un.long_str.data = (char*)JGENC_REALLOC(
-        ss->un.long_str.data, newlen + CAP_ADD_DELTA + 1);
-    ss->un.long_str.capacity = newlen + CAP_ADD_DELTA + 1;
-    memcpy(ss->un.long_str.data + oldlen, data, length);
-    ss->length = newlen;
-    ss->un.long_str.data[newlen] = '\0';
+    memset(p, 0, length + 1);
+    ss->length += length;
 }
 
-void sstr_append(sstr_t dst, sstr_t src) {
-    sstr_append_of(dst, STR_PTR(src), sstr_length(src));
+int sstr_append_of(sstr_t s, const void* data, size_t length) {
+    STR* ss = SSTR(s);
+    char* p = sstr_make_room(ss, length);
+    if (p == NULL) {
+        return -1;
+    }
+    if (length > 0) {
+        memcpy(p, data, length);
+    }
+    ss->length += length;
+    p[length] = '\0';
+    return 0;
+}
+
+int sstr_append(sstr_t dst, sstr_t src) {
+    return sstr_append_of(dst, STR_PTR(src), sstr_length(src));
 }
 
 void sstr_append_cstr(sstr_t dst, const char* src) {
@@ -245,8 +478,10 @@ void sstr_clear(sstr_t s) {
 
     switch (ss->type) {
         case SSTR_TYPE_REF:
+            // stop referencing, so the string can be appended to again
             ss->length = 0;
-            ss->un.ref_str.data = NULL;
+            ss->un.short_str[0] = 0;
+            ss->type = SSTR_TYPE_SHORT;
             break;
         case SSTR_TYPE_SHORT:
             ss->length = 0;
@@ -815,78 +1050,268 @@ int sstr_parse_double(sstr_t s, double* v) {
     return sstr_size_to_int(i);
 }
 
-int sstr_json_escape_string_append(sstr_t out, sstr_t in) {
-    if (in == NULL) {
-        return 0;
+void sstr_reset(sstr_t s) {
+    STR* ss = SSTR(s);
+    if (ss->type == SSTR_TYPE_LONG) {
+        JGENC_FREE(ss->un.long_str.data);
     }
-    unsigned char* data = (unsigned char*)sstr_cstr(in);
-    size_t in_len = sstr_length(in);
+    memset(ss, 0, sizeof(STR));
+}
 
-    /* Fast path: scan for chars needing escape. If none, single bulk append. */
-    size_t first_esc = in_len;
-    for (size_t k = 0; k < in_len; ++k) {
-        if (data[k] <= 31 || data[k] == '\"' || data[k] == '\\') {
-            first_esc = k;
-            break;
+char* sstr_grow_tail(sstr_t s, size_t extra) {
+    return sstr_make_room(SSTR(s), extra);
+}
+
+void sstr_reserve(sstr_t s, size_t n) {
+    STR* ss = SSTR(s);
+
+    assert(ss->type != SSTR_TYPE_REF);
+
+    if (n > sstr_capacity(s) ||
+        (ss->type == SSTR_TYPE_LONG && ss->un.long_str.data == NULL)) {
+        sstr_set_capacity(ss, n);
+    }
+}
+
+size_t sstr_capacity(sstr_t s) {
+    STR* ss = SSTR(s);
+    switch (ss->type) {
+        case SSTR_TYPE_SHORT:
+            return SHORT_STR_CAPACITY;
+        case SSTR_TYPE_LONG:
+            return ss->un.long_str.capacity;
+        default:
+            return ss->length;
+    }
+}
+
+void sstr_shrink_to_fit(sstr_t s) {
+    STR* ss = SSTR(s);
+    if (ss->type != SSTR_TYPE_LONG || ss->un.long_str.capacity == ss->length) {
+        return;
+    }
+    if (ss->length <= SHORT_STR_CAPACITY) {
+        char* ldata = ss->un.long_str.data;
+        memcpy(ss->un.short_str, ldata, ss->length);
+        ss->un.short_str[ss->length] = '\0';
+        ss->type = SSTR_TYPE_SHORT;
+        JGENC_FREE(ldata);
+        return;
+    }
+    sstr_set_capacity(ss, ss->length);
+}
+
+char* sstr_detach(sstr_t s, size_t* length) {
+    STR* ss = SSTR(s);
+    size_t len = ss->length;
+    char* data;
+
+    if (ss->type == SSTR_TYPE_LONG && ss->un.long_str.data != NULL) {
+        data = ss->un.long_str.data;
+    } else {
+        data = (char*)JGENC_MALLOC(len + 1);
+        if (data == NULL) {
+            return NULL;
+        }
+        memcpy(data, STR_PTR(ss), len);
+        data[len] = '\0';
+    }
+    memset(ss, 0, sizeof(STR));
+    if (length != NULL) {
+        *length = len;
+    }
+    return data;
+}
+
+void sstr_adopt(sstr_t s, char* data, size_t length, size_t size) {
+    STR* ss = SSTR(s);
+
+    assert(size > length);
+
+    if (ss->type == SSTR_TYPE_LONG) {
+        JGENC_FREE(ss->un.long_str.data);
+    }
+    data[length] = '\0';
+    ss->un.long_str.data = data;
+    ss->un.long_str.capacity = size - 1;
+    ss->length = length;
+    ss->type = SSTR_TYPE_LONG;
+}
+
+/* Second byte of the JSON escape for each input byte: 0 if the byte is
+ * copied as is, 'u' for the \u00XX form. */
+static const unsigned char json_escape_table[256] = {
+    [0x00] = 'u', [0x01] = 'u', [0x02] = 'u', [0x03] = 'u',
+    [0x04] = 'u', [0x05] = 'u', [0x06] = 'u', [0x07] = 'u',
+    [0x08] = 'b', [0x09] = 't', [0x0a] = 'n', [0x0b] = 'u',
+    [0x0c] = 'f', [0x0d] = 'r', [0x0e] = 'u', [0x0f] = 'u',
+    [0x10] = 'u', [0x11] = 'u', [0x12] = 'u', [0x13] = 'u',
+    [0x14] = 'u', [0x15] = 'u', [0x16] = 'u', [0x17] = 'u',
+    [0x18] = 'u', [0x19] = 'u', [0x1a] = 'u', [0x1b] = 'u',
+    [0x1c] = 'u', [0x1d] = 'u', [0x1e] = 'u', [0x1f] = 'u',
+    ['"'] = '"', ['\\'] = '\\',
+};
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    defined(__SSE2__)
+#include <emmintrin.h>
+#include <immintrin.h>
+#define SSTR_ESCAPE_SSE2 1
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SSTR_ESCAPE_NEON 1
+#endif
+
+static size_t json_escape_scan_scalar(const unsigned char* p, size_t i,
+                                      size_t n) {
+    while (i < n && json_escape_table[p[i]] == 0) {
+        i++;
+    }
+    return i;
+}
+
+#ifdef SSTR_ESCAPE_SSE2
+__attribute__((target("avx2"))) static size_t json_escape_scan_avx2(
+    const unsigned char* p, size_t n) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i ctl = _mm256_set1_epi8(31);
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + i));
+        __m256i hit = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                            _mm256_cmpeq_epi8(v, bslash)),
+            _mm256_cmpeq_epi8(_mm256_min_epu8(v, ctl), v));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(hit);
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz(mask);
+        }
+    }
+    return json_escape_scan_scalar(p, i, n);
+}
+
+static size_t json_escape_scan_sse2(const unsigned char* p, size_t n) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i ctl = _mm_set1_epi8(31);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, bslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(v, ctl), v));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return i + (size_t)__builtin_ctz(mask);
         }
     }
-    if (first_esc == in_len) {
-        /* No escaping needed — single append for the whole string */
-        sstr_append_of(out, data, in_len);
+    return json_escape_scan_scalar(p, i, n);
+}
+#endif
+
+#ifdef SSTR_ESCAPE_NEON
+static size_t json_escape_scan_neon(const unsigned char* p, size_t n) {
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t bslash = vdupq_n_u8('\\');
+    const uint8x16_t ctl = vdupq_n_u8(31);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(p + i);
+        uint8x16_t hit = vorrq_u8(vorrq_u8(vceqq_u8(v, quote),
+                                           vceqq_u8(v, bslash)),
+                                  vcleq_u8(v, ctl));
+        if (vmaxvq_u8(hit) != 0) {
+            return json_escape_scan_scalar(p, i, i + 16);
+        }
+    }
+    return json_escape_scan_scalar(p, i, n);
+}
+#endif
+
+/* Length of the run at the start of p[0..n) that needs no escaping. */
+static size_t json_escape_scan(const unsigned char* p, size_t n) {
+#if defined(SSTR_ESCAPE_SSE2)
+    if (n >= 64 && __builtin_cpu_supports("avx2")) {
+        return json_escape_scan_avx2(p, n);
+    }
+    return json_escape_scan_sse2(p, n);
+#elif defined(SSTR_ESCAPE_NEON)
+    return json_escape_scan_neon(p, n);
+#else
+    return json_escape_scan_scalar(p, 0, n);
+#endif
+}
+
+/* Input bytes escaped per capacity reservation; bounds the worst-case
+ * (6x) over-reservation for long strings. */
+#define JSON_ESCAPE_CHUNK 4096
+
+int sstr_json_escape_string_append(sstr_t out, sstr_t in) {
+    if (in == NULL) {
         return 0;
     }
+    return sstr_json_escape_append_of(out, STR_PTR(in), sstr_length(in));
+}
 
-    /* Append the clean prefix before the first escape char */
-    if (first_esc > 0) {
-        sstr_append_of(out, data, first_esc);
+int sstr_json_escape_append_of(sstr_t out, const void* in, size_t in_len) {
+    static const char hex[] = "0123456789abcdef";
+    const unsigned char* data = (const unsigned char*)in;
+
+    /* Fast path: no escaping needed — single append for the whole string */
+    size_t i = json_escape_scan(data, in_len);
+    if (i == in_len) {
+        return sstr_append_of(out, data, in_len);
+    }
+    if (sstr_append_of(out, data, i) != 0) {
+        return -1;
     }
 
-    for (size_t i = first_esc; i < in_len; ++i) {
-        if (data[i] <= 31 || data[i] == '\"' || data[i] == '\\') {
-            switch (data[i]) {
-                case '\\':
-                    sstr_append_of(out, "\\\\", 2);
-                    break;
-                case '\"':
-                    sstr_append_of(out, "\\\"", 2);
-                    break;
-                case '\b':
-                    sstr_append_of(out, "\\b", 2);
-                    break;
-                case '\f':
-                    sstr_append_of(out, "\\f", 2);
-                    break;
-                case '\n':
-                    sstr_append_of(out, "\\n", 2);
-                    break;
-                case '\r':
-                    sstr_append_of(out, "\\r", 2);
-                    break;
-                case '\t':
-                    sstr_append_of(out, "\\t", 2);
-                    break;
-                default: {
-                    char tmp[7];
-                    tmp[0] = '\\';
-                    tmp[1] = 'u';
-                    snprintf(tmp + 2, 5, "%04x", (unsigned)data[i]);
-                    sstr_append_of(out, tmp, 6);
-                }
+    STR* so = SSTR(out);
+    while (i < in_len) {
+        size_t end = in_len - i > JSON_ESCAPE_CHUNK ? i + JSON_ESCAPE_CHUNK
+                                                    : in_len;
+        char* start = sstr_grow_tail(so, (end - i) * 6);
+        if (start == NULL) {
+            return -1;
+        }
+        char* w = start;
+        while (i < end) {
+            unsigned char e = json_escape_table[data[i]];
+            if (e == 0) {
+                size_t run = json_escape_scan(data + i, end - i);
+                memcpy(w, data + i, run);
+                w += run;
+                i += run;
+                continue;
             }
-        } else {
-            size_t j;
-            for (j = i + 1; j < in_len; ++j) {
-                if (data[j] <= 31 || data[j] == '\"' || data[j] == '\\') {
-                    break;
-                }
+            *w++ = '\\';
+            *w++ = (char)e;
+            if (e == 'u') {
+                *w++ = '0';
+                *w++ = '0';
+                *w++ = hex[data[i] >> 4];
+                *w++ = hex[data[i] & 0x0f];
             }
-            sstr_append_of(out, data + i, j - i);
-            i += j - i - 1;
+            i++;
         }
+        so->length += (size_t)(w - start);
+        *w = '\0';
     }
     return 0;
 }
 
+size_t sstr_json_escape_scan(sstr_t in) {
+    if (in == NULL) {
+        return 0;
+    }
+    return json_escape_scan((const unsigned char*)STR_PTR(in),
+                            sstr_length(in));
+}
+
 void sstr_append_of_if(sstr_t s, const void* data, size_t length, bool cond) {
     if (cond) {
         sstr_append_of(s, data, length);
@@ -39,6 +39,7 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -47,6 +48,19 @@ extern "C" {
 #define SHORT_STR_CAPACITY 25
 #define CAP_ADD_DELTA 256
 
+/*
+ * A long string that runs out of room grows its capacity by the factor
+ * SSTR_GROWTH_NUM / SSTR_GROWTH_DEN (1.5x by default), and by at least
+ * CAP_ADD_DELTA bytes. Define both before compiling sstr.c to change it,
+ * e.g. -DSSTR_GROWTH_NUM=2 -DSSTR_GROWTH_DEN=1 to double.
+ */
+#ifndef SSTR_GROWTH_NUM
+#define SSTR_GROWTH_NUM 3
+#endif
+#ifndef SSTR_GROWTH_DEN
+#define SSTR_GROWTH_DEN 2
+#endif
+
 struct sstr_s {
     size_t length;  // MUST FIRST, see sstr_length at sstr.h
     char type;
@@ -69,6 +83,84 @@ struct sstr_s {
 #define SSTR_TYPE_LONG 1
 #define SSTR_TYPE_REF 2
 
+/**
+ * @brief A memory allocator with a user pointer, passed to every call.
+ * @details Install one for the calling thread with
+ * jgenc_set_thread_allocator(), or pass one to the generated _ex/_alloc
+ * entry points, to route sstr_t buffers and generated-code allocations
+ * to a pool or a per-request arena. Memory must be released through the
+ * allocator that allocated it. Neither an sstr_t nor a generated object
+ * records which allocator built it: sstr_free() and the generated clear
+ * functions free through the allocator installed when they run, so
+ * install the same one again (or use the _ex clear) before freeing.
+ */
+struct jgenc_allocator {
+    void* ud;
+    void* (*malloc_fn)(void* ud, size_t size);
+    void* (*realloc_fn)(void* ud, void* ptr, size_t size);
+    void (*free_fn)(void* ud, void* ptr);
+};
+
+/**
+ * @brief Make \a alloc the allocator of the calling thread.
+ * @details NULL restores the default: the json_gen_c_set_alloc()
+ * functions in generated code, malloc()/realloc()/free() otherwise.
+ * \a alloc must stay valid while it is installed.
+ *
+ * @param alloc the allocator, or NULL.
+ * @return const struct jgenc_allocator* the previous one, to restore later.
+ */
+extern const struct jgenc_allocator* jgenc_set_thread_allocator(
+    const struct jgenc_allocator* alloc);
+
+/**
+ * @brief Return the allocator of the calling thread, or NULL.
+ */
+extern const struct jgenc_allocator* jgenc_thread_allocator(void);
+
+/**
+ * @brief malloc()/realloc()/free() through the calling thread's allocator,
+ * or the C library when it has none.
+ */
+extern void* jgenc_malloc(size_t size);
+extern void* jgenc_realloc(void* ptr, size_t size);
+extern void jgenc_free(void* ptr);
+
+/** Number of size classes of a jgenc_pool; the largest is 512 bytes. */
+#define JGENC_POOL_CLASS_COUNT 10
+
+/**
+ * @brief A size-class pool allocator for decoded objects.
+ * @details Decoding allocates many small blocks of a few sizes: struct
+ * sstr_s headers, short arrays, map entries. A pool serves them from
+ * per-class free lists refilled in batches from 64 KiB slabs, with no
+ * locking; blocks above 512 bytes go to malloc(). A pool is not thread
+ * safe: give each decoding thread its own and install it with
+ * jgenc_set_thread_allocator(jgenc_pool_allocator(pool)). Blocks must be
+ * freed through the pool that allocated them.
+ */
+struct jgenc_pool;
+
+/**
+ * @brief Create an empty pool.
+ * @return struct jgenc_pool* the pool, or NULL if out of memory.
+ */
+extern struct jgenc_pool* jgenc_pool_new(void);
+
+/**
+ * @brief Release every slab of \a pool, and \a pool itself.
+ * @details Objects still holding pool memory become invalid; blocks above
+ * 512 bytes that were not freed are leaked.
+ */
+extern void jgenc_pool_destroy(struct jgenc_pool* pool);
+
+/**
+ * @brief Return the allocator that allocates from \a pool, valid until
+ * jgenc_pool_destroy().
+ */
+extern const struct jgenc_allocator* jgenc_pool_allocator(
+    struct jgenc_pool* pool);
+
 /**
  * @brief sstr_t are objects that represent sequences of characters.
  */
@@ -88,6 +180,16 @@ extern sstr_t sstr_new(void);
  */
 extern void sstr_free(sstr_t s);
 
+/**
+ * @brief Declare \a name as an empty sstr_t whose header is a local
+ * variable of the enclosing block, so creating it allocates nothing.
+ * @details It grows like any sstr_t, but must be released with
+ * sstr_clear(), never sstr_free(), before the block ends.
+ */
+#define SSTR_LOCAL(name)                     \
+    struct sstr_s name##_local_ = {0};       \
+    sstr_t name = &name##_local_
+
 /**
  * @brief Create a sstr_t from \a data with \a length bytes.
  * @details The \a data is copied to the new sstr_t, so you can free \a data
@@ -112,6 +214,19 @@ extern sstr_t sstr_of(const void* data, size_t length);
  */
 extern sstr_t sstr_ref(const void* data, size_t length);
 
+/**
+ * @brief Make \a s a reference to \a data, as sstr_ref() would, releasing
+ * what \a s owned.
+ * @details Reuses the header of \a s, so nothing is allocated. \a data is
+ * not copied and need not be NUL-terminated; it must outlive \a s or the
+ * next sstr_clear() of it.
+ *
+ * @param s the sstr_t to repoint.
+ * @param data data of the result.
+ * @param length length of \a data.
+ */
+extern void sstr_set_ref(sstr_t s, const void* data, size_t length);
+
 /**
  * @brief Create a sstr_t from C-style (NULL-terminated) string \a str.
  * @details The \a cstr is copied to the new sstr_t, so you can free \a cstr
@@ -193,8 +308,9 @@ extern void sstr_append_zero(sstr_t s, size_t length);
  * @param s destination sstr_t.
  * @param data data to append.
  * @param length length of \a data.
+ * @return 0, or -1 if \a s could not grow; it is left unchanged then.
  */
-extern void sstr_append_of(sstr_t s, const void* data, size_t length);
+extern int sstr_append_of(sstr_t s, const void* data, size_t length);
 
 /**
  * @brief Extends the sstr_t by appending additional characters contained in \a
@@ -202,8 +318,9 @@ extern void sstr_append_of(sstr_t s, const void* data, size_t length);
  *
  * @param dst destination sstr_t.
  * @param src source sstr_t.
+ * @return 0, or -1 if \a dst could not grow; it is left unchanged then.
  */
-extern void sstr_append(sstr_t dst, sstr_t src);
+extern int sstr_append(sstr_t dst, sstr_t src);
 
 /**
  * @brief Extends the sstr_t by appending additional characters contained in \a
@@ -235,6 +352,8 @@ extern sstr_t sstr_substr(sstr_t s, size_t index, size_t len);
 
 /**
  * @brief clear the sstr_t. After this call, the sstr_t is empty.
+ * @details A sstr_ref() string stops referencing its data and becomes an
+ * empty string that can be appended to.
  *
  * @param s sstr_t instance to clear.
  */
@@ -403,6 +522,26 @@ extern void sstr_append_of_if(sstr_t s, const void* data, size_t length, bool co
  */
 extern int sstr_json_escape_string_append(sstr_t out, sstr_t in);
 
+/**
+ * @brief Like sstr_json_escape_string_append(), for @p len bytes at @p in
+ * rather than an sstr_t.
+ *
+ * @param out the output sstr_t to append the escaped string to.
+ * @param in  the raw bytes to escape.
+ * @param len number of bytes at @p in.
+ * @return 0 on success, non-zero on error.
+ */
+extern int sstr_json_escape_append_of(sstr_t out, const void* in, size_t len);
+
+/**
+ * @brief Length of the leading part of a string that JSON escaping leaves
+ * unchanged; equal to sstr_length(in) when nothing needs escaping.
+ *
+ * @param in the string to scan, may be NULL (returns 0).
+ * @return number of leading bytes that need no escape sequence.
+ */
+extern size_t sstr_json_escape_scan(sstr_t in);
+
 /**
  * @brief append spaces at the end of the sstr_t.
  *
@@ -411,6 +550,172 @@ extern int sstr_json_escape_string_append(sstr_t out, sstr_t in);
  */
 extern void sstr_append_indent(sstr_t s, size_t indent);
 
+/**
+ * @brief Empty \a s and free its heap buffer, leaving an empty short string.
+ * @details Unlike sstr_clear(), \a s keeps a valid empty C string, and it
+ * never frees \a s itself. This is how a struct sstr_s that is embedded in
+ * another object (rather than created with sstr_new()) is released; a
+ * zero-filled struct sstr_s is a valid empty string.
+ *
+ * @param s the sstr_t to reset.
+ */
+extern void sstr_reset(sstr_t s);
+
+/**
+ * @brief Make room for \a extra more bytes, plus the terminator, at the end
+ * of \a s and return where they start. The length is left unchanged.
+ * @details This is the out-of-line growth path of sstr_reserve_fast(); a
+ * short string is promoted to a long one here.
+ *
+ * @param s destination sstr_t, must not be a sstr_ref() result.
+ * @param extra number of bytes to make room for.
+ * @return char* the first byte after the current contents, or NULL if \a s
+ * could not grow.
+ */
+extern char* sstr_grow_tail(sstr_t s, size_t extra);
+
+/**
+ * @brief Make sure \a s can hold \a n bytes, plus the terminator, without
+ * reallocating. Never shrinks \a s.
+ * @details Call it before appending output whose size is known, so a long
+ * run of appends does a single allocation.
+ *
+ * @param s the sstr_t to grow, must not be a sstr_ref() result.
+ * @param n total number of bytes to make room for.
+ */
+extern void sstr_reserve(sstr_t s, size_t n);
+
+/**
+ * @brief Return how many bytes \a s can hold without reallocating.
+ * @details A short string reports SHORT_STR_CAPACITY, and a sstr_ref()
+ * result its length.
+ *
+ * @param s the sstr_t.
+ * @return size_t capacity of \a s, not counting the terminator.
+ */
+extern size_t sstr_capacity(sstr_t s);
+
+/**
+ * @brief Release the spare capacity of \a s.
+ * @details A long string that fits in SHORT_STR_CAPACITY goes back to a
+ * short one and frees its buffer.
+ *
+ * @param s the sstr_t to shrink.
+ */
+extern void sstr_shrink_to_fit(sstr_t s);
+
+/**
+ * @brief Take the buffer out of \a s without copying it, leaving \a s an
+ * empty short string.
+ * @details The returned buffer is NUL-terminated and owned by the caller,
+ * who releases it with jgenc_free() while the allocator that built \a s
+ * is installed (JGENC_FREE if sstr.c was built with one). It is not safe
+ * to pass to free() unless that allocator is the C library's. Only a long
+ * string hands over its own buffer; short and sstr_ref() strings are
+ * copied into a new one from the current allocator.
+ *
+ * @param s the sstr_t to empty.
+ * @param length if not NULL, receives the length of the returned string.
+ * @return char* the buffer, or NULL if copying a short string failed to
+ * allocate.
+ */
+extern char* sstr_detach(sstr_t s, size_t* length);
+
+/**
+ * @brief Make \a s own \a data without copying it; the previous contents
+ * of \a s are released.
+ * @details \a data must come from jgenc_malloc() under the allocator
+ * that will be installed when \a s is freed (JGENC_MALLOC if sstr.c was
+ * built with one), since sstr_free() releases it with jgenc_free(). A
+ * terminator is written at data[length], so \a size must be greater
+ * than \a length. This is the inverse of sstr_detach().
+ *
+ * @param s the sstr_t to fill.
+ * @param data the buffer to take over.
+ * @param length number of bytes of string in \a data.
+ * @param size allocated size of \a data in bytes.
+ */
+extern void sstr_adopt(sstr_t s, char* data, size_t length, size_t size);
+
+/*
+ * Inline fast paths. Code that appends in tight loops (the generated
+ * marshal code, the msgpack and CBOR codecs) calls these instead of the
+ * functions above, so the common case, which only copies into spare
+ * capacity, costs no function call. sstr_length() is already a macro.
+ */
+
+/**
+ * @brief Inline sstr_cstr().
+ */
+static inline char* sstr_cstr_fast(sstr_t s) {
+    struct sstr_s* ss = (struct sstr_s*)s;
+    if (ss->type == SSTR_TYPE_SHORT) {
+        return ss->un.short_str;
+    }
+    return ss->type == SSTR_TYPE_LONG ? ss->un.long_str.data
+                                      : ss->un.ref_str.data;
+}
+
+/**
+ * @brief Like sstr_clear(), but a long string keeps its buffer for reuse.
+ * @details A long string already emptied by sstr_clear() has no buffer
+ * and takes the out-of-line path.
+ */
+static inline void sstr_clear_fast(sstr_t s) {
+    struct sstr_s* ss = (struct sstr_s*)s;
+    if (ss->type == SSTR_TYPE_SHORT) {
+        ss->length = 0;
+        ss->un.short_str[0] = '\0';
+    } else if (ss->type == SSTR_TYPE_LONG && ss->un.long_str.data != NULL) {
+        ss->length = 0;
+        ss->un.long_str.data[0] = '\0';
+    } else {
+        sstr_clear(s);
+    }
+}
+
+/**
+ * @brief Inline sstr_grow_tail(): room for \a extra more bytes at the end
+ * of \a s. Write them, then call sstr_commit_fast().
+ */
+static inline char* sstr_reserve_fast(sstr_t s, size_t extra) {
+    struct sstr_s* ss = (struct sstr_s*)s;
+    if (ss->type == SSTR_TYPE_SHORT) {
+        if (ss->length + extra <= SHORT_STR_CAPACITY) {
+            return ss->un.short_str + ss->length;
+        }
+    } else if (ss->type == SSTR_TYPE_LONG && ss->un.long_str.data != NULL &&
+               ss->un.long_str.capacity - ss->length > extra) {
+        return ss->un.long_str.data + ss->length;
+    }
+    return sstr_grow_tail(s, extra);
+}
+
+/**
+ * @brief Add \a n bytes written after sstr_reserve_fast() to the length.
+ */
+static inline void sstr_commit_fast(sstr_t s, size_t n) {
+    struct sstr_s* ss = (struct sstr_s*)s;
+    ss->length += n;
+    (ss->type == SSTR_TYPE_SHORT ? ss->un.short_str
+                                 : ss->un.long_str.data)[ss->length] = '\0';
+}
+
+/**
+ * @brief Inline sstr_append_of().
+ */
+static inline void sstr_append_of_fast(sstr_t s, const void* data,
+                                       size_t length) {
+    char* p = sstr_reserve_fast(s, length);
+    if (p == NULL) {
+        return;
+    }
+    if (length > 0) {
+        memcpy(p, data, length);
+    }
+    sstr_commit_fast(s, length);
+}
+
 /**
  * @brief return version string.
  *
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+
+// ==========================================================================
+// @cached structs: json_marshal_<S>() reuses clean field fragments
+// ==========================================================================
+
+static std::string CachedDocJson(struct CachedDoc* doc) {
+    sstr_t out = sstr_new();
+    EXPECT_EQ(json_marshal_CachedDoc(doc, out), 0);
+    std::string s(sstr_cstr(out), sstr_length(out));
+    sstr_free(out);
+    return s;
+}
+
+static std::string CachedDocIndentJson(struct CachedDoc* doc) {
+    sstr_t out = sstr_new();
+    EXPECT_EQ(json_marshal_indent_CachedDoc(doc, 0, 0, out), 0);
+    std::string s(sstr_cstr(out), sstr_length(out));
+    sstr_free(out);
+    return s;
+}
+
+static const char* kCachedDocJson =
+    "{\"title\":\"t\",\"version\":3,\"note\":null,\"score\":1.5,"
+    "\"color\":\"GREEN\",\"leaf\":{\"id\":1,\"label\":\"a\"},"
+    "\"leaves\":[{\"id\":2,\"label\":\"b\"},{\"id\":3,\"label\":\"c\"}],"
+    "\"house\":{\"number\":\"9\",\"street\":\"s\"},\"values\":[1,2],"
+    "\"counts\":{\"k\":1}}";
+
+static void ExpectCachedMatchesIndent(const char* text) {
+    struct CachedDoc doc;
+    CachedDoc_init(&doc);
+    sstr_t in = sstr(text);
+    ASSERT_EQ(json_unmarshal_CachedDoc(in, &doc), 0) << text;
+    EXPECT_EQ(CachedDocJson(&doc), CachedDocIndentJson(&doc));
+    sstr_free(in);
+    CachedDoc_clear(&doc);
+}
+
+TEST(CachedMarshal, MatchesIndentZeroAndIsStable) {
+    ExpectCachedMatchesIndent(kCachedDocJson);
+    ExpectCachedMatchesIndent("{}");
+
+    struct CachedDoc doc;
+    CachedDoc_init(&doc);
+    sstr_t in = sstr(kCachedDocJson);
+    ASSERT_EQ(json_unmarshal_CachedDoc(in, &doc), 0);
+    std::string first = CachedDocJson(&doc);
+    EXPECT_NE(doc._json_cache, nullptr);
+    EXPECT_EQ(CachedDocJson(&doc), first);
+    EXPECT_EQ(first, CachedDocIndentJson(&doc));
+
+    sstr_free(in);
+    CachedDoc_clear(&doc);
+    EXPECT_EQ(doc._json_cache, nullptr);
+}
+
+TEST(CachedMarshal, SettersAndMarkDirtyInvalidate) {
+    struct CachedDoc doc;
+    CachedDoc_init(&doc);
+    sstr_t in = sstr(kCachedDocJson);
+    ASSERT_EQ(json_unmarshal_CachedDoc(in, &doc), 0);
+    CachedDocJson(&doc);
+
+    ASSERT_EQ(CachedDoc_set_title(&doc, sstr("new")), 0);
+    ASSERT_EQ(CachedDoc_set_note(&doc, sstr("n")), 0);
+    ASSERT_EQ(CachedLeaf_set_label(&doc.leaf, sstr("z")), 0);
+    ASSERT_EQ(CachedLeaf_set_id(&doc.leaves[1], 7), 0);
+    EXPECT_EQ(CachedDocJson(&doc), CachedDocIndentJson(&doc));
+
+    // a direct write is not seen until the field is marked
+    doc.values[0] = 42;
+    sstr_free(doc.house.street);
+    doc.house.street = sstr("x");
+    std::string stale = CachedDocJson(&doc);
+    EXPECT_NE(stale, CachedDocIndentJson(&doc));
+    ASSERT_EQ(CachedDoc_mark_dirty(&doc, CachedDoc_FIELD_values), 0);
+    ASSERT_EQ(CachedDoc_mark_dirty(&doc, CachedDoc_FIELD_house), 0);
+    EXPECT_EQ(CachedDocJson(&doc), CachedDocIndentJson(&doc));
+
+    doc.has_version = false;
+    ASSERT_EQ(CachedDoc_mark_dirty(&doc, -1), 0);
+    EXPECT_EQ(CachedDocJson(&doc), CachedDocIndentJson(&doc));
+
+    sstr_free(in);
+    CachedDoc_clear(&doc);
+}
+
+TEST(CachedMarshal, UnmarshalCopyAndMoveKeepFragmentsConsistent) {
+    struct CachedDoc doc, copy, moved;
+    CachedDoc_init(&doc);
+    CachedDoc_init(&copy);
+    CachedDoc_init(&moved);
+    sstr_t in = sstr(kCachedDocJson);
+    ASSERT_EQ(json_unmarshal_CachedDoc(in, &doc), 0);
+    CachedDocJson(&doc);
+
+    // decoding into a marshaled object drops its fragments
+    sstr_t patch = sstr("{\"leaf\":{\"id\":6},\"score\":2,\"title\":\"u\"}");
+    ASSERT_EQ(json_apply_patch_CachedDoc(&doc, patch), 0);
+    EXPECT_EQ(CachedDocJson(&doc), CachedDocIndentJson(&doc));
+
+    ASSERT_EQ(CachedDoc_copy(&copy, &doc), 0);
+    EXPECT_EQ(copy._json_cache, nullptr);
+    ASSERT_EQ(CachedDoc_set_title(&copy, sstr("c")), 0);
+    EXPECT_EQ(CachedDocJson(&copy), CachedDocIndentJson(&copy));
+    EXPECT_EQ(CachedDocJson(&doc), CachedDocIndentJson(&doc));
+
+    std::string before = CachedDocJson(&doc);
+    ASSERT_EQ(CachedDoc_move(&moved, &doc), 0);
+    EXPECT_EQ(doc._json_cache, nullptr);
+    EXPECT_EQ(CachedDocJson(&moved), before);
+
+    sstr_free(patch);
+    sstr_free(in);
+    CachedDoc_clear(&moved);
+    CachedDoc_clear(&copy);
+    CachedDoc_clear(&doc);
+}
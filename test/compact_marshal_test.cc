@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+
+// ============================================================================
+// Compact marshal: the dedicated json_marshal_<S> path must produce exactly
+// the bytes of json_marshal_indent_<S>(obj, 0, 0, out)
+// ============================================================================
+
+#define EXPECT_COMPACT_MATCHES_INDENT(S, text)                          \
+    do {                                                                \
+        struct S obj_;                                                  \
+        S##_init(&obj_);                                                \
+        sstr_t in_ = sstr(text);                                        \
+        ASSERT_EQ(json_unmarshal_##S(in_, &obj_), 0) << (text);         \
+        sstr_t compact_ = sstr_new();                                   \
+        sstr_t indent_ = sstr_new();                                    \
+        ASSERT_EQ(json_marshal_##S(&obj_, compact_), 0);                \
+        ASSERT_EQ(json_marshal_indent_##S(&obj_, 0, 0, indent_), 0);    \
+        EXPECT_STREQ(sstr_cstr(compact_), sstr_cstr(indent_));          \
+        sstr_free(compact_);                                            \
+        sstr_free(indent_);                                             \
+        sstr_free(in_);                                                 \
+        S##_clear(&obj_);                                               \
+    } while (0)
+
+TEST(CompactMarshal, MatchesIndentZero) {
+    EXPECT_COMPACT_MATCHES_INDENT(ComplexStruct,
+        "{\"simple_int\":-7,\"simple_long\":1234567890123,\"simple_float\":1.5,"
+        "\"simple_double\":2.25,\"simple_bool\":true,\"simple_string\":\"a\\\"b\\n\","
+        "\"int_array\":[1,2,3],\"long_array\":[],\"float_array\":[0.5],"
+        "\"double_array\":[1e10,-2],\"string_array\":[\"x\",\"\"],"
+        "\"address\":{\"number\":\"1\",\"street\":\"s\"},"
+        "\"contacts\":[{\"name\":\"p\",\"age\":\"1\"},{\"name\":\"q\",\"age\":\"2\"}]}");
+    EXPECT_COMPACT_MATCHES_INDENT(OptionalOnlyStruct, "{\"id\":1}");
+    EXPECT_COMPACT_MATCHES_INDENT(OptionalOnlyStruct,
+        "{\"id\":1,\"name\":\"n\",\"active\":false,\"big_num\":9}");
+    EXPECT_COMPACT_MATCHES_INDENT(OptionalOnlyStruct,
+        "{\"id\":1,\"name\":\"n\",\"score\":2,\"active\":true,\"rating\":0.5,"
+        "\"precise\":0.25,\"big_num\":9}");
+    EXPECT_COMPACT_MATCHES_INDENT(NullableOnlyStruct,
+        "{\"id\":1,\"name\":null,\"score\":null,\"active\":null}");
+    EXPECT_COMPACT_MATCHES_INDENT(NullableOnlyStruct,
+        "{\"id\":1,\"name\":\"x\",\"score\":4,\"active\":true}");
+    EXPECT_COMPACT_MATCHES_INDENT(OptionalNullableStruct, "{\"id\":1,\"score\":null}");
+    EXPECT_COMPACT_MATCHES_INDENT(NullableNestedStruct,
+        "{\"id\":1,\"person\":{\"name\":\"a\",\"age\":\"2\"},\"color\":\"GREEN\","
+        "\"status\":null}");
+    EXPECT_COMPACT_MATCHES_INDENT(MapAllTypesStruct,
+        "{\"int_map\":{\"a\":1,\"b\":2},\"long_map\":{},\"float_map\":{\"f\":1.5},"
+        "\"double_map\":{\"d\":-0.5},\"bool_map\":{\"t\":true,\"f\":false},"
+        "\"str_map\":{\"k\\\"\":\"v\"},\"enum_map\":{\"c\":\"BLUE\"},"
+        "\"struct_map\":{\"p\":{\"name\":\"n\",\"age\":\"5\"}}}");
+    EXPECT_COMPACT_MATCHES_INDENT(MapArrayStruct,
+        "{\"tags\":[{\"a\":1},{},{\"b\":2,\"c\":3}]}");
+    EXPECT_COMPACT_MATCHES_INDENT(PreciseIntArrays,
+        "{\"i8_arr\":[-128,0,127],\"u32_dyn\":[4294967295],"
+        "\"i64_dyn\":[-9223372036854775808],\"u64_fixed\":[18446744073709551615,0]}");
+    EXPECT_COMPACT_MATCHES_INDENT(AliasMixed,
+        "{\"first_name\":\"f\",\"last\":\"l\",\"is_active\":true}");
+    EXPECT_COMPACT_MATCHES_INDENT(Drawing,
+        "{\"name\":\"d\",\"shape\":{\"type\":\"circle\",\"radius\":1.5},"
+        "\"shapes\":[{\"type\":\"rectangle\",\"width\":1,\"height\":2}]}");
+}
+
+TEST(CompactMarshal, ArrayMatchesIndentZero) {
+    struct Person people[2];
+    Person_init(&people[0]);
+    Person_init(&people[1]);
+    people[0].name = sstr("a");
+    people[0].age = sstr("1");
+    people[1].name = sstr("b\tc");
+    people[1].age = sstr("2");
+    sstr_t compact = sstr_new();
+    sstr_t indent = sstr_new();
+    ASSERT_EQ(json_marshal_array_Person(people, 2, compact), 0);
+    ASSERT_EQ(json_marshal_array_indent_Person(people, 2, 0, 0, indent), 0);
+    EXPECT_STREQ(sstr_cstr(compact), sstr_cstr(indent));
+    EXPECT_STREQ(sstr_cstr(compact), "[{\"name\":\"a\",\"age\":\"1\"},{\"name\":\"b\\tc\",\"age\":\"2\"}]");
+    sstr_free(compact);
+    sstr_free(indent);
+    Person_clear(&people[0]);
+    Person_clear(&people[1]);
+}
@@ -179,3 +179,21 @@ TEST_F(CompatCheckTest, AddEnumSafe) {
     ASSERT_EQ(0, parse_new("struct Foo { int x; }\nenum Color { RED }"));
     EXPECT_EQ(0, run_check());
 }
+
+TEST_F(CompatCheckTest, CompactAppendFieldSafe) {
+    ASSERT_EQ(0, parse_old("@compact struct Foo { int x; }"));
+    ASSERT_EQ(0, parse_new("@compact struct Foo { int x; optional int y; }"));
+    EXPECT_EQ(0, run_check());
+}
+
+TEST_F(CompatCheckTest, CompactReorderFieldsBreaking) {
+    ASSERT_EQ(0, parse_old("@compact struct Foo { int x; int y; }"));
+    ASSERT_EQ(0, parse_new("@compact struct Foo { int y; int x; }"));
+    EXPECT_EQ(1, run_check());
+}
+
+TEST_F(CompatCheckTest, CompactDroppedBreaking) {
+    ASSERT_EQ(0, parse_old("@compact struct Foo { int x; }"));
+    ASSERT_EQ(0, parse_new("struct Foo { int x; }"));
+    EXPECT_EQ(1, run_check());
+}
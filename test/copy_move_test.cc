@@ -357,6 +357,18 @@ static void fail_free(void* ptr) {
     std::free(ptr);
 }
 
+static void* fail_malloc_ud(void*, size_t size) {
+    return fail_malloc(size);
+}
+
+static void* fail_realloc_ud(void*, void* ptr, size_t size) {
+    return fail_realloc(ptr, size);
+}
+
+static void fail_free_ud(void*, void* ptr) {
+    fail_free(ptr);
+}
+
 TEST(CopyMoveTest, CopyFailureLeavesDestinationCleared) {
     struct ComplexStruct src;
     struct ComplexStruct dest;
@@ -381,4 +393,34 @@ TEST(CopyMoveTest, CopyFailureLeavesDestinationCleared) {
 
     ComplexStruct_clear(&src);
     ComplexStruct_clear(&dest);
-}
\ No newline at end of file
+}
+
+TEST(CopyMoveTest, InlineStrCopyFailureLeavesDestinationCleared) {
+    struct InlineStrRecord src;
+    struct InlineStrRecord dest;
+    InlineStrRecord_init(&src);
+    InlineStrRecord_init(&dest);
+    sstr_append_cstr(src.code, "short");
+    // too long for the embedded buffer, so copying it allocates
+    for (int i = 0; i < 10; i++) {
+        sstr_append_cstr(src.unit, "0123456789");
+    }
+
+    // sstr_t buffers follow the thread allocator
+    struct jgenc_allocator alloc = {nullptr, fail_malloc_ud, fail_realloc_ud,
+                                    fail_free_ud};
+    fail_alloc_budget = 0;
+    int rc = InlineStrRecord_copy_ex(&dest, &src, &alloc);
+
+    EXPECT_EQ(rc, -1);
+    EXPECT_EQ(sstr_length(dest.code), 0u);
+    EXPECT_EQ(sstr_length(dest.unit), 0u);
+    EXPECT_EQ(dest.heap, nullptr);
+
+    fail_alloc_budget = -1;
+    ASSERT_EQ(InlineStrRecord_copy(&dest, &src), 0);
+    EXPECT_EQ(sstr_length(dest.unit), 100u + 2u);
+
+    InlineStrRecord_clear(&src);
+    InlineStrRecord_clear(&dest);
+}
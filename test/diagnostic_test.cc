@@ -958,6 +958,34 @@ TEST_F(ParserDiagTest, UnknownAnnotationError) {
     EXPECT_TRUE(diag_contains("unknown annotation"));
 }
 
+TEST_F(ParserDiagTest, CachedStructAnnotation) {
+    int r = parse("@cached struct Foo { int x; }\nstruct Bar { Foo f; }");
+    EXPECT_EQ(0, r);
+    void* foo = nullptr;
+    void* bar = nullptr;
+    sstr_t key = sstr("Foo");
+    ASSERT_EQ(HASH_MAP_OK, hash_map_find(parser->struct_map, key, &foo));
+    sstr_free(key);
+    key = sstr("Bar");
+    ASSERT_EQ(HASH_MAP_OK, hash_map_find(parser->struct_map, key, &bar));
+    sstr_free(key);
+    EXPECT_EQ(1, static_cast<struct struct_container*>(foo)->is_cached);
+    EXPECT_EQ(0, static_cast<struct struct_container*>(bar)->is_cached);
+    ASSERT_NE(nullptr, get_field("Foo", "x"));
+}
+
+TEST_F(ParserDiagTest, UnknownStructAnnotationError) {
+    int r = parse("@bogus struct Foo { int x; }");
+    EXPECT_LT(r, 0);
+    EXPECT_TRUE(diag_contains("unknown struct annotation '@bogus'"));
+}
+
+TEST_F(ParserDiagTest, StructAnnotationOnEnumError) {
+    int r = parse("@cached enum Color { RED }");
+    EXPECT_LT(r, 0);
+    EXPECT_TRUE(diag_contains("expected 'struct' after struct annotation"));
+}
+
 TEST_F(ParserDiagTest, UnknownAnnotationInEnumError) {
     int r = parse("enum Color { @bogus RED }");
     EXPECT_LT(r, 0);
@@ -971,3 +999,58 @@ TEST_F(ParserDiagTest, UnknownAnnotationInOneofError) {
     EXPECT_LT(r, 0);
     EXPECT_TRUE(diag_contains("unknown annotation"));
 }
+
+TEST_F(ParserDiagTest, InlineStrAnnotation) {
+    int r = parse("struct Foo { @inline_str sstr_t code; sstr_t name; }");
+    EXPECT_EQ(0, r);
+    auto* f = get_field("Foo", "code");
+    ASSERT_NE(nullptr, f);
+    EXPECT_EQ(1, f->is_inline_str);
+    f = get_field("Foo", "name");
+    ASSERT_NE(nullptr, f);
+    EXPECT_EQ(0, f->is_inline_str);
+}
+
+TEST_F(ParserDiagTest, InlineStrOnNonStringError) {
+    int r = parse("struct Foo { @inline_str int x; }");
+    EXPECT_LT(r, 0);
+    EXPECT_TRUE(diag_contains("'@inline_str' requires a non-array sstr_t field"));
+}
+
+TEST_F(ParserDiagTest, InlineStrOnArrayError) {
+    int r = parse("struct Foo { @inline_str sstr_t names[]; }");
+    EXPECT_LT(r, 0);
+    EXPECT_TRUE(diag_contains("'@inline_str' requires a non-array sstr_t field"));
+}
+
+TEST_F(ParserDiagTest, FixStrField) {
+    int r = parse("struct Foo { str<3> ccy = \"USD\"; optional str<255> s; }");
+    EXPECT_EQ(0, r);
+    auto* f = get_field("Foo", "ccy");
+    ASSERT_NE(nullptr, f);
+    EXPECT_EQ(FIELD_TYPE_FIXSTR, f->type);
+    EXPECT_EQ(3, f->str_size);
+    f = get_field("Foo", "s");
+    ASSERT_NE(nullptr, f);
+    EXPECT_EQ(255, f->str_size);
+}
+
+TEST_F(ParserDiagTest, FixStrSizeError) {
+    EXPECT_LT(parse("struct Foo { str<256> s; }"), 0);
+    EXPECT_TRUE(diag_contains("str<N> size must be an integer from 1 to 255"));
+}
+
+TEST_F(ParserDiagTest, FixStrMissingSizeError) {
+    EXPECT_LT(parse("struct Foo { str s; }"), 0);
+    EXPECT_TRUE(diag_contains("expected '<size>' after 'str'"));
+}
+
+TEST_F(ParserDiagTest, FixStrArrayError) {
+    EXPECT_LT(parse("struct Foo { str<3> codes[]; }"), 0);
+    EXPECT_TRUE(diag_contains("str<N> fields cannot be arrays"));
+}
+
+TEST_F(ParserDiagTest, FixStrDefaultTooLongError) {
+    EXPECT_LT(parse("struct Foo { str<2> s = \"abc\"; }"), 0);
+    EXPECT_TRUE(diag_contains("default value does not fit in str<2>"));
+}
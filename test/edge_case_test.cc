@@ -1,9 +1,11 @@
 #include <gtest/gtest.h>
 #include <string>
 #include <cstring>
+#include <pthread.h>
 
 #include "json.gen.h"
 #include "sstr.h"
+#include "utils/error_codes.h"
 
 // ==========================================================================
 // Empty / whitespace JSON tests
@@ -141,6 +143,236 @@ TEST_F(EdgeCaseDepthLimit, ExceedMaxDepthFails) {
     sstr_free(json);
 }
 
+// Struct arrays and nested struct fields are decoded on an explicit frame
+// stack, so a decode must fit a small coroutine-sized thread stack.
+static void* decode_complex_on_thread(void* arg) {
+    const std::string* json_str = static_cast<const std::string*>(arg);
+    struct ComplexStruct cs;
+    ComplexStruct_init(&cs);
+    sstr_t json = sstr(json_str->c_str());
+    long r = json_unmarshal_ComplexStruct(json, &cs);
+    if (r == 0 && (cs.contacts_len != 500 ||
+                   strcmp(sstr_cstr(cs.contacts[499].name), "n499") != 0 ||
+                   strcmp(sstr_cstr(cs.address.street), "Main") != 0)) {
+        r = -100;
+    }
+    ComplexStruct_clear(&cs);
+    sstr_free(json);
+    return reinterpret_cast<void*>(r);
+}
+
+TEST_F(EdgeCaseDepthLimit, StructArrayOnSmallStack) {
+    std::string json_str = R"({"address":{"number":"1","street":"Main"},"contacts":[)";
+    for (int i = 0; i < 500; i++) {
+        if (i > 0) json_str += ",";
+        json_str += R"({"name":"n)" + std::to_string(i) + R"(","age":"1"})";
+    }
+    json_str += "]}";
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, 64 * 1024);
+    pthread_t th;
+    ASSERT_EQ(pthread_create(&th, &attr, decode_complex_on_thread, &json_str), 0);
+    void* ret = nullptr;
+    pthread_join(th, &ret);
+    pthread_attr_destroy(&attr);
+    EXPECT_EQ(reinterpret_cast<long>(ret), 0);
+}
+
+// {"value":0,"children":[{"value":1,"children":[ ... {"value":levels}]}]}
+static std::string make_tree_json(int levels) {
+    std::string prefix, suffix;
+    for (int i = 0; i < levels; i++) {
+        prefix += R"({"value":)" + std::to_string(i) + R"(,"children":[)";
+        suffix += "]}";
+    }
+    return prefix + R"({"value":)" + std::to_string(levels) + "}" + suffix;
+}
+
+struct TreeDecodeArgs {
+    std::string json;
+    int levels;
+    int r;
+    int err_code;
+};
+
+static void* decode_tree_on_thread(void* arg) {
+    TreeDecodeArgs* a = static_cast<TreeDecodeArgs*>(arg);
+    struct TreeNode root;
+    TreeNode_init(&root);
+    struct json_error err;
+    sstr_t json = sstr(a->json.c_str());
+    a->r = json_unmarshal_TreeNode_ex(json, &root, &err);
+    a->err_code = err.code;
+    if (a->r == 0) {
+        struct TreeNode* node = &root;
+        int level = 0;
+        while (node->children_len == 1) {
+            node = &node->children[0];
+            level++;
+        }
+        if (level != a->levels || node->value != a->levels) {
+            a->r = -100;
+        }
+    }
+    TreeNode_clear(&root);
+    sstr_free(json);
+    return nullptr;
+}
+
+static void* validate_tree_on_thread(void* arg) {
+    TreeDecodeArgs* a = static_cast<TreeDecodeArgs*>(arg);
+    a->r = json_validate_TreeNode(a->json.data(), a->json.size());
+    return nullptr;
+}
+
+// Every other function that walks a TreeNode recurses once per level, so
+// each must fit the same stack at JSON_MAX_DEPTH. a->r is the first step
+// that failed, or 0.
+static void* tree_paths_on_thread(void* arg) {
+    TreeDecodeArgs* a = static_cast<TreeDecodeArgs*>(arg);
+    struct TreeNode root, copy, patched;
+    TreeNode_init(&root);
+    TreeNode_init(&copy);
+    TreeNode_init(&patched);
+    sstr_t json = sstr(a->json.c_str());
+    sstr_t out = sstr_new();
+    sstr_t patch = sstr_new();
+    uint64_t all[TreeNode_FIELD_MASK_WORD_COUNT] = {~0ull};
+    std::string path;
+    for (int i = 0; i < a->levels; i++) {
+        path += "/children/0";
+    }
+    path += "/value";
+    int leaf = -1;
+    struct CachedTreeNode cached;
+    CachedTreeNode_init(&cached);
+
+    a->r = 0;
+    if (json_unmarshal_TreeNode(json, &root) != 0) {
+        a->r = 1;
+    } else if (json_validate_TreeNode(a->json.data(), a->json.size()) != 0) {
+        a->r = 2;
+    } else if (TreeNode_copy(&copy, &root) != 0) {
+        a->r = 3;
+    } else if (json_marshal_TreeNode(&copy, out) != 0) {
+        a->r = 4;
+    } else if (sstr_clear(out), json_marshal_indent_TreeNode(&copy, 2, 0, out) != 0) {
+        a->r = 5;
+    } else if (sstr_clear(out),
+               json_marshal_selected_TreeNode(&copy, all, 1, out) != 0) {
+        a->r = 6;
+    } else if (json_marshal_diff_TreeNode(&patched, &root, patch) != 1) {
+        a->r = 7;
+    } else if (json_apply_patch_TreeNode(&patched, patch) != 0) {
+        a->r = 8;
+    } else if (sstr_clear(patch),
+               json_marshal_diff_TreeNode(&patched, &root, patch) != 0) {
+        a->r = 9;
+    } else if (json_extract(a->json.data(), a->json.size(), path.c_str(),
+                            JSON_EXTRACT_INT, &leaf) != 0 ||
+               leaf != a->levels) {
+        a->r = 10;
+    } else if (json_unmarshal_CachedTreeNode(json, &cached) != 0) {
+        a->r = 11;
+    } else {
+        sstr_clear(out);
+        sstr_clear(patch);
+        if (json_marshal_CachedTreeNode(&cached, out) != 0 ||
+            json_marshal_CachedTreeNode(&cached, patch) != 0 ||
+            sstr_compare(out, patch) != 0) {
+            a->r = 12;
+        }
+    }
+    CachedTreeNode_clear(&cached);
+    TreeNode_clear(&patched);
+    TreeNode_clear(&copy);
+    TreeNode_clear(&root);
+    sstr_free(patch);
+    sstr_free(out);
+    sstr_free(json);
+    return nullptr;
+}
+
+// AddressSanitizer pads every frame with redzones; JSON_SANITIZE=1 builds
+// get a larger stack so the walk paths still measure the same depth.
+#if defined(__SANITIZE_ADDRESS__)
+#define TREE_STACK_SIZE (256 * 1024)
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define TREE_STACK_SIZE (256 * 1024)
+#endif
+#endif
+#ifndef TREE_STACK_SIZE
+#define TREE_STACK_SIZE (64 * 1024)
+#endif
+
+static void run_on_small_stack(void* (*fn)(void*), TreeDecodeArgs* args) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, TREE_STACK_SIZE);
+    pthread_t th;
+    ASSERT_EQ(pthread_create(&th, &attr, fn, args), 0);
+    pthread_join(th, nullptr);
+    pthread_attr_destroy(&attr);
+}
+
+// Struct nesting right up to JSON_MAX_DEPTH (256) fits a 64 KB stack.
+TEST_F(EdgeCaseDepthLimit, DeepStructNestingOnSmallStack) {
+    TreeDecodeArgs args = {make_tree_json(256), 256, -1, -1};
+    run_on_small_stack(decode_tree_on_thread, &args);
+    EXPECT_EQ(args.r, 0);
+    EXPECT_EQ(args.err_code, 0);
+}
+
+TEST_F(EdgeCaseDepthLimit, StructNestingPastMaxDepthFailsOnSmallStack) {
+    TreeDecodeArgs args = {make_tree_json(257), 257, 0, 0};
+    run_on_small_stack(decode_tree_on_thread, &args);
+    EXPECT_NE(args.r, 0);
+    EXPECT_EQ(args.err_code, JSON_GEN_ERROR_BOUNDS);
+}
+
+// json_validate_<S>() keeps its frames off the C stack too, and stops at
+// the same depth as the decoder.
+TEST_F(EdgeCaseDepthLimit, DeepStructValidateOnSmallStack) {
+    TreeDecodeArgs args = {make_tree_json(256), 256, -1, 0};
+    run_on_small_stack(validate_tree_on_thread, &args);
+    EXPECT_EQ(args.r, 0);
+
+    args = {make_tree_json(257), 257, 0, 0};
+    run_on_small_stack(validate_tree_on_thread, &args);
+    EXPECT_EQ(args.r, JSON_GEN_ERROR_BOUNDS);
+}
+
+TEST_F(EdgeCaseDepthLimit, DeepStructPathsOnSmallStack) {
+    TreeDecodeArgs args = {make_tree_json(256), 256, -1, 0};
+    run_on_small_stack(tree_paths_on_thread, &args);
+    EXPECT_EQ(args.r, 0);
+}
+
+TEST_F(EdgeCaseDepthLimit, StructArrayErrorKeepsDecodedElements) {
+    struct ComplexStruct cs;
+    ComplexStruct_init(&cs);
+    sstr_t json = sstr(R"({"contacts":[{"name":"Alice"},{"name":"Bob",}]})");
+    int r = json_unmarshal_ComplexStruct(json, &cs);
+    EXPECT_NE(r, 0);
+    // The completed element stays counted; the failed one is released.
+    ASSERT_EQ(cs.contacts_len, 1);
+    EXPECT_STREQ(sstr_cstr(cs.contacts[0].name), "Alice");
+    ComplexStruct_clear(&cs);
+    sstr_free(json);
+}
+
+TEST_F(EdgeCaseDepthLimit, StructArrayMissingCommaFails) {
+    struct ComplexStruct cs;
+    ComplexStruct_init(&cs);
+    sstr_t json = sstr(R"({"contacts":[{"name":"Alice"} {"name":"Bob"}]})");
+    EXPECT_NE(json_unmarshal_ComplexStruct(json, &cs), 0);
+    ComplexStruct_clear(&cs);
+    sstr_free(json);
+}
+
 // ==========================================================================
 // Empty object / empty array tests
 // ==========================================================================
@@ -767,3 +999,94 @@ TEST(OverflowBoundary, ExactMinValues) {
     sstr_free(json);
     PreciseInts_clear(&obj);
 }
+
+// ==========================================================================
+// Input that is rejected since the decoder and json_validate_<S>() were
+// made to agree; earlier versions clamped or skipped these silently
+// ==========================================================================
+
+// Decode text into a fresh S; 0 or the json_error code. The validator
+// must give the same verdict.
+#define DECODE_CODE(S, text, code)                                      \
+    do {                                                                \
+        struct S obj_;                                                  \
+        struct json_error err_;                                         \
+        S##_init(&obj_);                                                \
+        sstr_t in_ = sstr(text);                                        \
+        int r_ = json_unmarshal_##S##_ex(in_, &obj_, &err_);            \
+        (code) = r_ == 0 ? 0 : err_.code;                               \
+        EXPECT_EQ(json_validate_##S(text, strlen(text)) == 0, r_ == 0)  \
+            << (text);                                                  \
+        sstr_free(in_);                                                 \
+        S##_clear(&obj_);                                               \
+    } while (0)
+
+TEST(OverflowBoundary, LongOverflowFailsInsteadOfSaturating) {
+    int code = -1;
+    DECODE_CODE(TestStruct, "{\"long_val\":9223372036854775808}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_BOUNDS);
+    DECODE_CODE(TestStruct, "{\"long_val\":-9223372036854775809}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_BOUNDS);
+    DECODE_CODE(TestStruct, "{\"long_val\":99999999999999999999999}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_BOUNDS);
+    DECODE_CODE(TestStruct, "{\"long_val\":-9223372036854775808}", code);
+    EXPECT_EQ(code, 0);
+}
+
+TEST(OverflowBoundary, Int64AndUint64OverflowFail) {
+    int code = -1;
+    DECODE_CODE(PreciseInts, "{\"i64\":9223372036854775808}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_BOUNDS);
+    DECODE_CODE(PreciseInts, "{\"i64\":-9223372036854775809}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_BOUNDS);
+    DECODE_CODE(PreciseInts, "{\"u64\":18446744073709551616}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_BOUNDS);
+    DECODE_CODE(PreciseIntArrays, "{\"i64_dyn\":[1,9223372036854775808]}",
+                code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_BOUNDS);
+    DECODE_CODE(PreciseIntArrays, "{\"u64_fixed\":[18446744073709551616]}",
+                code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_BOUNDS);
+}
+
+TEST(EdgeCaseMalformed, MapSeparatorsRejected) {
+    int code = -1;
+    DECODE_CODE(MapAllTypesStruct, "{\"int_map\":{\"a\":1,,\"b\":2}}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_PARSE);
+    DECODE_CODE(MapAllTypesStruct, "{\"int_map\":{\"a\":1,}}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_PARSE);
+    DECODE_CODE(MapAllTypesStruct, "{\"int_map\":{\"a\":1 \"b\":2}}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_PARSE);
+    DECODE_CODE(MapAllTypesStruct, "{\"int_map\":{\"a\":\"x\"}}", code);
+    EXPECT_NE(code, 0);
+    DECODE_CODE(MapAllTypesStruct, "{\"int_map\":{\"a\":1,\"b\":2}}", code);
+    EXPECT_EQ(code, 0);
+}
+
+TEST(EdgeCaseMalformed, ArraySeparatorsRejected) {
+    int code = -1;
+    DECODE_CODE(ComplexStruct, "{\"int_array\":[1 2]}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_PARSE);
+    DECODE_CODE(ComplexStruct, "{\"string_array\":[\"a\" \"b\"]}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_PARSE);
+    DECODE_CODE(PreciseIntArrays, "{\"u64_fixed\":[1 2]}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_PARSE);
+    DECODE_CODE(ComplexStruct, "{\"int_array\":[1,null]}", code);
+    EXPECT_NE(code, 0);
+    // a ',' before ']' is still accepted, in fixed arrays too
+    DECODE_CODE(ComplexStruct, "{\"int_array\":[1,2,]}", code);
+    EXPECT_EQ(code, 0);
+    DECODE_CODE(PreciseIntArrays, "{\"u64_fixed\":[1,2,]}", code);
+    EXPECT_EQ(code, 0);
+}
+
+TEST(EdgeCaseMalformed, UnknownValueMustBeValid) {
+    int code = -1;
+    DECODE_CODE(TestStruct, "{\"extra\":tru,\"int_val\":1}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_PARSE);
+    DECODE_CODE(TestStruct, "{\"extra\":[1,{\"k\":nul}],\"int_val\":1}", code);
+    EXPECT_EQ(code, JSON_GEN_ERROR_PARSE);
+    // members of a struct object still tolerate a missing ','
+    DECODE_CODE(TestStruct, "{\"int_val\":1 \"long_val\":2}", code);
+    EXPECT_EQ(code, 0);
+}
@@ -6,6 +6,9 @@
 #include <gtest/gtest.h>
 #include <string>
 #include <memory>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 extern "C" {
 #include "utils/error_codes.h"
@@ -91,6 +94,66 @@ TEST_F(JsonGenCEnhancedTest, JsonContextBasic) {
     json_context_free(ctx);
 }
 
+// A full hash table: every lookup probes until it finds its item, and a
+// miss must stop after one pass instead of spinning.
+static struct json_field_offset_item g_ctx_items[] = {
+    {0, 4, 0, "int", "a", "S", 0},
+    {4, 4, 0, "int", "b", "S", 0},
+    {8, 4, 0, "int", "c", "T", 0},
+};
+static int g_ctx_hash[] = {0, 1, 2};
+
+TEST_F(JsonGenCEnhancedTest, JsonContextFindAndReplace) {
+    struct json_context* ctx = json_context_new();
+    ASSERT_NE(nullptr, ctx);
+    EXPECT_EQ(JSON_GEN_ERROR_INVALID_PARAM,
+              json_context_init(ctx, nullptr, 0, g_ctx_hash, 3));
+    ASSERT_EQ(JSON_GEN_SUCCESS,
+              json_context_init(ctx, g_ctx_items, 3, g_ctx_hash, 3));
+
+    EXPECT_EQ(&g_ctx_items[1], json_context_find_field(ctx, "S", "b"));
+    EXPECT_EQ(&g_ctx_items[2], json_context_find_field(ctx, "T", "c"));
+    EXPECT_EQ(nullptr, json_context_find_field(ctx, "T", "a"));
+
+    // Readers keep finding fields while the table is republished.
+    std::atomic<bool> stop{false};
+    std::atomic<int> misses{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&] {
+            while (!stop.load()) {
+                if (json_context_find_field(ctx, "S", "a") != &g_ctx_items[0]) {
+                    misses++;
+                }
+            }
+        });
+    }
+    int init_failures = 0;
+    for (int i = 0; i < 1000; i++) {
+        if (json_context_init(ctx, g_ctx_items, 3, g_ctx_hash, 3) !=
+            JSON_GEN_SUCCESS) {
+            init_failures++;
+        }
+    }
+    stop = true;
+    for (auto& th : readers) {
+        th.join();
+    }
+    EXPECT_EQ(0, init_failures);
+    EXPECT_EQ(0, misses.load());
+
+    // No reader is left, so the replaced tables can go; the current one stays.
+    json_context_reclaim(ctx);
+    EXPECT_EQ(&g_ctx_items[0], json_context_find_field(ctx, "S", "a"));
+    ASSERT_EQ(JSON_GEN_SUCCESS,
+              json_context_init(ctx, g_ctx_items, 3, g_ctx_hash, 3));
+    json_context_reclaim(ctx);
+    json_context_reclaim(nullptr);
+    EXPECT_EQ(&g_ctx_items[2], json_context_find_field(ctx, "T", "c"));
+
+    json_context_free(ctx);
+}
+
 // Test memory bounds checking
 TEST_F(JsonGenCEnhancedTest, MemoryBoundsChecking) {
     sstr_t str = sstr_new();
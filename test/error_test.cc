@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+#include "utils/error_codes.h"
+
+// ==========================================================================
+// struct json_error and the *_ex unmarshal entry points
+// ==========================================================================
+
+TEST(JsonError, ExReportsStructuredError) {
+    struct TestStruct obj;
+    TestStruct_init(&obj);
+    const char* text = "{\"int_val\": 1,\n \"long_val\" 2}";
+    sstr_t json = sstr(text);
+    struct json_error err;
+    int r = json_unmarshal_TestStruct_ex(json, &obj, &err);
+    EXPECT_NE(r, 0);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_PARSE);
+    EXPECT_EQ(err.expected_token, ':');
+    EXPECT_GT(err.offset, (long)(strstr(text, "long_val") - text));
+
+    sstr_t msg = sstr_new();
+    ASSERT_EQ(json_error_format(&err, json, msg), 0);
+    EXPECT_NE(strstr(sstr_cstr(msg), "line 1 col"), nullptr) << sstr_cstr(msg);
+    EXPECT_NE(strstr(sstr_cstr(msg), "expected ':'"), nullptr) << sstr_cstr(msg);
+    sstr_free(msg);
+    sstr_free(json);
+    TestStruct_clear(&obj);
+}
+
+TEST(JsonError, ExClearsErrorOnSuccess) {
+    struct TestStruct obj;
+    TestStruct_init(&obj);
+    struct json_error err;
+    err.code = JSON_GEN_ERROR_PARSE;
+    err.offset = 99;
+    err.expected_token = '{';
+    sstr_t json = sstr("{\"int_val\": 7}");
+    EXPECT_EQ(json_unmarshal_TestStruct_ex(json, &obj, &err), 0);
+    EXPECT_EQ(err.code, 0);
+    EXPECT_EQ(err.expected_token, JSON_EXPECT_NONE);
+    EXPECT_EQ(obj.int_val, 7);
+    // A NULL sink behaves like json_unmarshal_TestStruct().
+    EXPECT_EQ(json_unmarshal_TestStruct_ex(json, &obj, NULL), 0);
+    sstr_free(json);
+    TestStruct_clear(&obj);
+}
+
+TEST(JsonError, ArrayExReportsExpectedToken) {
+    struct Person* arr = NULL;
+    int len = 0;
+    struct json_error err;
+    sstr_t json = sstr("[{\"name\":\"a\"}, 5]");
+    EXPECT_NE(json_unmarshal_array_Person_ex(json, &arr, &len, &err), 0);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_PARSE);
+    EXPECT_EQ(err.expected_token, '{');
+    EXPECT_EQ(arr, nullptr);
+    EXPECT_EQ(len, 0);
+    sstr_free(json);
+}
+
+// An empty array or a trailing comma is not an error, and must not hide the
+// real one that follows.
+TEST(JsonError, ExIgnoresArrayEnds) {
+    struct ComplexStruct obj;
+    ComplexStruct_init(&obj);
+    struct json_error err;
+    sstr_t ok = sstr("{\"int_array\":[],\"string_array\":[\"a\",]}");
+    EXPECT_EQ(json_unmarshal_ComplexStruct_ex(ok, &obj, &err), 0);
+    EXPECT_EQ(err.code, 0);
+    EXPECT_EQ(obj.string_array_len, 1);
+
+    const char* text = "{\"int_array\":[1,],\"simple_int\":\"x\"}";
+    sstr_t bad = sstr(text);
+    EXPECT_NE(json_unmarshal_ComplexStruct_ex(bad, &obj, &err), 0);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_PARSE);
+    EXPECT_EQ(err.expected_token, JSON_EXPECT_NUMBER);
+    EXPECT_GT(err.offset, (long)(strstr(text, "simple_int") - text));
+    sstr_free(ok);
+    sstr_free(bad);
+    ComplexStruct_clear(&obj);
+}
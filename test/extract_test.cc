@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+#include "utils/error_codes.h"
+
+// ==========================================================================
+// json_extract() and json_extract_<S>_<path>()
+// ==========================================================================
+
+TEST(Extract, RuntimePath) {
+    const char* json =
+        "{\"skip\": {\"a\": [1, {\"b\": \"}\"}]}, \"items\": [{\"price\": 1},"
+        " {\"price\": 2.5}, {\"price\": 3, \"name\": \"x\\u00e9\"}],"
+        " \"a/b\": {\"m~n\": -7}, \"flag\": true, \"big\": 300}";
+    size_t len = strlen(json);
+    double d = 0;
+    EXPECT_EQ(json_extract(json, len, "/items/1/price", JSON_EXTRACT_DOUBLE, &d),
+              0);
+    EXPECT_DOUBLE_EQ(d, 2.5);
+
+    sstr_t s = sstr("old");
+    EXPECT_EQ(json_extract(json, len, "/items/2/name", JSON_EXTRACT_SSTR, s), 0);
+    EXPECT_EQ(sstr_compare_c(s, "x\xc3\xa9"), 0);
+    sstr_free(s);
+
+    int i = 0;
+    EXPECT_EQ(json_extract(json, len, "/a~1b/m~0n", JSON_EXTRACT_INT, &i), 0);
+    EXPECT_EQ(i, -7);
+    EXPECT_EQ(json_extract(json, len, "/flag", JSON_EXTRACT_BOOL, &i), 0);
+    EXPECT_EQ(i, 1);
+
+    uint8_t u8 = 0;
+    EXPECT_EQ(json_extract(json, len, "/big", JSON_EXTRACT_UINT8, &u8),
+              JSON_GEN_ERROR_BOUNDS);
+    EXPECT_EQ(json_extract(json, len, "/items/3/price", JSON_EXTRACT_INT, &i),
+              JSON_GEN_ERROR_NOT_FOUND);
+    EXPECT_EQ(json_extract(json, len, "/items/x", JSON_EXTRACT_INT, &i),
+              JSON_GEN_ERROR_NOT_FOUND);
+    EXPECT_EQ(json_extract(json, len, "/flag/x", JSON_EXTRACT_INT, &i),
+              JSON_GEN_ERROR_NOT_FOUND);
+    EXPECT_EQ(json_extract(json, len, "/items", JSON_EXTRACT_INT, &i),
+              JSON_GEN_ERROR_PARSE);
+    EXPECT_EQ(json_extract(json, len, "items", JSON_EXTRACT_INT, &i),
+              JSON_GEN_ERROR_INVALID_PARAM);
+    EXPECT_EQ(json_extract(json, len, "/flag", 5, &i),
+              JSON_GEN_ERROR_INVALID_PARAM);
+}
+
+TEST(Extract, StopsAtTarget) {
+    // Everything after the target is never looked at.
+    const char* json = "{\"id\": 42, \"name\": \"n\", \"embedded\": {oops";
+    int id = 0;
+    EXPECT_EQ(json_extract_NestedStruct_id(json, strlen(json), &id), 0);
+    EXPECT_EQ(id, 42);
+}
+
+TEST(Extract, GeneratedAccessors) {
+    const char* json =
+        "{\"user_info\": {\"name\": \"ann\", \"age\": \"7\"},"
+        " \"home_address\": {\"number\": \"12\", \"street\": \"main\"}}";
+    sstr_t s = sstr_new();
+    EXPECT_EQ(json_extract_AliasNested_addr_street(json, strlen(json), s), 0);
+    EXPECT_EQ(sstr_compare_c(s, "main"), 0);
+    sstr_free(s);
+
+    const char* colors = "{\"color\": \"BLUE\", \"colors\": [\"RED\", 1]}";
+    int c = -1;
+    EXPECT_EQ(json_extract_EnumTestStruct_color(colors, strlen(colors), &c), 0);
+    EXPECT_EQ(c, Color_BLUE);
+    EXPECT_EQ(json_extract_EnumTestStruct_colors(colors, strlen(colors), 1, &c),
+              0);
+    EXPECT_EQ(c, Color_GREEN);
+    EXPECT_EQ(json_extract_EnumTestStruct_colors(colors, strlen(colors), 2, &c),
+              JSON_GEN_ERROR_NOT_FOUND);
+    EXPECT_EQ(json_extract_EnumTestStruct_colors(colors, strlen(colors), -1, &c),
+              JSON_GEN_ERROR_NOT_FOUND);
+
+    const char* ints = "{\"u64_fixed\": [1, 18446744073709551615]}";
+    uint64_t u = 0;
+    EXPECT_EQ(json_extract_PreciseIntArrays_u64_fixed(ints, strlen(ints), 1, &u),
+              0);
+    EXPECT_EQ(u, UINT64_MAX);
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+#include "utils/error_codes.h"
+
+// ==========================================================================
+// str<N> fixed-capacity string fields
+// ==========================================================================
+
+TEST(FixStr, RoundTripValidateAndLimit) {
+    struct FixStrRecord r;
+    FixStrRecord_init(&r);
+    EXPECT_STREQ(r.currency, "USD");
+    EXPECT_EQ(r.currency_len, 3);
+    EXPECT_EQ(r.id_len, 0);
+
+    sstr_t in = sstr(
+        "{\"currency\":\"EUR\",\"id\":\"0f8fad5b-d9cb-469f-a165-70867728950e\","
+        "\"tag\":\"a\\\"b\",\"country\":null,\"sym\":\"\",\"qty\":2}");
+    EXPECT_EQ(json_validate_FixStrRecord(sstr_cstr(in), sstr_length(in)), 0);
+    ASSERT_EQ(json_unmarshal_FixStrRecord(in, &r), 0);
+    EXPECT_STREQ(r.currency, "EUR");
+    EXPECT_EQ(r.id_len, 36);
+    EXPECT_TRUE(r.has_tag);
+    EXPECT_STREQ(r.tag, "a\"b");
+    EXPECT_EQ(r.tag_len, 3);
+    EXPECT_FALSE(r.has_country);
+    EXPECT_EQ(r.symbol_len, 0);
+    EXPECT_EQ(r.qty, 2);
+
+    sstr_t out = sstr_new();
+    ASSERT_EQ(json_marshal_FixStrRecord(&r, out), 0);
+    EXPECT_STREQ(sstr_cstr(out), sstr_cstr(in));
+    sstr_t indented = sstr_new();
+    ASSERT_EQ(json_marshal_indent_FixStrRecord(&r, 0, 0, indented), 0);
+    EXPECT_STREQ(sstr_cstr(indented), sstr_cstr(in));
+
+    // a 4-byte currency does not fit str<3>
+    sstr_t bad = sstr("{\"currency\":\"EURO\"}");
+    EXPECT_EQ(json_validate_FixStrRecord(sstr_cstr(bad), sstr_length(bad)),
+              JSON_GEN_ERROR_BOUNDS);
+    struct json_error err;
+    memset(&err, 0, sizeof(err));
+    EXPECT_NE(json_unmarshal_FixStrRecord_ex(bad, &r, &err), 0);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_BOUNDS);
+    // the debug message for it; sstr_printf() spells size_t as %uz
+    sstr_t msg = sstr_printf("string of %uz bytes exceeds str<%d> field '%s'",
+                             (size_t)4, 3, "currency");
+    EXPECT_STREQ(sstr_cstr(msg),
+                 "string of 4 bytes exceeds str<3> field 'currency'");
+    sstr_free(msg);
+
+    // escapes count once decoded: "\u00e9" is two bytes
+    sstr_t esc = sstr("{\"currency\":\"\\u00e9\"}");
+    FixStrRecord_clear(&r);
+    ASSERT_EQ(json_unmarshal_FixStrRecord(esc, &r), 0);
+    EXPECT_EQ(r.currency_len, 2);
+    EXPECT_STREQ(r.currency, "\xc3\xa9");
+
+    sstr_free(esc);
+    sstr_free(bad);
+    sstr_free(indented);
+    sstr_free(out);
+    sstr_free(in);
+    FixStrRecord_clear(&r);
+}
+
+TEST(FixStr, CopyDiffPatchAndCachedSetter) {
+    struct FixStrRecord a, b;
+    FixStrRecord_init(&a);
+    FixStrRecord_init(&b);
+    memcpy(a.symbol, "AAPL", 5);
+    a.symbol_len = 4;
+    ASSERT_EQ(FixStrRecord_copy(&b, &a), 0);
+    EXPECT_STREQ(b.symbol, "AAPL");
+    EXPECT_EQ(b.symbol_len, 4);
+
+    sstr_t patch = sstr_new();
+    EXPECT_EQ(json_marshal_diff_FixStrRecord(&a, &b, patch), 0);
+    EXPECT_STREQ(sstr_cstr(patch), "{}");
+    memcpy(b.symbol, "MSFT", 5);
+    sstr_clear(patch);
+    EXPECT_GT(json_marshal_diff_FixStrRecord(&a, &b, patch), 0);
+    EXPECT_STREQ(sstr_cstr(patch), "{\"sym\":\"MSFT\"}");
+    ASSERT_EQ(json_apply_patch_FixStrRecord(&a, patch), 0);
+    EXPECT_STREQ(a.symbol, "MSFT");
+
+    sstr_t doc = sstr("{\"qty\":1,\"sym\":\"IBM\"}");
+    sstr_t sym = sstr_new();
+    ASSERT_EQ(json_extract_FixStrRecord_symbol(sstr_cstr(doc),
+                                               sstr_length(doc), sym),
+              0);
+    EXPECT_STREQ(sstr_cstr(sym), "IBM");
+
+    struct CachedFixStr c;
+    CachedFixStr_init(&c);
+    EXPECT_EQ(CachedFixStr_set_unit(&c, "kg"), 0);
+    sstr_t out = sstr_new();
+    ASSERT_EQ(json_marshal_CachedFixStr(&c, out), 0);
+    EXPECT_STREQ(sstr_cstr(out), "{\"unit\":\"kg\",\"n\":0}");
+    EXPECT_EQ(CachedFixStr_set_unit(&c, "grams"), -1);
+    EXPECT_EQ(CachedFixStr_set_unit(&c, "lb"), 0);
+    sstr_clear(out);
+    ASSERT_EQ(json_marshal_CachedFixStr(&c, out), 0);
+    EXPECT_STREQ(sstr_cstr(out), "{\"unit\":\"lb\",\"n\":0}");
+
+    CachedFixStr_clear(&c);
+    sstr_free(out);
+    sstr_free(sym);
+    sstr_free(doc);
+    sstr_free(patch);
+    FixStrRecord_clear(&a);
+    FixStrRecord_clear(&b);
+}
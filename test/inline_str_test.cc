@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+
+// ==========================================================================
+// @inline_str sstr_t fields stored inside the struct
+// ==========================================================================
+
+TEST(InlineStr, RoundTripWithoutHeapForShortStrings) {
+    struct InlineStrRecord r;
+    InlineStrRecord_init(&r);
+    EXPECT_STREQ(sstr_cstr(r.code), "");
+    EXPECT_STREQ(sstr_cstr(r.unit), "kg");
+
+    sstr_t in = sstr(
+        "{\"id\":7,\"code\":\"AB-12\",\"note\":\"n\",\"alias\":null,"
+        "\"unit\":\"g\",\"heap\":\"h\",\"inner\":{\"c\":\"x\\\"y\"}}");
+    ASSERT_EQ(json_unmarshal_InlineStrRecord(in, &r), 0);
+    EXPECT_EQ(r.id, 7);
+    EXPECT_STREQ(sstr_cstr(r.code), "AB-12");
+    EXPECT_EQ(r.code->type, SSTR_TYPE_SHORT);
+    EXPECT_TRUE(r.has_note);
+    EXPECT_STREQ(sstr_cstr(r.note), "n");
+    EXPECT_FALSE(r.has_alias);
+    EXPECT_STREQ(sstr_cstr(r.unit), "g");
+    EXPECT_STREQ(sstr_cstr(r.inner.code), "x\"y");
+
+    sstr_t out = sstr_new();
+    ASSERT_EQ(json_marshal_InlineStrRecord(&r, out), 0);
+    EXPECT_STREQ(sstr_cstr(out), sstr_cstr(in));
+
+    /* A value past the short capacity spills to the heap and is freed by
+     * _clear; _clear leaves a valid empty string behind. */
+    std::string big(200, 'z');
+    std::string json = "{\"code\":\"" + big + "\"}";
+    sstr_t in2 = sstr(json.c_str());
+    ASSERT_EQ(json_unmarshal_InlineStrRecord(in2, &r), 0);
+    EXPECT_EQ(r.code->type, SSTR_TYPE_LONG);
+    EXPECT_EQ(std::string(sstr_cstr(r.code), sstr_length(r.code)), big);
+    InlineStrRecord_clear(&r);
+    EXPECT_EQ(r.code->type, SSTR_TYPE_SHORT);
+    EXPECT_EQ(sstr_length(r.code), 0u);
+
+    sstr_free(in2);
+    sstr_free(out);
+    sstr_free(in);
+}
+
+TEST(InlineStr, CopyMoveAndCachedSetter) {
+    struct InlineStrRecord a, b, c;
+    InlineStrRecord_init(&a);
+    InlineStrRecord_init(&b);
+    InlineStrRecord_init(&c);
+    sstr_append_cstr(a.code, "short");
+    for (int i = 0; i < 10; i++) {
+        sstr_append_cstr(a.unit, "0123456789");
+    }
+    a.heap = sstr("h");
+
+    ASSERT_EQ(InlineStrRecord_copy(&b, &a), 0);
+    EXPECT_STREQ(sstr_cstr(b.code), "short");
+    EXPECT_EQ(sstr_length(b.unit), 100u + 2u);
+    EXPECT_NE(sstr_cstr(b.unit), sstr_cstr(a.unit));
+
+    ASSERT_EQ(InlineStrRecord_move(&c, &b), 0);
+    EXPECT_STREQ(sstr_cstr(c.code), "short");
+    EXPECT_EQ(sstr_length(c.unit), 102u);
+    EXPECT_EQ(sstr_length(b.code), 0u);
+
+    struct CachedLeaf leaf;
+    CachedLeaf_init(&leaf);
+    ASSERT_EQ(CachedLeaf_set_code(&leaf, sstr("k1")), 0);
+    sstr_t out = sstr_new();
+    ASSERT_EQ(json_marshal_CachedLeaf(&leaf, out), 0);
+    EXPECT_NE(std::string(sstr_cstr(out)).find("\"code\":\"k1\""),
+              std::string::npos);
+    ASSERT_EQ(CachedLeaf_set_code(&leaf, sstr("k2")), 0);
+    sstr_clear(out);
+    ASSERT_EQ(json_marshal_CachedLeaf(&leaf, out), 0);
+    EXPECT_NE(std::string(sstr_cstr(out)).find("\"code\":\"k2\""),
+              std::string::npos);
+
+    sstr_free(out);
+    CachedLeaf_clear(&leaf);
+    InlineStrRecord_clear(&a);
+    InlineStrRecord_clear(&b);
+    InlineStrRecord_clear(&c);
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+
+// ==========================================================================
+// json_marshal_iov_<S>() scatter-gather output
+// ==========================================================================
+
+static std::string IovJoin(struct json_iov* io) {
+    int count = 0;
+    JSON_IOVEC* vec = json_iov_vec(io, &count);
+    std::string r;
+    for (int i = 0; i < count; i++) {
+        r.append((const char*)vec[i].iov_base, vec[i].iov_len);
+    }
+    return r;
+}
+
+TEST(IovMarshal, MatchesCompactOutput) {
+    struct ComplexStruct obj;
+    ComplexStruct_init(&obj);
+    std::string big(1000, 'a');
+    obj.simple_int = -5;
+    obj.simple_string = sstr(big.c_str());
+    obj.string_array_len = 3;
+    obj.string_array = (sstr_t*)malloc(3 * sizeof(sstr_t));
+    obj.string_array[0] = sstr("short");
+    obj.string_array[1] = sstr(big.c_str());
+    obj.string_array[2] = sstr((big + "\"q\n").c_str());
+    obj.address.street = sstr(big.c_str());
+    obj.contacts_len = 2;
+    obj.contacts = (struct Person*)malloc(2 * sizeof(struct Person));
+    Person_init(&obj.contacts[0]);
+    Person_init(&obj.contacts[1]);
+    obj.contacts[1].name = sstr(big.c_str());
+
+    sstr_t out = sstr_new();
+    ASSERT_EQ(json_marshal_ComplexStruct(&obj, out), 0);
+
+    struct json_iov io;
+    ASSERT_EQ(json_iov_init(&io), 0);
+    ASSERT_EQ(json_marshal_iov_ComplexStruct(&obj, &io), 0);
+    EXPECT_EQ(IovJoin(&io), std::string(sstr_cstr(out), sstr_length(out)));
+    // a second call gives the same vector
+    EXPECT_EQ(IovJoin(&io), std::string(sstr_cstr(out), sstr_length(out)));
+
+    int count = 0;
+    JSON_IOVEC* vec = json_iov_vec(&io, &count);
+    int refs = 0;
+    for (int i = 0; i < count; i++) {
+        if (vec[i].iov_base == (void*)sstr_cstr(obj.simple_string) ||
+            vec[i].iov_base == (void*)sstr_cstr(obj.string_array[1]) ||
+            vec[i].iov_base == (void*)sstr_cstr(obj.address.street) ||
+            vec[i].iov_base == (void*)sstr_cstr(obj.contacts[1].name)) {
+            refs++;
+        }
+        // the escaped string is never referenced
+        EXPECT_NE(vec[i].iov_base, (void*)sstr_cstr(obj.string_array[2]));
+    }
+    EXPECT_EQ(refs, 4);
+
+    json_iov_reset(&io);
+    ASSERT_EQ(json_marshal_array_iov_Person(obj.contacts, 2, &io), 0);
+    sstr_clear(out);
+    ASSERT_EQ(json_marshal_array_Person(obj.contacts, 2, out), 0);
+    EXPECT_EQ(IovJoin(&io), std::string(sstr_cstr(out), sstr_length(out)));
+
+    json_iov_clear(&io);
+    sstr_free(out);
+    ComplexStruct_clear(&obj);
+}
+
+TEST(IovMarshal, OptionalAndCachedStructs) {
+    struct CachedDoc doc;
+    CachedDoc_init(&doc);
+    sstr_t in = sstr(
+        "{\"title\":\"t\",\"version\":3,\"note\":null,\"score\":1.5,"
+        "\"color\":\"GREEN\",\"leaf\":{\"id\":1,\"label\":\"a\"},"
+        "\"leaves\":[{\"id\":2,\"label\":\"b\"},{\"id\":3,\"label\":\"c\"}],"
+        "\"house\":{\"number\":\"9\",\"street\":\"s\"},\"values\":[1,2],"
+        "\"counts\":{\"k\":1}}");
+    ASSERT_EQ(json_unmarshal_CachedDoc(in, &doc), 0);
+
+    struct json_iov io;
+    ASSERT_EQ(json_iov_init(&io), 0);
+    ASSERT_EQ(json_marshal_iov_CachedDoc(&doc, &io), 0);
+    sstr_t out = sstr_new();
+    ASSERT_EQ(json_marshal_CachedDoc(&doc, out), 0);
+    EXPECT_EQ(IovJoin(&io), std::string(sstr_cstr(out), sstr_length(out)));
+
+    struct OptionalFieldsStruct opt;
+    OptionalFieldsStruct_init(&opt);
+    json_iov_reset(&io);
+    ASSERT_EQ(json_marshal_iov_OptionalFieldsStruct(&opt, &io), 0);
+    sstr_clear(out);
+    json_marshal_OptionalFieldsStruct(&opt, out);
+    EXPECT_EQ(IovJoin(&io), std::string(sstr_cstr(out)));
+
+    sstr_free(out);
+    OptionalFieldsStruct_clear(&opt);
+    json_iov_clear(&io);
+    sstr_free(in);
+    CachedDoc_clear(&doc);
+}
@@ -0,0 +1,286 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+#include "utils/error_codes.h"
+
+// ==========================================================================
+// Resource limit tests (struct json_limits)
+// ==========================================================================
+
+TEST(Limits, InputBytes) {
+    struct TestStruct obj;
+    TestStruct_init(&obj);
+    struct json_limits lim = {};
+    lim.max_input_bytes = 8;
+    struct json_error err;
+    sstr_t json = sstr("{\"int_val\": 7}");
+    EXPECT_EQ(json_unmarshal_TestStruct_limited(json, &obj, &lim, &err),
+              JSON_GEN_ERROR_BOUNDS);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_BOUNDS);
+    EXPECT_EQ(err.offset, 0);
+    lim.max_input_bytes = sstr_length(json);
+    EXPECT_EQ(json_unmarshal_TestStruct_limited(json, &obj, &lim, &err), 0);
+    EXPECT_EQ(obj.int_val, 7);
+    sstr_free(json);
+    TestStruct_clear(&obj);
+}
+
+TEST(Limits, StringLength) {
+    struct TestStruct obj;
+    TestStruct_init(&obj);
+    struct json_limits lim = {};
+    lim.max_string_len = 4;
+    struct json_error err;
+    sstr_t json = sstr("{\"sstr_val\": \"abcd\"}");
+    EXPECT_NE(json_unmarshal_TestStruct_limited(json, &obj, &lim, &err), 0);
+    // The key "sstr_val" is a string too.
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_BOUNDS);
+    sstr_free(json);
+    TestStruct_clear(&obj);
+
+    lim.max_string_len = 8;
+    TestStruct_init(&obj);
+    json = sstr("{\"sstr_val\": \"abcd\"}");
+    EXPECT_EQ(json_unmarshal_TestStruct_limited(json, &obj, &lim, &err), 0);
+    EXPECT_EQ(sstr_compare_c(obj.sstr_val, "abcd"), 0);
+    sstr_free(json);
+    TestStruct_clear(&obj);
+
+    // Escapes count after decoding, and are checked as they are appended.
+    TestStruct_init(&obj);
+    json = sstr("{\"sstr_val\": \"\\n\\n\\n\\n\\n\\n\\n\\n\\n\"}");
+    EXPECT_NE(json_unmarshal_TestStruct_limited(json, &obj, &lim, &err), 0);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_BOUNDS);
+    sstr_free(json);
+    TestStruct_clear(&obj);
+}
+
+TEST(Limits, ArrayLength) {
+    struct json_limits lim = {};
+    lim.max_array_len = 3;
+    struct json_error err;
+
+    struct ComplexStruct cs;
+    ComplexStruct_init(&cs);
+    sstr_t json = sstr("{\"int_array\":[1,2,3]}");
+    EXPECT_EQ(json_unmarshal_ComplexStruct_limited(json, &cs, &lim, &err), 0);
+    EXPECT_EQ(cs.int_array_len, 3);
+    sstr_free(json);
+    ComplexStruct_clear(&cs);
+
+    ComplexStruct_init(&cs);
+    json = sstr("{\"int_array\":[1,2,3,4]}");
+    EXPECT_NE(json_unmarshal_ComplexStruct_limited(json, &cs, &lim, &err), 0);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_BOUNDS);
+    sstr_free(json);
+    ComplexStruct_clear(&cs);
+
+    ComplexStruct_init(&cs);
+    json = sstr("{\"string_array\":[\"a\",\"b\",\"c\",\"d\"]}");
+    EXPECT_NE(json_unmarshal_ComplexStruct_limited(json, &cs, &lim, &err), 0);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_BOUNDS);
+    sstr_free(json);
+    ComplexStruct_clear(&cs);
+
+    ComplexStruct_init(&cs);
+    json = sstr("{\"contacts\":[{},{},{},{}]}");
+    EXPECT_NE(json_unmarshal_ComplexStruct_limited(json, &cs, &lim, &err), 0);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_BOUNDS);
+    EXPECT_EQ(cs.contacts_len, 3);
+    sstr_free(json);
+    ComplexStruct_clear(&cs);
+
+    struct Person* arr = NULL;
+    int len = 0;
+    json = sstr("[{},{},{},{}]");
+    EXPECT_NE(json_unmarshal_array_Person_limited(json, &arr, &len, &lim, &err),
+              0);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_BOUNDS);
+    EXPECT_EQ(arr, nullptr);
+    sstr_free(json);
+}
+
+TEST(Limits, MapEntries) {
+    struct MapIntStruct m;
+    MapIntStruct_init(&m);
+    struct json_limits lim = {};
+    lim.max_map_entries = 2;
+    struct json_error err;
+    sstr_t json = sstr("{\"scores\":{\"a\":1,\"b\":2,\"c\":3}}");
+    EXPECT_NE(json_unmarshal_MapIntStruct_limited(json, &m, &lim, &err), 0);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_BOUNDS);
+    sstr_free(json);
+    MapIntStruct_clear(&m);
+}
+
+TEST(Limits, AllocBytes) {
+    struct ComplexStruct cs;
+    ComplexStruct_init(&cs);
+    struct json_limits lim = {};
+    lim.max_alloc_bytes = 64 * sizeof(int);
+    struct json_error err;
+    sstr_t big = sstr("{\"int_array\":[0");
+    for (int i = 1; i < 1000; i++) {
+        sstr_append_cstr(big, ",0");
+    }
+    sstr_append_cstr(big, "]}");
+    EXPECT_NE(json_unmarshal_ComplexStruct_limited(big, &cs, &lim, &err), 0);
+    EXPECT_EQ(err.code, JSON_GEN_ERROR_BOUNDS);
+    ComplexStruct_clear(&cs);
+
+    // The budget is per decode, not cumulative across calls.
+    ComplexStruct_init(&cs);
+    sstr_t small = sstr("{\"int_array\":[1,2,3]}");
+    EXPECT_EQ(json_unmarshal_ComplexStruct_limited(small, &cs, &lim, &err), 0);
+    EXPECT_EQ(json_unmarshal_ComplexStruct_limited(small, &cs, &lim, &err), 0);
+    sstr_free(small);
+    sstr_free(big);
+    ComplexStruct_clear(&cs);
+}
+
+TEST(Limits, ProcessDefault) {
+    struct json_limits lim = {};
+    lim.max_array_len = 2;
+    json_gen_c_set_limits(&lim);
+
+    struct ComplexStruct cs;
+    ComplexStruct_init(&cs);
+    sstr_t json = sstr("{\"int_array\":[1,2,3]}");
+    EXPECT_NE(json_unmarshal_ComplexStruct(json, &cs), 0);
+    ComplexStruct_clear(&cs);
+
+    // Explicit limits take precedence over the default.
+    struct json_limits wide = {};
+    ComplexStruct_init(&cs);
+    EXPECT_EQ(json_unmarshal_ComplexStruct_limited(json, &cs, &wide, NULL), 0);
+    ComplexStruct_clear(&cs);
+
+    json_gen_c_set_limits(NULL);
+    ComplexStruct_init(&cs);
+    EXPECT_EQ(json_unmarshal_ComplexStruct(json, &cs), 0);
+    EXPECT_EQ(cs.int_array_len, 3);
+    ComplexStruct_clear(&cs);
+    sstr_free(json);
+}
+
+// Every other decode entry point picks up the process default too.
+TEST(Limits, ProcessDefaultSelected) {
+    struct json_limits lim = {};
+    lim.max_array_len = 2;
+    json_gen_c_set_limits(&lim);
+
+    uint64_t mask[ComplexStruct_FIELD_MASK_WORD_COUNT] = {0};
+    JSON_GEN_C_FIELD_MASK_SET(mask, ComplexStruct_FIELD_int_array);
+    sstr_t json = sstr("{\"int_array\":[1,2,3]}");
+    struct ComplexStruct cs;
+    ComplexStruct_init(&cs);
+    EXPECT_NE(json_unmarshal_selected_ComplexStruct(
+                  json, &cs, mask, ComplexStruct_FIELD_MASK_WORD_COUNT),
+              0);
+    ComplexStruct_clear(&cs);
+
+    ComplexStruct_init(&cs);
+    EXPECT_NE(json_unmarshal_selected_ComplexStruct_deep(
+                  json, &cs, mask, ComplexStruct_FIELD_MASK_WORD_COUNT,
+                  NULL, 0),
+              0);
+    ComplexStruct_clear(&cs);
+
+    json_gen_c_set_limits(NULL);
+    ComplexStruct_init(&cs);
+    EXPECT_EQ(json_unmarshal_selected_ComplexStruct(
+                  json, &cs, mask, ComplexStruct_FIELD_MASK_WORD_COUNT),
+              0);
+    EXPECT_EQ(cs.int_array_len, 3);
+    ComplexStruct_clear(&cs);
+    sstr_free(json);
+}
+
+TEST(Limits, ProcessDefaultApplyPatch) {
+    struct json_limits lim = {};
+    lim.max_array_len = 2;
+    json_gen_c_set_limits(&lim);
+
+    struct ComplexStruct cs;
+    ComplexStruct_init(&cs);
+    sstr_t patch = sstr("{\"int_array\":[1,2,3]}");
+    EXPECT_NE(json_apply_patch_ComplexStruct(&cs, patch), 0);
+
+    json_gen_c_set_limits(NULL);
+    EXPECT_EQ(json_apply_patch_ComplexStruct(&cs, patch), 0);
+    EXPECT_EQ(cs.int_array_len, 3);
+    ComplexStruct_clear(&cs);
+    sstr_free(patch);
+}
+
+TEST(Limits, ProcessDefaultOneof) {
+    sstr_t json = sstr(
+        "[{\"type\":\"circle\",\"radius\":1.0},"
+        "{\"type\":\"circle\",\"radius\":2.0}]");
+    // Each element fits; the whole document does not.
+    struct json_limits lim = {};
+    lim.max_input_bytes = sstr_length(json) - 1;
+    json_gen_c_set_limits(&lim);
+
+    struct Shape* shapes = NULL;
+    int len = 0;
+    EXPECT_EQ(json_unmarshal_array_Shape(json, &shapes, &len),
+              JSON_GEN_ERROR_BOUNDS);
+    EXPECT_EQ(len, 0);
+    EXPECT_EQ(shapes, nullptr);
+
+    sstr_t one = sstr("{\"type\":\"circle\",\"radius\":1.0}");
+    lim.max_input_bytes = sstr_length(one) - 1;
+    json_gen_c_set_limits(&lim);
+    struct Shape shape;
+    EXPECT_EQ(json_unmarshal_Shape(one, &shape), JSON_GEN_ERROR_BOUNDS);
+
+    json_gen_c_set_limits(NULL);
+    EXPECT_EQ(json_unmarshal_Shape(one, &shape), 0);
+    EXPECT_EQ(shape.tag, Shape_circle);
+    Shape_clear(&shape);
+    sstr_free(one);
+    sstr_free(json);
+}
+
+TEST(Limits, ProcessDefaultArrays) {
+    struct json_limits lim = {};
+    lim.max_array_len = 2;
+    json_gen_c_set_limits(&lim);
+
+    sstr_t json = sstr("[1,2,3]");
+    int* ints = NULL;
+    int32_t* ints32 = NULL;
+    double* doubles = NULL;
+    int len = 0;
+    EXPECT_NE(json_unmarshal_array_int(json, &ints, &len), 0);
+    EXPECT_EQ(ints, nullptr);
+    EXPECT_EQ(len, 0);
+    EXPECT_NE(json_unmarshal_array_int32_t(json, &ints32, &len), 0);
+    EXPECT_EQ(ints32, nullptr);
+    EXPECT_NE(json_unmarshal_array_double(json, &doubles, &len), 0);
+    EXPECT_EQ(doubles, nullptr);
+    sstr_t strs_json = sstr("[\"a\",\"b\",\"c\"]");
+    sstr_t* strs = NULL;
+    EXPECT_NE(json_unmarshal_array_sstr_t(strs_json, &strs, &len), 0);
+    EXPECT_EQ(strs, nullptr);
+    EXPECT_EQ(len, 0);
+
+    // max_input_bytes is checked before anything is parsed.
+    lim.max_array_len = 0;
+    lim.max_input_bytes = 4;
+    json_gen_c_set_limits(&lim);
+    EXPECT_EQ(json_unmarshal_array_int(json, &ints, &len),
+              JSON_GEN_ERROR_BOUNDS);
+    EXPECT_EQ(ints, nullptr);
+
+    json_gen_c_set_limits(NULL);
+    ASSERT_EQ(json_unmarshal_array_int(json, &ints, &len), 0);
+    EXPECT_EQ(len, 3);
+    free(ints);
+    sstr_free(strs_json);
+    sstr_free(json);
+}
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+
+// ==========================================================================
+// sstr_json_escape_string_append() against a byte-at-a-time reference
+// ==========================================================================
+
+static std::string reference_escape(const std::string& in) {
+    std::string out;
+    char tmp[8];
+    for (unsigned char ch : in) {
+        switch (ch) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (ch <= 31) {
+                    snprintf(tmp, sizeof(tmp), "\\u%04x", ch);
+                    out += tmp;
+                } else {
+                    out += (char)ch;
+                }
+        }
+    }
+    return out;
+}
+
+TEST(MarshalEscape, EveryByteAtEveryBlockOffset) {
+    // Lengths and positions straddle the 16/32-byte scan blocks.
+    for (int c = 0; c < 256; c++) {
+        for (size_t len : {1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100}) {
+            for (size_t pos = 0; pos < len; pos += 7) {
+                std::string raw(len, 'a');
+                raw[pos] = (char)c;
+                sstr_t in = sstr_of(raw.data(), raw.size());
+                sstr_t out = sstr("x");
+                ASSERT_EQ(sstr_json_escape_string_append(out, in), 0);
+                ASSERT_EQ(std::string(sstr_cstr(out), sstr_length(out)),
+                          "x" + reference_escape(raw))
+                    << "byte " << c << " len " << len << " pos " << pos;
+                sstr_free(in);
+                sstr_free(out);
+            }
+        }
+    }
+}
+
+TEST(MarshalEscape, LongStringAcrossChunks) {
+    std::string raw;
+    for (int i = 0; i < 20000; i++) {
+        raw += (char)(i % 97 == 0 ? '\n' : i % 89 == 0 ? '"' : 'a' + i % 26);
+    }
+    raw += std::string(5000, '\x01');
+    sstr_t in = sstr_of(raw.data(), raw.size());
+    sstr_t out = sstr_new();
+    ASSERT_EQ(sstr_json_escape_string_append(out, in), 0);
+    EXPECT_EQ(std::string(sstr_cstr(out), sstr_length(out)),
+              reference_escape(raw));
+    EXPECT_EQ(sstr_cstr(out)[sstr_length(out)], '\0');
+    sstr_free(in);
+    sstr_free(out);
+}
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+
+// ============================================================================
+// Merge patch: json_marshal_diff_<S> / json_apply_patch_<S>
+// ============================================================================
+
+// diff(old, new) applied onto a copy of old must give an object equal to new
+#define EXPECT_PATCH_ROUND_TRIP(S, old_text, new_text)                  \
+    do {                                                                \
+        struct S a_, b_;                                                \
+        S##_init(&a_);                                                  \
+        S##_init(&b_);                                                  \
+        sstr_t ta_ = sstr(old_text);                                    \
+        sstr_t tb_ = sstr(new_text);                                    \
+        ASSERT_EQ(json_unmarshal_##S(ta_, &a_), 0);                     \
+        ASSERT_EQ(json_unmarshal_##S(tb_, &b_), 0);                     \
+        sstr_t patch_ = sstr_new();                                     \
+        ASSERT_GE(json_marshal_diff_##S(&a_, &b_, patch_), 0);          \
+        ASSERT_EQ(json_apply_patch_##S(&a_, patch_), 0)                 \
+            << sstr_cstr(patch_);                                       \
+        EXPECT_EQ(json_marshal_diff_##S(&b_, &a_, NULL), 0)             \
+            << sstr_cstr(patch_);                                       \
+        sstr_t ma_ = sstr_new();                                        \
+        sstr_t mb_ = sstr_new();                                        \
+        json_marshal_##S(&a_, ma_);                                     \
+        json_marshal_##S(&b_, mb_);                                     \
+        EXPECT_STREQ(sstr_cstr(ma_), sstr_cstr(mb_));                   \
+        sstr_free(ma_);                                                 \
+        sstr_free(mb_);                                                 \
+        sstr_free(patch_);                                              \
+        sstr_free(ta_);                                                 \
+        sstr_free(tb_);                                                 \
+        S##_clear(&a_);                                                 \
+        S##_clear(&b_);                                                 \
+    } while (0)
+
+TEST(MergePatch, EqualObjectsGiveEmptyPatch) {
+    struct ComplexStruct a, b;
+    ComplexStruct_init(&a);
+    ComplexStruct_init(&b);
+    sstr_t in = sstr("{\"simple_int\":1,\"simple_string\":\"x\","
+                     "\"int_array\":[1,2],\"contacts\":[{\"name\":\"p\",\"age\":\"1\"}]}");
+    ASSERT_EQ(json_unmarshal_ComplexStruct(in, &a), 0);
+    ASSERT_EQ(json_unmarshal_ComplexStruct(in, &b), 0);
+
+    sstr_t out = sstr_new();
+    EXPECT_EQ(json_marshal_diff_ComplexStruct(&a, &b, out), 0);
+    EXPECT_STREQ(sstr_cstr(out), "{}");
+    EXPECT_EQ(json_marshal_diff_ComplexStruct(&a, &b, NULL), 0);
+    EXPECT_EQ(json_marshal_diff_ComplexStruct(NULL, &b, out), -1);
+
+    // a NULL string and "" marshal the same, so they are not a change
+    struct Person p, q;
+    Person_init(&p);
+    Person_init(&q);
+    q.name = sstr("");
+    EXPECT_EQ(json_marshal_diff_Person(&p, &q, NULL), 0);
+
+    Person_clear(&p);
+    Person_clear(&q);
+    sstr_free(out);
+    sstr_free(in);
+    ComplexStruct_clear(&a);
+    ComplexStruct_clear(&b);
+}
+
+TEST(MergePatch, DiffContainsOnlyChangedFields) {
+    struct AliasNested a, b;
+    AliasNested_init(&a);
+    AliasNested_init(&b);
+    a.info.name = sstr("ann");
+    a.info.age = sstr("7");
+    a.addr.street = sstr("main");
+    b.info.name = sstr("ann");
+    b.info.age = sstr("8");
+    b.addr.street = sstr("main");
+
+    sstr_t out = sstr_new();
+    EXPECT_EQ(json_marshal_diff_AliasNested(&a, &b, out), 1);
+    EXPECT_STREQ(sstr_cstr(out), "{\"user_info\":{\"age\":\"8\"}}");
+
+    sstr_free(out);
+    AliasNested_clear(&a);
+    AliasNested_clear(&b);
+}
+
+TEST(MergePatch, UnsetOptionalFieldBecomesNull) {
+    struct NullableNestedStruct a, b;
+    NullableNestedStruct_init(&a);
+    NullableNestedStruct_init(&b);
+    sstr_t ta = sstr("{\"id\":1,\"person\":{\"name\":\"a\",\"age\":\"2\"},"
+                     "\"color\":\"RED\",\"status\":\"ACTIVE\"}");
+    sstr_t tb = sstr("{\"id\":1,\"person\":null,\"status\":\"ACTIVE\"}");
+    ASSERT_EQ(json_unmarshal_NullableNestedStruct(ta, &a), 0);
+    ASSERT_EQ(json_unmarshal_NullableNestedStruct(tb, &b), 0);
+
+    sstr_t out = sstr_new();
+    EXPECT_EQ(json_marshal_diff_NullableNestedStruct(&a, &b, out), 2);
+    EXPECT_STREQ(sstr_cstr(out), "{\"person\":null,\"color\":null}");
+
+    ASSERT_EQ(json_apply_patch_NullableNestedStruct(&a, out), 0);
+    EXPECT_FALSE(a.has_person);
+    EXPECT_FALSE(a.has_color);
+    EXPECT_TRUE(a.has_status);
+    EXPECT_EQ(a.id, 1);
+
+    sstr_free(out);
+    sstr_free(ta);
+    sstr_free(tb);
+    NullableNestedStruct_clear(&a);
+    NullableNestedStruct_clear(&b);
+}
+
+TEST(MergePatch, ApplyMergesNestedObjects) {
+    struct AliasNested obj;
+    AliasNested_init(&obj);
+    obj.info.name = sstr("ann");
+    obj.info.age = sstr("7");
+    obj.addr.number = sstr("12");
+
+    sstr_t patch = sstr("{\"user_info\":{\"age\":\"8\"},\"unknown\":[1,{}]}");
+    ASSERT_EQ(json_apply_patch_AliasNested(&obj, patch), 0);
+    EXPECT_STREQ(sstr_cstr(obj.info.name), "ann");
+    EXPECT_STREQ(sstr_cstr(obj.info.age), "8");
+    EXPECT_STREQ(sstr_cstr(obj.addr.number), "12");
+
+    sstr_free(patch);
+    AliasNested_clear(&obj);
+}
+
+TEST(MergePatch, ApplyReplacesArraysAndRejectsRemovingRequiredFields) {
+    struct ComplexStruct obj;
+    ComplexStruct_init(&obj);
+    sstr_t in = sstr("{\"simple_int\":1,\"int_array\":[1,2,3]}");
+    ASSERT_EQ(json_unmarshal_ComplexStruct(in, &obj), 0);
+
+    sstr_t patch = sstr("{\"int_array\":[9]}");
+    ASSERT_EQ(json_apply_patch_ComplexStruct(&obj, patch), 0);
+    ASSERT_EQ(obj.int_array_len, 1);
+    EXPECT_EQ(obj.int_array[0], 9);
+    EXPECT_EQ(obj.simple_int, 1);
+
+    sstr_t bad = sstr("{\"simple_int\":null}");
+    EXPECT_LT(json_apply_patch_ComplexStruct(&obj, bad), 0);
+    EXPECT_EQ(obj.simple_int, 1);
+
+    sstr_free(bad);
+    sstr_free(patch);
+    sstr_free(in);
+    ComplexStruct_clear(&obj);
+}
+
+TEST(MergePatch, DiffThenApplyRoundTrips) {
+    EXPECT_PATCH_ROUND_TRIP(ComplexStruct,
+        "{\"simple_int\":1,\"simple_string\":\"a\",\"int_array\":[1],"
+        "\"string_array\":[\"x\"],\"address\":{\"number\":\"1\",\"street\":\"s\"},"
+        "\"contacts\":[{\"name\":\"p\",\"age\":\"1\"}]}",
+        "{\"simple_int\":2,\"simple_string\":\"b\",\"int_array\":[1,2],"
+        "\"string_array\":[\"y\"],\"address\":{\"number\":\"1\",\"street\":\"t\"},"
+        "\"contacts\":[{\"name\":\"p\",\"age\":\"2\"}]}");
+    EXPECT_PATCH_ROUND_TRIP(OptionalOnlyStruct,
+        "{\"id\":1,\"name\":\"n\",\"score\":3}",
+        "{\"id\":1,\"score\":4,\"active\":true}");
+    EXPECT_PATCH_ROUND_TRIP(NullableNestedStruct,
+        "{\"id\":1,\"person\":null}",
+        "{\"id\":1,\"person\":{\"name\":\"x\",\"age\":\"3\"},\"color\":\"BLUE\"}");
+    EXPECT_PATCH_ROUND_TRIP(MapAllTypesStruct,
+        "{\"int_map\":{\"a\":1},\"str_map\":{\"k\":\"v\"}}",
+        "{\"int_map\":{\"a\":1,\"b\":2},\"str_map\":{\"k\":\"v\"},"
+        "\"struct_map\":{\"p\":{\"name\":\"n\",\"age\":\"5\"}}}");
+    EXPECT_PATCH_ROUND_TRIP(FixedArrayStruct, "{}",
+        "{\"fixed_ints\":[1,2,3,4,5]}");
+    EXPECT_PATCH_ROUND_TRIP(Drawing,
+        "{\"name\":\"d\",\"shape\":{\"type\":\"circle\",\"radius\":1.5},\"shapes\":[]}",
+        "{\"name\":\"d\",\"shape\":{\"type\":\"rectangle\",\"width\":1,\"height\":2},"
+        "\"shapes\":[{\"type\":\"circle\",\"radius\":2}]}");
+}
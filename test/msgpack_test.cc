@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <cmath>
 #include <cstring>
+#include <string>
 
 extern "C" {
 #include "msgpack.gen.h"
@@ -87,6 +88,20 @@ TEST(MsgpackScalar, NegativeValues) {
     ROUNDTRIP_CLEANUP(Scalar);
 }
 
+TEST(MsgpackScalar, DecodeIntoClearedLongString) {
+    ROUNDTRIP_INIT(Scalar);
+    sstr_append_cstr(src.s, "short");
+    // sstr_clear() leaves a long string without a buffer
+    sstr_append_cstr(dst.s, "a value longer than the short string capacity");
+    sstr_clear(dst.s);
+
+    ROUNDTRIP_PACK_UNPACK(Scalar);
+
+    EXPECT_STREQ(sstr_cstr(dst.s), "short");
+
+    ROUNDTRIP_CLEANUP(Scalar);
+}
+
 /* ═══════════════════════════════════════════════════════════════════════
  * Nested structs
  * ═══════════════════════════════════════════════════════════════════════ */
@@ -339,6 +354,264 @@ TEST(MsgpackPrecise, AllWidths) {
     ROUNDTRIP_CLEANUP(WithPrecise);
 }
 
+/* WithPrecise is wide enough for the key-length switch: keys sharing a
+ * length, keys out of order and unknown keys of a known length. */
+TEST(MsgpackPrecise, KeysOutOfOrderAndUnknown) {
+    const unsigned char in[] = {
+        0x85,
+        0xa3, 'u', '6', '4', 0x07,
+        0xa2, 'i', '9', 0x01,
+        0xa2, 'i', '8', 0xfd,
+        0xa4, 'z', 'z', 'z', 'z', 0x92, 0x01, 0x02,
+        0xa3, 'u', '1', '6', 0xcd, 0x01, 0x2c,
+    };
+    struct WithPrecise dst;
+    WithPrecise_init(&dst);
+    ASSERT_EQ(0, msgpack_unpack_WithPrecise(in, sizeof(in), &dst));
+    EXPECT_EQ(dst.u64, 7u);
+    EXPECT_EQ(dst.i8, -3);
+    EXPECT_EQ(dst.u16, 300);
+    EXPECT_EQ(dst.i16, 0);
+    EXPECT_EQ(dst.u8, 0);
+    WithPrecise_clear(&dst);
+}
+
+/* ═══════════════════════════════════════════════════════════════════════
+ * Stream framing
+ * ═══════════════════════════════════════════════════════════════════════ */
+
+TEST(MsgpackFrame, SplitStreamByteByByte) {
+    sstr_t stream = sstr_new();
+    for (int i = 0; i < 3; i++) {
+        struct Nested n;
+        Nested_init(&n);
+        n.id = i;
+        sstr_append_cstr(n.name, i == 1 ? "a name long enough to need str8" : "x");
+        n.inner.d = 0.25 * i;
+        ASSERT_EQ(0, msgpack_pack_Nested(&n, stream));
+        Nested_clear(&n);
+    }
+
+    // bytes arrive one at a time; each complete message is decoded once
+    const unsigned char* in = (const unsigned char*)sstr_cstr(stream);
+    size_t total = sstr_length(stream), start = 0;
+    struct msgpack_frame fr = {0, 0};
+    int decoded = 0;
+    for (size_t end = 1; end <= total; end++) {
+        size_t msg_len = 0;
+        int rc = msgpack_frame_next(&fr, in + start, end - start, &msg_len);
+        ASSERT_GE(rc, 0);
+        if (rc == 0) {
+            EXPECT_LE(fr.pos + fr.pending, total - start);
+            continue;
+        }
+        struct Nested n;
+        Nested_init(&n);
+        ASSERT_EQ(0, msgpack_unpack_Nested(in + start, msg_len, &n));
+        EXPECT_EQ(n.id, decoded);
+        EXPECT_DOUBLE_EQ(n.inner.d, 0.25 * decoded);
+        Nested_clear(&n);
+        decoded++;
+        start += msg_len;
+    }
+    EXPECT_EQ(decoded, 3);
+    EXPECT_EQ(start, total);
+    sstr_free(stream);
+}
+
+TEST(MsgpackFrame, MessageLength) {
+    ROUNDTRIP_INIT(WithMap);
+    src.labels.len = 1;
+    src.labels.entries = (struct map_entry_sstr_t *)calloc(1, sizeof(struct map_entry_sstr_t));
+    src.labels.entries[0].key = sstr_of("k", 1);
+    src.labels.entries[0].value = sstr_of("v", 1);
+    ASSERT_EQ(0, msgpack_pack_WithMap(&src, buf));
+    sstr_append_cstr(buf, "trailing");
+
+    const unsigned char* in = (const unsigned char*)sstr_cstr(buf);
+    size_t n = sstr_length(buf) - 8, got = 0;
+    EXPECT_EQ(1, msgpack_message_length(in, sstr_length(buf), &got));
+    EXPECT_EQ(got, n);
+    for (size_t i = 0; i < n; i++) {
+        EXPECT_EQ(0, msgpack_message_length(in, i, &got)) << i;
+    }
+    const unsigned char bad[] = {0xc1, 0x01};
+    EXPECT_EQ(-1, msgpack_message_length(bad, sizeof(bad), &got));
+    ROUNDTRIP_CLEANUP(WithMap);
+}
+
+TEST(MsgpackFrame, DeepNestingUsesNoStack) {
+    std::string deep(200000, (char)0x91);
+    deep.push_back(0x01);
+    size_t got = 0;
+    EXPECT_EQ(1, msgpack_message_length((const unsigned char*)deep.data(),
+                                      deep.size(), &got));
+    EXPECT_EQ(got, deep.size());
+}
+
+/* ═══════════════════════════════════════════════════════════════════════
+ * Borrowed strings (_borrow)
+ * ═══════════════════════════════════════════════════════════════════════ */
+
+static bool points_into(sstr_t s, sstr_t buf) {
+    const char* p = sstr_cstr(s);
+    return p >= sstr_cstr(buf) && p + sstr_length(s) <= sstr_cstr(buf) + sstr_length(buf);
+}
+
+TEST(MsgpackBorrow, StringsPointIntoInput) {
+    ROUNDTRIP_INIT(WithArrays);
+    src.dyn_strings_len = 2;
+    src.dyn_strings = (sstr_t *)calloc(2, sizeof(sstr_t));
+    src.dyn_strings[0] = sstr_of("alpha", 5);
+    src.dyn_strings[1] = sstr("a string too long for the short form");
+    ASSERT_EQ(0, msgpack_pack_WithArrays(&src, buf));
+    ASSERT_EQ(0, msgpack_unpack_WithArrays_borrow(
+        (const unsigned char *)sstr_cstr(buf), sstr_length(buf), &dst));
+
+    ASSERT_EQ(dst.dyn_strings_len, 2);
+    EXPECT_TRUE(points_into(dst.dyn_strings[0], buf));
+    EXPECT_TRUE(points_into(dst.dyn_strings[1], buf));
+    EXPECT_EQ(std::string(sstr_cstr(dst.dyn_strings[1]), sstr_length(dst.dyn_strings[1])),
+              "a string too long for the short form");
+    ROUNDTRIP_CLEANUP(WithArrays);
+}
+
+TEST(MsgpackBorrow, MapKeysAndValues) {
+    ROUNDTRIP_INIT(WithMap);
+    src.labels.len = 1;
+    src.labels.entries = (struct map_entry_sstr_t *)calloc(1, sizeof(struct map_entry_sstr_t));
+    src.labels.entries[0].key = sstr_of("env", 3);
+    src.labels.entries[0].value = sstr_of("prod", 4);
+    ASSERT_EQ(0, msgpack_pack_WithMap(&src, buf));
+    ASSERT_EQ(0, msgpack_unpack_WithMap_borrow(
+        (const unsigned char *)sstr_cstr(buf), sstr_length(buf), &dst));
+
+    ASSERT_EQ(dst.labels.len, 1);
+    EXPECT_TRUE(points_into(dst.labels.entries[0].key, buf));
+    EXPECT_TRUE(points_into(dst.labels.entries[0].value, buf));
+    EXPECT_EQ(sstr_length(dst.labels.entries[0].value), 4u);
+    ROUNDTRIP_CLEANUP(WithMap);
+}
+
+TEST(MsgpackBorrow, DecodeAgainAfterBorrow) {
+    ROUNDTRIP_INIT(Nested);
+    sstr_append_cstr(src.name, "outer");
+    sstr_append_cstr(src.inner.s, "inner");
+    ASSERT_EQ(0, msgpack_pack_Nested(&src, buf));
+    sstr_t copy = sstr_dup(buf);
+
+    // nested structs borrow too
+    ASSERT_EQ(0, msgpack_unpack_Nested_borrow(
+        (const unsigned char *)sstr_cstr(copy), sstr_length(copy), &dst));
+    EXPECT_TRUE(points_into(dst.name, copy));
+    EXPECT_TRUE(points_into(dst.inner.s, copy));
+
+    // a copying decode into the same object owns its strings again
+    ASSERT_EQ(0, msgpack_unpack_Nested(
+        (const unsigned char *)sstr_cstr(buf), sstr_length(buf), &dst));
+    sstr_free(copy);
+    EXPECT_STREQ(sstr_cstr(dst.name), "outer");
+    EXPECT_STREQ(sstr_cstr(dst.inner.s), "inner");
+    sstr_append_cstr(dst.name, "!");
+    EXPECT_STREQ(sstr_cstr(dst.name), "outer!");
+    ROUNDTRIP_CLEANUP(Nested);
+}
+
+/* ═══════════════════════════════════════════════════════════════════════
+ * @compact structs (positional array)
+ * ═══════════════════════════════════════════════════════════════════════ */
+
+TEST(MsgpackCompact, RoundTrip) {
+    ROUNDTRIP_INIT(Metric);
+    src.id = 9;
+    sstr_append_cstr(src.name, "cpu");
+    src.value = 0.5;
+    src.has_value = 1;
+    sstr_append_cstr(src.unit, "pct");
+    src.has_unit = 1;
+    src.samples_len = 3;
+    src.samples = (int *)calloc(3, sizeof(int));
+    src.samples[0] = 3;
+    src.samples[1] = 4;
+    src.samples[2] = 5;
+    src.origin.i = -1;
+
+    ROUNDTRIP_PACK_UNPACK(Metric);
+    EXPECT_EQ((unsigned char)sstr_cstr(buf)[0], 0x96);
+    EXPECT_EQ(strstr(sstr_cstr(buf), "name"), nullptr);
+
+    EXPECT_EQ(dst.id, 9);
+    EXPECT_STREQ(sstr_cstr(dst.name), "cpu");
+    EXPECT_EQ(dst.has_value, 1);
+    EXPECT_DOUBLE_EQ(dst.value, 0.5);
+    EXPECT_EQ(dst.has_unit, 1);
+    EXPECT_STREQ(sstr_cstr(dst.unit), "pct");
+    ASSERT_EQ(dst.samples_len, 3);
+    EXPECT_EQ(dst.samples[2], 5);
+    EXPECT_EQ(dst.origin.i, -1);
+
+    ROUNDTRIP_CLEANUP(Metric);
+}
+
+TEST(MsgpackCompact, AbsentFieldsKeepTheirSlot) {
+    ROUNDTRIP_INIT(Metric);
+    src.id = 1;
+    ROUNDTRIP_PACK_UNPACK(Metric);
+    EXPECT_EQ((unsigned char)sstr_cstr(buf)[0], 0x96);
+    EXPECT_EQ(dst.id, 1);
+    EXPECT_EQ(dst.has_value, 0);
+    EXPECT_EQ(dst.has_unit, 0);
+    ROUNDTRIP_CLEANUP(Metric);
+}
+
+TEST(MsgpackCompact, ShortAndLongArrays) {
+    /* An older writer sent two fields; the rest keep their defaults. */
+    const unsigned char short_in[] = {0x92, 0x07, 0xa1, 'a',};
+    struct Metric dst;
+    Metric_init(&dst);
+    ASSERT_EQ(0, msgpack_unpack_Metric(short_in, sizeof(short_in), &dst));
+    EXPECT_EQ(dst.id, 7);
+    EXPECT_STREQ(sstr_cstr(dst.name), "a");
+    EXPECT_EQ(dst.has_value, 0);
+    EXPECT_EQ(dst.samples_len, 0);
+    Metric_clear(&dst);
+
+    /* A newer writer appended a field; it is skipped. */
+    const unsigned char long_in[] = {0x97, 0x01, 0xa1, 'n', 0xc0, 0xc0, 0x90, 0x80, 0x2a,};
+    Metric_init(&dst);
+    ASSERT_EQ(0, msgpack_unpack_Metric(long_in, sizeof(long_in), &dst));
+    EXPECT_EQ(dst.id, 1);
+    EXPECT_STREQ(sstr_cstr(dst.name), "n");
+    EXPECT_EQ(dst.has_value, 0);
+    EXPECT_EQ(dst.has_unit, 0);
+    Metric_clear(&dst);
+}
+
+TEST(MsgpackCompact, BadTrailingElementFails) {
+    /* Declares a seventh element that never arrives. */
+    const unsigned char truncated[] = {0x97, 0x01, 0xa1, 'n', 0xc0, 0xc0, 0x90, 0x80,};
+    struct Metric dst;
+    Metric_init(&dst);
+    EXPECT_EQ(-1, msgpack_unpack_Metric(truncated, sizeof(truncated), &dst));
+    Metric_clear(&dst);
+
+    /* The seventh element is not a valid item. */
+    const unsigned char garbage[] = {0x97, 0x01, 0xa1, 'n', 0xc0, 0xc0, 0x90, 0x80, 0xc1,};
+    Metric_init(&dst);
+    EXPECT_EQ(-1, msgpack_unpack_Metric(garbage, sizeof(garbage), &dst));
+    Metric_clear(&dst);
+}
+
+TEST(MsgpackCompact, KeyedMapStillAccepted) {
+    const unsigned char in[] = {0x82, 0xa2, 'i', 'd', 0x05, 0xa4, 'n', 'a', 'm', 'e', 0xa1, 'x',};
+    struct Metric dst;
+    Metric_init(&dst);
+    ASSERT_EQ(0, msgpack_unpack_Metric(in, sizeof(in), &dst));
+    EXPECT_EQ(dst.id, 5);
+    EXPECT_STREQ(sstr_cstr(dst.name), "x");
+    Metric_clear(&dst);
+}
+
 /* ═══════════════════════════════════════════════════════════════════════
  * Field aliases (@json)
  * ═══════════════════════════════════════════════════════════════════════ */
@@ -563,3 +836,92 @@ TEST(MsgpackEdge, InvalidData) {
 
     Scalar_clear(&s);
 }
+
+TEST(MsgpackEdge, InlineStrRoundTrip) {
+    ROUNDTRIP_INIT(InlineStr);
+    EXPECT_STREQ(sstr_cstr(src.unit), "kg");
+    sstr_append_cstr(src.code, "AB-12");
+    for (int j = 0; j < 10; j++) {
+        sstr_append_cstr(src.alias, "0123456789");
+    }
+    src.has_alias = true;
+
+    ROUNDTRIP_PACK_UNPACK(InlineStr);
+
+    EXPECT_STREQ(sstr_cstr(dst.code), "AB-12");
+    EXPECT_EQ(dst.code->type, SSTR_TYPE_SHORT);
+    EXPECT_TRUE(dst.has_alias);
+    EXPECT_EQ(sstr_length(dst.alias), (size_t)100);
+    EXPECT_STREQ(sstr_cstr(dst.unit), "kg");
+
+    ROUNDTRIP_CLEANUP(InlineStr);
+}
+
+TEST(MsgpackEdge, FixStrRoundTripAndLimit) {
+    ROUNDTRIP_INIT(FixStr);
+    EXPECT_STREQ(src.unit, "USD");
+    memcpy(src.code, "AB\"12", 6);
+    src.code_len = 5;
+    src.has_alias = true;
+    memcpy(src.alias, "de", 3);
+    src.alias_len = 2;
+
+    ROUNDTRIP_PACK_UNPACK(FixStr);
+
+    EXPECT_STREQ(dst.code, "AB\"12");
+    EXPECT_EQ(dst.code_len, 5);
+    EXPECT_TRUE(dst.has_alias);
+    EXPECT_STREQ(dst.alias, "de");
+    EXPECT_STREQ(dst.unit, "USD");
+    EXPECT_EQ(dst.unit_len, 3);
+
+    /* "code" is an @inline_str in InlineStr: 9 bytes do not fit str<8> */
+    struct InlineStr wide;
+    InlineStr_init(&wide);
+    sstr_append_cstr(wide.code, "123456789");
+    sstr_clear(buf);
+    ASSERT_EQ(0, msgpack_pack_InlineStr(&wide, buf));
+    EXPECT_NE(0, msgpack_unpack_FixStr(
+        (const unsigned char *)sstr_cstr(buf), sstr_length(buf), &dst));
+    InlineStr_clear(&wide);
+
+    ROUNDTRIP_CLEANUP(FixStr);
+}
+
+static void *arena_malloc(void *ud, size_t sz) {
+    ++*(long *)ud;
+    return malloc(sz);
+}
+static void *arena_realloc(void *ud, void *p, size_t sz) {
+    if (p == NULL) ++*(long *)ud;
+    return realloc(p, sz);
+}
+static void arena_free(void *ud, void *p) {
+    if (p != NULL) --*(long *)ud;
+    free(p);
+}
+
+TEST(MsgpackEdge, UnpackExUsesGivenAllocator) {
+    long live = 0;  /* blocks allocated through alloc and not freed */
+    struct jgenc_allocator alloc = {&live, arena_malloc, arena_realloc,
+                                    arena_free};
+    ROUNDTRIP_INIT(Nested);
+    src.id = 7;
+    sstr_append_cstr(src.name, "a name that does not fit a short sstr");
+    sstr_append_cstr(src.inner.s, "inner");
+    ASSERT_EQ(0, msgpack_pack_Nested(&src, buf));
+
+    struct Nested out;
+    ASSERT_EQ(0, Nested_init_ex(&out, &alloc));
+    ASSERT_EQ(0, msgpack_unpack_Nested_ex(
+        (const unsigned char *)sstr_cstr(buf), sstr_length(buf), &out, &alloc));
+    EXPECT_EQ(out.id, 7);
+    EXPECT_STREQ(sstr_cstr(out.name), "a name that does not fit a short sstr");
+    EXPECT_STREQ(sstr_cstr(out.inner.s), "inner");
+    EXPECT_GT(live, 0);
+    EXPECT_EQ(jgenc_thread_allocator(), nullptr);
+
+    Nested_clear_ex(&out, &alloc);
+    EXPECT_EQ(live, 0);
+    ROUNDTRIP_CLEANUP(Nested);
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+
+// ==========================================================================
+// json_marshal_array_parallel_<S>()
+// ==========================================================================
+
+TEST(ParallelMarshal, MatchesSequentialArray) {
+    const int counts[] = {0, 1, 255, 256, 1000, 5003};
+    for (int n : counts) {
+        struct Person* people = new struct Person[(size_t)(n ? n : 1)];
+        for (int i = 0; i < n; i++) {
+            Person_init(&people[i]);
+            people[i].name = sstr_printf("p\"%d", i);
+            people[i].age = sstr_printf("%d", i % 90);
+        }
+        sstr_t seq = sstr_new();
+        ASSERT_EQ(json_marshal_array_Person(people, n, seq), 0);
+        for (int threads : {1, 3, 0}) {
+            sstr_t par = sstr_new();
+            ASSERT_EQ(json_marshal_array_parallel_Person(people, n, threads, par),
+                      0);
+            EXPECT_STREQ(sstr_cstr(par), sstr_cstr(seq))
+                << "n=" << n << " threads=" << threads;
+            sstr_free(par);
+        }
+        sstr_free(seq);
+        for (int i = 0; i < n; i++) {
+            Person_clear(&people[i]);
+        }
+        delete[] people;
+    }
+}
+
+TEST(ParallelMarshal, AppendsToExistingOutputAndRoundTrips) {
+    const int n = 2000;
+    struct Person* people = new struct Person[n];
+    for (int i = 0; i < n; i++) {
+        Person_init(&people[i]);
+        people[i].name = sstr_printf("name%d", i);
+        people[i].age = sstr_printf("%d", i);
+    }
+    sstr_t out = sstr("x=");
+    ASSERT_EQ(json_marshal_array_parallel_Person(people, n, 4, out), 0);
+    EXPECT_EQ(std::string(sstr_cstr(out), 3), "x=[");
+
+    sstr_t json = sstr_substr(out, 2, sstr_length(out) - 2);
+    struct Person* back = NULL;
+    int back_len = 0;
+    ASSERT_EQ(json_unmarshal_array_Person(json, &back, &back_len), 0);
+    ASSERT_EQ(back_len, n);
+    EXPECT_STREQ(sstr_cstr(back[n - 1].name), "name1999");
+
+    for (int i = 0; i < back_len; i++) {
+        Person_clear(&back[i]);
+    }
+    free(back);
+    for (int i = 0; i < n; i++) {
+        Person_clear(&people[i]);
+    }
+    delete[] people;
+    sstr_free(json);
+    sstr_free(out);
+}
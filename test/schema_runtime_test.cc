@@ -0,0 +1,619 @@
+/**
+ * @file schema_runtime_test.cc
+ * @brief Tests for the schema interpreter: its layout and wire output must
+ *        match the code generated from the same schema.
+ */
+
+#include <gtest/gtest.h>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "json.gen.h"
+#include "schema/schema_runtime.h"
+#include "utils/error_codes.h"
+}
+
+// The structs of test.json-gen-c that the interpreter supports.
+static const char kSchema[] = R"(
+enum Color { RED, GREEN, BLUE }
+enum Status { ACTIVE, INACTIVE, PENDING }
+
+struct TestStruct {
+    int int_val;
+    long long_val;
+    float float_val;
+    double double_val;
+    bool bool_val;
+    sstr_t sstr_val;
+}
+
+struct House {
+    sstr_t number;
+    sstr_t street;
+}
+
+struct Person {
+    sstr_t name;
+    sstr_t age;
+}
+
+struct ComplexStruct {
+    int simple_int;
+    long simple_long;
+    float simple_float;
+    double simple_double;
+    bool simple_bool;
+    sstr_t simple_string;
+    int int_array[];
+    long long_array[];
+    float float_array[];
+    double double_array[];
+    sstr_t string_array[];
+    House address;
+    Person contacts[];
+}
+
+struct FixedArrayStruct {
+    int fixed_ints[5];
+    long fixed_longs[3];
+    float fixed_floats[4];
+    double fixed_doubles[3];
+    sstr_t fixed_strings[3];
+    bool fixed_bools[2];
+    Color fixed_colors[3];
+    Person fixed_contacts[2];
+}
+
+struct NullableNestedStruct {
+    int id;
+    nullable Person person;
+    optional Color color;
+    optional nullable Status status;
+}
+
+struct PreciseInts {
+    int8_t i8;
+    int16_t i16;
+    int32_t i32;
+    int64_t i64;
+    uint8_t u8;
+    uint16_t u16;
+    uint32_t u32;
+    uint64_t u64;
+}
+
+struct AliasBasic {
+    @json "user_name"
+    sstr_t username;
+    @json "created_at"
+    long created;
+    int id;
+}
+
+struct DefaultBasic {
+    int count = 42;
+    long big = 1000000;
+    float ratio = 3.14;
+    double precise = 2.718281828;
+    bool active = true;
+    sstr_t label = "hello";
+    int no_default;
+}
+
+struct DefaultEnum {
+    Color color = GREEN;
+    Status status = PENDING;
+}
+)";
+
+class SchemaRuntimeTest : public ::testing::Test {
+protected:
+    struct jgenc_schema* schema = nullptr;
+
+    void SetUp() override {
+        schema = jgenc_schema_compile(kSchema, sizeof(kSchema) - 1);
+        ASSERT_NE(nullptr, schema);
+    }
+    void TearDown() override { jgenc_schema_free(schema); }
+
+    const struct jgenc_schema_type* type(const char* name) {
+        const struct jgenc_schema_type* t = jgenc_schema_find_type(schema, name);
+        EXPECT_NE(nullptr, t) << name;
+        return t;
+    }
+};
+
+#define EXPECT_FIELD_AT(t, S, f) \
+    EXPECT_EQ((long)offsetof(struct S, f), jgenc_schema_field_offset(t, #f))
+
+TEST_F(SchemaRuntimeTest, LayoutMatchesGeneratedStructs) {
+    const struct jgenc_schema_type* t = type("ComplexStruct");
+    EXPECT_EQ(sizeof(struct ComplexStruct), jgenc_schema_type_size(t));
+    EXPECT_EQ(alignof(struct ComplexStruct), jgenc_schema_type_align(t));
+    EXPECT_FIELD_AT(t, ComplexStruct, simple_bool);
+    EXPECT_FIELD_AT(t, ComplexStruct, simple_string);
+    EXPECT_FIELD_AT(t, ComplexStruct, double_array);
+    EXPECT_FIELD_AT(t, ComplexStruct, address);
+    EXPECT_FIELD_AT(t, ComplexStruct, contacts);
+    EXPECT_EQ(-1, jgenc_schema_field_offset(t, "missing"));
+
+    t = type("FixedArrayStruct");
+    EXPECT_EQ(sizeof(struct FixedArrayStruct), jgenc_schema_type_size(t));
+    EXPECT_FIELD_AT(t, FixedArrayStruct, fixed_strings);
+    EXPECT_FIELD_AT(t, FixedArrayStruct, fixed_contacts);
+
+    t = type("NullableNestedStruct");
+    EXPECT_EQ(sizeof(struct NullableNestedStruct), jgenc_schema_type_size(t));
+    EXPECT_FIELD_AT(t, NullableNestedStruct, person);
+    EXPECT_FIELD_AT(t, NullableNestedStruct, status);
+
+    t = type("PreciseInts");
+    EXPECT_EQ(sizeof(struct PreciseInts), jgenc_schema_type_size(t));
+    EXPECT_FIELD_AT(t, PreciseInts, u8);
+    EXPECT_FIELD_AT(t, PreciseInts, u64);
+
+    EXPECT_EQ(nullptr, jgenc_schema_find_type(schema, "NoSuchStruct"));
+}
+
+TEST_F(SchemaRuntimeTest, InitAppliesDefaults) {
+    struct DefaultBasic want, got;
+    DefaultBasic_init(&want);
+    ASSERT_EQ(0, jgenc_schema_init(type("DefaultBasic"), &got));
+    EXPECT_EQ(want.count, got.count);
+    EXPECT_EQ(want.big, got.big);
+    EXPECT_FLOAT_EQ(want.ratio, got.ratio);
+    EXPECT_DOUBLE_EQ(want.precise, got.precise);
+    EXPECT_EQ(want.active, got.active);
+    EXPECT_STREQ("hello", sstr_cstr(got.label));
+    EXPECT_EQ(0, got.no_default);
+    DefaultBasic_clear(&want);
+    jgenc_schema_clear(type("DefaultBasic"), &got);
+
+    struct DefaultEnum e;
+    jgenc_schema_init(type("DefaultEnum"), &e);
+    EXPECT_EQ(Color_GREEN, e.color);
+    EXPECT_EQ(Status_PENDING, e.status);
+}
+
+TEST_F(SchemaRuntimeTest, JsonMatchesGeneratedCode) {
+    const struct jgenc_schema_type* t = type("ComplexStruct");
+    sstr_t in = sstr(
+        "{\"simple_int\":-7,\"simple_long\":1234567890123,"
+        "\"simple_float\":1.5,\"simple_double\":-2.25e3,"
+        "\"simple_bool\":true,\"simple_string\":\"tab\\there \\u00e9\","
+        "\"int_array\":[1,2,3],\"long_array\":[],\"float_array\":[0.5],"
+        "\"double_array\":[1e-3,2],\"string_array\":[\"a\",\"\\\"b\\\"\"],"
+        "\"unknown\":{\"x\":[1,{\"y\":null}]},"
+        "\"address\":{\"number\":\"12\",\"street\":\"Main\"},"
+        "\"contacts\":[{\"name\":\"Ann\",\"age\":\"30\"},"
+        "{\"age\":\"41\",\"name\":\"Bob\"}]}");
+
+    struct ComplexStruct gen, interp;
+    ComplexStruct_init(&gen);
+    ASSERT_EQ(0, json_unmarshal_ComplexStruct(in, &gen));
+    jgenc_schema_init(t, &interp);
+    ASSERT_EQ(0, jgenc_schema_json_unmarshal(t, sstr_cstr(in),
+                                             sstr_length(in), &interp));
+
+    // objects decoded by either side are interchangeable
+    sstr_t a = sstr_new();
+    sstr_t b = sstr_new();
+    sstr_t c = sstr_new();
+    json_marshal_ComplexStruct(&gen, a);
+    jgenc_schema_json_marshal(t, &gen, b);
+    json_marshal_ComplexStruct(&interp, c);
+    EXPECT_STREQ(sstr_cstr(a), sstr_cstr(b));
+    EXPECT_STREQ(sstr_cstr(a), sstr_cstr(c));
+    EXPECT_EQ(2, interp.contacts_len);
+    EXPECT_STREQ("Bob", sstr_cstr(interp.contacts[1].name));
+
+    sstr_free(a);
+    sstr_free(b);
+    sstr_free(c);
+    sstr_free(in);
+    ComplexStruct_clear(&gen);
+    jgenc_schema_clear(t, &interp);
+}
+
+TEST_F(SchemaRuntimeTest, JsonNullableAliasAndEnums) {
+    const struct jgenc_schema_type* t = type("NullableNestedStruct");
+    struct NullableNestedStruct o;
+    const char* in = "{\"id\":3,\"person\":null,\"status\":\"INACTIVE\"}";
+    jgenc_schema_init(t, &o);
+    ASSERT_EQ(0, jgenc_schema_json_unmarshal(t, in, strlen(in), &o));
+    EXPECT_FALSE(o.has_person);
+    EXPECT_FALSE(o.has_color);
+    EXPECT_TRUE(o.has_status);
+    EXPECT_EQ(Status_INACTIVE, o.status);
+
+    sstr_t gen = sstr_new();
+    sstr_t interp = sstr_new();
+    json_marshal_NullableNestedStruct(&o, gen);
+    jgenc_schema_json_marshal(t, &o, interp);
+    EXPECT_STREQ(sstr_cstr(gen), sstr_cstr(interp));
+    jgenc_schema_clear(t, &o);
+
+    t = type("AliasBasic");
+    struct AliasBasic al;
+    in = "{\"user_name\":\"zl\",\"created_at\":99,\"id\":1}";
+    jgenc_schema_init(t, &al);
+    ASSERT_EQ(0, jgenc_schema_json_unmarshal(t, in, strlen(in), &al));
+    EXPECT_STREQ("zl", sstr_cstr(al.username));
+    EXPECT_EQ(99, al.created);
+    sstr_clear(interp);
+    jgenc_schema_json_marshal(t, &al, interp);
+    EXPECT_STREQ(in, sstr_cstr(interp));
+    jgenc_schema_clear(t, &al);
+
+    sstr_free(gen);
+    sstr_free(interp);
+}
+
+TEST_F(SchemaRuntimeTest, JsonRejectsMalformedInput) {
+    const struct jgenc_schema_type* t = type("TestStruct");
+    const char* bad[] = {
+        "", "{", "{\"int_val\":}", "{\"int_val\":1,}", "{\"sstr_val\":\"x}",
+        "{\"sstr_val\":\"\x01\"}", "[1]", "{\"bool_val\":yes}",
+    };
+    for (const char* in : bad) {
+        struct TestStruct o;
+        jgenc_schema_init(t, &o);
+        EXPECT_NE(0, jgenc_schema_json_unmarshal(t, in, strlen(in), &o)) << in;
+        jgenc_schema_clear(t, &o);
+    }
+
+    std::string deep(1000, '[');
+    deep = "{\"x\":" + deep;
+    struct TestStruct o;
+    jgenc_schema_init(t, &o);
+    EXPECT_NE(0, jgenc_schema_json_unmarshal(t, deep.data(), deep.size(), &o));
+    jgenc_schema_clear(t, &o);
+}
+
+// The generated functions of one struct, callable on untyped memory.
+struct GeneratedCodec {
+    const char* name;
+    size_t size;
+    int (*init)(void*);
+    int (*clear)(void*);
+    int (*unmarshal)(sstr_t, void*, const struct json_limits*,
+                     struct json_error*);
+    int (*marshal)(void*, sstr_t);
+};
+
+#define GENERATED_CODEC(S)                                                  \
+    GeneratedCodec {                                                        \
+        #S, sizeof(struct S),                                               \
+            [](void* o) { return S##_init((struct S*)o); },                 \
+            [](void* o) { return S##_clear((struct S*)o); },                \
+            [](sstr_t in, void* o, const struct json_limits* l,             \
+               struct json_error* e) {                                      \
+                return json_unmarshal_##S##_limited(in, (struct S*)o, l, e); \
+            },                                                              \
+            [](void* o, sstr_t out) {                                       \
+                return json_marshal_##S((struct S*)o, out);                 \
+            }                                                               \
+    }
+
+static const GeneratedCodec kCodecs[] = {
+    GENERATED_CODEC(TestStruct),
+    GENERATED_CODEC(PreciseInts),
+    GENERATED_CODEC(FixedArrayStruct),
+    GENERATED_CODEC(ComplexStruct),
+    GENERATED_CODEC(NullableNestedStruct),
+};
+
+// Decode `in` with the generated code and the interpreter: both must fail
+// with the same code, or both succeed and re-encode to the same JSON.
+static void ExpectSameDecode(const struct jgenc_schema_type* t,
+                             const char* struct_name, const char* in,
+                             const struct json_limits* limits = nullptr) {
+    const GeneratedCodec* gc = nullptr;
+    for (const GeneratedCodec& c : kCodecs) {
+        if (strcmp(c.name, struct_name) == 0) gc = &c;
+    }
+    ASSERT_NE(nullptr, gc) << struct_name;
+    std::vector<char> gen(gc->size), interp(gc->size);
+    struct json_error gen_err, interp_err;
+    sstr_t s = sstr(in);
+    gc->init(gen.data());
+    jgenc_schema_init(t, interp.data());
+    int gen_rc = gc->unmarshal(s, gen.data(), limits, &gen_err);
+    int interp_rc = jgenc_schema_json_unmarshal_limited(
+        t, in, strlen(in), interp.data(), limits, &interp_err);
+    EXPECT_EQ(gen_rc == 0, interp_rc == 0) << struct_name << " " << in;
+    EXPECT_EQ(gen_err.code, interp_err.code) << struct_name << " " << in;
+    if (gen_rc == 0 && interp_rc == 0) {
+        sstr_t a = sstr_new();
+        sstr_t b = sstr_new();
+        gc->marshal(gen.data(), a);
+        gc->marshal(interp.data(), b);
+        EXPECT_STREQ(sstr_cstr(a), sstr_cstr(b)) << struct_name << " " << in;
+        sstr_free(a);
+        sstr_free(b);
+    }
+    gc->clear(gen.data());
+    jgenc_schema_clear(t, interp.data());
+    sstr_free(s);
+}
+
+TEST_F(SchemaRuntimeTest, JsonDecodesLikeGeneratedCode) {
+    static const struct {
+        const char* type;
+        const char* in;
+    } cases[] = {
+        // rejected by both
+        {"TestStruct", "{\"int_val\":5000000000}"},
+        {"TestStruct", "{\"int_val\":1e300}"},
+        {"TestStruct", "{\"int_val\":1.5}"},
+        {"TestStruct", "{\"int_val\":1.}"},
+        {"TestStruct", "{\"int_val\":1e}"},
+        {"TestStruct", "{\"int_val\":\"1\"}"},
+        {"TestStruct", "{\"int_val\":null}"},
+        {"TestStruct", "{\"long_val\":99999999999999999999}"},
+        {"TestStruct", "{\"double_val\":1e}"},
+        {"TestStruct", "{\"double_val\":1e+}"},
+        {"TestStruct", "{\"double_val\":-}"},
+        {"TestStruct", "{\"double_val\":null}"},
+        {"TestStruct", "{\"bool_val\":null}"},
+        {"TestStruct", "{\"bool_val\":\"true\"}"},
+        {"TestStruct", "{\"sstr_val\":\"\\ud800\"}"},
+        {"TestStruct", "{\"sstr_val\":\"\\ud800x\"}"},
+        {"TestStruct", "{\"sstr_val\":\"\\udc00\"}"},
+        {"TestStruct", "{\"sstr_val\":\"\\ud800\\u0041\"}"},
+        {"TestStruct", "{\"sstr_val\":1}"},
+        {"TestStruct", "{\"int_val\":1,}"},
+        {"PreciseInts", "{\"i8\":128}"},
+        {"PreciseInts", "{\"i8\":-129}"},
+        {"PreciseInts", "{\"i16\":32768}"},
+        {"PreciseInts", "{\"i32\":-2147483649}"},
+        {"PreciseInts", "{\"i64\":9223372036854775808}"},
+        {"PreciseInts", "{\"u8\":256}"},
+        {"PreciseInts", "{\"u8\":-1}"},
+        {"PreciseInts", "{\"u16\":-0}"},
+        {"PreciseInts", "{\"u32\":4294967296}"},
+        {"PreciseInts", "{\"u64\":18446744073709551616}"},
+        {"FixedArrayStruct", "{\"fixed_ints\":[1,2,3,4,5,6]}"},
+        {"FixedArrayStruct", "{\"fixed_ints\":null}"},
+        {"FixedArrayStruct", "{\"fixed_ints\":[1 2]}"},
+        {"FixedArrayStruct", "{\"fixed_colors\":[\"PURPLE\"]}"},
+        {"FixedArrayStruct", "{\"fixed_bools\":[0.5]}"},
+        {"ComplexStruct", "{\"int_array\":[1,2}"},
+        {"ComplexStruct", "{\"int_array\":[1 2]}"},
+        {"ComplexStruct", "{\"int_array\":[,1]}"},
+        {"ComplexStruct", "{\"int_array\":[4294967296]}"},
+        {"ComplexStruct", "{\"contacts\":[null]}"},
+        {"ComplexStruct", "{\"address\":null}"},
+        {"NullableNestedStruct", "{\"color\":null}"},
+        {"NullableNestedStruct", "{\"status\":\"NOPE\"}"},
+        // accepted by both
+        {"TestStruct",
+         "{\"int_val\":-2147483648,\"long_val\":-9223372036854775808,"
+         "\"float_val\":1.,\"double_val\":.5,\"bool_val\":1,"
+         "\"sstr_val\":\"\\ud83d\\ude00\"}"},
+        {"TestStruct", "{\"bool_val\":false,\"int_val\":true}"},
+        {"TestStruct", "{\"sstr_val\":null,\"double_val\":-1.5e-3}"},
+        {"TestStruct", "{\"float_val\":1E+2,\"double_val\":1e400}"},
+        {"PreciseInts",
+         "{\"i8\":-128,\"i16\":32767,\"i32\":-2147483648,"
+         "\"i64\":9223372036854775807,\"u8\":255,\"u16\":65535,"
+         "\"u32\":4294967295,\"u64\":18446744073709551615}"},
+        {"FixedArrayStruct", "{\"fixed_ints\":[1,2,],\"fixed_bools\":[]}"},
+        {"ComplexStruct",
+         "{\"int_array\":[1,2,],\"contacts\":[{\"name\":\"a\"},]}"},
+        {"NullableNestedStruct",
+         "{\"person\":null,\"status\":null,\"color\":\"RED\"}"},
+        {"NullableNestedStruct",
+         "{\"id\":1,\"unknown\":{\"a\":[1,{\"b\":null}]},\"color\":2}"},
+    };
+    for (const auto& c : cases) {
+        ExpectSameDecode(type(c.type), c.type, c.in);
+    }
+}
+
+TEST_F(SchemaRuntimeTest, JsonAppliesLimitsLikeGeneratedCode) {
+    struct json_limits lim;
+    memset(&lim, 0, sizeof(lim));
+    lim.max_input_bytes = 16;
+    ExpectSameDecode(type("TestStruct"), "TestStruct",
+                     "{\"sstr_val\":\"0123456789\"}", &lim);
+
+    memset(&lim, 0, sizeof(lim));
+    lim.max_string_len = 4;
+    ExpectSameDecode(type("TestStruct"), "TestStruct",
+                     "{\"sstr_val\":\"abcd\"}", &lim);
+    ExpectSameDecode(type("TestStruct"), "TestStruct",
+                     "{\"sstr_val\":\"abcde\"}", &lim);
+    ExpectSameDecode(type("TestStruct"), "TestStruct",
+                     "{\"sstr_val\":\"ab\\ncd\"}", &lim);
+    ExpectSameDecode(type("TestStruct"), "TestStruct",
+                     "{\"unknown_key\":1}", &lim);
+
+    memset(&lim, 0, sizeof(lim));
+    lim.max_array_len = 3;
+    ExpectSameDecode(type("ComplexStruct"), "ComplexStruct",
+                     "{\"int_array\":[1,2,3]}", &lim);
+    ExpectSameDecode(type("ComplexStruct"), "ComplexStruct",
+                     "{\"int_array\":[1,2,3,4]}", &lim);
+
+    // the budget only has to stop a large decode; the exact point at which
+    // each side charges its allocations differs
+    memset(&lim, 0, sizeof(lim));
+    lim.max_alloc_bytes = 1024;
+    std::string big = "{\"sstr_val\":\"" + std::string(4096, 'x') + "\"}";
+    ExpectSameDecode(type("TestStruct"), "TestStruct", big.c_str(), &lim);
+
+    // failures are reported with the offending offset
+    struct TestStruct o;
+    struct json_error err;
+    const char* in = "{\"int_val\":5000000000}";
+    jgenc_schema_init(type("TestStruct"), &o);
+    EXPECT_EQ(JSON_GEN_ERROR_BOUNDS,
+              jgenc_schema_json_unmarshal_limited(type("TestStruct"), in,
+                                                  strlen(in), &o, nullptr,
+                                                  &err));
+    EXPECT_EQ(JSON_GEN_ERROR_BOUNDS, err.code);
+    EXPECT_EQ(11, err.offset);
+    jgenc_schema_clear(type("TestStruct"), &o);
+}
+
+TEST_F(SchemaRuntimeTest, MsgpackAndCborRoundTrip) {
+    const struct jgenc_schema_type* t = type("FixedArrayStruct");
+    const char* in =
+        "{\"fixed_ints\":[1,2,3,4,5],\"fixed_longs\":[-1,0,1],"
+        "\"fixed_floats\":[0.5,1.5,2.5,3.5],\"fixed_doubles\":[1,2,3],"
+        "\"fixed_strings\":[\"x\",\"y\",\"z\"],\"fixed_bools\":[true,false],"
+        "\"fixed_colors\":[\"BLUE\",\"RED\",\"GREEN\"],"
+        "\"fixed_contacts\":[{\"name\":\"a\",\"age\":\"1\"},"
+        "{\"name\":\"b\",\"age\":\"2\"}]}";
+    struct FixedArrayStruct src;
+    jgenc_schema_init(t, &src);
+    ASSERT_EQ(0, jgenc_schema_json_unmarshal(t, in, strlen(in), &src));
+
+    sstr_t json = sstr_new();
+    jgenc_schema_json_marshal(t, &src, json);
+
+    for (int fmt = 0; fmt < 2; fmt++) {
+        sstr_t wire = sstr_new();
+        struct FixedArrayStruct dst;
+        jgenc_schema_init(t, &dst);
+        if (fmt == 0) {
+            jgenc_schema_msgpack_pack(t, &src, wire);
+            ASSERT_EQ(0, jgenc_schema_msgpack_unpack(
+                             t, (const unsigned char*)sstr_cstr(wire),
+                             sstr_length(wire), &dst));
+            // truncated input is an error, never a crash
+            for (size_t n = 0; n < sstr_length(wire); n += 7) {
+                struct FixedArrayStruct part;
+                jgenc_schema_init(t, &part);
+                EXPECT_NE(0, jgenc_schema_msgpack_unpack(
+                                 t, (const unsigned char*)sstr_cstr(wire), n,
+                                 &part));
+                jgenc_schema_clear(t, &part);
+            }
+        } else {
+            jgenc_schema_cbor_pack(t, &src, wire);
+            ASSERT_EQ(0, jgenc_schema_cbor_unpack(
+                             t, (const unsigned char*)sstr_cstr(wire),
+                             sstr_length(wire), &dst));
+        }
+        sstr_t back = sstr_new();
+        jgenc_schema_json_marshal(t, &dst, back);
+        EXPECT_STREQ(sstr_cstr(json), sstr_cstr(back)) << fmt;
+        sstr_free(back);
+        sstr_free(wire);
+        jgenc_schema_clear(t, &dst);
+    }
+    sstr_free(json);
+    jgenc_schema_clear(t, &src);
+}
+
+// The same struct marked @compact packs as a positional array and still
+// decodes the keyed form.
+TEST_F(SchemaRuntimeTest, CompactStructsPackByPosition) {
+    static const char kCompact[] =
+        "enum Status { PENDING, DONE }\n"
+        "enum Color { RED, GREEN, BLUE }\n"
+        "struct Person { sstr_t name; sstr_t age; }\n"
+        "@compact struct NullableNestedStruct {\n"
+        "    int id;\n"
+        "    nullable Person person;\n"
+        "    optional Color color;\n"
+        "    optional nullable Status status;\n"
+        "}\n";
+    struct jgenc_schema* cs = jgenc_schema_compile(kCompact, sizeof(kCompact) - 1);
+    ASSERT_NE(nullptr, cs);
+    const struct jgenc_schema_type* ct =
+        jgenc_schema_find_type(cs, "NullableNestedStruct");
+    const struct jgenc_schema_type* kt = type("NullableNestedStruct");
+    ASSERT_EQ(jgenc_schema_type_size(kt), jgenc_schema_type_size(ct));
+
+    const char* in = "{\"id\":7,\"person\":{\"name\":\"a\",\"age\":\"1\"}}";
+    struct NullableNestedStruct src;
+    jgenc_schema_init(kt, &src);
+    ASSERT_EQ(0, jgenc_schema_json_unmarshal(kt, in, strlen(in), &src));
+    sstr_t json = sstr_new();
+    jgenc_schema_json_marshal(kt, &src, json);
+
+    for (int fmt = 0; fmt < 2; fmt++) {
+        sstr_t packed = sstr_new();
+        sstr_t keyed = sstr_new();
+        int (*pack)(const struct jgenc_schema_type*, const void*, sstr_t) =
+            fmt == 0 ? jgenc_schema_msgpack_pack : jgenc_schema_cbor_pack;
+        int (*unpack)(const struct jgenc_schema_type*, const unsigned char*,
+                      size_t, void*) =
+            fmt == 0 ? jgenc_schema_msgpack_unpack : jgenc_schema_cbor_unpack;
+        pack(ct, &src, packed);
+        pack(kt, &src, keyed);
+        // 4-element array header; absent optionals hold nil
+        EXPECT_EQ(fmt == 0 ? 0x94 : 0x84, (unsigned char)sstr_cstr(packed)[0]);
+        EXPECT_LT(sstr_length(packed), sstr_length(keyed));
+
+        sstr_t wires[2] = {packed, keyed};
+        for (sstr_t wire : wires) {
+            struct NullableNestedStruct dst;
+            jgenc_schema_init(ct, &dst);
+            ASSERT_EQ(0, unpack(ct, (const unsigned char*)sstr_cstr(wire),
+                                sstr_length(wire), &dst));
+            sstr_t back = sstr_new();
+            jgenc_schema_json_marshal(ct, &dst, back);
+            EXPECT_STREQ(sstr_cstr(json), sstr_cstr(back)) << fmt;
+            sstr_free(back);
+            jgenc_schema_clear(ct, &dst);
+        }
+        // a keyed type does not take the positional form
+        struct NullableNestedStruct dst;
+        jgenc_schema_init(kt, &dst);
+        EXPECT_NE(0, unpack(kt, (const unsigned char*)sstr_cstr(packed),
+                            sstr_length(packed), &dst));
+        jgenc_schema_clear(kt, &dst);
+        sstr_free(keyed);
+        sstr_free(packed);
+    }
+    sstr_free(json);
+    jgenc_schema_clear(kt, &src);
+    jgenc_schema_free(cs);
+}
+
+TEST(SchemaRuntimeCompileTest, RejectsUnsupportedSchemas) {
+    const char* bad[] = {
+        "struct M { map<sstr_t, int> m; }",
+        "struct S { @inline_str sstr_t s; }",
+        "@cached struct C { int a; }",
+        "struct A { B b; }",
+    };
+    for (const char* text : bad) {
+        EXPECT_EQ(nullptr, jgenc_schema_compile(text, strlen(text))) << text;
+    }
+}
+
+TEST(SchemaRuntimeCacheTest, CompilesEachTextOnce) {
+    struct jgenc_schema_cache* cache = jgenc_schema_cache_new();
+    ASSERT_NE(nullptr, cache);
+    const char a[] = "struct P { int x; }";
+    const char b[] = "struct P { long x; }";
+
+    std::vector<const struct jgenc_schema*> seen(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < seen.size(); i++) {
+        threads.emplace_back([&, i] {
+            seen[i] = jgenc_schema_cache_compile(cache, a, sizeof(a) - 1);
+        });
+    }
+    for (auto& th : threads) th.join();
+    ASSERT_NE(nullptr, seen[0]);
+    for (const struct jgenc_schema* s : seen) EXPECT_EQ(seen[0], s);
+
+    const struct jgenc_schema* other =
+        jgenc_schema_cache_compile(cache, b, sizeof(b) - 1);
+    ASSERT_NE(nullptr, other);
+    EXPECT_NE(seen[0], other);
+    EXPECT_EQ(sizeof(long), jgenc_schema_type_size(
+                                jgenc_schema_find_type(other, "P")));
+    EXPECT_EQ(nullptr, jgenc_schema_cache_compile(cache, "struct P { int }", 16));
+    jgenc_schema_cache_free(cache);
+}
@@ -3,6 +3,8 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include <string>
+
 #include "json.gen.h"
 #include "sstr.h"
 
@@ -552,3 +554,179 @@ TEST(SelectiveParseTest, LargeFieldIndexesFitInMask) {
     word_count = JSON_GEN_C_FIELD_MASK_WORD_COUNT(field_count);
     EXPECT_EQ(word_count, 3);
 }
+
+TEST(SelectiveMarshalTest, EmitsOnlySelectedAliasedFields) {
+    struct AliasBasic obj;
+    AliasBasic_init(&obj);
+    obj.username = sstr("alice");
+    obj.created = 1234567890L;
+    obj.id = 7;
+
+    uint64_t mask[AliasBasic_FIELD_MASK_WORD_COUNT] = {0};
+    JSON_GEN_C_FIELD_MASK_SET(mask, AliasBasic_FIELD_id);
+    JSON_GEN_C_FIELD_MASK_SET(mask, AliasBasic_FIELD_username);
+
+    sstr_t out = sstr_new();
+    ASSERT_EQ(json_marshal_selected_AliasBasic(
+                  &obj, mask, AliasBasic_FIELD_MASK_WORD_COUNT, out),
+              0);
+    EXPECT_STREQ(sstr_cstr(out), "{\"user_name\":\"alice\",\"id\":7}");
+
+    sstr_clear(out);
+    JSON_GEN_C_FIELD_MASK_CLEAR(mask, AliasBasic_FIELD_username);
+    JSON_GEN_C_FIELD_MASK_CLEAR(mask, AliasBasic_FIELD_id);
+    ASSERT_EQ(json_marshal_selected_AliasBasic(
+                  &obj, mask, AliasBasic_FIELD_MASK_WORD_COUNT, out),
+              0);
+    EXPECT_STREQ(sstr_cstr(out), "{}");
+
+    sstr_free(out);
+    AliasBasic_clear(&obj);
+}
+
+TEST(SelectiveMarshalTest, RejectsNullOrShortMasks) {
+    struct AliasBasic obj;
+    AliasBasic_init(&obj);
+    sstr_t out = sstr_new();
+    uint64_t mask[AliasBasic_FIELD_MASK_WORD_COUNT] = {0};
+
+    EXPECT_EQ(json_marshal_selected_AliasBasic(
+                  &obj, NULL, AliasBasic_FIELD_MASK_WORD_COUNT, out),
+              -1);
+    EXPECT_EQ(json_marshal_selected_AliasBasic(&obj, mask, 0, out), -1);
+
+    sstr_free(out);
+    AliasBasic_clear(&obj);
+}
+
+TEST(SelectiveMarshalTest, UnsetOptionalSelectedFieldIsOmitted) {
+    struct OptionalOnlyStruct obj;
+    OptionalOnlyStruct_init(&obj);
+    obj.id = 3;
+    obj.has_score = true;
+    obj.score = 9;
+
+    uint64_t mask[OptionalOnlyStruct_FIELD_MASK_WORD_COUNT] = {0};
+    JSON_GEN_C_FIELD_MASK_SET(mask, OptionalOnlyStruct_FIELD_name);
+    JSON_GEN_C_FIELD_MASK_SET(mask, OptionalOnlyStruct_FIELD_score);
+
+    sstr_t out = sstr_new();
+    ASSERT_EQ(json_marshal_selected_OptionalOnlyStruct(
+                  &obj, mask, OptionalOnlyStruct_FIELD_MASK_WORD_COUNT, out),
+              0);
+    EXPECT_STREQ(sstr_cstr(out), "{\"score\":9}");
+
+    sstr_free(out);
+    OptionalOnlyStruct_clear(&obj);
+}
+
+TEST(SelectiveMarshalTest, FullMaskMatchesCompactMarshal) {
+    struct ComplexStruct obj;
+    ComplexStruct_init(&obj);
+    sstr_t in = sstr(
+        "{\"simple_int\":1,\"simple_long\":2,\"simple_float\":0.5,"
+        "\"simple_double\":1.25,\"simple_bool\":true,\"simple_string\":\"s\","
+        "\"int_array\":[1,2],\"long_array\":[3],\"float_array\":[],"
+        "\"double_array\":[4.5],\"string_array\":[\"a\"],"
+        "\"address\":{\"number\":\"1\",\"street\":\"x\"},"
+        "\"contacts\":[{\"name\":\"p\",\"age\":\"30\"}]}");
+    ASSERT_EQ(json_unmarshal_ComplexStruct(in, &obj), 0);
+
+    uint64_t mask[ComplexStruct_FIELD_MASK_WORD_COUNT];
+    int i;
+    for (i = 0; i < ComplexStruct_FIELD_MASK_WORD_COUNT; i++) {
+        mask[i] = ~UINT64_C(0);
+    }
+    sstr_t full = sstr_new();
+    sstr_t selected = sstr_new();
+    ASSERT_EQ(json_marshal_ComplexStruct(&obj, full), 0);
+    ASSERT_EQ(json_marshal_selected_ComplexStruct(
+                  &obj, mask, ComplexStruct_FIELD_MASK_WORD_COUNT, selected),
+              0);
+    EXPECT_STREQ(sstr_cstr(selected), sstr_cstr(full));
+
+    sstr_free(full);
+    sstr_free(selected);
+    sstr_free(in);
+    ComplexStruct_clear(&obj);
+}
+
+TEST(SelectiveMarshalTest, DeepProjectsNestedStruct) {
+    struct NestedStruct obj;
+    NestedStruct_init(&obj);
+    obj.id = 42;
+    obj.name = sstr("n");
+    obj.embedded.int_val = 7;
+    obj.embedded.sstr_val = sstr("hidden");
+
+    uint64_t mask[NestedStruct_FIELD_MASK_WORD_COUNT] = {0};
+    JSON_GEN_C_FIELD_MASK_SET(mask, NestedStruct_FIELD_id);
+    JSON_GEN_C_FIELD_MASK_SET(mask, NestedStruct_FIELD_embedded);
+
+    uint64_t inner[TestStruct_FIELD_MASK_WORD_COUNT] = {0};
+    JSON_GEN_C_FIELD_MASK_SET(inner, TestStruct_FIELD_int_val);
+
+    struct json_nested_mask nested[] = {
+        { NestedStruct_FIELD_embedded, inner,
+          TestStruct_FIELD_MASK_WORD_COUNT, NULL, 0 }
+    };
+
+    sstr_t out = sstr_new();
+    ASSERT_EQ(json_marshal_selected_NestedStruct_deep(
+                  &obj, mask, NestedStruct_FIELD_MASK_WORD_COUNT, nested, 1,
+                  out),
+              0);
+    EXPECT_STREQ(sstr_cstr(out), "{\"id\":42,\"embedded\":{\"int_val\":7}}");
+
+    // without a sub-mask the nested struct is written in full
+    sstr_t full = sstr_new();
+    sstr_clear(out);
+    ASSERT_EQ(json_marshal_selected_NestedStruct(
+                  &obj, mask, NestedStruct_FIELD_MASK_WORD_COUNT, out),
+              0);
+    json_marshal_TestStruct(&obj.embedded, full);
+    EXPECT_EQ(std::string(sstr_cstr(out)),
+              std::string("{\"id\":42,\"embedded\":") + sstr_cstr(full) + "}");
+
+    // a too-short sub-mask fails the whole call
+    nested[0].mask_word_count = 0;
+    sstr_clear(out);
+    EXPECT_EQ(json_marshal_selected_NestedStruct_deep(
+                  &obj, mask, NestedStruct_FIELD_MASK_WORD_COUNT, nested, 1,
+                  out),
+              -1);
+
+    sstr_free(full);
+    sstr_free(out);
+    NestedStruct_clear(&obj);
+}
+
+TEST(SelectiveMarshalTest, DeepSubMaskAppliesToEveryArrayElement) {
+    struct ComplexStruct obj;
+    ComplexStruct_init(&obj);
+    sstr_t in = sstr(
+        "{\"simple_int\":1,\"contacts\":[{\"name\":\"p\",\"age\":\"30\"},"
+        "{\"name\":\"q\",\"age\":\"40\"}]}");
+    ASSERT_EQ(json_unmarshal_ComplexStruct(in, &obj), 0);
+
+    uint64_t mask[ComplexStruct_FIELD_MASK_WORD_COUNT] = {0};
+    JSON_GEN_C_FIELD_MASK_SET(mask, ComplexStruct_FIELD_contacts);
+    uint64_t inner[Person_FIELD_MASK_WORD_COUNT] = {0};
+    JSON_GEN_C_FIELD_MASK_SET(inner, Person_FIELD_name);
+    struct json_nested_mask nested[] = {
+        { ComplexStruct_FIELD_contacts, inner, Person_FIELD_MASK_WORD_COUNT,
+          NULL, 0 }
+    };
+
+    sstr_t out = sstr_new();
+    ASSERT_EQ(json_marshal_selected_ComplexStruct_deep(
+                  &obj, mask, ComplexStruct_FIELD_MASK_WORD_COUNT, nested, 1,
+                  out),
+              0);
+    EXPECT_STREQ(sstr_cstr(out),
+                 "{\"contacts\":[{\"name\":\"p\"},{\"name\":\"q\"}]}");
+
+    sstr_free(out);
+    sstr_free(in);
+    ComplexStruct_clear(&obj);
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+#include <algorithm>
+
+#include "json.gen.h"
+#include "sstr.h"
+
+// ==========================================================================
+// json_sink, json_array_writer and NDJSON output
+// ==========================================================================
+
+struct StreamCapture {
+    std::string data;
+    int writes = 0;
+    size_t max_write = 0;
+    int fail_after = -1;
+};
+
+static int StreamCaptureWrite(void* ctx, const char* data, size_t len) {
+    StreamCapture* c = (StreamCapture*)ctx;
+    if (c->fail_after >= 0 && c->writes >= c->fail_after) {
+        return -1;
+    }
+    c->data.append(data, len);
+    c->writes++;
+    c->max_write = std::max(c->max_write, len);
+    return 0;
+}
+
+TEST(StreamMarshal, ArrayWriterMatchesArrayMarshal) {
+    const int n = 500;
+    struct Person* people = new struct Person[n];
+    for (int i = 0; i < n; i++) {
+        Person_init(&people[i]);
+        people[i].name = sstr_printf("p\"%d", i);
+        people[i].age = sstr_printf("%d", i);
+    }
+    for (int count : {0, 1, n}) {
+        StreamCapture cap;
+        struct json_sink sink;
+        ASSERT_EQ(json_sink_init(&sink, StreamCaptureWrite, &cap, 256), 0);
+        struct json_array_writer w;
+        ASSERT_EQ(json_array_writer_begin_Person(&w, &sink), 0);
+        for (int i = 0; i < count; i++) {
+            ASSERT_EQ(json_array_writer_append_Person(&w, &people[i]), 0);
+            // the buffer never holds much more than one flush
+            EXPECT_LT(sstr_length(sink.buf), 256u);
+        }
+        ASSERT_EQ(json_array_writer_end_Person(&w), 0);
+        EXPECT_EQ(sstr_length(sink.buf), 0u);
+
+        sstr_t out = sstr_new();
+        json_marshal_array_Person(people, count, out);
+        EXPECT_EQ(cap.data, std::string(sstr_cstr(out)));
+        if (count == n) {
+            EXPECT_GT(cap.writes, 10);
+            EXPECT_LT(cap.max_write, 256u + 64u);
+        }
+        sstr_free(out);
+        json_sink_clear(&sink);
+    }
+    for (int i = 0; i < n; i++) {
+        Person_clear(&people[i]);
+    }
+    delete[] people;
+}
+
+TEST(StreamMarshal, NdjsonLinesAndWriteFailure) {
+    struct Person p;
+    Person_init(&p);
+    p.name = sstr("a\nb");
+    p.age = sstr("3");
+
+    StreamCapture cap;
+    struct json_sink sink;
+    ASSERT_EQ(json_sink_init(&sink, StreamCaptureWrite, &cap, 0), 0);
+    ASSERT_EQ(json_ndjson_write_Person(&sink, &p), 0);
+    ASSERT_EQ(json_ndjson_write_Person(&sink, &p), 0);
+    EXPECT_TRUE(cap.data.empty());  // below the default flush size
+    ASSERT_EQ(json_sink_flush(&sink), 0);
+    EXPECT_EQ(cap.data,
+              "{\"name\":\"a\\nb\",\"age\":\"3\"}\n"
+              "{\"name\":\"a\\nb\",\"age\":\"3\"}\n");
+    json_sink_clear(&sink);
+
+    // once the sink fails, every later call fails too
+    StreamCapture bad;
+    bad.fail_after = 0;
+    ASSERT_EQ(json_sink_init(&sink, StreamCaptureWrite, &bad, 1), 0);
+    EXPECT_EQ(json_ndjson_write_Person(&sink, &p), -1);
+    EXPECT_EQ(json_ndjson_write_Person(&sink, &p), -1);
+    struct json_array_writer w;
+    EXPECT_EQ(json_array_writer_begin_Person(&w, &sink), -1);
+    EXPECT_EQ(json_sink_flush(&sink), -1);
+    EXPECT_TRUE(bad.data.empty());
+    json_sink_clear(&sink);
+
+    Person_clear(&p);
+}
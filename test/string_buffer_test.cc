@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+
+// ==========================================================================
+// Inline sstr fast paths
+// ==========================================================================
+
+TEST(SstrFastPath, MatchesOutOfLineFunctions) {
+    sstr_t slow = sstr_new();
+    sstr_t fast = sstr_new();
+    // cross the short -> long promotion and several long regrowths
+    for (int i = 0; i < 400; i++) {
+        char piece[16];
+        int n = snprintf(piece, sizeof(piece), "%d,", i);
+        sstr_append_of(slow, piece, (size_t)n);
+        sstr_append_of_fast(fast, piece, (size_t)n);
+        ASSERT_EQ(sstr_length(fast), sstr_length(slow));
+        ASSERT_STREQ(sstr_cstr_fast(fast), sstr_cstr(slow));
+    }
+    char* p = sstr_reserve_fast(fast, 3);
+    memcpy(p, "end", 3);
+    sstr_commit_fast(fast, 3);
+    sstr_append_cstr(slow, "end");
+    EXPECT_STREQ(sstr_cstr(fast), sstr_cstr(slow));
+
+    // a long string keeps its buffer across sstr_clear_fast()
+    char* buf = sstr_cstr(fast);
+    sstr_clear_fast(fast);
+    EXPECT_EQ(sstr_length(fast), 0u);
+    EXPECT_STREQ(sstr_cstr(fast), "");
+    sstr_append_of_fast(fast, "x", 1);
+    EXPECT_EQ(sstr_cstr(fast), buf);
+
+    sstr_t ref = sstr_ref("abc", 3);
+    EXPECT_EQ(std::string(sstr_cstr_fast(ref), 3), "abc");
+    sstr_free(ref);
+    sstr_free(slow);
+    sstr_free(fast);
+}
+
+TEST(SstrFastPath, AfterSstrClear) {
+    // sstr_clear() frees a long buffer but keeps the long type
+    sstr_t s = sstr("a value longer than the short string capacity");
+    sstr_clear(s);
+    sstr_clear_fast(s);
+    EXPECT_EQ(sstr_length(s), 0u);
+    sstr_clear(s);
+    sstr_append_of_fast(s, "abc", 3);
+    EXPECT_STREQ(sstr_cstr(s), "abc");
+    sstr_free(s);
+
+    struct Person p;
+    Person_init(&p);
+    // unmarshal replaces the field, so keep the cleared header to free it
+    sstr_t cleared = sstr("a value longer than the short string capacity");
+    sstr_clear(cleared);
+    p.name = cleared;
+    sstr_t json = sstr("{\"name\":\"Bob\",\"age\":\"3\"}");
+    ASSERT_EQ(json_unmarshal_Person(json, &p), 0);
+    EXPECT_STREQ(sstr_cstr(p.name), "Bob");
+    sstr_free(json);
+    Person_clear(&p);
+    sstr_free(cleared);
+}
+
+// ==========================================================================
+// sstr growth, reserve, detach/adopt and set_ref
+// ==========================================================================
+
+TEST(SstrGrowth, AppendsGrowGeometrically) {
+    sstr_t s = sstr_new();
+    size_t last = sstr_capacity(s);
+    int grows = 0;
+    EXPECT_EQ(last, (size_t)SHORT_STR_CAPACITY);
+    for (int i = 0; i < 1 << 20; i++) {
+        sstr_append_of(s, "x", 1);
+        if (sstr_capacity(s) != last) {
+            EXPECT_GE(sstr_capacity(s), last + CAP_ADD_DELTA);
+            last = sstr_capacity(s);
+            grows++;
+        }
+    }
+    EXPECT_EQ(sstr_length(s), (size_t)(1 << 20));
+    // 1 MiB in 256-byte steps would be ~4096 reallocations.
+    EXPECT_LT(grows, 40);
+    sstr_free(s);
+}
+
+TEST(SstrGrowth, ReserveAndShrinkToFit) {
+    sstr_t s = sstr("abc");
+    sstr_reserve(s, 10);
+    EXPECT_EQ(sstr_capacity(s), (size_t)SHORT_STR_CAPACITY);
+
+    sstr_reserve(s, 4096);
+    ASSERT_EQ(sstr_capacity(s), (size_t)4096);
+    EXPECT_STREQ(sstr_cstr(s), "abc");
+    const char* data = sstr_cstr(s);
+    sstr_append_zero(s, 4093);
+    EXPECT_EQ(sstr_cstr(s), data);  // no reallocation up to the reservation
+    EXPECT_EQ(sstr_capacity(s), (size_t)4096);
+
+    sstr_reserve(s, 100);  // never shrinks
+    EXPECT_EQ(sstr_capacity(s), (size_t)4096);
+
+    sstr_clear(s);
+    sstr_append_cstr(s, "0123456789012345678901234567890123456789");
+    sstr_shrink_to_fit(s);
+    EXPECT_EQ(sstr_capacity(s), (size_t)40);
+    EXPECT_STREQ(sstr_cstr(s), "0123456789012345678901234567890123456789");
+
+    sstr_t shortened = sstr_substr(s, 0, 5);
+    sstr_reserve(shortened, 1000);
+    sstr_shrink_to_fit(shortened);  // back to a short string
+    EXPECT_EQ(sstr_capacity(shortened), (size_t)SHORT_STR_CAPACITY);
+    EXPECT_STREQ(sstr_cstr(shortened), "01234");
+
+    sstr_free(shortened);
+    sstr_free(s);
+}
+
+TEST(SstrGrowth, DetachAndAdopt) {
+    sstr_t s = sstr_new();
+    sstr_append_zero(s, 300);
+    memset(sstr_cstr(s), 'a', 300);
+    const char* data = sstr_cstr(s);
+
+    size_t len = 0;
+    char* buf = sstr_detach(s, &len);
+    EXPECT_EQ(buf, data);  // a long string hands over its buffer
+    EXPECT_EQ(len, (size_t)300);
+    EXPECT_EQ(buf[300], '\0');
+    EXPECT_EQ(sstr_length(s), (size_t)0);
+    EXPECT_STREQ(sstr_cstr(s), "");
+
+    sstr_t t = sstr("old contents");
+    sstr_adopt(t, buf, len, len + 1);
+    EXPECT_EQ(sstr_cstr(t), buf);
+    EXPECT_EQ(sstr_length(t), (size_t)300);
+    sstr_append_cstr(t, "b");
+    EXPECT_EQ(sstr_cstr(t)[300], 'b');
+    EXPECT_EQ(sstr_length(t), (size_t)301);
+
+    sstr_append_cstr(s, "short");
+    buf = sstr_detach(s, NULL);  // a short string is copied out
+    EXPECT_STREQ(buf, "short");
+    jgenc_free(buf);
+
+    char* raw = (char*)jgenc_malloc(16);
+    memcpy(raw, "hello", 5);
+    sstr_adopt(s, raw, 5, 16);
+    EXPECT_STREQ(sstr_cstr(s), "hello");
+    EXPECT_EQ(sstr_capacity(s), (size_t)15);
+
+    sstr_free(t);
+    sstr_free(s);
+}
+
+TEST(SstrGrowth, SetRefAndClear) {
+    const char data[] = "borrowed bytes";
+    sstr_t s = sstr_new();
+    sstr_append_zero(s, 100);  // a long string's buffer is released
+    sstr_set_ref(s, data, 8);
+    EXPECT_EQ(sstr_cstr(s), data);
+    EXPECT_EQ(sstr_length(s), (size_t)8);
+
+    sstr_set_ref(s, data + 9, 5);  // repointing a reference
+    EXPECT_EQ(sstr_cstr(s), data + 9);
+
+    sstr_clear(s);  // no longer a reference, so it can grow
+    EXPECT_STREQ(sstr_cstr(s), "");
+    sstr_append_cstr(s, "own");
+    EXPECT_STREQ(sstr_cstr(s), "own");
+    sstr_free(s);
+}
@@ -0,0 +1,243 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <cstring>
+
+#include "json.gen.h"
+#include "sstr.h"
+#include "utils/error_codes.h"
+
+// ==========================================================================
+// json_validate_<S>()
+// ==========================================================================
+
+#define VALIDATE(S, s) json_validate_##S((s), strlen(s))
+
+TEST(Validate, AcceptsWhatUnmarshalAccepts) {
+    const char* json =
+        "{\"id\": 1, \"name\": \"n\", /* c */ \"embedded\": {\"int_val\": 1,"
+        " \"long_val\": -2, \"float_val\": 1.5e3, \"double_val\": 2,"
+        " \"bool_val\": true, \"sstr_val\": \"\\u00e9\\n\"}, \"extra\": "
+        "[{\"x\": [1, {\"y\": null}]}, 2]}";
+    EXPECT_EQ(VALIDATE(NestedStruct, json), 0);
+
+    struct NestedStruct obj;
+    NestedStruct_init(&obj);
+    sstr_t s = sstr(json);
+    EXPECT_EQ(json_unmarshal_NestedStruct(s, &obj), 0);
+    sstr_free(s);
+    NestedStruct_clear(&obj);
+}
+
+TEST(Validate, TypeMismatch) {
+    EXPECT_EQ(VALIDATE(Person, "{\"name\": 1, \"age\": \"3\"}"),
+              JSON_GEN_ERROR_PARSE);
+    EXPECT_EQ(VALIDATE(Circle, "{\"radius\": \"big\"}"), JSON_GEN_ERROR_PARSE);
+    EXPECT_EQ(VALIDATE(Circle, "{\"radius\": 1.}"), 0);
+    EXPECT_EQ(VALIDATE(Circle, "{\"radius\": 1e}"), JSON_GEN_ERROR_PARSE);
+    EXPECT_EQ(VALIDATE(Circle, "{\"radius\": 1,}"), JSON_GEN_ERROR_PARSE);
+    // like json_unmarshal_<S>(), stop at the closing '}'
+    EXPECT_EQ(VALIDATE(Circle, "{\"radius\": 1} x"), 0);
+    EXPECT_EQ(VALIDATE(Circle, "{\"radius\": 1"), JSON_GEN_ERROR_PARSE);
+    EXPECT_EQ(VALIDATE(Person, "{\"name\": \"\\x\", \"age\": \"\"}"),
+              JSON_GEN_ERROR_PARSE);
+}
+
+TEST(Validate, IntegerRanges) {
+    const char* ok =
+        "{\"i8\":-128,\"i16\":32767,\"i32\":-2147483648,"
+        "\"i64\":9223372036854775807,\"u8\":255,\"u16\":65535,"
+        "\"u32\":4294967295,\"u64\":18446744073709551615}";
+    EXPECT_EQ(VALIDATE(PreciseInts, ok), 0);
+    EXPECT_EQ(VALIDATE(PreciseInts,
+                       "{\"i8\":128,\"i16\":0,\"i32\":0,\"i64\":0,\"u8\":0,"
+                       "\"u16\":0,\"u32\":0,\"u64\":0}"),
+              JSON_GEN_ERROR_BOUNDS);
+    EXPECT_EQ(VALIDATE(PreciseInts,
+                       "{\"i8\":0,\"i16\":0,\"i32\":0,\"i64\":0,\"u8\":-1,"
+                       "\"u16\":0,\"u32\":0,\"u64\":0}"),
+              JSON_GEN_ERROR_BOUNDS);
+    EXPECT_EQ(VALIDATE(PreciseInts,
+                       "{\"i8\":0,\"i16\":0,\"i32\":0,\"i64\":0,\"u8\":0,"
+                       "\"u16\":0,\"u32\":0,\"u64\":18446744073709551616}"),
+              JSON_GEN_ERROR_BOUNDS);
+}
+
+TEST(Validate, AbsentFields) {
+    // no field has to be present: the decoder leaves absent ones as
+    // _init() set them.
+    EXPECT_EQ(VALIDATE(Triangle, "{\"base\":1,\"height\":2,\"label\":\"t\"}"),
+              0);
+    EXPECT_EQ(VALIDATE(Triangle, "{\"base\":1,\"label\":\"t\",\"base\":3}"),
+              0);
+    EXPECT_EQ(VALIDATE(Triangle, "{}"), 0);
+    EXPECT_EQ(VALIDATE(OptionalOnlyStruct, "{\"name\": \"x\"}"), 0);
+    EXPECT_EQ(VALIDATE(DefaultBasic, "{}"), 0);
+    EXPECT_EQ(VALIDATE(NullableOnlyStruct, "{\"id\":1,\"name\":null}"), 0);
+}
+
+TEST(Validate, EnumMembership) {
+    EXPECT_EQ(VALIDATE(EnumTestStruct,
+                       "{\"color\":\"RED\",\"status\":2,\"value\":0,"
+                       "\"colors\":[\"GREEN\",0,\"BLUE\"]}"),
+              0);
+    EXPECT_EQ(VALIDATE(EnumTestStruct,
+                       "{\"color\":\"PINK\",\"status\":0,\"value\":0,"
+                       "\"colors\":[]}"),
+              JSON_GEN_ERROR_PARSE);
+    // an integer is stored as is, even past the last enumerator
+    EXPECT_EQ(VALIDATE(EnumTestStruct,
+                       "{\"color\":\"RED\",\"status\":3,\"value\":0,"
+                       "\"colors\":null}"),
+              0);
+    EXPECT_EQ(VALIDATE(EnumTestStruct, "{\"status\":99999999999}"),
+              JSON_GEN_ERROR_BOUNDS);
+}
+
+TEST(Validate, FixedArrayBounds) {
+    EXPECT_EQ(VALIDATE(PreciseIntArrays,
+                       "{\"i8_arr\":[1,2,3,4],\"u32_dyn\":[],\"i64_dyn\":[1,],"
+                       "\"u64_fixed\":[1]}"),
+              0);
+    EXPECT_EQ(VALIDATE(PreciseIntArrays,
+                       "{\"i8_arr\":[1,2,3,4,5],\"u32_dyn\":[],\"i64_dyn\":[],"
+                       "\"u64_fixed\":[]}"),
+              JSON_GEN_ERROR_BOUNDS);
+    EXPECT_EQ(VALIDATE(PreciseIntArrays,
+                       "{\"i8_arr\":null,\"u32_dyn\":[],\"i64_dyn\":[],"
+                       "\"u64_fixed\":[]}"),
+              JSON_GEN_ERROR_PARSE);
+}
+
+TEST(Validate, MapsAndOneof) {
+    EXPECT_EQ(VALIDATE(MapAllTypesStruct,
+                       "{\"int_map\":{\"a\":1},\"long_map\":null,"
+                       "\"float_map\":{},\"double_map\":{\"d\":1.5},"
+                       "\"bool_map\":{\"b\":false},\"str_map\":{\"s\":\"v\"},"
+                       "\"enum_map\":{\"e\":\"BLUE\"},\"struct_map\":{\"p\":"
+                       "{\"name\":\"n\",\"age\":\"1\"}}}"),
+              0);
+    EXPECT_EQ(VALIDATE(MapIntStruct, "{\"scores\":{\"a\":\"x\"}}"),
+              JSON_GEN_ERROR_PARSE);
+    EXPECT_EQ(VALIDATE(MapIntStruct, "{\"scores\":{\"a\":1 \"b\":2}}"),
+              JSON_GEN_ERROR_PARSE);
+    EXPECT_EQ(VALIDATE(MapIntStruct, "{\"scores\":{\"a\":1,}}"),
+              JSON_GEN_ERROR_PARSE);
+
+    EXPECT_EQ(VALIDATE(Drawing,
+                       "{\"name\":\"d\",\"shape\":{\"radius\":2,\"type\":"
+                       "\"circle\"},\"shapes\":[{\"type\":\"rectangle\","
+                       "\"width\":1,\"height\":2}]}"),
+              0);
+    EXPECT_EQ(VALIDATE(Drawing,
+                       "{\"name\":\"d\",\"shape\":{\"type\":\"hexagon\"},"
+                       "\"shapes\":[]}"),
+              JSON_GEN_ERROR_PARSE);
+    // The variant's own fields are checked too.
+    EXPECT_EQ(VALIDATE(Drawing,
+                       "{\"name\":\"d\",\"shape\":{\"type\":\"rectangle\","
+                       "\"width\":\"1\"},\"shapes\":null}"),
+              JSON_GEN_ERROR_PARSE);
+}
+
+TEST(Validate, DepthLimit) {
+    std::string json = "{\"house\":{\"number\":\"1\",\"street\":\"s\"},"
+                       "\"people\":[],\"x\":";
+    json += std::string(100000, '[');
+    json += std::string(100000, ']');
+    json += "}";
+    EXPECT_EQ(json_validate_Data(json.data(), json.size()), 0);
+    EXPECT_EQ(json_validate_Data(NULL, 0), JSON_GEN_ERROR_INVALID_PARAM);
+}
+
+// json_validate_<S>() must accept exactly the documents json_unmarshal_<S>()
+// accepts.
+#define EXPECT_AGREES(S, s)                                                 \
+    do {                                                                    \
+        struct S obj_;                                                      \
+        S##_init(&obj_);                                                    \
+        sstr_t in_ = sstr(s);                                               \
+        int u_ = json_unmarshal_##S(in_, &obj_);                            \
+        EXPECT_EQ(VALIDATE(S, s) == 0, u_ == 0) << #S << " " << (s);        \
+        sstr_free(in_);                                                     \
+        S##_clear(&obj_);                                                   \
+    } while (0)
+
+TEST(Validate, AgreesWithUnmarshal) {
+    // object and map grammar
+    EXPECT_AGREES(Triangle, "{}");
+    EXPECT_AGREES(Triangle, "{\"base\":1} x");
+    EXPECT_AGREES(Triangle, "{\"base\":1,}");
+    EXPECT_AGREES(Triangle, "{\"base\":1");
+    EXPECT_AGREES(Triangle, "{\"base\"1}");
+    EXPECT_AGREES(Triangle, "{\"base\":1 \"height\":2}");
+    EXPECT_AGREES(Triangle, "{\"zzz\":[1,{\"a\":[]}],\"base\":1}");
+    EXPECT_AGREES(Triangle, "{\"zzz\":}");
+    EXPECT_AGREES(Triangle, "{\"zzz\":tru}");
+    EXPECT_AGREES(Triangle, "{\"label\":\"\\ud800\"}");
+    EXPECT_AGREES(Triangle, "{\"label\":\"\\x\"}");
+    EXPECT_AGREES(MapIntStruct, "{\"scores\":{\"a\":1,\"b\":2}}");
+    EXPECT_AGREES(MapIntStruct, "{\"scores\":{\"a\":1 \"b\":2}}");
+    EXPECT_AGREES(MapIntStruct, "{\"scores\":{,\"a\":1}}");
+    EXPECT_AGREES(MapIntStruct, "{\"scores\":{\"a\":1,,\"b\":2}}");
+    EXPECT_AGREES(MapIntStruct, "{\"scores\":{\"a\":1,}}");
+    EXPECT_AGREES(MapIntStruct, "{\"scores\":{\"a\":null}}");
+    EXPECT_AGREES(MapIntStruct, "{\"scores\":{\"a\":1.5}}");
+    EXPECT_AGREES(MapIntStruct, "{\"scores\":null}");
+    EXPECT_AGREES(MapAllTypesStruct, "{\"struct_map\":{\"p\":1}}");
+    EXPECT_AGREES(MapAllTypesStruct, "{\"enum_map\":{\"p\":\"RED\",\"q\":7}}");
+    EXPECT_AGREES(MapArrayStruct, "{\"tags\":[{\"a\":1},]}");
+    EXPECT_AGREES(MapArrayStruct, "{\"tags\":[{\"a\":1},{},{\"b\":2}],\"x\":1}");
+    EXPECT_AGREES(MapArrayStruct, "{\"tags\":[{} {}]}");
+    EXPECT_AGREES(MapAllTypesStruct,
+                  "{\"struct_map\":{\"p\":{\"name\":\"a\"},\"q\":{}},"
+                  "\"int_map\":{\"a\":1}}");
+    EXPECT_AGREES(MapAllTypesStruct, "{\"struct_map\":{\"p\":{} \"q\":{}}}");
+
+    // scalars
+    EXPECT_AGREES(Circle, "{\"radius\": 1.}");
+    EXPECT_AGREES(Circle, "{\"radius\": 1e}");
+    EXPECT_AGREES(Circle, "{\"radius\": -}");
+    EXPECT_AGREES(Circle, "{\"radius\": true}");
+    EXPECT_AGREES(Circle, "{\"radius\": null}");
+    EXPECT_AGREES(EnumTestStruct, "{\"status\":3}");
+    EXPECT_AGREES(EnumTestStruct, "{\"status\":99999999999}");
+    EXPECT_AGREES(EnumTestStruct, "{\"status\":1.0}");
+    EXPECT_AGREES(EnumTestStruct, "{\"value\":true}");
+    EXPECT_AGREES(EnumTestStruct, "{\"value\":1e2}");
+    EXPECT_AGREES(EnumTestStruct, "{\"colors_len\":\"x\"}");
+    EXPECT_AGREES(TestStruct, "{\"long_val\":9223372036854775808}");
+    EXPECT_AGREES(TestStruct, "{\"int_val\":-2147483649}");
+    EXPECT_AGREES(PreciseInts, "{\"u8\":-0}");
+    EXPECT_AGREES(PreciseInts, "{\"u64\":18446744073709551616}");
+    EXPECT_AGREES(PreciseInts, "{\"i64\":-9223372036854775808}");
+    EXPECT_AGREES(DefaultBasic, "{\"count\":null}");
+    EXPECT_AGREES(FixStrRecord, "{\"currency\":\"EURO\"}");
+
+    // arrays
+    EXPECT_AGREES(EnumTestStruct, "{\"colors\":[0,]}");
+    EXPECT_AGREES(EnumTestStruct, "{\"colors\":[0 1]}");
+    EXPECT_AGREES(EnumTestStruct, "{\"colors\":[,0]}");
+    EXPECT_AGREES(EnumTestStruct, "{\"colors\":null}");
+    EXPECT_AGREES(PreciseIntArrays, "{\"u32_dyn\":[1 2]}");
+    EXPECT_AGREES(PreciseIntArrays, "{\"u32_dyn\":[,1]}");
+    EXPECT_AGREES(PreciseIntArrays, "{\"u32_dyn\":[1,]}");
+    EXPECT_AGREES(PreciseIntArrays, "{\"u32_dyn\":null}");
+    EXPECT_AGREES(PreciseIntArrays, "{\"i8_arr\":[1,2,3,4,5]}");
+    EXPECT_AGREES(FixedArrayStruct, "{\"fixed_ints\":[1 2]}");
+    EXPECT_AGREES(FixedArrayStruct, "{\"fixed_strings\":[\"a\" \"b\"]}");
+    EXPECT_AGREES(FixedArrayStruct, "{\"fixed_contacts\":[{},]}");
+    EXPECT_AGREES(FixedArrayStruct, "{\"fixed_bools\":[true,false,true]}");
+    EXPECT_AGREES(Data, "{\"people\":[{},]}");
+    EXPECT_AGREES(Data, "{\"people\":[{} {}]}");
+    EXPECT_AGREES(Data, "{\"people\":null}");
+    EXPECT_AGREES(Drawing, "{\"shape\":{\"radius\":1,\"type\":\"circle\"}}");
+    EXPECT_AGREES(Drawing, "{\"shape\":{\"radius\":1}}");
+    EXPECT_AGREES(Drawing,
+                  "{\"shapes\":[{\"type\":\"circle\"} {\"type\":\"circle\"}]}");
+    EXPECT_AGREES(Drawing, "{\"shapes\":null}");
+    EXPECT_AGREES(TreeNode,
+                  "{\"children\":[{\"children\":[{}]},{\"value\":2}],"
+                  "\"value\":1}");
+    EXPECT_AGREES(TreeNode, "{\"children\":[{\"children\":[{} {}]}]}");
+    EXPECT_AGREES(TreeNode, "{\"children\":[{\"children\":[{\"value\":\"x\"}]}]}");
+}